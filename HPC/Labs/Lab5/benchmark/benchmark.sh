@@ -1,41 +1,203 @@
 #!/bin/bash
 
-echo "Compiling LBM..."
-make clean && make
+# Performance regression benchmark of the exercises.
+#
+# Each scenario runs a fixed number of steps. Every (exercise, processes) point is
+# timed without output (-n) after warmup runs, keeping the median of the repeats,
+# then run once more with output to compare the checksum of the last frame with the
+# sequential ex0 result. MLUPS are compared against a stored baseline.
+#
+# Usage: benchmark/benchmark.sh [--save-baseline] [--no-build]
+#   --save-baseline  store the results as the new baseline
+#   --no-build       use the current ./lbm and ./display
+#
+# Settings (environment):
+#   ITERATIONS   steps of each run (2000)
+#   WARMUP       untimed runs before the repeats (1)
+#   REPEATS      timed runs, the median is kept (5)
+#   SCENARIOS    scenarios to run ("default complex wing")
+#   EXERCISES    exercises compared with ex0 ("1 2 3 4 5 6")
+#   RANKS        numbers of processes ("2 4 8")
+#   TOLERANCE    relative MLUPS drop reported as a regression (0.10)
+#   CHECK_TOLERANCE relative checksum difference accepted (0)
+#   BASELINE     baseline file (benchmark/baseline.csv)
+#   MPIRUN       MPI launcher and its options ("mpirun")
+#   MAKE_FLAGS   options of make, e.g. ENABLE_MAGICK_WAND=false
+
+cd "$(dirname "$0")/.." || exit 1
+
+ITERATIONS=${ITERATIONS:-2000}
+WARMUP=${WARMUP:-1}
+REPEATS=${REPEATS:-5}
+SCENARIOS=${SCENARIOS:-"default complex wing"}
+EXERCISES=${EXERCISES:-"1 2 3 4 5 6"}
+RANKS=${RANKS:-"2 4 8"}
+TOLERANCE=${TOLERANCE:-0.10}
+CHECK_TOLERANCE=${CHECK_TOLERANCE:-0}
+BASELINE=${BASELINE:-benchmark/baseline.csv}
+MPIRUN=${MPIRUN:-mpirun}
+
+SAVE_BASELINE=false
+BUILD=true
+for arg in "$@"; do
+    case "$arg" in
+        --save-baseline) SAVE_BASELINE=true ;;
+        --no-build) BUILD=false ;;
+        *) echo "Unknown option $arg"; exit 1 ;;
+    esac
+done
+
+if $BUILD; then
+    echo "Compiling LBM..."
+    make clean && make $MAKE_FLAGS || exit 1
+fi
 
 OUTPUT_FILE="benchmark/benchmark_results.csv"
-echo "Scenario,Exercise,Nodes,Time" > $OUTPUT_FILE
+echo "Scenario,Exercise,Nodes,Time,MLUPS,Speedup,Efficiency,Check" > $OUTPUT_FILE
 
-# Define the scenarios and their respective arguments
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+# Define the scenarios and their respective config files
 declare -A scenarios
 scenarios=(
-    ["default"]=""
-    ["complex"]="-c cases/config-complex.txt"
-    ["wing"]="-c cases/config-wing.txt"
+    ["default"]="config.txt"
+    ["complex"]="cases/config-complex.txt"
+    ["wing"]="cases/config-wing.txt"
 )
 
-# Specify execution order
-SCENARIO_ORDER=("default" "complex" "wing")
+# Config of a run : the scenario with the step count fixed and a single frame at
+# the end (frames 0 and 1), later keys overriding the ones of the scenario.
+make_config() {
+    { sed -e '$a\' "$1"
+      echo "iterations = $((ITERATIONS + 1))"
+      echo "write_interval = $ITERATIONS"
+      echo "output_filename = $2"
+    } > "$3"
+}
+
+# Median of the values given as arguments.
+median() {
+    printf '%s\n' "$@" | sort -g | awk '{v[NR] = $1} END {if (NR % 2) print v[(NR + 1) / 2]; else print (v[NR / 2] + v[NR / 2 + 1]) / 2}'
+}
+
+# Run without output (-n) and keep the time of the loop and the rate measured by
+# the program itself, so mpirun startup and I/O are not part of the numbers.
+# Prints "time mlups" as the median of the repeats, nothing if a run failed.
+run_lbm() {
+    local np=$1 e=$2 config=$3
+    local out r times=() rates=()
+    for ((r = 0 ; r < WARMUP + REPEATS ; r++)); do
+        out=$($MPIRUN -np $np ./lbm -n -c $config -e $e 2>&1)
+        local time=$(echo "$out" | grep "^Total time:" | awk '{print $3}')
+        local mlups=$(echo "$out" | grep "^MLUPS:" | awk '{print $2}')
+        [ -z "$time" ] && return
+        if ((r >= WARMUP)); then
+            times+=($time)
+            rates+=($mlups)
+        fi
+    done
+    echo "$(median "${times[@]}") $(median "${rates[@]}")"
+}
+
+# Run with output and print the checksum of the last frame.
+run_checksum() {
+    local np=$1 e=$2 config=$3 raw=$4
+    rm -f $raw
+    $MPIRUN -np $np ./lbm -c $config -e $e > /dev/null 2>&1 || return
+    ./display --checksum $raw 1 2> /dev/null | awk '{print $3}'
+}
 
-for scenario in "${SCENARIO_ORDER[@]}"; do
-    args="${scenarios[$scenario]}"
+# Tell if a checksum matches the reference one.
+same_checksum() {
+    [ -n "$1" ] && [ -n "$2" ] && awk -v a=$1 -v b=$2 -v tol=$CHECK_TOLERANCE \
+        'BEGIN {d = a - b; if (d < 0) d = -d; r = (b < 0) ? -b : b; exit !(d <= tol * r)}'
+}
+
+FAILURES=0
+
+for scenario in $SCENARIOS; do
     echo "======================================"
     echo "Starting Scenario: $scenario"
     echo "======================================"
-    
-    TIME_SEC=$(/usr/bin/time -f "%e" mpirun -np 1 ./lbm -e 0 $args 2>&1 >/dev/null | tail -n 1)
-    
-    echo "$scenario,0,1,$TIME_SEC" >> $OUTPUT_FILE
-    for e in {1..6}; do
-        for np in 2 4 8; do
+
+    # sequential reference
+    raw="$WORK_DIR/$scenario.raw"
+    config="$WORK_DIR/$scenario.txt"
+    make_config "${scenarios[$scenario]}" $raw $config
+    REF_CHECKSUM=$(run_checksum 1 0 $config $raw)
+    read REF_TIME REF_MLUPS <<< "$(run_lbm 1 0 $config)"
+    if [ -z "$REF_TIME" ] || [ -z "$REF_CHECKSUM" ]; then
+        echo "Reference run of $scenario failed, skipping the scenario"
+        echo "$scenario,0,1,,,,,FAIL" >> $OUTPUT_FILE
+        FAILURES=$((FAILURES + 1))
+        continue
+    fi
+    echo "$scenario,0,1,$REF_TIME,$REF_MLUPS,1,1,ref" >> $OUTPUT_FILE
+
+    for e in $EXERCISES; do
+        for np in $RANKS; do
             echo "Running $scenario | Exercise $e | Nodes $np..."
-            # Capture execution time in seconds
-            TIME_SEC=$(/usr/bin/time -f "%e" mpirun -np $np ./lbm -e $e $args 2>&1 >/dev/null | tail -n 1)
-            
-            # Log to CSV
-            echo "$scenario,$e,$np,$TIME_SEC" >> $OUTPUT_FILE
+            read TIME MLUPS <<< "$(run_lbm $np $e $config)"
+            CHECKSUM=$(run_checksum $np $e $config $raw)
+
+            # correctness against ex0
+            if [ -z "$TIME" ] || [ -z "$CHECKSUM" ]; then
+                CHECK=FAIL
+            elif same_checksum $CHECKSUM $REF_CHECKSUM; then
+                CHECK=ok
+            else
+                CHECK=MISMATCH
+            fi
+            [ "$CHECK" != ok ] && FAILURES=$((FAILURES + 1)) && echo "  $CHECK (checksum $CHECKSUM, ex0 $REF_CHECKSUM)"
+
+            # speedup and parallel efficiency against ex0
+            if [ -n "$TIME" ]; then
+                SPEEDUP=$(awk -v t=$TIME -v r=$REF_TIME 'BEGIN {printf "%.3f", r / t}')
+                EFFICIENCY=$(awk -v s=$SPEEDUP -v np=$np 'BEGIN {printf "%.3f", s / np}')
+            else
+                SPEEDUP=
+                EFFICIENCY=
+            fi
+            echo "$scenario,$e,$np,$TIME,$MLUPS,$SPEEDUP,$EFFICIENCY,$CHECK" >> $OUTPUT_FILE
         done
     done
 done
 
 echo "Benchmarking complete. Data saved to $OUTPUT_FILE"
+
+# Regressions against the baseline, matched on scenario, exercise and processes.
+REGRESSIONS=0
+if $SAVE_BASELINE; then
+    cp $OUTPUT_FILE $BASELINE
+    echo "Baseline saved to $BASELINE"
+elif [ -f $BASELINE ]; then
+    echo "======================================"
+    echo "Comparison with $BASELINE (tolerance $TOLERANCE)"
+    echo "======================================"
+    REGRESSIONS=$(awk -F, -v tol=$TOLERANCE '
+        FNR == 1 {next}
+        NR == FNR {base[$1 "," $2 "," $3] = $5; next}
+        {
+            key = $1 "," $2 "," $3
+            if (!(key in base) || base[key] == "" || $5 == "") {
+                printf "%-10s ex%-3s np%-3s %10s -> %10s MLUPS   not compared\n", $1, $2, $3, base[key], $5 > "/dev/stderr"
+                next
+            }
+            ratio = $5 / base[key]
+            status = "ok"
+            if (ratio < 1 - tol) { status = "REGRESSION"; count++ }
+            else if (ratio > 1 + tol) status = "faster"
+            printf "%-10s ex%-3s np%-3s %10.3f -> %10.3f MLUPS %+7.1f%%  %s\n", $1, $2, $3, base[key], $5, (ratio - 1) * 100, status > "/dev/stderr"
+        }
+        END {print count + 0}' $BASELINE $OUTPUT_FILE)
+    echo "$REGRESSIONS regression(s)"
+else
+    echo "No baseline ($BASELINE), store one with --save-baseline"
+fi
+
+# failure status for automated runs
+if ((FAILURES > 0 || REGRESSIONS > 0)); then
+    echo "$FAILURES failed or mismatching run(s), $REGRESSIONS regression(s)"
+    exit 1
+fi
@@ -25,8 +25,8 @@ void lbm_comm_init_ex0(lbm_comm_t * comm, int total_width, int total_height)
 	//get infos
 	int rank;
 	int comm_size;
-	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	MPI_Comm_size( lbm_comm_world, &comm_size );
 
 	//check
 	if (comm_size != 1)
@@ -74,14 +74,20 @@ void lbm_comm_ghost_exchange_ex0(lbm_comm_t * comm, lbm_mesh_t * mesh)
 void lbm_do_step_ex0(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh)
 {
 	//compute special actions (border, obstacle...)
+	double start = lbm_timer_now();
 	lbm_phys_special_cells( mesh, mesh_type, comm);
+	lbm_timer_add(LBM_TIMER_SPECIAL_CELLS, start);
 
 	//compute lbm_phys_collision term
+	start = lbm_timer_now();
 	lbm_phys_collision( temp_mesh, mesh);
+	lbm_timer_add(LBM_TIMER_COLLISION, start);
 
 	//propagate values from node to neighboors
 	lbm_comm_ghost_exchange_ex_select( comm, temp_mesh );
 
 	//compute fuild displacement from cells to cells
+	start = lbm_timer_now();
 	lbm_phys_propagation( mesh, temp_mesh);
+	lbm_timer_add(LBM_TIMER_PROPAGATION, start);
 }
@@ -32,13 +32,11 @@ void lbm_comm_init_ex1(lbm_comm_t * comm, int total_width, int total_height)
 	//get infos
 	int rank;
 	int comm_size;
-	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	MPI_Comm_size( lbm_comm_world, &comm_size );
 
     //initialize mpi communicator
-    comm->communicator = MPI_COMM_WORLD;
-
-    if (total_width%comm_size !=0){abort();}
+    comm->communicator = lbm_comm_world;
 
 	comm->nb_x = comm_size;
 	comm->nb_y = 1;
@@ -47,13 +45,9 @@ void lbm_comm_init_ex1(lbm_comm_t * comm, int total_width, int total_height)
 	comm->rank_x = rank;
 	comm->rank_y = 0;
 
-	// local sub-domain size
-	comm->width = total_width/comm_size +2;
-	comm->height = total_height+2;
-
-	// absolute position in the global mesh.
-	comm->x = (total_width/comm_size)*rank;
-	comm->y = 0;
+	// local sub-domain size and absolute position in the global mesh
+	// (block split, the width does not need to be a multiple of comm_size)
+	lbm_comm_setup_local_domain(comm, total_width, total_height);
 
 	//if debug print comm
 	//lbm_comm_print(comm);
@@ -69,27 +63,31 @@ void lbm_comm_ghost_exchange_ex1(lbm_comm_t * comm, lbm_mesh_t * mesh)
 	//get infos
 	int rank;
 	int comm_size;
-	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	MPI_Comm_size( lbm_comm_world, &comm_size );
+
 
+    // the exchange is only made of blocking calls, all of it is waiting
+    double start = lbm_timer_now();
 
     // send data forwards
     if (rank<comm_size-1){
-	    double * cell_send = lbm_mesh_get_cell(mesh, comm->width-2, 0);
-        MPI_Send(cell_send, DIRECTIONS*comm->height, MPI_DOUBLE, rank+1, 0, comm->communicator);
+	    lbm_real_t * cell_send = lbm_mesh_get_cell(mesh, comm->width-2, 0);
+        MPI_Send(cell_send, DIRECTIONS*comm->height, LBM_MPI_REAL, rank+1, 0, comm->communicator);
     }
     if (rank>0){
-	    double * cell_rcv = lbm_mesh_get_cell(mesh, 0, 0);
-        MPI_Recv(cell_rcv, DIRECTIONS*comm->height, MPI_DOUBLE, rank-1, 0, comm->communicator,MPI_STATUS_IGNORE);
+	    lbm_real_t * cell_rcv = lbm_mesh_get_cell(mesh, 0, 0);
+        MPI_Recv(cell_rcv, DIRECTIONS*comm->height, LBM_MPI_REAL, rank-1, 0, comm->communicator,MPI_STATUS_IGNORE);
     }
 
     // send data backwards
     if (rank>0){
-	    double * cell_send = lbm_mesh_get_cell(mesh, 1, 0);
-        MPI_Send(cell_send, DIRECTIONS*comm->height, MPI_DOUBLE, rank-1, 1, comm->communicator);
+	    lbm_real_t * cell_send = lbm_mesh_get_cell(mesh, 1, 0);
+        MPI_Send(cell_send, DIRECTIONS*comm->height, LBM_MPI_REAL, rank-1, 1, comm->communicator);
     }
     if (rank<comm_size-1){
-	    double * cell_rcv = lbm_mesh_get_cell(mesh, comm->width-1, 0);
-        MPI_Recv(cell_rcv, DIRECTIONS*comm->height, MPI_DOUBLE, rank+1, 1, comm->communicator,MPI_STATUS_IGNORE);
+	    lbm_real_t * cell_rcv = lbm_mesh_get_cell(mesh, comm->width-1, 0);
+        MPI_Recv(cell_rcv, DIRECTIONS*comm->height, LBM_MPI_REAL, rank+1, 1, comm->communicator,MPI_STATUS_IGNORE);
     }
+    lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
 }
@@ -0,0 +1,193 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+//////////////////////////////////////////////////////
+//
+// Goal: Exchange k layers of ghost cells once every
+//       k steps and advance the steps in between
+//       without any communication.
+//
+// SUMMARY:
+//     - 2D splitting along X and Y
+//     - 8 neighbors communications
+//     - MPI type for non contiguous cells
+//     - MPI_Neighbor_alltoallw on a graph communicator
+// NEW:
+//     - >>> Ghost depth k (-g option or ghost_depth) <<<
+//     - >>> Shrinking valid region between exchanges <<<
+//
+//////////////////////////////////////////////////////
+
+/****************************************************/
+#include "src/lbm_struct.h"
+#include "src/exercises.h"
+
+/****************************************************/
+/** Offsets of the 8 neighbors. **/
+static const int lbm_comm_ex10_neighbors[LBM_NEIGHBORS_2D][2] = {
+	{ 1, 0}, { 0, 1}, {-1, 0}, { 0,-1},
+	{ 1, 1}, {-1, 1}, {-1,-1}, { 1,-1}
+};
+
+/****************************************************/
+static int lbm_comm_rank_at(lbm_comm_t * comm, int rank_x, int rank_y)
+{
+	if (rank_x < 0 || rank_x >= comm->nb_x || rank_y < 0 || rank_y >= comm->nb_y)
+		return MPI_PROC_NULL;
+
+	int coords[2] = {rank_x, rank_y};
+	int rank;
+	MPI_Cart_rank(comm->communicator, coords, &rank);
+	return rank;
+}
+
+/****************************************************/
+/**
+ * Build the type of a block of full cells (all the directions are needed as
+ * the ghost cells are computed again until the next exchange).
+ * @param columns Number of columns of the block.
+ * @param rows Number of cells in each column of the block.
+ * @param height Height of the local mesh (distance between two columns).
+**/
+static void lbm_comm_ex10_build_type(MPI_Datatype * type, int columns, int rows, int height)
+{
+	MPI_Type_vector(columns, rows * DIRECTIONS, height * DIRECTIONS, LBM_MPI_REAL, type);
+	MPI_Type_commit(type);
+}
+
+/****************************************************/
+/**
+ * Cells of the local mesh to compute along one axis, sub_step steps after the
+ * exchange. Toward a neighbor the valid cells shrink by one each step, on the
+ * global borders we stay on the outer ring of the global mesh as the extra
+ * ghost layers are outside of it.
+ * @param neighbor True if there is a neighbor on the low (resp. high) side.
+**/
+static void lbm_comm_ex10_range(int size, int ghost, int sub_step, const int neighbor[2], int * start, int * end)
+{
+	*start = neighbor[0] ? sub_step : ghost - 1;
+	*end = neighbor[1] ? size - sub_step : size - ghost + 1;
+}
+
+/****************************************************/
+void lbm_comm_init_ex10(lbm_comm_t * comm, int total_width, int total_height)
+{
+	//vars
+	int k;
+	int neighbors[MAX_NEIGHBORS];
+	int weights[MAX_NEIGHBORS];
+	int w, h, g;
+
+	//deep ghost layers (check_comm does not load a config, keep one layer)
+	comm->ghost = (GHOST_DEPTH > 1) ? GHOST_DEPTH : 1;
+	comm->ghost_step = 0;
+	if (comm->ghost > 1 && SPARSE_MODE)
+		fatal("The sparse mode needs a ghost depth of 1 !");
+
+	//we use the same implementation than ex4 for the 2D splitting
+	lbm_comm_init_ex4(comm, total_width, total_height);
+	w = comm->width;
+	h = comm->height;
+	g = comm->ghost;
+
+	//neighbors on each side
+	comm->has_neighbor[0] = lbm_comm_rank_at(comm, comm->rank_x - 1, comm->rank_y) != MPI_PROC_NULL;
+	comm->has_neighbor[1] = lbm_comm_rank_at(comm, comm->rank_x + 1, comm->rank_y) != MPI_PROC_NULL;
+	comm->has_neighbor[2] = lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y - 1) != MPI_PROC_NULL;
+	comm->has_neighbor[3] = lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y + 1) != MPI_PROC_NULL;
+
+	//extent of the sides, on global borders the outer ring is a real cell with
+	//no diagonal neighbor to send it, so it travels with the side
+	int x_start = comm->has_neighbor[0] ? g : g - 1;
+	int x_end   = comm->has_neighbor[1] ? w - g : w - g + 1;
+	int y_start = comm->has_neighbor[2] ? g : g - 1;
+	int y_end   = comm->has_neighbor[3] ? h - g : h - g + 1;
+
+	//build types for existing neighbors
+	comm->nb_neighbors = 0;
+	for (k = 0 ; k < LBM_NEIGHBORS_2D ; k++)
+	{
+		int dx = lbm_comm_ex10_neighbors[k][0];
+		int dy = lbm_comm_ex10_neighbors[k][1];
+		int peer = lbm_comm_rank_at(comm, comm->rank_x + dx, comm->rank_y + dy);
+		if (peer == MPI_PROC_NULL)
+			continue;
+
+		//first cell of the g last inner layers to send and of the g ghost layers to receive
+		int send_x = (dx == 0) ? x_start : ((dx > 0) ? w - 2 * g : g);
+		int send_y = (dy == 0) ? y_start : ((dy > 0) ? h - 2 * g : g);
+		int recv_x = (dx == 0) ? x_start : ((dx > 0) ? w - g : 0);
+		int recv_y = (dy == 0) ? y_start : ((dy > 0) ? h - g : 0);
+		int columns = (dx == 0) ? x_end - x_start : g;
+		int rows = (dy == 0) ? y_end - y_start : g;
+
+		//same block shape in both directions
+		int id = comm->nb_neighbors++;
+		neighbors[id] = peer;
+		weights[id] = columns * rows;
+		lbm_comm_ex10_build_type(&comm->send_types[id], columns, rows, h);
+		lbm_comm_ex10_build_type(&comm->recv_types[id], columns, rows, h);
+		comm->send_displs[id] = (MPI_Aint)(send_x * h + send_y) * DIRECTIONS * sizeof(lbm_real_t);
+		comm->recv_displs[id] = (MPI_Aint)(recv_x * h + recv_y) * DIRECTIONS * sizeof(lbm_real_t);
+	}
+
+	//graph communicator with the 8 neighbors, edges weighted by the number of cells
+	MPI_Dist_graph_create_adjacent(comm->communicator,
+		comm->nb_neighbors, neighbors, weights,
+		comm->nb_neighbors, neighbors, weights,
+		MPI_INFO_NULL, 0, &comm->neighbor_communicator);
+}
+
+/****************************************************/
+void lbm_comm_release_ex10(lbm_comm_t * comm)
+{
+	//same resources than ex9
+	lbm_comm_release_ex9(comm);
+}
+
+/****************************************************/
+void lbm_comm_ghost_exchange_ex10(lbm_comm_t * comm, lbm_mesh_t * mesh)
+{
+	//same single phase exchange than ex9, only the types differ
+	lbm_comm_ghost_exchange_ex9(comm, mesh);
+}
+
+/****************************************************/
+void lbm_do_step_ex10(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh)
+{
+	//vars
+	int g = comm->ghost;
+	int s = comm->ghost_step;
+	int x_start, x_end, y_start, y_end;
+
+	//compute special actions (border, obstacle...), the ones on invalid ghost cells are harmless
+	double start = lbm_timer_now();
+	lbm_phys_special_cells( mesh, mesh_type, comm);
+	lbm_timer_add(LBM_TIMER_SPECIAL_CELLS, start);
+
+	//collision on the valid cells, on exchange steps the ghost layers will be received
+	lbm_comm_ex10_range(mesh->width, g, (s == 0) ? g : s, comm->has_neighbor, &x_start, &x_end);
+	lbm_comm_ex10_range(mesh->height, g, (s == 0) ? g : s, comm->has_neighbor + 2, &y_start, &y_end);
+	start = lbm_timer_now();
+	lbm_phys_collision_region( temp_mesh, mesh, x_start, x_end, y_start, y_end);
+	lbm_timer_add(LBM_TIMER_COLLISION, start);
+
+	//refresh the g ghost layers once every g steps
+	if (s == 0)
+		lbm_comm_ghost_exchange_ex_select( comm, temp_mesh );
+
+	//propagation from the valid cells, the valid region shrink by one cell
+	lbm_comm_ex10_range(mesh->width, g, s, comm->has_neighbor, &x_start, &x_end);
+	lbm_comm_ex10_range(mesh->height, g, s, comm->has_neighbor + 2, &y_start, &y_end);
+	start = lbm_timer_now();
+	lbm_phys_propagation_region( mesh, temp_mesh, x_start, x_end, y_start, y_end);
+	lbm_timer_add(LBM_TIMER_PROPAGATION, start);
+
+	//next step in the block
+	comm->ghost_step = (s + 1) % g;
+}
@@ -0,0 +1,370 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+//////////////////////////////////////////////////////
+//
+// Goal: Read the ghost cells of the neighbors on the
+//       same node directly from their mesh instead of
+//       copying them through MPI buffers.
+//
+// SUMMARY:
+//     - 2D splitting along X and Y
+//     - 8 neighbors communications
+//     - MPI type selecting the crossing directions
+// NEW:
+//     - >>> MPI_Comm_split_type(MPI_COMM_TYPE_SHARED) <<<
+//     - >>> MPI_Win_allocate_shared for the temporary mesh <<<
+//     - >>> Zero-byte notifications instead of barriers <<<
+//     - >>> Point-to-point fallback for off-node neighbors <<<
+//
+//////////////////////////////////////////////////////
+
+/****************************************************/
+#include <string.h>
+#include "src/lbm_struct.h"
+#include "src/exercises.h"
+
+/****************************************************/
+/** Offsets of the 8 neighbors. **/
+static const int lbm_comm_ex11_neighbors[LBM_NEIGHBORS_2D][2] = {
+	{ 1, 0}, { 0, 1}, {-1, 0}, { 0,-1},
+	{ 1, 1}, {-1, 1}, {-1,-1}, { 1,-1}
+};
+
+/****************************************************/
+/** Tags of the notifications, the data messages use the direction (0 to 7). **/
+#define LBM_EX11_TAG_READY 100
+#define LBM_EX11_TAG_DONE  101
+#define LBM_EX11_TAG_SHAPE 102
+
+/****************************************************/
+static int lbm_comm_rank_at(lbm_comm_t * comm, int rank_x, int rank_y)
+{
+	if (rank_x < 0 || rank_x >= comm->nb_x || rank_y < 0 || rank_y >= comm->nb_y)
+		return MPI_PROC_NULL;
+
+	int coords[2] = {rank_x, rank_y};
+	int rank;
+	MPI_Cart_rank(comm->communicator, coords, &rank);
+	return rank;
+}
+
+/****************************************************/
+/** Directions moving along (dx,dy), ie. the ones reaching the neighbor at this offset. **/
+static int lbm_comm_ex11_select_dirs(int dx, int dy, int dirs[DIRECTIONS])
+{
+	int k;
+	int nb_dirs = 0;
+	for (k = 0 ; k < DIRECTIONS ; k++)
+		if ((dx == 0 || direction_matrix[k][0] == dx) && (dy == 0 || direction_matrix[k][1] == dy))
+			dirs[nb_dirs++] = k;
+	return nb_dirs;
+}
+
+/****************************************************/
+/**
+ * Build the type of a line of cells only keeping the directions moving along
+ * (dx,dy), same as ex9, for the neighbors on other nodes.
+ * @param count Number of cells in the line.
+ * @param stride Distance in cells between two cells of the line.
+**/
+static void lbm_comm_ex11_build_type(MPI_Datatype * type, int dx, int dy, int count, int stride)
+{
+	//vars
+	int nb_dirs;
+	int dirs[DIRECTIONS];
+	MPI_Datatype cell_type;
+	MPI_Datatype cell_type_resized;
+
+	//one cell, with the extent of a full cell
+	nb_dirs = lbm_comm_ex11_select_dirs(dx, dy, dirs);
+	MPI_Type_create_indexed_block(nb_dirs, 1, dirs, LBM_MPI_REAL, &cell_type);
+	MPI_Type_create_resized(cell_type, 0, DIRECTIONS * sizeof(lbm_real_t), &cell_type_resized);
+
+	//the line
+	MPI_Type_create_hvector(count, 1, (MPI_Aint)stride * DIRECTIONS * sizeof(lbm_real_t), cell_type_resized, type);
+	MPI_Type_commit(type);
+
+	//free temp types
+	MPI_Type_free(&cell_type);
+	MPI_Type_free(&cell_type_resized);
+}
+
+/****************************************************/
+/** Tag used by the neighbor in direction k to reach us (it sees us in the opposite direction). **/
+static int lbm_comm_ex11_opposite(int k)
+{
+	return (k < 4) ? (k + 2) % 4 : 4 + (k - 4 + 2) % 4;
+}
+
+/****************************************************/
+void lbm_comm_init_ex11(lbm_comm_t * comm, int total_width, int total_height)
+{
+	//vars
+	int k;
+	int w, h;
+	int node_rank;
+	int shape[3];
+	int peer_shapes[MAX_NEIGHBORS][3];
+	MPI_Request requests[2 * MAX_NEIGHBORS];
+	MPI_Group group, node_group;
+	MPI_Info info;
+
+	//we use the same implementation than ex4 for the 2D splitting
+	lbm_comm_init_ex4(comm, total_width, total_height);
+	w = comm->width;
+	h = comm->height;
+
+	//extent of the sides, on global borders the ghost row/column is a real cell
+	//with no diagonal neighbor to send it, so it travels with the side (see ex9).
+	int x_start = (lbm_comm_rank_at(comm, comm->rank_x - 1, comm->rank_y) == MPI_PROC_NULL) ? 0 : 1;
+	int x_end   = (lbm_comm_rank_at(comm, comm->rank_x + 1, comm->rank_y) == MPI_PROC_NULL) ? w : w - 1;
+	int y_start = (lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y - 1) == MPI_PROC_NULL) ? 0 : 1;
+	int y_end   = (lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y + 1) == MPI_PROC_NULL) ? h : h - 1;
+
+	//tasks sharing the memory, each one exposes its temporary mesh. Non contiguous
+	//allocation keeps each part on the NUMA node of its owner.
+	MPI_Comm_split_type(comm->communicator, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &comm->node_communicator);
+	MPI_Info_create(&info);
+	MPI_Info_set(info, "alloc_shared_noncontig", "true");
+	MPI_Win_allocate_shared((MPI_Aint)w * h * DIRECTIONS * sizeof(lbm_real_t), sizeof(lbm_real_t), info,
+		comm->node_communicator, &comm->shared_cells, &comm->shared_window);
+	MPI_Info_free(&info);
+	memset(comm->shared_cells, 0, (size_t)w * h * DIRECTIONS * sizeof(lbm_real_t));
+	comm->shared_source = NULL;
+	comm->nb_pending = 0;
+
+	//passive access for the whole run, we only synchronize with MPI_Win_sync
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, comm->shared_window);
+
+	//neighbors, the types are only used if they are on another node
+	comm->nb_neighbors = 0;
+	for (k = 0 ; k < LBM_NEIGHBORS_2D ; k++)
+	{
+		int dx = lbm_comm_ex11_neighbors[k][0];
+		int dy = lbm_comm_ex11_neighbors[k][1];
+		int peer = lbm_comm_rank_at(comm, comm->rank_x + dx, comm->rank_y + dy);
+		if (peer == MPI_PROC_NULL)
+			continue;
+
+		//first cell to send and to receive
+		int send_x = (dx == 0) ? x_start : ((dx > 0) ? w - 2 : 1);
+		int send_y = (dy == 0) ? y_start : ((dy > 0) ? h - 2 : 1);
+		int recv_x = (dx == 0) ? x_start : ((dx > 0) ? w - 1 : 0);
+		int recv_y = (dy == 0) ? y_start : ((dy > 0) ? h - 1 : 0);
+
+		//shape of the side : column (contiguous), row (stride of a column) or corner
+		int count = 1;
+		int stride = 1;
+		if (dx != 0 && dy == 0) {
+			count = y_end - y_start;
+		} else if (dx == 0) {
+			count = x_end - x_start;
+			stride = h;
+		}
+
+		//point-to-point fallback
+		int id = comm->nb_neighbors++;
+		comm->neighbor_ranks[id] = peer;
+		comm->neighbor_dirs[id] = k;
+		lbm_comm_ex11_build_type(&comm->send_types[id], dx, dy, count, stride);
+		lbm_comm_ex11_build_type(&comm->recv_types[id], -dx, -dy, count, stride);
+		comm->send_displs[id] = (MPI_Aint)(send_x * h + send_y) * DIRECTIONS * sizeof(lbm_real_t);
+		comm->recv_displs[id] = (MPI_Aint)(recv_x * h + recv_y) * DIRECTIONS * sizeof(lbm_real_t);
+
+		//direct copy, the source is known once we have the position of the neighbor
+		lbm_comm_shared_copy_t * copy = &comm->shared_copies[id];
+		copy->src = NULL;
+		copy->dst = recv_x * h + recv_y;
+		copy->dst_stride = stride;
+		copy->count = count;
+		copy->nb_dirs = lbm_comm_ex11_select_dirs(-dx, -dy, copy->dirs);
+	}
+
+	//position and height of the neighbors to address their mesh
+	shape[0] = comm->x;
+	shape[1] = comm->y;
+	shape[2] = h;
+	for (k = 0 ; k < comm->nb_neighbors ; k++)
+	{
+		MPI_Irecv(peer_shapes[k], 3, MPI_INT, comm->neighbor_ranks[k], LBM_EX11_TAG_SHAPE, comm->communicator, &requests[2 * k]);
+		MPI_Isend(shape, 3, MPI_INT, comm->neighbor_ranks[k], LBM_EX11_TAG_SHAPE, comm->communicator, &requests[2 * k + 1]);
+	}
+	MPI_Waitall(2 * comm->nb_neighbors, requests, MPI_STATUSES_IGNORE);
+
+	//find the neighbors on the node and the address of their mesh
+	MPI_Comm_group(comm->communicator, &group);
+	MPI_Comm_group(comm->node_communicator, &node_group);
+	for (k = 0 ; k < comm->nb_neighbors ; k++)
+	{
+		MPI_Aint size;
+		int disp_unit;
+		lbm_real_t * base;
+		lbm_comm_shared_copy_t * copy = &comm->shared_copies[k];
+
+		MPI_Group_translate_ranks(group, 1, &comm->neighbor_ranks[k], node_group, &node_rank);
+		if (node_rank == MPI_UNDEFINED)
+			continue;
+		MPI_Win_shared_query(comm->shared_window, node_rank, &size, &disp_unit, &base);
+
+		//our ghost cell i is the global cell x + i, so the cell x + i - peer_x of the neighbor
+		int dst_x = copy->dst / h;
+		int dst_y = copy->dst % h;
+		int src_x = comm->x + dst_x - peer_shapes[k][0];
+		int src_y = comm->y + dst_y - peer_shapes[k][1];
+		copy->src = base + (size_t)(src_x * peer_shapes[k][2] + src_y) * DIRECTIONS;
+		copy->src_stride = (copy->dst_stride == 1) ? 1 : peer_shapes[k][2];
+	}
+	MPI_Group_free(&group);
+	MPI_Group_free(&node_group);
+}
+
+/****************************************************/
+/**
+ * Wait the neighbors on the node to have read our ghost cells of the last exchange
+ * before overwriting the temporary mesh.
+**/
+static void lbm_comm_ex11_wait_readers(lbm_comm_t * comm)
+{
+	if (comm->nb_pending == 0)
+		return;
+	MPI_Waitall(comm->nb_pending, comm->requests, MPI_STATUSES_IGNORE);
+	comm->nb_pending = 0;
+}
+
+/****************************************************/
+void lbm_comm_release_ex11(lbm_comm_t * comm)
+{
+	//vars
+	int k;
+
+	//neighbors can still be reading us
+	lbm_comm_ex11_wait_readers(comm);
+
+	//free types
+	for (k = 0 ; k < comm->nb_neighbors ; k++)
+	{
+		MPI_Type_free(&comm->send_types[k]);
+		MPI_Type_free(&comm->recv_types[k]);
+	}
+	comm->nb_neighbors = 0;
+
+	//free the window
+	MPI_Win_unlock_all(comm->shared_window);
+	MPI_Win_free(&comm->shared_window);
+	MPI_Comm_free(&comm->node_communicator);
+	comm->shared_cells = NULL;
+
+	//we use the same implementation than ex4 for the 2D splitting release
+	lbm_comm_release_ex4(comm);
+}
+
+/****************************************************/
+void lbm_comm_ghost_exchange_ex11(lbm_comm_t * comm, lbm_mesh_t * mesh)
+{
+	//vars
+	int k, c, d;
+	int nb_requests = 0;
+	int nb_notify = 0;
+	MPI_Request requests[2 * MAX_NEIGHBORS];
+	MPI_Request notify[2 * MAX_NEIGHBORS];
+	size_t cell_size = (size_t)mesh->width * mesh->height * DIRECTIONS * sizeof(lbm_real_t);
+
+	//notifications of the last exchange (already waited by lbm_do_step_ex11())
+	lbm_comm_ex11_wait_readers(comm);
+
+	//the neighbors read the shared window, publish the mesh there if it is not in it
+	if (mesh->cells != comm->shared_cells)
+		memcpy(comm->shared_cells, mesh->cells, cell_size);
+
+	//off-node neighbors use point-to-point messages, on-node ones get a notification
+	//telling our cells are ready
+	for (k = 0 ; k < comm->nb_neighbors ; k++)
+	{
+		int peer = comm->neighbor_ranks[k];
+		int dir = comm->neighbor_dirs[k];
+		if (comm->shared_copies[k].src == NULL) {
+			MPI_Irecv((char*)mesh->cells + comm->recv_displs[k], 1, comm->recv_types[k], peer, lbm_comm_ex11_opposite(dir), comm->communicator, &requests[nb_requests++]);
+			MPI_Isend((char*)mesh->cells + comm->send_displs[k], 1, comm->send_types[k], peer, dir, comm->communicator, &requests[nb_requests++]);
+		} else {
+			MPI_Irecv(NULL, 0, MPI_BYTE, peer, LBM_EX11_TAG_READY, comm->communicator, &notify[nb_notify++]);
+			MPI_Isend(NULL, 0, MPI_BYTE, peer, LBM_EX11_TAG_READY, comm->communicator, &notify[nb_notify++]);
+		}
+	}
+
+	//make our stores visible and see the ones of the neighbors
+	double start = lbm_timer_now();
+	MPI_Win_sync(comm->shared_window);
+	MPI_Waitall(nb_notify, notify, MPI_STATUSES_IGNORE);
+	MPI_Win_sync(comm->shared_window);
+	lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
+
+	//read the sides of the on-node neighbors, only the directions coming toward us
+	for (k = 0 ; k < comm->nb_neighbors ; k++)
+	{
+		const lbm_comm_shared_copy_t * copy = &comm->shared_copies[k];
+		if (copy->src == NULL)
+			continue;
+		for (c = 0 ; c < copy->count ; c++)
+		{
+			const lbm_real_t * src = copy->src + (size_t)c * copy->src_stride * DIRECTIONS;
+			lbm_real_t * dst = mesh->cells + (size_t)(copy->dst + c * copy->dst_stride) * DIRECTIONS;
+			for (d = 0 ; d < copy->nb_dirs ; d++)
+				dst[copy->dirs[d]] = src[copy->dirs[d]];
+		}
+
+		//tell the neighbor it can overwrite its mesh, waited before the next collision
+		MPI_Irecv(NULL, 0, MPI_BYTE, comm->neighbor_ranks[k], LBM_EX11_TAG_DONE, comm->communicator, &comm->requests[comm->nb_pending++]);
+		MPI_Isend(NULL, 0, MPI_BYTE, comm->neighbor_ranks[k], LBM_EX11_TAG_DONE, comm->communicator, &comm->requests[comm->nb_pending++]);
+	}
+
+	//off-node messages
+	start = lbm_timer_now();
+	MPI_Waitall(nb_requests, requests, MPI_STATUSES_IGNORE);
+	lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
+}
+
+/****************************************************/
+void lbm_do_step_ex11(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh)
+{
+	//the temporary mesh is the one of the shared window
+	lbm_mesh_t shared_mesh = {
+		.width = temp_mesh->width,
+		.height = temp_mesh->height,
+		.cells = comm->shared_cells,
+	};
+
+	//start from the initial state of the temporary mesh
+	if (comm->shared_source != temp_mesh->cells) {
+		memcpy(shared_mesh.cells, temp_mesh->cells, (size_t)temp_mesh->width * temp_mesh->height * DIRECTIONS * sizeof(lbm_real_t));
+		comm->shared_source = temp_mesh->cells;
+	}
+
+	//compute special actions (border, obstacle...)
+	double start = lbm_timer_now();
+	lbm_phys_special_cells( mesh, mesh_type, comm);
+	lbm_timer_add(LBM_TIMER_SPECIAL_CELLS, start);
+
+	//the neighbors must have read the ghost cells of the last step
+	start = lbm_timer_now();
+	lbm_comm_ex11_wait_readers(comm);
+	lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
+
+	//compute lbm_phys_collision term
+	start = lbm_timer_now();
+	lbm_phys_collision( &shared_mesh, mesh);
+	lbm_timer_add(LBM_TIMER_COLLISION, start);
+
+	//propagate values from node to neighboors
+	lbm_comm_ghost_exchange_ex_select( comm, &shared_mesh );
+
+	//compute fuild displacement from cells to cells
+	start = lbm_timer_now();
+	lbm_phys_propagation( mesh, &shared_mesh);
+	lbm_timer_add(LBM_TIMER_PROPAGATION, start);
+}
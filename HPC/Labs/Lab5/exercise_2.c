@@ -40,20 +40,23 @@ void lbm_comm_ghost_exchange_ex2(lbm_comm_t * comm, lbm_mesh_t * mesh)
 	//get infos
 	int rank;
 	int comm_size;
-	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	MPI_Comm_size( lbm_comm_world, &comm_size );
+
+    // the exchange is only made of blocking calls, all of it is waiting
+    double start = lbm_timer_now();
 
     // odd sends
     if (rank%2==1){
         // send right side
         if (rank<comm_size-1){
-            double * cell_send = lbm_mesh_get_cell(mesh, comm->width-2, 0);
-            MPI_Send(cell_send, DIRECTIONS*comm->height, MPI_DOUBLE, rank+1, 0, comm->communicator);
+            lbm_real_t * cell_send = lbm_mesh_get_cell(mesh, comm->width-2, 0);
+            MPI_Send(cell_send, DIRECTIONS*comm->height, LBM_MPI_REAL, rank+1, 0, comm->communicator);
         }
         // send left side
         if (rank>0){
-            double * cell_send = lbm_mesh_get_cell(mesh, 1, 0);
-            MPI_Send(cell_send, DIRECTIONS*comm->height, MPI_DOUBLE, rank-1, 1, comm->communicator);
+            lbm_real_t * cell_send = lbm_mesh_get_cell(mesh, 1, 0);
+            MPI_Send(cell_send, DIRECTIONS*comm->height, LBM_MPI_REAL, rank-1, 1, comm->communicator);
         }
     }
 
@@ -61,14 +64,14 @@ void lbm_comm_ghost_exchange_ex2(lbm_comm_t * comm, lbm_mesh_t * mesh)
     if (rank%2==0){
         // receive left side
         if (rank>0){
-            double * cell_rcv = lbm_mesh_get_cell(mesh, 0, 0);
-            MPI_Recv(cell_rcv, DIRECTIONS*comm->height, MPI_DOUBLE, rank-1, 0, comm->communicator,MPI_STATUS_IGNORE);
+            lbm_real_t * cell_rcv = lbm_mesh_get_cell(mesh, 0, 0);
+            MPI_Recv(cell_rcv, DIRECTIONS*comm->height, LBM_MPI_REAL, rank-1, 0, comm->communicator,MPI_STATUS_IGNORE);
         }
 
         // receive right side
         if (rank<comm_size-1){
-            double * cell_rcv = lbm_mesh_get_cell(mesh, comm->width-1, 0);
-            MPI_Recv(cell_rcv, DIRECTIONS*comm->height, MPI_DOUBLE, rank+1, 1, comm->communicator,MPI_STATUS_IGNORE);
+            lbm_real_t * cell_rcv = lbm_mesh_get_cell(mesh, comm->width-1, 0);
+            MPI_Recv(cell_rcv, DIRECTIONS*comm->height, LBM_MPI_REAL, rank+1, 1, comm->communicator,MPI_STATUS_IGNORE);
         }
     }
 	
@@ -76,13 +79,13 @@ void lbm_comm_ghost_exchange_ex2(lbm_comm_t * comm, lbm_mesh_t * mesh)
     if (rank%2==0){
         // send right side
         if (rank<comm_size-1){
-            double * cell_send = lbm_mesh_get_cell(mesh, comm->width-2, 0);
-            MPI_Send(cell_send, DIRECTIONS*comm->height, MPI_DOUBLE, rank+1, 0, comm->communicator);
+            lbm_real_t * cell_send = lbm_mesh_get_cell(mesh, comm->width-2, 0);
+            MPI_Send(cell_send, DIRECTIONS*comm->height, LBM_MPI_REAL, rank+1, 0, comm->communicator);
         }
         // send left side
         if (rank>0){
-            double * cell_send = lbm_mesh_get_cell(mesh, 1, 0);
-            MPI_Send(cell_send, DIRECTIONS*comm->height, MPI_DOUBLE, rank-1, 1, comm->communicator);
+            lbm_real_t * cell_send = lbm_mesh_get_cell(mesh, 1, 0);
+            MPI_Send(cell_send, DIRECTIONS*comm->height, LBM_MPI_REAL, rank-1, 1, comm->communicator);
         }
     }
     
@@ -90,14 +93,15 @@ void lbm_comm_ghost_exchange_ex2(lbm_comm_t * comm, lbm_mesh_t * mesh)
     if (rank%2==1){
         // receive left side
         if (rank>0){
-            double * cell_rcv = lbm_mesh_get_cell(mesh, 0, 0);
-            MPI_Recv(cell_rcv, DIRECTIONS*comm->height, MPI_DOUBLE, rank-1, 0, comm->communicator,MPI_STATUS_IGNORE);
+            lbm_real_t * cell_rcv = lbm_mesh_get_cell(mesh, 0, 0);
+            MPI_Recv(cell_rcv, DIRECTIONS*comm->height, LBM_MPI_REAL, rank-1, 0, comm->communicator,MPI_STATUS_IGNORE);
         }
 
         // send right side
         if (rank<comm_size-1){
-            double * cell_rcv = lbm_mesh_get_cell(mesh, comm->width-1, 0);
-            MPI_Recv(cell_rcv, DIRECTIONS*comm->height, MPI_DOUBLE, rank+1, 1, comm->communicator,MPI_STATUS_IGNORE);
+            lbm_real_t * cell_rcv = lbm_mesh_get_cell(mesh, comm->width-1, 0);
+            MPI_Recv(cell_rcv, DIRECTIONS*comm->height, LBM_MPI_REAL, rank+1, 1, comm->communicator,MPI_STATUS_IGNORE);
         }
     }
+    lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
 }
@@ -40,32 +40,34 @@ void lbm_comm_ghost_exchange_ex3(lbm_comm_t * comm, lbm_mesh_t * mesh)
 	//get infos
 	int rank;
 	int comm_size;
-	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	MPI_Comm_size( lbm_comm_world, &comm_size );
 
 
     int req_count = 0;
     
     // send data
     if (rank<comm_size-1){
-	    double * cell_send = lbm_mesh_get_cell(mesh, comm->width-2, 0);
-        MPI_Isend(cell_send, DIRECTIONS*comm->height, MPI_DOUBLE, rank+1, 0, comm->communicator, &comm->requests[req_count++]);
+	    lbm_real_t * cell_send = lbm_mesh_get_cell(mesh, comm->width-2, 0);
+        MPI_Isend(cell_send, DIRECTIONS*comm->height, LBM_MPI_REAL, rank+1, 0, comm->communicator, &comm->requests[req_count++]);
     }
     if (rank>0){
-	    double * cell_send = lbm_mesh_get_cell(mesh, 1, 0);
-        MPI_Isend(cell_send, DIRECTIONS*comm->height, MPI_DOUBLE, rank-1, 1, comm->communicator, &comm->requests[req_count++]);
+	    lbm_real_t * cell_send = lbm_mesh_get_cell(mesh, 1, 0);
+        MPI_Isend(cell_send, DIRECTIONS*comm->height, LBM_MPI_REAL, rank-1, 1, comm->communicator, &comm->requests[req_count++]);
     }
 
     // receive data
     if (rank>0){
-	    double * cell_rcv = lbm_mesh_get_cell(mesh, 0, 0);
-        MPI_Irecv(cell_rcv, DIRECTIONS*comm->height, MPI_DOUBLE, rank-1, 0, comm->communicator, &comm->requests[req_count++]);
+	    lbm_real_t * cell_rcv = lbm_mesh_get_cell(mesh, 0, 0);
+        MPI_Irecv(cell_rcv, DIRECTIONS*comm->height, LBM_MPI_REAL, rank-1, 0, comm->communicator, &comm->requests[req_count++]);
     }
     // send data backwards
     if (rank<comm_size-1){
-	    double * cell_rcv = lbm_mesh_get_cell(mesh, comm->width-1, 0);
-        MPI_Irecv(cell_rcv, DIRECTIONS*comm->height, MPI_DOUBLE, rank+1, 1, comm->communicator, &comm->requests[req_count++]);
+	    lbm_real_t * cell_rcv = lbm_mesh_get_cell(mesh, comm->width-1, 0);
+        MPI_Irecv(cell_rcv, DIRECTIONS*comm->height, LBM_MPI_REAL, rank+1, 1, comm->communicator, &comm->requests[req_count++]);
     }
 
+    double start = lbm_timer_now();
     MPI_Waitall(req_count, comm->requests, MPI_STATUSES_IGNORE);
+    lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
 }
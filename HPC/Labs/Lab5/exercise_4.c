@@ -13,7 +13,7 @@
 //       contiguous side and blocking communications
 //
 // SUMMARY:
-//     - 2D splitting along X and Y
+//     - 2D splitting along X and Y (and Z with the 3D lattices)
 //     - 8 neighbors communications
 //     - Blocking communications
 //     - Manual copy for non continguous cells
@@ -29,59 +29,18 @@
 #include <stdlib.h>
 
 /****************************************************/
-
-static void lbm_choose_2d_split(int comm_size, int total_width, int total_height, int dims[2])
-{
-    // compute the best 2d split
-    // i.e. find nb_x, nb_y st nb_x*nb_y=comm_size; total_width%nb_x=0; total_length%nb_y=0 such that the local dimensions are as square as possible : min(|nb_x-nb_y|)
-    //
-
-	int best_x = 0;
-	int best_y = 0;
-	int best_score = 0;
-	int nb_x;
-
-    // iterate over all the possibilities
-	for (nb_x = 1 ; nb_x <= comm_size ; nb_x++) {
-		int nb_y;
-
-		if (comm_size % nb_x != 0) // comm size needs to be a multiple of nb_x
-			continue;
-
-		nb_y = comm_size / nb_x;
-		if (total_width % nb_x != 0 || total_height % nb_y != 0)// nb_x and nby have to divide the width and height
-			continue;
-
-		// square proportions are better
-		int local_width = total_width / nb_x;
-		int local_height = total_height / nb_y;
-		int score = abs(local_width - local_height);
-
-		if (best_x == 0 || score < best_score) {
-			best_x = nb_x;
-			best_y = nb_y;
-			best_score = score;
-		}
-	}
-
-    // no viable solution found
-	if (best_x == 0){abort();}
-        
-	dims[0] = best_x;
-	dims[1] = best_y;
-}
-
-static int lbm_comm_rank_at(lbm_comm_t * comm, int rank_x, int rank_y)
+static int lbm_comm_rank_at(lbm_comm_t * comm, int rank_x, int rank_y, int rank_z)
 {
-	int coords[2];
+	int coords[3];
 	int rank;
 
-	if (rank_x < 0 || rank_x >= comm->nb_x || rank_y < 0 || rank_y >= comm->nb_y)
+	if (rank_x < 0 || rank_x >= comm->nb_x || rank_y < 0 || rank_y >= comm->nb_y || rank_z < 0 || rank_z >= comm->nb_z)
         // handles borders and corners
 		return MPI_PROC_NULL;
 
 	coords[0] = rank_x;
 	coords[1] = rank_y;
+	coords[2] = rank_z;
 	MPI_Cart_rank(comm->communicator, coords, &rank);
 
 	return rank;
@@ -97,44 +56,51 @@ void lbm_comm_init_ex4(lbm_comm_t * comm, int total_width, int total_height)
     // get infos
 	int rank;
 	int comm_size;
-	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
-
-	int dims[2] = {0, 0};
-	int periods[2] = {0, 0};
-	int coords[2];
-
-	lbm_choose_2d_split(comm_size, total_width, total_height, dims);
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	MPI_Comm_size( lbm_comm_world, &comm_size );
+
+	int dims[3] = {0, 0, 1};
+	int periods[3] = {0, 0, 0};
+	int coords[3] = {0, 0, 0};
+
+	// the 3D lattices also split the depth
+	if (DIMENSIONS == 3)
+		lbm_comm_choose_3d_split(comm_size, total_width, total_height, MESH_DEPTH, dims);
+	else
+		lbm_comm_choose_2d_split(comm_size, total_width, total_height, dims);
     // printf("dims[0] = %d, dims[1] = %d\n", dims[0], dims[1]);
     // for testing purpose as best split chooses [8,1] for -np 8 which is only on x
     //dims[0] = comm_size/2;
     //dims[1] = 2;
-    printf("dims[0] = %d, dims[1] = %d\n", dims[0], dims[1]);
+    if (DIMENSIONS == 3)
+        printf("dims[0] = %d, dims[1] = %d, dims[2] = %d\n", dims[0], dims[1], dims[2]);
+    else
+        printf("dims[0] = %d, dims[1] = %d\n", dims[0], dims[1]);
     // MPI_Dims_create(int nnodes, int ndims, int *dims) // doesn't look at the height and width of the domain so could return dims that don't divide the grid perfectly
-	MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &comm->communicator);
-	MPI_Cart_coords(comm->communicator, rank, 2, coords);
+	MPI_Cart_create(lbm_comm_world, DIMENSIONS, dims, periods, 0, &comm->communicator);
+	MPI_Cart_coords(comm->communicator, rank, DIMENSIONS, coords);
 
-	//number of tasks along X axis and Y axis.
+	//number of tasks along X axis, Y axis and Z axis (1 in 2D).
 	comm->nb_x = dims[0];
 	comm->nb_y = dims[1];
+	comm->nb_z = dims[2];
 
 	//current task position in the splitting
 	comm->rank_x = coords[0];
 	comm->rank_y = coords[1];
+	comm->rank_z = coords[2];
 
-	//local sub-domain size
-	comm->width = total_width / comm->nb_x + 2;
-	comm->height = total_height / comm->nb_y + 2;
-
-	// absolute position  (in cell number) in the global mesh without accounting the ghost cells
-	comm->x = comm->rank_x * (total_width / comm->nb_x);
-	comm->y = comm->rank_y * (total_height / comm->nb_y);
+	//local sub-domain size and absolute position (in cell number) in the global mesh
+	//without accounting the ghost cells, tiles can differ by one row/column
+	lbm_comm_setup_local_domain(comm, total_width, total_height);
 
-	// preallocate buffers for non contiguous communications
-	comm->buffer_send_up   = malloc(DIRECTIONS * comm->width * sizeof(double));
-	comm->buffer_send_down = malloc(DIRECTIONS * comm->width * sizeof(double));
-	comm->buffer_recv_up   = malloc(DIRECTIONS * comm->width * sizeof(double));
-	comm->buffer_recv_down = malloc(DIRECTIONS * comm->width * sizeof(double));
+	// preallocate buffers for non contiguous communications, large enough for a Y side
+	// (width x depth) and in 3D for a Z side (width x height)
+	size_t side = (size_t)comm->width * ((DIMENSIONS == 3 && comm->height > comm->depth) ? comm->height : comm->depth);
+	comm->buffer_send_up   = malloc(DIRECTIONS * side * sizeof(lbm_real_t));
+	comm->buffer_send_down = malloc(DIRECTIONS * side * sizeof(lbm_real_t));
+	comm->buffer_recv_up   = malloc(DIRECTIONS * side * sizeof(lbm_real_t));
+	comm->buffer_recv_down = malloc(DIRECTIONS * side * sizeof(lbm_real_t));
 
 	//if debug print comm
 	//lbm_comm_print(comm);
@@ -173,46 +139,52 @@ void lbm_comm_ghost_exchange_ex4(lbm_comm_t * comm, lbm_mesh_t * mesh)
 	//      special cases for border tasks.
 
 	//example to access cell
-	//double * cell = lbm_mesh_get_cell(mesh, local_x, local_y);
-	//double * cell = lbm_mesh_get_cell(mesh, comm->width - 1, 0);
+	//lbm_real_t * cell = lbm_mesh_get_cell(mesh, local_x, local_y);
+	//lbm_real_t * cell = lbm_mesh_get_cell(mesh, comm->width - 1, 0);
 
-    // left-right communication
-    int rank_left   = lbm_comm_rank_at(comm, comm->rank_x - 1, comm->rank_y);
-    int rank_right  = lbm_comm_rank_at(comm, comm->rank_x + 1, comm->rank_y);
+    // left-right communication, a X side is contiguous (with the whole depth in 3D)
+    int rank_left   = lbm_comm_rank_at(comm, comm->rank_x - 1, comm->rank_y, comm->rank_z);
+    int rank_right  = lbm_comm_rank_at(comm, comm->rank_x + 1, comm->rank_y, comm->rank_z);
+    int side_x = DIRECTIONS * comm->height * comm->depth;
 
-    double * right_inner = lbm_mesh_get_cell(mesh, comm->width-2, 0);
-    double * right_ghost = lbm_mesh_get_cell(mesh, comm->width-1, 0);
-    double * left_inner  = lbm_mesh_get_cell(mesh, 1, 0);
-    double * left_ghost  = lbm_mesh_get_cell(mesh, 0, 0);
+    lbm_real_t * right_inner = lbm_mesh_get_cell(mesh, comm->width-2, 0);
+    lbm_real_t * right_ghost = lbm_mesh_get_cell(mesh, comm->width-1, 0);
+    lbm_real_t * left_inner  = lbm_mesh_get_cell(mesh, 1, 0);
+    lbm_real_t * left_ghost  = lbm_mesh_get_cell(mesh, 0, 0);
 
-    MPI_Send(right_inner, DIRECTIONS * comm->height, MPI_DOUBLE, rank_right, 0, comm->communicator);
-    MPI_Recv(left_ghost, DIRECTIONS * comm->height, MPI_DOUBLE, rank_left, 0, comm->communicator, MPI_STATUS_IGNORE);
+    double start = lbm_timer_now();
+    MPI_Send(right_inner, side_x, LBM_MPI_REAL, rank_right, 0, comm->communicator);
+    MPI_Recv(left_ghost, side_x, LBM_MPI_REAL, rank_left, 0, comm->communicator, MPI_STATUS_IGNORE);
 
-    MPI_Send(left_inner, DIRECTIONS * comm->height, MPI_DOUBLE, rank_left, 1, comm->communicator);
-    MPI_Recv(right_ghost, DIRECTIONS * comm->height, MPI_DOUBLE, rank_right, 1, comm->communicator, MPI_STATUS_IGNORE);
+    MPI_Send(left_inner, side_x, LBM_MPI_REAL, rank_left, 1, comm->communicator);
+    MPI_Recv(right_ghost, side_x, LBM_MPI_REAL, rank_right, 1, comm->communicator, MPI_STATUS_IGNORE);
+    lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
 
 
-    // top-bottom communication
-    int rank_top    = lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y - 1);
-    int rank_bottom = lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y + 1);
+    // top-bottom communication, the depth of a column is contiguous
+    int rank_top    = lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y - 1, comm->rank_z);
+    int rank_bottom = lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y + 1, comm->rank_z);
+    int column = DIRECTIONS * comm->depth;
 
-    double *cell;
+    lbm_real_t *cell;
 
     // send top inner, receive bottom ghost
     for (int i=0; i<comm->width; i++) {
         cell = lbm_mesh_get_cell(mesh, i, 1);
-        for (int k=0; k<DIRECTIONS; k++) {
-            comm->buffer_send_up[i*DIRECTIONS+k] = cell[k];
+        for (int k=0; k<column; k++) {
+            comm->buffer_send_up[i*column+k] = cell[k];
         }
     }
-    MPI_Send(comm->buffer_send_up, DIRECTIONS * comm->width, MPI_DOUBLE, rank_top, 0, comm->communicator);
-    MPI_Recv(comm->buffer_recv_down, DIRECTIONS * comm->width, MPI_DOUBLE, rank_bottom, 0, comm->communicator, MPI_STATUS_IGNORE);
+    start = lbm_timer_now();
+    MPI_Send(comm->buffer_send_up, column * comm->width, LBM_MPI_REAL, rank_top, 0, comm->communicator);
+    MPI_Recv(comm->buffer_recv_down, column * comm->width, LBM_MPI_REAL, rank_bottom, 0, comm->communicator, MPI_STATUS_IGNORE);
+    lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
 
     if (rank_bottom != MPI_PROC_NULL) {
         for (int i=0; i<comm->width; i++) {
             cell = lbm_mesh_get_cell(mesh, i, comm->height-1);
-            for (int k=0; k<DIRECTIONS; k++) {
-                cell[k] = comm->buffer_recv_down[i*DIRECTIONS+k] ;
+            for (int k=0; k<column; k++) {
+                cell[k] = comm->buffer_recv_down[i*column+k] ;
             }
         }
     }
@@ -220,18 +192,79 @@ void lbm_comm_ghost_exchange_ex4(lbm_comm_t * comm, lbm_mesh_t * mesh)
     // send bottom inner, receive top ghost
     for (int i=0; i<comm->width; i++) {
         cell = lbm_mesh_get_cell(mesh, i, comm->height-2);
-        for (int k=0; k<DIRECTIONS; k++) {
-            comm->buffer_send_down[i*DIRECTIONS+k] = cell[k];
+        for (int k=0; k<column; k++) {
+            comm->buffer_send_down[i*column+k] = cell[k];
         }
     }
-    MPI_Send(comm->buffer_send_down, DIRECTIONS * comm->width, MPI_DOUBLE, rank_bottom, 0, comm->communicator);
-    MPI_Recv(comm->buffer_recv_up, DIRECTIONS * comm->width, MPI_DOUBLE, rank_top, 0, comm->communicator, MPI_STATUS_IGNORE);
+    start = lbm_timer_now();
+    MPI_Send(comm->buffer_send_down, column * comm->width, LBM_MPI_REAL, rank_bottom, 0, comm->communicator);
+    MPI_Recv(comm->buffer_recv_up, column * comm->width, LBM_MPI_REAL, rank_top, 0, comm->communicator, MPI_STATUS_IGNORE);
+    lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
 
     if (rank_top != MPI_PROC_NULL) {
         for (int i=0; i<comm->width; i++) {
             cell = lbm_mesh_get_cell(mesh, i, 0);
-            for (int k=0; k<DIRECTIONS; k++) {
-                cell[k] = comm->buffer_recv_up[i*DIRECTIONS+k] ;
+            for (int k=0; k<column; k++) {
+                cell[k] = comm->buffer_recv_up[i*column+k] ;
+            }
+        }
+    }
+
+
+    // front-back communication (3D split only), one cell per column over the whole
+    // width and height so the edges and corners filled above travel too
+    if (comm->nb_z > 1) {
+        int rank_front = lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y, comm->rank_z - 1);
+        int rank_back  = lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y, comm->rank_z + 1);
+        int side_z = DIRECTIONS * comm->width * comm->height;
+
+        // send front inner, receive back ghost
+        for (int i=0; i<comm->width; i++) {
+            for (int j=0; j<comm->height; j++) {
+                cell = lbm_mesh_get_cell_3d(mesh, i, j, 1);
+                for (int k=0; k<DIRECTIONS; k++) {
+                    comm->buffer_send_up[(i*comm->height+j)*DIRECTIONS+k] = cell[k];
+                }
+            }
+        }
+        start = lbm_timer_now();
+        MPI_Send(comm->buffer_send_up, side_z, LBM_MPI_REAL, rank_front, 0, comm->communicator);
+        MPI_Recv(comm->buffer_recv_down, side_z, LBM_MPI_REAL, rank_back, 0, comm->communicator, MPI_STATUS_IGNORE);
+        lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
+
+        if (rank_back != MPI_PROC_NULL) {
+            for (int i=0; i<comm->width; i++) {
+                for (int j=0; j<comm->height; j++) {
+                    cell = lbm_mesh_get_cell_3d(mesh, i, j, comm->depth-1);
+                    for (int k=0; k<DIRECTIONS; k++) {
+                        cell[k] = comm->buffer_recv_down[(i*comm->height+j)*DIRECTIONS+k];
+                    }
+                }
+            }
+        }
+
+        // send back inner, receive front ghost
+        for (int i=0; i<comm->width; i++) {
+            for (int j=0; j<comm->height; j++) {
+                cell = lbm_mesh_get_cell_3d(mesh, i, j, comm->depth-2);
+                for (int k=0; k<DIRECTIONS; k++) {
+                    comm->buffer_send_down[(i*comm->height+j)*DIRECTIONS+k] = cell[k];
+                }
+            }
+        }
+        start = lbm_timer_now();
+        MPI_Send(comm->buffer_send_down, side_z, LBM_MPI_REAL, rank_back, 0, comm->communicator);
+        MPI_Recv(comm->buffer_recv_up, side_z, LBM_MPI_REAL, rank_front, 0, comm->communicator, MPI_STATUS_IGNORE);
+        lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
+
+        if (rank_front != MPI_PROC_NULL) {
+            for (int i=0; i<comm->width; i++) {
+                for (int j=0; j<comm->height; j++) {
+                    cell = lbm_mesh_get_cell_3d(mesh, i, j, 0);
+                    for (int k=0; k<DIRECTIONS; k++) {
+                        cell[k] = comm->buffer_recv_up[(i*comm->height+j)*DIRECTIONS+k];
+                    }
+                }
             }
         }
     }
@@ -35,7 +35,7 @@ void lbm_comm_init_ex5(lbm_comm_t * comm, int total_width, int total_height)
 	// create MPI vector type for a horizontal row of cells
 	// each cell has DIRECTIONS doubles, and the stride from one cell
 	// to the next is (mesh->height * DIRECTIONS) doubles
-	MPI_Type_vector(comm->width, DIRECTIONS, (comm->height) * DIRECTIONS, MPI_DOUBLE, &comm->type);
+	MPI_Type_vector(comm->width, DIRECTIONS, (comm->height) * DIRECTIONS, LBM_MPI_REAL, &comm->type);
 	MPI_Type_commit(&comm->type);
 }
 
@@ -72,29 +72,33 @@ void lbm_comm_ghost_exchange_ex5(lbm_comm_t * comm, lbm_mesh_t * mesh)
     int rank_left  = lbm_comm_rank_at(comm,comm->rank_x-1,comm->rank_y);
     int rank_right = lbm_comm_rank_at(comm,comm->rank_x+1,comm->rank_y);
 
-    double * right_inner = lbm_mesh_get_cell(mesh,comm->width-2,0);
-    double * right_ghost = lbm_mesh_get_cell(mesh, comm->width - 1, 0);
-    double * left_inner = lbm_mesh_get_cell(mesh,1,0);
-    double * left_ghost = lbm_mesh_get_cell(mesh,0, 0);
+    lbm_real_t * right_inner = lbm_mesh_get_cell(mesh,comm->width-2,0);
+    lbm_real_t * right_ghost = lbm_mesh_get_cell(mesh, comm->width - 1, 0);
+    lbm_real_t * left_inner = lbm_mesh_get_cell(mesh,1,0);
+    lbm_real_t * left_ghost = lbm_mesh_get_cell(mesh,0, 0);
 
-    MPI_Send(right_inner, DIRECTIONS * comm->height, MPI_DOUBLE, rank_right, 1, comm->communicator);
-    MPI_Recv(left_ghost, DIRECTIONS * comm->height, MPI_DOUBLE, rank_left, 1, comm->communicator, MPI_STATUS_IGNORE);
+    double start = lbm_timer_now();
+    MPI_Send(right_inner, DIRECTIONS * comm->height, LBM_MPI_REAL, rank_right, 1, comm->communicator);
+    MPI_Recv(left_ghost, DIRECTIONS * comm->height, LBM_MPI_REAL, rank_left, 1, comm->communicator, MPI_STATUS_IGNORE);
 
-    MPI_Send(left_inner, DIRECTIONS * comm->height, MPI_DOUBLE, rank_left,  2, comm->communicator);
-    MPI_Recv(right_ghost, DIRECTIONS * comm->height, MPI_DOUBLE, rank_right, 2, comm->communicator, MPI_STATUS_IGNORE);
+    MPI_Send(left_inner, DIRECTIONS * comm->height, LBM_MPI_REAL, rank_left,  2, comm->communicator);
+    MPI_Recv(right_ghost, DIRECTIONS * comm->height, LBM_MPI_REAL, rank_right, 2, comm->communicator, MPI_STATUS_IGNORE);
+    lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
 
     // top-bottom
     int rank_top = lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y - 1);
     int rank_bottom = lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y + 1);
 
-    double * top_inner = lbm_mesh_get_cell(mesh, 0, 1);
-    double * top_ghost = lbm_mesh_get_cell(mesh, 0, 0);
-    double * bottom_inner = lbm_mesh_get_cell(mesh, 0, comm->height - 2);
-    double * bottom_ghost = lbm_mesh_get_cell(mesh, 0, comm->height - 1);
+    lbm_real_t * top_inner = lbm_mesh_get_cell(mesh, 0, 1);
+    lbm_real_t * top_ghost = lbm_mesh_get_cell(mesh, 0, 0);
+    lbm_real_t * bottom_inner = lbm_mesh_get_cell(mesh, 0, comm->height - 2);
+    lbm_real_t * bottom_ghost = lbm_mesh_get_cell(mesh, 0, comm->height - 1);
 
+    start = lbm_timer_now();
     MPI_Send(top_inner, 1, comm->type, rank_top, 3, comm->communicator);
     MPI_Recv(bottom_ghost, 1, comm->type, rank_bottom, 3, comm->communicator, MPI_STATUS_IGNORE);
 
     MPI_Send(bottom_inner, 1, comm->type, rank_bottom, 4, comm->communicator);
     MPI_Recv(top_ghost, 1, comm->type, rank_top, 4, comm->communicator, MPI_STATUS_IGNORE);
+    lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
 }
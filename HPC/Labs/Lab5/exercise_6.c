@@ -66,31 +66,33 @@ void lbm_comm_ghost_exchange_ex6(lbm_comm_t * comm, lbm_mesh_t * mesh)
     int rank_bottom = lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y + 1);
 
     // left - right
-    double * right_inner = lbm_mesh_get_cell(mesh,comm->width-2,0);
-    double * right_ghost = lbm_mesh_get_cell(mesh, comm->width - 1, 0);
-    double * left_inner = lbm_mesh_get_cell(mesh,1,0);
-    double * left_ghost = lbm_mesh_get_cell(mesh,0, 0);
+    lbm_real_t * right_inner = lbm_mesh_get_cell(mesh,comm->width-2,0);
+    lbm_real_t * right_ghost = lbm_mesh_get_cell(mesh, comm->width - 1, 0);
+    lbm_real_t * left_inner = lbm_mesh_get_cell(mesh,1,0);
+    lbm_real_t * left_ghost = lbm_mesh_get_cell(mesh,0, 0);
 
 
     if (rank_left != MPI_PROC_NULL) {
-        MPI_Isend(left_inner, DIRECTIONS * comm->height, MPI_DOUBLE, rank_left, 1, comm->communicator, &comm->requests[req_count++]);
-        MPI_Irecv(left_ghost, DIRECTIONS * comm->height, MPI_DOUBLE, rank_left, 2, comm->communicator, &comm->requests[req_count++]);
+        MPI_Isend(left_inner, DIRECTIONS * comm->height, LBM_MPI_REAL, rank_left, 1, comm->communicator, &comm->requests[req_count++]);
+        MPI_Irecv(left_ghost, DIRECTIONS * comm->height, LBM_MPI_REAL, rank_left, 2, comm->communicator, &comm->requests[req_count++]);
     }
     
     if (rank_right != MPI_PROC_NULL) {
-        MPI_Isend(right_inner, DIRECTIONS * comm->height, MPI_DOUBLE, rank_right, 2, comm->communicator, &comm->requests[req_count++]);
-        MPI_Irecv(right_ghost, DIRECTIONS * comm->height, MPI_DOUBLE, rank_right, 1, comm->communicator, &comm->requests[req_count++]);
+        MPI_Isend(right_inner, DIRECTIONS * comm->height, LBM_MPI_REAL, rank_right, 2, comm->communicator, &comm->requests[req_count++]);
+        MPI_Irecv(right_ghost, DIRECTIONS * comm->height, LBM_MPI_REAL, rank_right, 1, comm->communicator, &comm->requests[req_count++]);
     }
 
     // Wait for the request to finish
+    double start = lbm_timer_now();
     MPI_Waitall(req_count, comm->requests, MPI_STATUSES_IGNORE);
+    lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
     req_count = 0; 
 
     // top-bottom
-    double * top_inner = lbm_mesh_get_cell(mesh, 0, 1);
-    double * top_ghost = lbm_mesh_get_cell(mesh, 0, 0);
-    double * bottom_inner = lbm_mesh_get_cell(mesh, 0, comm->height - 2);
-    double * bottom_ghost = lbm_mesh_get_cell(mesh, 0, comm->height - 1);
+    lbm_real_t * top_inner = lbm_mesh_get_cell(mesh, 0, 1);
+    lbm_real_t * top_ghost = lbm_mesh_get_cell(mesh, 0, 0);
+    lbm_real_t * bottom_inner = lbm_mesh_get_cell(mesh, 0, comm->height - 2);
+    lbm_real_t * bottom_ghost = lbm_mesh_get_cell(mesh, 0, comm->height - 1);
 
     if (rank_top != MPI_PROC_NULL) {
         MPI_Isend(top_inner, 1, comm->type, rank_top, 3, comm->communicator, &comm->requests[req_count++]);
@@ -103,6 +105,8 @@ void lbm_comm_ghost_exchange_ex6(lbm_comm_t * comm, lbm_mesh_t * mesh)
     }
 
     // synchronize before continuing computations
+    start = lbm_timer_now();
     MPI_Waitall(req_count, comm->requests, MPI_STATUSES_IGNORE);
+    lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
 }
 
@@ -0,0 +1,97 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+//////////////////////////////////////////////////////
+//
+// Goal: Hybrid MPI + OpenMP execution to run one rank
+//       per socket (or per NUMA node) instead of one
+//       rank per core.
+//
+// SUMMARY:
+//     - 2D splitting along X and Y
+//     - 8 neighbors communications
+//     - MPI type for non contiguous cells
+//     - Non-blocking communications
+// NEW:
+//     - >>> OpenMP threads inside each rank <<<
+//     - Only the master thread communicates
+//       (MPI_THREAD_FUNNELED)
+//
+//////////////////////////////////////////////////////
+
+/****************************************************/
+#include "src/lbm_struct.h"
+#include "src/lbm_sparse.h"
+#include "src/exercises.h"
+
+/****************************************************/
+void lbm_comm_init_ex7(lbm_comm_t * comm, int total_width, int total_height)
+{
+	//check threading support
+	int provided;
+	MPI_Query_thread(&provided);
+	if (provided < MPI_THREAD_FUNNELED)
+		fatal("The MPI library does not provide MPI_THREAD_FUNNELED, required by the hybrid exercise !");
+
+	//we use the same implementation than ex6
+	lbm_comm_init_ex6(comm, total_width, total_height);
+}
+
+/****************************************************/
+void lbm_comm_release_ex7(lbm_comm_t * comm)
+{
+	//we use the same implementation than ex6
+	lbm_comm_release_ex6(comm);
+}
+
+/****************************************************/
+void lbm_comm_ghost_exchange_ex7(lbm_comm_t * comm, lbm_mesh_t * mesh)
+{
+	//must be called by the master thread only
+	lbm_comm_ghost_exchange_ex6(comm, mesh);
+}
+
+/****************************************************/
+void lbm_do_step_ex7(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh)
+{
+	//Open a single parallel region for the whole step, the lbm_phys_* functions
+	//share their loops between the threads with static scheduling so each thread
+	//always works on the same columns (the ones it first touched at allocation).
+	#pragma omp parallel
+	{
+		//sparse mode has its own step with the same structure
+		if (mesh_type->sparse != NULL) {
+			lbm_sparse_do_step( comm, mesh_type, mesh, temp_mesh);
+		} else {
+			//compute special actions (border, obstacle...)
+			double start = lbm_timer_now();
+			lbm_phys_special_cells( mesh, mesh_type, comm);
+			lbm_timer_add(LBM_TIMER_SPECIAL_CELLS, start);
+
+			//compute lbm_phys_collision term
+			start = lbm_timer_now();
+			lbm_phys_collision( temp_mesh, mesh);
+			lbm_timer_add(LBM_TIMER_COLLISION, start);
+
+			//propagate values from node to neighboors (implicit barrier at end of the
+			//collision loop ensure all the cells are ready)
+			#pragma omp master
+			{
+				lbm_timer_exchange_begin();
+				lbm_comm_ghost_exchange_ex7( comm, temp_mesh );
+				lbm_timer_exchange_end();
+			}
+			#pragma omp barrier
+
+			//compute fuild displacement from cells to cells
+			start = lbm_timer_now();
+			lbm_phys_propagation( mesh, temp_mesh);
+			lbm_timer_add(LBM_TIMER_PROPAGATION, start);
+		}
+	}
+}
@@ -0,0 +1,228 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+//////////////////////////////////////////////////////
+//
+// Goal: Overlap the ghost exchange with the computation
+//       of the inner cells to hide the latency.
+//
+// SUMMARY:
+//     - 2D splitting along X and Y
+//     - 8 neighbors communications
+//     - MPI type for non contiguous cells
+//     - Non-blocking communications
+// NEW:
+//     - >>> Persistent requests (MPI_Send_init/MPI_Recv_init) <<<
+//     - >>> Single phase exchange, corners sent directly <<<
+//     - >>> Inner cells computed while messages are in flight <<<
+//
+//////////////////////////////////////////////////////
+
+/****************************************************/
+#include "src/lbm_struct.h"
+#include "src/exercises.h"
+
+/****************************************************/
+/** Offsets of the 8 neighbors, the tag of a message is the index of its direction. **/
+static const int lbm_comm_ex8_neighbors[8][2] = {
+	{ 1, 0}, { 0, 1}, {-1, 0}, { 0,-1},
+	{ 1, 1}, {-1, 1}, {-1,-1}, { 1,-1}
+};
+
+/****************************************************/
+void lbm_comm_init_ex8(lbm_comm_t * comm, int total_width, int total_height)
+{
+	//we use the same implementation than ex4 for the 2D splitting
+	lbm_comm_init_ex4(comm, total_width, total_height);
+
+	//the overlap needs an interior not touching the ghost cells
+	if (comm->width < 4 || comm->height < 4)
+		fatal("Local sub-domain too small to overlap communications, need at least 2x2 cells !");
+
+	//requests are built on first exchange as we need the mesh address
+	comm->nb_persistent = 0;
+	comm->persistent_cells = NULL;
+	comm->type = MPI_DATATYPE_NULL;
+}
+
+/****************************************************/
+static void lbm_comm_ex8_free_requests(lbm_comm_t * comm)
+{
+	int i;
+	for (i = 0 ; i < comm->nb_persistent ; i++)
+		MPI_Request_free(&comm->requests[i]);
+	comm->nb_persistent = 0;
+	comm->persistent_cells = NULL;
+	if (comm->type != MPI_DATATYPE_NULL)
+		MPI_Type_free(&comm->type);
+}
+
+/****************************************************/
+void lbm_comm_release_ex8(lbm_comm_t * comm)
+{
+	//free persistent requests and type
+	lbm_comm_ex8_free_requests(comm);
+
+	//we use the same implementation than ex4 for the 2D splitting release
+	lbm_comm_release_ex4(comm);
+}
+
+/****************************************************/
+static int lbm_comm_rank_at(lbm_comm_t * comm, int rank_x, int rank_y)
+{
+	if (rank_x < 0 || rank_x >= comm->nb_x || rank_y < 0 || rank_y >= comm->nb_y)
+		return MPI_PROC_NULL;
+
+	int coords[2] = {rank_x, rank_y};
+	int rank;
+	MPI_Cart_rank(comm->communicator, coords, &rank);
+	return rank;
+}
+
+/****************************************************/
+/**
+ * Build the persistent requests for the given mesh. Sides are sent without
+ * the corner cells which go directly to the diagonal neighbors, except on
+ * the global borders where the ghost row/column is a real cell and has no
+ * diagonal neighbor to come from.
+**/
+static void lbm_comm_ex8_setup(lbm_comm_t * comm, lbm_mesh_t * mesh)
+{
+	//vars
+	int k;
+	int w = comm->width;
+	int h = comm->height;
+
+	//cleanup previous if mesh changed
+	lbm_comm_ex8_free_requests(comm);
+
+	//extent of the sides
+	int x_start = (lbm_comm_rank_at(comm, comm->rank_x - 1, comm->rank_y) == MPI_PROC_NULL) ? 0 : 1;
+	int x_end   = (lbm_comm_rank_at(comm, comm->rank_x + 1, comm->rank_y) == MPI_PROC_NULL) ? w : w - 1;
+	int y_start = (lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y - 1) == MPI_PROC_NULL) ? 0 : 1;
+	int y_end   = (lbm_comm_rank_at(comm, comm->rank_x, comm->rank_y + 1) == MPI_PROC_NULL) ? h : h - 1;
+
+	//type for a horizontal row of cells
+	MPI_Type_vector(x_end - x_start, DIRECTIONS, h * DIRECTIONS, LBM_MPI_REAL, &comm->type);
+	MPI_Type_commit(&comm->type);
+
+	//build the requests
+	for (k = 0 ; k < 8 ; k++)
+	{
+		int dx = lbm_comm_ex8_neighbors[k][0];
+		int dy = lbm_comm_ex8_neighbors[k][1];
+		int peer = lbm_comm_rank_at(comm, comm->rank_x + dx, comm->rank_y + dy);
+		if (peer == MPI_PROC_NULL)
+			continue;
+
+		//first cell to send and to receive
+		int send_x = (dx == 0) ? x_start : ((dx > 0) ? w - 2 : 1);
+		int send_y = (dy == 0) ? y_start : ((dy > 0) ? h - 2 : 1);
+		int recv_x = (dx == 0) ? x_start : ((dx > 0) ? w - 1 : 0);
+		int recv_y = (dy == 0) ? y_start : ((dy > 0) ? h - 1 : 0);
+
+		//shape of the message
+		int count;
+		MPI_Datatype type;
+		if (dx != 0 && dy != 0) {
+			count = DIRECTIONS;
+			type = LBM_MPI_REAL;
+		} else if (dx != 0) {
+			count = DIRECTIONS * (y_end - y_start);
+			type = LBM_MPI_REAL;
+		} else {
+			count = 1;
+			type = comm->type;
+		}
+
+		//the peer tags its message with the opposite direction ((k+2)%4 in the same group)
+		int tag_recv = (k < 4) ? (k + 2) % 4 : 4 + (k - 4 + 2) % 4;
+		MPI_Send_init(lbm_mesh_get_cell(mesh, send_x, send_y), count, type, peer, k, comm->communicator, &comm->requests[comm->nb_persistent++]);
+		MPI_Recv_init(lbm_mesh_get_cell(mesh, recv_x, recv_y), count, type, peer, tag_recv, comm->communicator, &comm->requests[comm->nb_persistent++]);
+	}
+
+	//remember
+	comm->persistent_cells = mesh->cells;
+}
+
+/****************************************************/
+static void lbm_comm_ex8_start(lbm_comm_t * comm, lbm_mesh_t * mesh)
+{
+	//(re)build if the mesh is not the one we know
+	if (comm->persistent_cells != mesh->cells)
+		lbm_comm_ex8_setup(comm, mesh);
+
+	//start all
+	MPI_Startall(comm->nb_persistent, comm->requests);
+}
+
+/****************************************************/
+static void lbm_comm_ex8_wait(lbm_comm_t * comm)
+{
+	MPI_Waitall(comm->nb_persistent, comm->requests, MPI_STATUSES_IGNORE);
+}
+
+/****************************************************/
+void lbm_comm_ghost_exchange_ex8(lbm_comm_t * comm, lbm_mesh_t * mesh)
+{
+	//blocking version, used when not overlapping
+	lbm_comm_ex8_start(comm, mesh);
+	double start = lbm_timer_now();
+	lbm_comm_ex8_wait(comm);
+	lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
+}
+
+/****************************************************/
+void lbm_do_step_ex8(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh)
+{
+	//vars
+	int w = mesh->width;
+	int h = mesh->height;
+
+	//compute special actions (border, obstacle...)
+	double start = lbm_timer_now();
+	lbm_phys_special_cells( mesh, mesh_type, comm);
+	lbm_timer_add(LBM_TIMER_SPECIAL_CELLS, start);
+
+	//collision on the two outer layers first : the cells to send and the ghost
+	//cells which will be overwritten by the receptions
+	start = lbm_timer_now();
+	lbm_phys_collision_region( temp_mesh, mesh, 0, w, 0, 2);
+	lbm_phys_collision_region( temp_mesh, mesh, 0, w, h - 2, h);
+	lbm_phys_collision_region( temp_mesh, mesh, 0, 2, 2, h - 2);
+	lbm_phys_collision_region( temp_mesh, mesh, w - 2, w, 2, h - 2);
+	lbm_timer_add(LBM_TIMER_COLLISION, start);
+
+	//start the exchange
+	start = lbm_timer_now();
+	lbm_comm_ex8_start( comm, temp_mesh );
+	lbm_timer_add(LBM_TIMER_EXCHANGE_PACK, start);
+
+	//collision on the deep interior while messages are in flight
+	start = lbm_timer_now();
+	lbm_phys_collision_region( temp_mesh, mesh, 2, w - 2, 2, h - 2);
+	lbm_timer_add(LBM_TIMER_COLLISION, start);
+
+	//propagation from all the non ghost cells (only read the send buffers)
+	start = lbm_timer_now();
+	lbm_phys_propagation_region( mesh, temp_mesh, 1, w - 1, 1, h - 1);
+	lbm_timer_add(LBM_TIMER_PROPAGATION, start);
+
+	//complete the exchange, what remains here is the part not hidden by the interior
+	start = lbm_timer_now();
+	lbm_comm_ex8_wait( comm );
+	lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
+
+	//propagation from the ghost cells
+	start = lbm_timer_now();
+	lbm_phys_propagation_region( mesh, temp_mesh, 0, w, 0, 1);
+	lbm_phys_propagation_region( mesh, temp_mesh, 0, w, h - 1, h);
+	lbm_phys_propagation_region( mesh, temp_mesh, 0, 1, 1, h - 1);
+	lbm_phys_propagation_region( mesh, temp_mesh, w - 1, w, 1, h - 1);
+	lbm_timer_add(LBM_TIMER_PROPAGATION, start);
+}
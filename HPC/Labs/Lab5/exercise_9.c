@@ -0,0 +1,203 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+//////////////////////////////////////////////////////
+//
+// Goal: Exchange the ghost cells with a single
+//       neighborhood collective and only the
+//       directions going through each side.
+//
+// SUMMARY:
+//     - 2D splitting along X and Y (and Z with the 3D lattices)
+//     - 8 neighbors communications (26 in 3D)
+//     - MPI type for non contiguous cells
+// NEW:
+//     - >>> MPI_Neighbor_alltoallw on a graph communicator <<<
+//     - >>> MPI type selecting the crossing directions <<<
+//
+//////////////////////////////////////////////////////
+
+/****************************************************/
+#include "src/lbm_struct.h"
+#include "src/exercises.h"
+
+/****************************************************/
+static int lbm_comm_rank_at(lbm_comm_t * comm, int rank_x, int rank_y, int rank_z)
+{
+	if (rank_x < 0 || rank_x >= comm->nb_x || rank_y < 0 || rank_y >= comm->nb_y || rank_z < 0 || rank_z >= comm->nb_z)
+		return MPI_PROC_NULL;
+
+	int coords[3] = {rank_x, rank_y, rank_z};
+	int rank;
+	MPI_Cart_rank(comm->communicator, coords, &rank);
+	return rank;
+}
+
+/****************************************************/
+/**
+ * Build the type of a box of cells only keeping the directions moving along
+ * the offset d, ie. the ones which will reach the neighbor at this offset after
+ * the propagation.
+ * @param sizes Size of the local mesh along each axis.
+ * @param subsizes Size of the box along each axis.
+ * @param starts First cell of the box along each axis.
+**/
+static void lbm_comm_ex9_build_type(MPI_Datatype * type, const int d[3], const int sizes[3], const int subsizes[3], const int starts[3])
+{
+	//vars
+	int k, a;
+	int nb_dirs = 0;
+	int dirs[DIRECTIONS];
+	MPI_Datatype cell_type;
+	MPI_Datatype cell_type_resized;
+
+	//select directions
+	for (k = 0 ; k < DIRECTIONS ; k++)
+	{
+		int keep = 1;
+		for (a = 0 ; a < DIMENSIONS ; a++)
+			if (d[a] != 0 && direction_matrix[k][a] != d[a])
+				keep = 0;
+		if (keep)
+			dirs[nb_dirs++] = k;
+	}
+
+	//one cell, with the extent of a full cell
+	MPI_Type_create_indexed_block(nb_dirs, 1, dirs, LBM_MPI_REAL, &cell_type);
+	MPI_Type_create_resized(cell_type, 0, DIRECTIONS * sizeof(lbm_real_t), &cell_type_resized);
+
+	//the box in the local mesh (x major, z contiguous in 3D)
+	MPI_Type_create_subarray(DIMENSIONS, sizes, subsizes, starts, MPI_ORDER_C, cell_type_resized, type);
+	MPI_Type_commit(type);
+
+	//free temp types
+	MPI_Type_free(&cell_type);
+	MPI_Type_free(&cell_type_resized);
+}
+
+/****************************************************/
+void lbm_comm_init_ex9(lbm_comm_t * comm, int total_width, int total_height)
+{
+	//vars
+	int a, dx, dy, dz;
+	int neighbors[MAX_NEIGHBORS];
+	int weights[MAX_NEIGHBORS];
+	int sizes[3], ranks[3], nb[3];
+	int side_start[3], side_end[3];
+
+	//we use the same implementation than ex4 for the 2D (or 3D) splitting
+	lbm_comm_init_ex4(comm, total_width, total_height);
+	sizes[0] = comm->width;
+	sizes[1] = comm->height;
+	sizes[2] = comm->depth;
+	ranks[0] = comm->rank_x;
+	ranks[1] = comm->rank_y;
+	ranks[2] = comm->rank_z;
+	nb[0] = comm->nb_x;
+	nb[1] = comm->nb_y;
+	nb[2] = comm->nb_z;
+
+	//extent of the sides along each axis, on global borders the ghost layer is a real
+	//cell with no diagonal neighbor to send it, so it travels with the side.
+	for (a = 0 ; a < 3 ; a++)
+	{
+		side_start[a] = (ranks[a] == 0) ? 0 : 1;
+		side_end[a] = (ranks[a] == nb[a] - 1) ? sizes[a] : sizes[a] - 1;
+	}
+
+	//build types for existing neighbors (sides, edges and corners in 3D)
+	comm->nb_neighbors = 0;
+	for (dz = (DIMENSIONS == 3) ? -1 : 0 ; dz <= ((DIMENSIONS == 3) ? 1 : 0) ; dz++)
+	{
+		for (dy = -1 ; dy <= 1 ; dy++)
+		{
+			for (dx = -1 ; dx <= 1 ; dx++)
+			{
+				int d[3] = {dx, dy, dz};
+				int minus_d[3] = {-dx, -dy, -dz};
+				int send_starts[3], recv_starts[3], subsizes[3];
+				int peer = lbm_comm_rank_at(comm, comm->rank_x + dx, comm->rank_y + dy, comm->rank_z + dz);
+				if ((dx == 0 && dy == 0 && dz == 0) || peer == MPI_PROC_NULL)
+					continue;
+
+				//box to send and to receive : the side along the axes without offset,
+				//the last inner (resp. ghost) layer along the others
+				for (a = 0 ; a < 3 ; a++)
+				{
+					subsizes[a] = (d[a] == 0) ? side_end[a] - side_start[a] : 1;
+					send_starts[a] = (d[a] == 0) ? side_start[a] : ((d[a] > 0) ? sizes[a] - 2 : 1);
+					recv_starts[a] = (d[a] == 0) ? side_start[a] : ((d[a] > 0) ? sizes[a] - 1 : 0);
+				}
+
+				//we send what goes toward the neighbor and receive what comes from it
+				int id = comm->nb_neighbors++;
+				neighbors[id] = peer;
+				weights[id] = subsizes[0] * subsizes[1] * subsizes[2];
+				lbm_comm_ex9_build_type(&comm->send_types[id], d, sizes, subsizes, send_starts);
+				lbm_comm_ex9_build_type(&comm->recv_types[id], minus_d, sizes, subsizes, recv_starts);
+				comm->send_displs[id] = 0;
+				comm->recv_displs[id] = 0;
+			}
+		}
+	}
+
+	//graph communicator with all the neighbors (the cartesian one only knows the sides),
+	//edges are weighted by the number of exchanged cells
+	MPI_Dist_graph_create_adjacent(comm->communicator,
+		comm->nb_neighbors, neighbors, weights,
+		comm->nb_neighbors, neighbors, weights,
+		MPI_INFO_NULL, 0, &comm->neighbor_communicator);
+}
+
+/****************************************************/
+void lbm_comm_release_ex9(lbm_comm_t * comm)
+{
+	//vars
+	int k;
+
+	//free types and graph
+	for (k = 0 ; k < comm->nb_neighbors ; k++)
+	{
+		MPI_Type_free(&comm->send_types[k]);
+		MPI_Type_free(&comm->recv_types[k]);
+	}
+	comm->nb_neighbors = 0;
+	MPI_Comm_free(&comm->neighbor_communicator);
+
+	//we use the same implementation than ex4 for the 2D (or 3D) splitting release
+	lbm_comm_release_ex4(comm);
+}
+
+/****************************************************/
+void lbm_comm_ghost_exchange_ex9(lbm_comm_t * comm, lbm_mesh_t * mesh)
+{
+	//vars
+	int k;
+	int counts[MAX_NEIGHBORS];
+	MPI_Aint base;
+	MPI_Aint send_displs[MAX_NEIGHBORS];
+	MPI_Aint recv_displs[MAX_NEIGHBORS];
+
+	//send and receive areas are in the same buffer, so address them from
+	//MPI_BOTTOM instead of passing the same pointer twice
+	MPI_Get_address(mesh->cells, &base);
+	for (k = 0 ; k < comm->nb_neighbors ; k++)
+	{
+		counts[k] = 1;
+		send_displs[k] = MPI_Aint_add(base, comm->send_displs[k]);
+		recv_displs[k] = MPI_Aint_add(base, comm->recv_displs[k]);
+	}
+
+	//single phase exchange with all the neighbors
+	double start = lbm_timer_now();
+	MPI_Neighbor_alltoallw(
+		MPI_BOTTOM, counts, send_displs, comm->send_types,
+		MPI_BOTTOM, counts, recv_displs, comm->recv_types,
+		comm->neighbor_communicator);
+	lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
+}
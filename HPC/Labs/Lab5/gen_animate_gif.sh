@@ -130,8 +130,32 @@ run_parallel()
 	rm -rf ${TMPDIR}
 }
 
+#stream the raw frames rendered by display to ffmpeg
+run_ffmpeg()
+{
+	./display --rgb ${INPUT_FILE} all | ffmpeg -loglevel error -y -f rawvideo -pix_fmt rgb24 -s ${WIDTH}x${HEIGHT} -r 20 -i - ${OUTPUT_FILE}
+}
+
+#frames rendered in parallel by display then merged
+run_png()
+{
+	#create tempdir
+	TMPDIR='/tmp/simu-simple-lbm-gif-gen'
+	rm -rf ${TMPDIR}
+	mkdir ${TMPDIR}
+
+	#render and merge
+	./display --png ${INPUT_FILE} all "${TMPDIR}/%05d.png" || return 1
+	echo "Merger images..."
+	convert -delay 5 ${TMPDIR}/*.png ${OUTPUT_FILE}
+
+	# clean
+	rm -rf ${TMPDIR}
+}
+
 # check
-which gnuplot > /dev/null || fail "ERROR: You need GNUPLOT to make rendering !"
+which ffmpeg > /dev/null && HAVE_FFMPEG='yes' || HAVE_FFMPEG='no'
+which gnuplot > /dev/null && HAVE_GNUPLOT='yes' || HAVE_GNUPLOT='no'
 which parallel > /dev/null && HAVE_PARALLEL='yes' || HAVE_PARALLEL='no'
 which convert > /dev/null && HAVE_CONVERT='yes' || HAVE_CONVERT='no'
 
@@ -144,8 +168,14 @@ HEIGHT=$(./display --info ${INPUT_FILE} 0 | grep height | sed -e 's/height=//g')
 #calc size
 calc_draw_size
 
-# select
-if [[ ${HAVE_PARALLEL} == 'yes' && ${HAVE_CONVERT} == 'yes' ]]; then
+# select, native rendering first
+if [[ ${HAVE_FFMPEG} == 'yes' ]]; then
+	run_ffmpeg || fail "Fail to encode ${OUTPUT_FILE} !"
+elif [[ ${HAVE_CONVERT} == 'yes' ]] && run_png; then
+	true
+elif [[ ${HAVE_GNUPLOT} == 'no' ]]; then
+	fail "ERROR: You need FFMPEG, CONVERT or GNUPLOT to make rendering !"
+elif [[ ${HAVE_PARALLEL} == 'yes' && ${HAVE_CONVERT} == 'yes' ]]; then
 	run_parallel
 else
 	echo "Warning: Not have GNU PARALLEL insalled, fallback to sequential version !"
@@ -29,7 +29,7 @@ gen_gnuplot_command()
 	echo "splot \"< ./display --gnuplot ${INPUT_FILE} ${IMG_ID} \" u 1:2:4"
 }
 
-#call if
+#render directly if display was built with libpng, fallback on gnuplot
 
-gen_gnuplot_command | gnuplot
+./display --png ${INPUT_FILE} ${IMG_ID} ${OUTPUT_FILE} 2> /dev/null || gen_gnuplot_command | gnuplot
 
@@ -56,8 +56,8 @@
 #endif
 
 /****************************************************/
-/** Define coored. **/
-typedef int lbm_coords_t[2];
+/** Define coored and sub-domain of a rank : rank_x, rank_y, x, y, width, height. **/
+typedef int lbm_coords_t[6];
 
 /****************************************************/
 typedef enum lbm_show_mode_e {
@@ -84,9 +84,13 @@ static char doc[] = "A simple checker for communication developpement for LBM.";
 	static struct argp_option options[] = {
 		{"width",         'w', "WIDTH",  0, "Total width of the mesh to compute and print." },
 		{"height",        'h', "HEIGHT", 0, "Total height of the mesh to compute and print." },
-		{"exercise",      'e', "EXID",   0, "ID of the exercice to execute." },
+		{"exercise",      'e', "EXID",   0, "ID of the exercice to execute, a comma separated list or 'all' with --bench." },
 		{"show",          's', "MODE",   0, "Show expected value on error: 'current', 'expected', or 'both'"},
 		{"pattern",       'p', "PATTERN",0, "Define how to fill the mesh: 'rank', 'modulo9', 'modulo10' or 'position'."},
+		{"bench",         'b', 0,        0, "Measure the time of the exchanges instead of checking them."},
+		{"tiles",         't', "LIST",   0, "Comma separated edges of the local tiles to measure with --bench."},
+		{"iterations",    'i', "COUNT",  0, "Number of exchanges measured for each tile with --bench."},
+		{"output",        'o', "FILE",   0, "Append the --bench results to a CSV file."},
 		{ 0 }
 	};
 #else
@@ -96,27 +100,39 @@ static char doc[] = "A simple checker for communication developpement for LBM.";
 			{ "exercise",   required_argument,      NULL,           'e' },
 			{ "show",       required_argument,      NULL,           's' },
 			{ "pattern",    required_argument,      NULL,           'p' },
+			{ "bench",      no_argument,            NULL,           'b' },
+			{ "tiles",      required_argument,      NULL,           't' },
+			{ "iterations", required_argument,      NULL,           'i' },
+			{ "output",     required_argument,      NULL,           'o' },
 			{ "help",       no_argument,            NULL,           '?' },
 			{ NULL,         0,                      NULL,           0 }
 	};
-	static const char * short_options = "[-w WIDTH] [-h HEIGHT] [-e EXID] [-s MODE] [-p PATTERN]";
+	static const char * short_options = "[-w WIDTH] [-h HEIGHT] [-e EXID] [-s MODE] [-p PATTERN] [-b [-t LIST] [-i COUNT] [-o FILE]]";
 	static const char * help_message = 
 		"-w/--with     {WIDTH}   Total width of the mesh to compute and print.\n"
 		"-h/--height   {HEIGHT}  Total height of the mesh to compute and print.\n"
-		"-e/--exercise {EXID}    ID of the exercise to execute\n"
+		"-e/--exercise {EXID}    ID of the exercise to execute, a comma separated list or 'all' with --bench.\n"
 		"-s/--show     {MODE}    Show expected value on error: 'current', 'expected', or 'both'.\n"
-		"-p/--pattern  {PATTERN} Define how to fill the mesh: 'rank', 'modulo9', 'modulo10' or 'position'.\n";
+		"-p/--pattern  {PATTERN} Define how to fill the mesh: 'rank', 'modulo9', 'modulo10' or 'position'.\n"
+		"-b/--bench              Measure the time of the exchanges instead of checking them.\n"
+		"-t/--tiles    {LIST}    Comma separated edges of the local tiles to measure with --bench.\n"
+		"-i/--iterations {COUNT} Number of exchanges measured for each tile with --bench.\n"
+		"-o/--output   {FILE}    Append the --bench results to a CSV file.\n";
 #endif
 
 /****************************************************/
 /* Used by main to communicate with parse_opt. */
 struct arguments
 {
-	int exercice;
+	const char * exercices;
 	int width;
 	int height;
 	lbm_show_mode_t show;
 	lbm_fill_mode_t fill;
+	bool bench;
+	const char * tiles;
+	int iterations;
+	const char * output;
 };
 
 /****************************************************/
@@ -136,7 +152,19 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 			arguments->height = atoi(arg);
 			break;
 		case 'e':
-			arguments->exercice = atoi(arg);
+			arguments->exercices = arg;
+			break;
+		case 'b':
+			arguments->bench = true;
+			break;
+		case 't':
+			arguments->tiles = arg;
+			break;
+		case 'i':
+			arguments->iterations = atoi(arg);
+			break;
+		case 'o':
+			arguments->output = arg;
 			break;
 		case 'p':
 			if (strcmp(arg, "rank") == 0)
@@ -198,9 +226,16 @@ int get_rank_at(lbm_comm_t * comm, lbm_coords_t * coords, int world_size, int x,
 }
 
 /****************************************************/
-bool is_on_border(lbm_comm_t * comm, int col, int line)
+bool is_on_border(lbm_coords_t * coords, int rank, int col, int line)
+{
+	return (col == 0 || col == coords[rank][4] -1 || line == 0 || line == coords[rank][5] - 1);
+}
+
+/****************************************************/
+/** Value of a cell from its global position, tiles can have different sizes. **/
+static int calc_position_value(int x, int y)
 {
-	return (col == 0 || col == comm->width -1 || line == 0 || line == comm->height - 1);
+	return x * (MESH_HEIGHT + 2) + y;
 }
 
 /****************************************************/
@@ -208,11 +243,11 @@ int calc_expected_value(lbm_comm_t * comm, lbm_coords_t * coords, int x, int y,
 {
 	//easy case
 	if (fill == LBM_FILL_POSITION)
-		return ((x * (comm->width-2) + col) * (comm->height) + (y * (comm->height-2)) + line);
+		return calc_position_value(coords[rank][2] + col, coords[rank][3] + line);
 	else if (fill == LBM_FILL_MODULO_9)
-		return ((x * (comm->width-2) + col) * (comm->height) + (y * (comm->height-2)) + line)%9;
+		return calc_position_value(coords[rank][2] + col, coords[rank][3] + line)%9;
 	else if (fill == LBM_FILL_MODULO_10)
-		return ((x * (comm->width-2) + col) * (comm->height) + (y * (comm->height-2)) + line)%10;
+		return calc_position_value(coords[rank][2] + col, coords[rank][3] + line)%10;
 
 	//calc expect location
 	int dx = 0;
@@ -221,8 +256,8 @@ int calc_expected_value(lbm_comm_t * comm, lbm_coords_t * coords, int x, int y,
 	//for borders
 	if (col == 0) dx = -1;
 	if (line == 0 && comm->nb_y > 1) dy = -1;
-	if (col == comm->width-1) dx=+1;
-	if (line == comm->height-1 && comm->nb_y > 1) dy=+1;
+	if (col == coords[rank][4]-1) dx=+1;
+	if (line == coords[rank][5]-1 && comm->nb_y > 1) dy=+1;
 
 	//get expect
 	int expect1 = get_rank_at(comm, coords, world_size, x+dx, y+dy, -1);
@@ -325,20 +360,22 @@ void display_meshes(lbm_comm_t * comm, lbm_mesh_t * mesh_rank, lbm_coords_t * co
 	char dim_error[1024] = "";
 	//loop all meshes
 	for (y = 0 ; y < comm->nb_y ; y++) {
-		for (line = 0 ; line < comm->height ; line++) {
+		//all the ranks of a line have the same height
+		int height = coords[get_rank_at(comm, coords, world_size, 0, y, -1)][5];
+		for (line = 0 ; line < height ; line++) {
 			for (x = 0 ; x < comm->nb_x ; x++) {
 				//found corresponding rank
 				int rank = get_rank_at(comm, coords, world_size, x, y, -1);
 				assert(rank != -1);
 
 				//display mesh
-				for (col = 0 ; col < comm->width ; col++) {
+				for (col = 0 ; col < coords[rank][4] ; col++) {
 					//extract cell
 					lbm_mesh_cell_t cell = lbm_mesh_get_cell(&mesh_rank[rank], col, line);
 					int value = (int)cell[0];
 
 					//check
-					bool is_border = is_on_border(comm, col, line);
+					bool is_border = is_on_border(coords, rank, col, line);
 					int expected = calc_expected_value(comm, coords, x, y, col, line, rank, world_size, fill);
 					bool err_cell = !check_cell_values(dim_error, cell, x, y, col, line);
 
@@ -419,7 +456,7 @@ void mesh_init_mod(lbm_mesh_t * mesh, lbm_comm_t * comm, int modulo)
 	for ( i = 0 ; i <  mesh->width ; i++)
 		for ( j = 0 ; j <  mesh->height ; j++)
 			for ( k = 0 ; k < DIRECTIONS ; k++)
-				lbm_mesh_get_cell(mesh, i, j)[k] = ((comm->x + i) * mesh->height + comm->y + j)%modulo;
+				lbm_mesh_get_cell(mesh, i, j)[k] = calc_position_value(comm->x + i, comm->y + j)%modulo;
 
 	//zero ghost
 	mesh_init_zero_ghost(mesh, comm);
@@ -438,7 +475,7 @@ void mesh_init_pos(lbm_mesh_t * mesh, lbm_comm_t * comm)
 	for ( i = 0 ; i <  mesh->width ; i++)
 		for ( j = 0 ; j <  mesh->height ; j++)
 			for ( k = 0 ; k < DIRECTIONS ; k++)
-				lbm_mesh_get_cell(mesh, i, j)[k] = ((comm->x + i) * mesh->height + comm->y + j);
+				lbm_mesh_get_cell(mesh, i, j)[k] = calc_position_value(comm->x + i, comm->y + j);
 
 	//zero ghost
 	mesh_init_zero_ghost(mesh, comm);
@@ -465,7 +502,7 @@ void print_help_message(char ** argv)
 void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
 {
 	int c;
-	while ( (c = getopt_long(argc, argv, "w:h:e:s:p:", long_options, NULL)) != -1) {
+	while ( (c = getopt_long(argc, argv, "w:h:e:s:p:bt:i:o:", long_options, NULL)) != -1) {
 		switch(c) {
 			case 'w':
 				arguments->width = atoi(optarg);
@@ -474,7 +511,19 @@ void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
 				arguments->height = atoi(optarg);
 				break;
 			case 'e':
-				arguments->exercice = atoi(optarg);
+				arguments->exercices = optarg;
+				break;
+			case 'b':
+				arguments->bench = true;
+				break;
+			case 't':
+				arguments->tiles = optarg;
+				break;
+			case 'i':
+				arguments->iterations = atoi(optarg);
+				break;
+			case 'o':
+				arguments->output = optarg;
 				break;
 			case 'p':
 				if (strcmp(optarg, "rank") == 0)
@@ -519,6 +568,230 @@ void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
 }
 #endif //HAVE_ARGP
 
+/****************************************************/
+/** Maximum number of values in the lists given to --bench. **/
+#define BENCH_MAX_VALUES 64
+/** Number of exchanges done before measuring. **/
+#define BENCH_WARMUP 10
+
+/****************************************************/
+/** Parse a comma separated list of integers, return the number of values. **/
+static int parse_int_list(const char * list, int * values, int max)
+{
+	//vars
+	char * copy = strdup(list);
+	char * saveptr = NULL;
+	char * token;
+	int count = 0;
+
+	//split
+	for (token = strtok_r(copy, ",", &saveptr) ; token != NULL ; token = strtok_r(NULL, ",", &saveptr)) {
+		if (count >= max)
+			fatal("Too many values in the list !");
+		values[count++] = atoi(token);
+	}
+
+	//free
+	free(copy);
+	return count;
+}
+
+/****************************************************/
+/**
+ * Number of ghost cells to receive from the neighbors, ie. the ones which are
+ * not outside of the global mesh.
+**/
+static long bench_count_ghost_cells(const lbm_comm_t * comm)
+{
+	//vars
+	int i, j;
+	long count = 0;
+	int g = comm->ghost;
+	int x0 = lbm_comm_inner_x(comm) - g;
+	int y0 = lbm_comm_inner_y(comm) - g;
+
+	//loop on the ghost layers
+	for (i = 0 ; i < comm->width ; i++)
+	{
+		for (j = 0 ; j < comm->height ; j++)
+		{
+			if (i >= g && i < comm->width - g && j >= g && j < comm->height - g)
+				continue;
+			if (x0 + i < 0 || x0 + i >= MESH_WIDTH || y0 + j < 0 || y0 + j >= MESH_HEIGHT)
+				continue;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/****************************************************/
+/**
+ * Measure the exchange of an exercise for each tile size, without the physics.
+ * The time is the mean of one exchange, the pack part is the time spent outside
+ * of the blocking MPI calls (posting requests, copies) and the wait part the time
+ * blocked inside them. The bandwidth is the full cell halo of a rank divided by
+ * the time of the slowest rank. At the end a latency + size / bandwidth model is
+ * fitted on the mean times.
+**/
+static void bench_exercise(int exercise, const int * tiles, int nb_tiles, int iterations, FILE * csv)
+{
+	//vars
+	int rank, comm_size, t, it;
+	int dims[2];
+	double fit_x[BENCH_MAX_VALUES];
+	double fit_y[BENCH_MAX_VALUES];
+	lbm_comm_t comm;
+	lbm_mesh_t mesh;
+
+	//infos
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+	lbm_ex_select(exercise);
+
+	//splitting chosen by the exercise on a square mesh, the mesh is then
+	//scaled to get the requested tiles
+	memset(&comm, 0, sizeof(comm));
+	MESH_WIDTH = 1024;
+	MESH_HEIGHT = 1024;
+	lbm_comm_init_ex_select( &comm, MESH_WIDTH, MESH_HEIGHT);
+	dims[0] = comm.nb_x;
+	dims[1] = comm.nb_y;
+	lbm_comm_release_ex_select(&comm);
+
+	//header
+	if (rank == RANK_MASTER) {
+		printf(" * Exercise %d, splitting: (%d x %d)\n", exercise, dims[0], dims[1]);
+		printf("%10s %10s %12s %12s %12s %12s %12s %12s\n", "tile", "halo (KB)", "min (us)", "mean (us)", "max (us)", "pack (us)", "wait (us)", "MB/s");
+	}
+
+	//loop on sizes
+	for (t = 0 ; t < nb_tiles ; t++)
+	{
+		//build
+		MESH_WIDTH = tiles[t] * dims[0];
+		MESH_HEIGHT = tiles[t] * dims[1];
+		memset(&comm, 0, sizeof(comm));
+		lbm_comm_init_ex_select( &comm, MESH_WIDTH, MESH_HEIGHT);
+		lbm_mesh_init( &mesh, lbm_comm_width( &comm ), lbm_comm_height( &comm ), lbm_comm_depth( &comm ) );
+		mesh_init_rank(&mesh, rank);
+
+		//ex11 exchanges in place the temporary mesh of its shared window
+		lbm_mesh_t exchanged = mesh;
+		if (comm.shared_cells != NULL)
+			exchanged.cells = comm.shared_cells;
+
+		//warmup
+		for (it = 0 ; it < BENCH_WARMUP ; it++)
+			lbm_comm_ghost_exchange_ex_select( &comm, &exchanged );
+
+		//measure
+		MPI_Barrier(MPI_COMM_WORLD);
+		lbm_timer_reset();
+		double start = lbm_timer_now();
+		for (it = 0 ; it < iterations ; it++)
+			lbm_comm_ghost_exchange_ex_select( &comm, &exchanged );
+		double local[4] = {
+			(lbm_timer_now() - start) / iterations,
+			lbm_timer_get(LBM_TIMER_EXCHANGE_PACK) / iterations,
+			lbm_timer_get(LBM_TIMER_EXCHANGE_WAIT) / iterations,
+			(double)bench_count_ghost_cells(&comm) * DIRECTIONS * sizeof(lbm_real_t),
+		};
+
+		//reduce
+		double min[4], max[4], sum[4];
+		MPI_Reduce(local, min, 4, MPI_DOUBLE, MPI_MIN, RANK_MASTER, MPI_COMM_WORLD);
+		MPI_Reduce(local, max, 4, MPI_DOUBLE, MPI_MAX, RANK_MASTER, MPI_COMM_WORLD);
+		MPI_Reduce(local, sum, 4, MPI_DOUBLE, MPI_SUM, RANK_MASTER, MPI_COMM_WORLD);
+
+		//print
+		if (rank == RANK_MASTER) {
+			double halo = sum[3] / comm_size;
+			double mean = sum[0] / comm_size;
+			double bandwidth = (max[0] > 0.0) ? halo / max[0] / 1e6 : 0.0;
+			printf("%10d %10.1f %12.2f %12.2f %12.2f %12.2f %12.2f %12.1f\n",
+				tiles[t], halo / 1024.0, min[0] * 1e6, mean * 1e6, max[0] * 1e6,
+				sum[1] / comm_size * 1e6, sum[2] / comm_size * 1e6, bandwidth);
+			if (csv != NULL)
+				fprintf(csv, "%d,%d,%d,%d,%d,%.0f,%g,%g,%g,%g,%g,%g\n",
+					comm_size, exercise, dims[0], dims[1], tiles[t], halo,
+					min[0], mean, max[0], sum[1] / comm_size, sum[2] / comm_size, bandwidth);
+			fit_x[t] = halo;
+			fit_y[t] = mean;
+		}
+
+		//clean
+		lbm_comm_release_ex_select(&comm);
+		lbm_mesh_release(&mesh);
+	}
+
+	//least squares fit of time = latency + bytes / bandwidth
+	if (rank == RANK_MASTER && nb_tiles >= 2) {
+		double sx = 0, sy = 0, sxx = 0, sxy = 0;
+		for (t = 0 ; t < nb_tiles ; t++) {
+			sx += fit_x[t];
+			sy += fit_y[t];
+			sxx += fit_x[t] * fit_x[t];
+			sxy += fit_x[t] * fit_y[t];
+		}
+		double det = nb_tiles * sxx - sx * sx;
+		if (det > 0.0) {
+			double slope = (nb_tiles * sxy - sx * sy) / det;
+			double latency = (sy - slope * sx) / nb_tiles;
+			printf(" * Model: latency %.2f us, bandwidth %.1f MB/s\n", latency * 1e6, (slope > 0.0) ? 1e-6 / slope : INFINITY);
+		}
+	}
+}
+
+/****************************************************/
+/** Run the --bench mode on all the requested exercises. **/
+static void bench_run(const struct arguments * arguments)
+{
+	//vars
+	int e, t, rank;
+	int nb_exercises = 0;
+	int nb_tiles;
+	int exercises[BENCH_MAX_VALUES];
+	int tiles[BENCH_MAX_VALUES];
+	FILE * csv = NULL;
+
+	//lists
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	if (strcmp(arguments->exercices, "all") == 0) {
+		for (e = 1 ; e <= LBM_MAX_EXERCISE ; e++)
+			exercises[nb_exercises++] = e;
+	} else {
+		nb_exercises = parse_int_list(arguments->exercices, exercises, BENCH_MAX_VALUES);
+	}
+	nb_tiles = parse_int_list(arguments->tiles, tiles, BENCH_MAX_VALUES);
+	for (t = 0 ; t < nb_tiles ; t++)
+		if (tiles[t] <= 0)
+			fatal("Invalid tile size for -t/--tiles option !");
+	if (arguments->iterations <= 0)
+		fatal("Invalid value for -i/--iterations option !");
+
+	//csv on master, the header only for a new file so runs on several rank counts
+	//can be appended
+	if (rank == RANK_MASTER && arguments->output != NULL) {
+		csv = fopen(arguments->output, "a");
+		if (csv == NULL) {
+			perror(arguments->output);
+			fatal("Fail to open the --bench output file !");
+		}
+		if (ftell(csv) == 0)
+			fprintf(csv, "ranks,exercise,nb_x,nb_y,tile,halo_bytes,time_min,time_mean,time_max,pack,wait,bandwidth_MBs\n");
+	}
+
+	//run
+	for (e = 0 ; e < nb_exercises ; e++)
+		bench_exercise(exercises[e], tiles, nb_tiles, arguments->iterations, csv);
+
+	//close
+	if (csv != NULL)
+		fclose(csv);
+}
+
 /****************************************************/
 int main(int argc, char * argv[])
 {
@@ -528,25 +801,42 @@ int main(int argc, char * argv[])
 	lbm_comm_t comm;
 	int rank;
 	int comm_size;
+	int thread_support;
 	int i;
 
 	//init MPI and get current rank and commuincator size.
-	MPI_Init( &argc, &argv );
+	//only the master thread of the hybrid exercise calls MPI
+	MPI_Init_thread( &argc, &argv, MPI_THREAD_FUNNELED, &thread_support );
 	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
 	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
 
 	//parse args
 	struct arguments arguments = {
-		.exercice = 0,
+		.exercices = "0",
 		.width = 16,
 		.height = 16,
 		.show = LBM_SHOW_CURRENT,
 		.fill = LBM_FILL_MODULO_9,
+		.bench = false,
+		.tiles = "8,16,32,64,128,256,512",
+		.iterations = 100,
+		.output = NULL,
 	};
 	parse_prgm_arguments(&arguments, argc, argv);
 
+	//the checked layouts are 2D tiles
+	if (DIMENSIONS != 2)
+		fatal("check_comm only supports the D2Q9 lattice !");
+
+	//measure instead of checking
+	if (arguments.bench) {
+		bench_run(&arguments);
+		MPI_Finalize();
+		return EXIT_SUCCESS;
+	}
+
 	//set exo
-	lbm_ex_select(arguments.exercice);
+	lbm_ex_select(atoi(arguments.exercices));
 
 	//run only on 9 ranks
 	if ( comm_size > 64 ) {
@@ -584,7 +874,7 @@ int main(int argc, char * argv[])
 	}
 
 	//init mesh
-	lbm_mesh_init( &mesh, lbm_comm_width( &comm ), lbm_comm_height( &comm ) );
+	lbm_mesh_init( &mesh, lbm_comm_width( &comm ), lbm_comm_height( &comm ), lbm_comm_depth( &comm ) );
 
 	//init
 	if (arguments.fill == LBM_FILL_RANK)
@@ -602,17 +892,21 @@ int main(int argc, char * argv[])
 	MPI_Barrier(MPI_COMM_WORLD);
 
 	//get positions
-	int coords[64][2];
+	lbm_coords_t coords[64];
 	MPI_Status status;
 	coords[0][0] = comm.rank_x;
 	coords[0][1] = comm.rank_y;
+	coords[0][2] = comm.x;
+	coords[0][3] = comm.y;
+	coords[0][4] = comm.width;
+	coords[0][5] = comm.height;
 	if (rank == RANK_MASTER) {
 		for (i = 1 ; i < comm_size ; i++)
-			MPI_Recv( coords[i], 2, MPI_INT, i, 0, MPI_COMM_WORLD, &status );
+			MPI_Recv( coords[i], 6, MPI_INT, i, 0, MPI_COMM_WORLD, &status );
 		for (i = 0 ; i < comm_size ; i++)
-			printf(" * Rank %d: (%d, %d)\n", i, coords[i][0], coords[i][1]);
+			printf(" * Rank %d: (%d, %d) (WH %d %d)\n", i, coords[i][0], coords[i][1], coords[i][4], coords[i][5]);
 	} else {
-		MPI_Send( coords[0], 2, MPI_INT, 0, 0, MPI_COMM_WORLD);
+		MPI_Send( coords[0], 6, MPI_INT, 0, 0, MPI_COMM_WORLD);
 	}
 	MPI_Barrier(MPI_COMM_WORLD);
 
@@ -622,20 +916,20 @@ int main(int argc, char * argv[])
 	lbm_comm_ghost_exchange_ex_select( &comm, &mesh );
 	MPI_Barrier(MPI_COMM_WORLD);
 
-	//allocate recieve meshes
+	//allocate recieve meshes (only rank 0 knows the size of each)
 	for (i = 0 ; i < comm_size ; i++)
-		lbm_mesh_init( &mesh_rank[i], lbm_comm_width( &comm ), lbm_comm_height( &comm ) );
+		lbm_mesh_init( &mesh_rank[i], (rank == RANK_MASTER) ? coords[i][4] : 1, (rank == RANK_MASTER) ? coords[i][5] : 1, 1 );
 	
 	//fetch on rank 0
 	if ( rank == RANK_MASTER ) {
 		printf(" * fetch...\n");
-		memcpy(mesh_rank[0].cells, mesh.cells, mesh.width * mesh.height * DIRECTIONS * sizeof(double));
+		memcpy(mesh_rank[0].cells, mesh.cells, mesh.width * mesh.height * DIRECTIONS * sizeof(lbm_real_t));
 		for (i = 1 ; i < comm_size ; i++)
-			MPI_Recv( mesh_rank[i].cells, mesh_rank[i].width * mesh_rank[i].height * DIRECTIONS, MPI_DOUBLE, i, i, MPI_COMM_WORLD, &status );
+			MPI_Recv( mesh_rank[i].cells, mesh_rank[i].width * mesh_rank[i].height * DIRECTIONS, LBM_MPI_REAL, i, i, MPI_COMM_WORLD, &status );
 		printf(" * display...\n");
 		display_meshes(&comm, mesh_rank, coords, comm_size, arguments.show, arguments.fill);
 	} else {
-		MPI_Send( mesh.cells, mesh.width * mesh.height * DIRECTIONS, MPI_DOUBLE, 0, rank, MPI_COMM_WORLD );
+		MPI_Send( mesh.cells, mesh.width * mesh.height * DIRECTIONS, LBM_MPI_REAL, 0, rank, MPI_COMM_WORLD );
 	}
 
 	//clean
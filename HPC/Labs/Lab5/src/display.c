@@ -14,9 +14,22 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <math.h>
+#include <float.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
+#ifdef HAVE_ZLIB
+	#include <zlib.h>
+#endif //HAVE_ZLIB
+#ifdef _OPENMP
+	#include <omp.h>
+#endif //_OPENMP
+#ifdef HAVE_PNG
+	#include <png.h>
+#endif //HAVE_PNG
 #include "lbm_struct.h"
 
 /*******************  ENUM  *********************/
@@ -26,9 +39,83 @@ typedef enum lbm_output_format_e
 	OUT_FORMAT_GNUPLOT,
 	OUT_FORMAT_OCTAVE,
 	OUT_FORMAT_CHECKSUM,
-	OUT_FORMAT_INFO
+	OUT_FORMAT_INFO,
+	OUT_FORMAT_CSV,
+	OUT_FORMAT_BINARY,
+	OUT_FORMAT_STATS,
+	OUT_FORMAT_AVERAGE,
+	OUT_FORMAT_PNG,
+	OUT_FORMAT_RGB,
+	OUT_FORMAT_COMPARE
 } lbm_output_format_t;
 
+/*******************  STRUCT  *********************/
+
+/** Buffers of a thread to decode the frames which cannot be used in place. **/
+typedef struct lbm_frame_reader_s
+{
+	/** Decoded frame. **/
+	lbm_file_entry_t * entries;
+	/** Decompressed frame before unshuffle. **/
+	void * work;
+} lbm_frame_reader_t;
+
+/*******************  STRUCT  *********************/
+
+/** Text produced by a thread before being written in order. **/
+typedef struct lbm_text_buffer_s
+{
+	char * data;
+	size_t size;
+	size_t capacity;
+} lbm_text_buffer_t;
+
+/*******************  STRUCT  *********************/
+
+/** Statistics of a frame, ignoring the obstacle cells (NaN). **/
+typedef struct lbm_frame_stats_s
+{
+	double checksum;
+	float density_min;
+	float density_max;
+	float v_min;
+	float v_max;
+	long obstacle_cells;
+} lbm_frame_stats_t;
+
+/*******************  STRUCT  *********************/
+
+/**
+ * Difference between a frame and the same frame of a reference file, for the density
+ * (index 0) and the velocity (index 1), ignoring the obstacle cells of both.
+**/
+typedef struct lbm_frame_diff_s
+{
+	double max[2];
+	double sum_sq[2];
+	double ref_sq[2];
+	long cells;
+} lbm_frame_diff_t;
+
+/*******************  STRUCT  *********************/
+
+/** Field drawn by the renderer and value range mapped on the palette. **/
+typedef struct lbm_render_s
+{
+	bool density;
+	float min;
+	float max;
+} lbm_render_t;
+
+/*******************  CONSTS  *********************/
+
+/** Palette of the gnuplot scripts, from the low to the high values. **/
+static const uint8_t render_palette[9][3] = {
+	{0x00,0x00,0x90}, {0x00,0x0f,0xff}, {0x00,0x90,0xff},
+	{0x0f,0xff,0xee}, {0x90,0xff,0x70}, {0xff,0xee,0x00},
+	{0xff,0x70,0x00}, {0xee,0x00,0x00}, {0x7f,0x00,0x00}
+};
+
 /*******************  FUNCTION  *********************/
 
 void fatal(const char * message)
@@ -39,42 +126,115 @@ void fatal(const char * message)
 
 /*******************  FUNCTION  *********************/
 
+static inline size_t frame_entries(const lbm_data_file_t * file)
+{
+	return (size_t)file->header.mesh_width * file->header.mesh_height;
+}
+
+/*******************  FUNCTION  *********************/
+
+void build_index_v2(lbm_data_file_t * file)
+{
+	//vars
+	lbm_file_trailer_v2_t trailer;
+	lbm_file_frame_v2_t prefix;
+	size_t offset;
+
+	//load the index from the end of the file
+	if (file->size >= sizeof(file->header_v2) + sizeof(trailer)) {
+		memcpy(&trailer,file->data + file->size - sizeof(trailer),sizeof(trailer));
+		if (trailer.magick == RESULT_MAGICK_V2 && trailer.index_offset + sizeof(uint64_t) * trailer.frames + sizeof(trailer) == file->size) {
+			file->frames = trailer.frames;
+			file->index = malloc(sizeof(uint64_t) * (file->frames + 1));
+			memcpy(file->index,file->data + trailer.index_offset,sizeof(uint64_t) * file->frames);
+			return;
+		}
+	}
+
+	//no index (the run did not finish), walk through the frames and drop a truncated last one
+	fprintf(stderr,"Warning : no frame index, the file was not closed properly, scanning it.\n");
+	file->frames = 0;
+	offset = sizeof(file->header_v2);
+	while (offset + sizeof(prefix) <= file->size)
+	{
+		memcpy(&prefix,file->data + offset,sizeof(prefix));
+		if (offset + sizeof(prefix) + prefix.size > file->size)
+			break;
+		file->index = realloc(file->index, sizeof(uint64_t) * (file->frames + 1));
+		file->index[file->frames++] = offset;
+		offset += sizeof(prefix) + prefix.size;
+	}
+}
+
+/*******************  FUNCTION  *********************/
+
 void open_data_file(lbm_data_file_t * file,const char * fname)
 {
+	//vars
+	struct stat info;
+	int i;
+
 	//errors
 	assert(file != NULL);
 	assert(fname != NULL);
 
 	//open file
-	file->fp = fopen(fname,"r");
-	if (file->fp == NULL)
+	file->fd = open(fname,O_RDONLY);
+	if (file->fd < 0 || fstat(file->fd,&info) != 0)
 	{
 		perror(fname);
 		abort();
 	}
 
-	//read header
-	if( !fread(&file->header,sizeof(file->header),1,file->fp) )
+	//check size
+	file->size = info.st_size;
+	if (file->size < sizeof(file->header))
 	{
-		if( ferror( file->fp ) )
-		{
-			perror( "fread" );
-			abort();
-		}
+		printf( "Error file is empty" );
+		abort();
+	}
 
-		if( feof( file->fp ) )
-		{
-			printf( "Error file is empty" );
-			abort();
-		}
+	//map the whole file, frames are then accessed in place
+	file->data = mmap(NULL,file->size,PROT_READ,MAP_PRIVATE,file->fd,0);
+	if (file->data == MAP_FAILED)
+	{
+		perror("mmap");
+		abort();
 	}
 
+	//read header
+	memcpy(&file->header,file->data,sizeof(file->header));
+	file->version = 1;
+	file->index = NULL;
+	file->frames = 0;
+
 	//check magick
-	if (file->header.magick != RESULT_MAGICK)
+	if (file->header.magick == RESULT_MAGICK_V2) {
+		//version 2, expose as a single line frame of the saved region
+		if (file->size < sizeof(file->header_v2))
+			fatal("Invalid file format.");
+		memcpy(&file->header_v2,file->data,sizeof(file->header_v2));
+		if (file->header_v2.version != 2)
+			fatal("Unsupported file format version.");
+		#ifndef HAVE_ZLIB
+			if (file->header_v2.codec == LBM_CODEC_ZLIB)
+				fatal("File compressed with zlib but zlib support not compiled in.");
+		#endif //HAVE_ZLIB
+		file->version = 2;
+		file->header.mesh_width = file->header_v2.width;
+		file->header.mesh_height = file->header_v2.height;
+		file->header.lines = 1;
+		build_index_v2(file);
+	} else if (file->header.magick == RESULT_MAGICK) {
+		//version 1, frames follow the header
+		size_t frame_size = frame_entries(file) * sizeof(lbm_file_entry_t);
+		file->frames = (file->size - sizeof(file->header)) / frame_size;
+		file->index = malloc(sizeof(uint64_t) * (file->frames + 1));
+		for (i = 0 ; i < file->frames ; i++)
+			file->index[i] = sizeof(file->header) + (uint64_t)i * frame_size;
+	} else {
 		fatal("Invalid file format.");
-
-	//allocate memory
-	file->entries = malloc(file->header.mesh_height * file->header.mesh_width * sizeof(lbm_file_entry_t));
+	}
 }
 
 /*******************  FUNCTION  *********************/
@@ -83,94 +243,239 @@ void close_data_file(lbm_data_file_t * file)
 {
 	//errors
 	assert(file != NULL);
-	assert(file->fp != NULL);
-	assert(file->entries != NULL);
+	assert(file->data != NULL);
 
 	//close
-	fclose(file->fp);
+	munmap((void*)file->data,file->size);
+	close(file->fd);
 
 	//free mem
-	free(file->entries);
+	free(file->index);
 }
 
 /*******************  FUNCTION  *********************/
 
-bool read_next_frame(lbm_data_file_t * file)
+void frame_reader_init(lbm_frame_reader_t * reader,const lbm_data_file_t * file)
 {
-	//vars
-	size_t res;
+	size_t size = frame_entries(file) * sizeof(lbm_file_entry_t);
+	reader->entries = malloc(size);
+	reader->work = malloc(size);
+	if (reader->entries == NULL || reader->work == NULL)
+		fatal("Fail to allocate the frame buffers.");
+}
 
-	//errors
-	assert(file != NULL);
-	assert(file->fp != NULL);
-	assert(file->entries != NULL);
+/*******************  FUNCTION  *********************/
 
-	//load the frame
-	res = fread(file->entries,sizeof(lbm_file_entry_t),file->header.mesh_height * file->header.mesh_width,file->fp);
+void frame_reader_release(lbm_frame_reader_t * reader)
+{
+	free(reader->entries);
+	free(reader->work);
+}
 
-	if (res != file->header.mesh_height * file->header.mesh_width)
+/*******************  FUNCTION  *********************/
+
+/**
+ * Convert the quantized values in place, they are stored as the difference with the
+ * previous value of the same field.
+**/
+void dequantize_frame_v2(const lbm_data_file_t * file,lbm_file_entry_t * entries,const int32_t * quantized)
+{
+	//vars
+	size_t i;
+	size_t count = frame_entries(file);
+	int32_t v = 0;
+	int32_t density = 0;
+	float step = 2.0f * file->header_v2.error_bound;
+
+	//loop, entries and quantized can be the same buffer
+	for (i = 0 ; i < count ; i++)
 	{
-		if (feof(file->fp))
-		{
-			return false;
+		int32_t dv = quantized[2 * i];
+		int32_t ddensity = quantized[2 * i + 1];
+		if (dv == LBM_FILE_QUANTIZED_NAN) {
+			entries[i].v = NAN;
+			entries[i].density = NAN;
 		} else {
-			fatal("Error while reading the file.");
-			return false;
+			v += dv;
+			density += ddensity;
+			entries[i].v = v * step;
+			entries[i].density = density * step;
 		}
-	} else {
-		return true;
 	}
 }
 
 /*******************  FUNCTION  *********************/
 
-bool seek_to_frame(lbm_data_file_t * file,int frame)
+/**
+ * Return the entries of a frame. The version 1 and the uncompressed float version 2
+ * files are read in place in the mapping, the others are decoded in the reader buffers.
+ * Can be called by several threads at the same time with their own reader.
+**/
+const lbm_file_entry_t * get_frame(const lbm_data_file_t * file,int frame,lbm_frame_reader_t * reader)
 {
-	int res = fseek(file->fp,frame * sizeof(lbm_file_entry_t) * file->header.mesh_height * file->header.mesh_width,SEEK_CUR);
-	return (res == 0);
+	//vars
+	lbm_file_frame_v2_t prefix;
+	size_t raw_size = frame_entries(file) * sizeof(lbm_file_entry_t);
+
+	//errors
+	assert(frame >= 0 && frame < file->frames);
+
+	//version 1
+	if (file->version == 1)
+		return (const lbm_file_entry_t *)(file->data + file->index[frame]);
+
+	//version 2
+	memcpy(&prefix,file->data + file->index[frame],sizeof(prefix));
+	const uint8_t * data = file->data + file->index[frame] + sizeof(prefix);
+
+	//decompress and unshuffle the bytes
+	if (file->header_v2.codec == LBM_CODEC_ZLIB) {
+		#ifdef HAVE_ZLIB
+			size_t i, b;
+			size_t words = raw_size / 4;
+			uLongf out_size = raw_size;
+			const uint8_t * in = reader->work;
+			uint8_t * out = (uint8_t*)reader->entries;
+			if (uncompress(reader->work,&out_size,data,prefix.size) != Z_OK || out_size != raw_size)
+				fatal("Fail to decompress the frame.");
+			for (b = 0 ; b < 4 ; b++)
+				for (i = 0 ; i < words ; i++)
+					out[i * 4 + b] = in[b * words + i];
+			data = out;
+		#endif //HAVE_ZLIB
+	} else if (prefix.size != raw_size) {
+		fatal("Invalid frame size.");
+	}
+
+	//floats are used in place
+	if (!file->header_v2.quantized)
+		return (const lbm_file_entry_t *)data;
+
+	//convert
+	dequantize_frame_v2(file,reader->entries,(const int32_t *)data);
+	return reader->entries;
 }
 
 /*******************  FUNCTION  *********************/
 
-void print_current_frame_gnuplot(lbm_data_file_t * file)
+/**
+ * Parse a frame selection : an id, a first:last range (both included) or "all".
+**/
+void parse_frame_range(const lbm_data_file_t * file,const char * value,int * first,int * last)
+{
+	if (strcmp(value,"all") == 0) {
+		*first = 0;
+		*last = file->frames - 1;
+	} else if (sscanf(value,"%d:%d",first,last) != 2) {
+		*first = atoi(value);
+		*last = *first;
+	}
+
+	//check
+	if (*first < 0 || *last >= file->frames || *first > *last)
+		fatal("Can't seek to the requested frame.");
+}
+
+/*******************  FUNCTION  *********************/
+
+static inline void text_buffer_reserve(lbm_text_buffer_t * buffer,size_t size)
+{
+	if (buffer->size + size > buffer->capacity) {
+		buffer->capacity = 2 * (buffer->size + size);
+		buffer->data = realloc(buffer->data,buffer->capacity);
+		if (buffer->data == NULL)
+			fatal("Fail to allocate the output buffer.");
+	}
+}
+
+/*******************  FUNCTION  *********************/
+
+/**
+ * Format the cells of a frame as text. Each thread formats a contiguous block of columns
+ * in its own buffer and the buffers are written in order, so the output is the same as
+ * a sequential one.
+ * @param csv Use the CSV format instead of the gnuplot one.
+**/
+void print_frame_text(const lbm_data_file_t * file,const lbm_file_entry_t * entries,bool csv)
 {
 	//vars
-	uint32_t i,j,l;
-	uint32_t line_height;
-	int pos;
+	int nb_blocks = 1;
+	int b;
+	uint32_t width = file->header.mesh_width;
+	uint32_t line_height = file->header.mesh_height / file->header.lines;
+	lbm_text_buffer_t * buffers;
 
-	//calc line_height
-	line_height = file->header.mesh_height / file->header.lines;
-	
-	//loop on datas
-	for ( i = 0 ; i < file->header.mesh_width ; i++)
+	//position of the saved cells in the mesh
+	uint32_t x0 = 0;
+	uint32_t y0 = 0;
+	uint32_t step = 1;
+	if (file->version == 2) {
+		x0 = file->header_v2.roi_x;
+		y0 = file->header_v2.roi_y;
+		step = file->header_v2.decimate;
+	}
+
+	//one block per thread
+	#ifdef _OPENMP
+		nb_blocks = omp_get_max_threads();
+	#endif //_OPENMP
+	buffers = calloc(nb_blocks,sizeof(lbm_text_buffer_t));
+
+	//format
+	#pragma omp parallel for schedule(static,1)
+	for (b = 0 ; b < nb_blocks ; b++)
 	{
-		for ( l = 0 ; l < file->header.lines ; l++)
+		uint32_t i,j,l;
+		uint32_t start = (uint64_t)width * b / nb_blocks;
+		uint32_t end = (uint64_t)width * (b + 1) / nb_blocks;
+		lbm_text_buffer_t * buffer = &buffers[b];
+		for ( i = start ; i < end ; i++)
 		{
-			for ( j = 0 ; j < line_height ; j++)
+			for ( l = 0 ; l < file->header.lines ; l++)
 			{
-					pos = line_height * i + j + l * line_height * file->header.mesh_width;
-					printf("%d %d %f %f\n",i,j+l * line_height,file->entries[pos].density,file->entries[pos].v);
+				for ( j = 0 ; j < line_height ; j++)
+				{
+					size_t pos = line_height * i + j + l * line_height * width;
+					text_buffer_reserve(buffer,256);
+					buffer->size += sprintf(buffer->data + buffer->size,csv ? "%d,%d,%.9g,%.9g\n" : "%d %d %f %f\n",
+						x0 + i * step,y0 + (j+l * line_height) * step,entries[pos].density,entries[pos].v);
+				}
+			}
+			if (!csv) {
+				text_buffer_reserve(buffer,1);
+				buffer->data[buffer->size++] = '\n';
 			}
 		}
-		printf("\n");
 	}
-	printf("\n");
+
+	//write in order
+	if (csv)
+		fputs("x,y,density,v\n",stdout);
+	for (b = 0 ; b < nb_blocks ; b++)
+	{
+		fwrite(buffers[b].data,1,buffers[b].size,stdout);
+		free(buffers[b].data);
+	}
+	if (!csv)
+		printf("\n");
+
+	//free
+	free(buffers);
 }
 
 /*******************  FUNCTION  *********************/
 
 double checksum = 0;
 
-void do_checksum(lbm_data_file_t * file)
+void do_checksum(lbm_data_file_t * file,const lbm_file_entry_t * entries)
 {
 	//vars
 	uint32_t i,j,l;
 	int pos;
-	
+
 	//calc line_height
 	int line_height = file->header.mesh_height / file->header.lines;
-	
+
 	//loop on datas
 	for ( i = 0 ; i < file->header.mesh_width ; i++)
 	{
@@ -179,22 +484,395 @@ void do_checksum(lbm_data_file_t * file)
 			for ( j = 0 ; j < line_height ; j++)
 			{
 				pos = line_height * i + j + l * line_height * file->header.mesh_width;
-				checksum += file->entries[pos].density + file->entries[pos].v;
+				//obstacle cells are NaN, skip them to keep a comparable sum
+				if (isnan(entries[pos].density) || isnan(entries[pos].v))
+					continue;
+				checksum += entries[pos].density + entries[pos].v;
 			}
 		}
 	}
 
-	printf("%llX - %g\n", (unsigned long long int)checksum ,checksum);
+	printf("%llX - %.17g\n", (unsigned long long int)checksum ,checksum);
+}
+
+/*******************  FUNCTION  *********************/
+
+void compute_frame_stats(const lbm_data_file_t * file,const lbm_file_entry_t * entries,lbm_frame_stats_t * stats)
+{
+	//vars
+	size_t i;
+	size_t count = frame_entries(file);
+
+	//init
+	stats->checksum = 0;
+	stats->density_min = FLT_MAX;
+	stats->density_max = -FLT_MAX;
+	stats->v_min = FLT_MAX;
+	stats->v_max = -FLT_MAX;
+	stats->obstacle_cells = 0;
+
+	//loop, obstacle cells are NaN and skipped
+	for (i = 0 ; i < count ; i++)
+	{
+		float density = entries[i].density;
+		float v = entries[i].v;
+		if (isnan(density) || isnan(v)) {
+			stats->obstacle_cells++;
+			continue;
+		}
+		stats->checksum += (double)density + (double)v;
+		if (density < stats->density_min) stats->density_min = density;
+		if (density > stats->density_max) stats->density_max = density;
+		if (v < stats->v_min) stats->v_min = v;
+		if (v > stats->v_max) stats->v_max = v;
+	}
+}
+
+/*******************  FUNCTION  *********************/
+
+/**
+ * Print the statistics of the selected frames, frames are decoded and processed in
+ * parallel. The checksum ignores the obstacle cells so it can be compared between runs.
+**/
+void print_stats(lbm_data_file_t * file,int first,int last)
+{
+	//vars
+	int f;
+	int count = last - first + 1;
+	lbm_frame_stats_t * stats = malloc(sizeof(lbm_frame_stats_t) * count);
+	lbm_frame_stats_t total = {0, FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX, 0};
+
+	//compute
+	#pragma omp parallel
+	{
+		lbm_frame_reader_t reader;
+		frame_reader_init(&reader,file);
+		#pragma omp for schedule(dynamic)
+		for (f = first ; f <= last ; f++)
+			compute_frame_stats(file,get_frame(file,f,&reader),&stats[f - first]);
+		frame_reader_release(&reader);
+	}
+
+	//print in order and reduce
+	printf("#frame checksum density_min density_max v_min v_max obstacle_cells\n");
+	for (f = 0 ; f < count ; f++)
+	{
+		printf("%d %.17g %g %g %g %g %ld\n",first + f,stats[f].checksum,stats[f].density_min,stats[f].density_max,stats[f].v_min,stats[f].v_max,stats[f].obstacle_cells);
+		total.checksum += stats[f].checksum;
+		total.density_min = fminf(total.density_min,stats[f].density_min);
+		total.density_max = fmaxf(total.density_max,stats[f].density_max);
+		total.v_min = fminf(total.v_min,stats[f].v_min);
+		total.v_max = fmaxf(total.v_max,stats[f].v_max);
+	}
+	printf("#total %.17g %g %g %g %g\n",total.checksum,total.density_min,total.density_max,total.v_min,total.v_max);
+
+	//free
+	free(stats);
+}
+
+/*******************  FUNCTION  *********************/
+
+/**
+ * Print the time average of the selected frames in the gnuplot format. Each thread
+ * accumulates its frames in its own buffer, the buffers are then summed.
+**/
+void print_average(lbm_data_file_t * file,int first,int last)
+{
+	//vars
+	size_t i;
+	int f;
+	size_t count = frame_entries(file);
+	double * sum = calloc(2 * count,sizeof(double));
+	lbm_file_entry_t * average = malloc(sizeof(lbm_file_entry_t) * count);
+
+	//accumulate
+	#pragma omp parallel private(i)
+	{
+		lbm_frame_reader_t reader;
+		double * local = calloc(2 * count,sizeof(double));
+		frame_reader_init(&reader,file);
+		#pragma omp for schedule(dynamic)
+		for (f = first ; f <= last ; f++)
+		{
+			const lbm_file_entry_t * entries = get_frame(file,f,&reader);
+			for (i = 0 ; i < count ; i++) {
+				local[2 * i] += entries[i].density;
+				local[2 * i + 1] += entries[i].v;
+			}
+		}
+		#pragma omp critical
+		for (i = 0 ; i < 2 * count ; i++)
+			sum[i] += local[i];
+		frame_reader_release(&reader);
+		free(local);
+	}
+
+	//average, obstacle cells stay NaN
+	for (i = 0 ; i < count ; i++)
+	{
+		average[i].density = sum[2 * i] / (last - first + 1);
+		average[i].v = sum[2 * i + 1] / (last - first + 1);
+	}
+
+	//print
+	print_frame_text(file,average,false);
+
+	//free
+	free(sum);
+	free(average);
+}
+
+/*******************  FUNCTION  *********************/
+
+void compute_frame_diff(const lbm_data_file_t * file,const lbm_file_entry_t * ref,const lbm_file_entry_t * entries,lbm_frame_diff_t * diff)
+{
+	//vars
+	size_t i;
+	int k;
+	size_t count = frame_entries(file);
+
+	//init
+	memset(diff,0,sizeof(*diff));
+
+	//loop, obstacle cells are NaN and skipped
+	for (i = 0 ; i < count ; i++)
+	{
+		double a[2] = {ref[i].density, ref[i].v};
+		double b[2] = {entries[i].density, entries[i].v};
+		if (isnan(a[0]) || isnan(a[1]) || isnan(b[0]) || isnan(b[1]))
+			continue;
+		for (k = 0 ; k < 2 ; k++) {
+			double d = fabs(b[k] - a[k]);
+			if (d > diff->max[k])
+				diff->max[k] = d;
+			diff->sum_sq[k] += d * d;
+			diff->ref_sq[k] += a[k] * a[k];
+		}
+		diff->cells++;
+	}
+}
+
+/*******************  FUNCTION  *********************/
+
+/**
+ * Print the drift of the selected frames of a run from the same frames of a reference
+ * run (eg. a single or mixed precision build against the double one) : max absolute
+ * difference, RMS difference and relative L2 norm of the difference, for the density
+ * and the velocity.
+**/
+void print_compare(lbm_data_file_t * file,int first,int last,const char * other_fname)
+{
+	//vars
+	int f, k;
+	int count = last - first + 1;
+	lbm_data_file_t other;
+	lbm_frame_diff_t total;
+	lbm_frame_diff_t * diffs = malloc(sizeof(lbm_frame_diff_t) * count);
+
+	//open and check they match
+	open_data_file(&other,other_fname);
+	if (other.header.mesh_width != file->header.mesh_width || other.header.mesh_height != file->header.mesh_height)
+		fatal("The two files do not have the same mesh size.");
+	if (last >= other.frames)
+		fatal("Can't seek to the requested frame in the compared file.");
+
+	//compute
+	#pragma omp parallel
+	{
+		lbm_frame_reader_t ref_reader;
+		lbm_frame_reader_t reader;
+		frame_reader_init(&ref_reader,file);
+		frame_reader_init(&reader,&other);
+		#pragma omp for schedule(dynamic)
+		for (f = first ; f <= last ; f++)
+			compute_frame_diff(file,get_frame(file,f,&ref_reader),get_frame(&other,f,&reader),&diffs[f - first]);
+		frame_reader_release(&ref_reader);
+		frame_reader_release(&reader);
+	}
+
+	//print in order and reduce
+	memset(&total,0,sizeof(total));
+	printf("#frame density_max density_rms density_rel_l2 v_max v_rms v_rel_l2 cells\n");
+	for (f = 0 ; f <= count ; f++)
+	{
+		lbm_frame_diff_t * diff = (f < count) ? &diffs[f] : &total;
+		if (f < count) {
+			printf("%d",first + f);
+			for (k = 0 ; k < 2 ; k++) {
+				total.max[k] = fmax(total.max[k],diff->max[k]);
+				total.sum_sq[k] += diff->sum_sq[k];
+				total.ref_sq[k] += diff->ref_sq[k];
+			}
+			total.cells += diff->cells;
+		} else {
+			printf("#total");
+		}
+		for (k = 0 ; k < 2 ; k++)
+			printf(" %g %g %g",diff->max[k],
+				(diff->cells > 0) ? sqrt(diff->sum_sq[k] / diff->cells) : 0.0,
+				(diff->ref_sq[k] > 0) ? sqrt(diff->sum_sq[k] / diff->ref_sq[k]) : 0.0);
+		printf(" %ld\n",diff->cells);
+	}
+
+	//free
+	free(diffs);
+	close_data_file(&other);
+}
+
+/*******************  FUNCTION  *********************/
+
+/**
+ * Colormap a frame into an RGB image of one pixel per saved cell, the top row being
+ * the top of the mesh. Obstacle cells (NaN) are white.
+**/
+void render_frame(const lbm_data_file_t * file,const lbm_file_entry_t * entries,const lbm_render_t * render,uint8_t * rgb)
+{
+	//vars
+	uint32_t i,j,c;
+	uint32_t width = file->header.mesh_width;
+	uint32_t height = file->header.mesh_height;
+	uint32_t line_height = height / file->header.lines;
+	float scale = (render->max > render->min) ? 8.0f / (render->max - render->min) : 0.0f;
+
+	//loop on pixels
+	for (j = 0 ; j < height ; j++)
+	{
+		uint8_t * row = rgb + 3 * (size_t)(height - 1 - j) * width;
+		for (i = 0 ; i < width ; i++)
+		{
+			size_t pos = line_height * i + j % line_height + (j / line_height) * line_height * width;
+			float value = render->density ? entries[pos].density : entries[pos].v;
+			uint8_t * pixel = row + 3 * i;
+			if (isnan(value)) {
+				pixel[0] = pixel[1] = pixel[2] = 0xff;
+				continue;
+			}
+
+			//interpolate between two colors of the palette
+			float t = (value - render->min) * scale;
+			t = (t < 0.0f) ? 0.0f : ((t > 8.0f) ? 8.0f : t);
+			int k = (t >= 8.0f) ? 7 : (int)t;
+			float a = t - k;
+			for (c = 0 ; c < 3 ; c++)
+				pixel[c] = render_palette[k][c] + a * (render_palette[k + 1][c] - render_palette[k][c]) + 0.5f;
+		}
+	}
+}
+
+/*******************  FUNCTION  *********************/
+
+#ifdef HAVE_PNG
+void write_png(const char * fname,const uint8_t * rgb,uint32_t width,uint32_t height)
+{
+	//vars
+	uint32_t j;
+	FILE * fp;
+	png_structp png;
+	png_infop info;
+
+	//open
+	fp = fopen(fname,"wb");
+	if (fp == NULL) {
+		perror(fname);
+		abort();
+	}
+	png = png_create_write_struct(PNG_LIBPNG_VER_STRING,NULL,NULL,NULL);
+	info = png_create_info_struct(png);
+	if (png == NULL || info == NULL || setjmp(png_jmpbuf(png)))
+		fatal("Fail to encode the PNG image.");
+
+	//fast compression, the frames are mostly smooth
+	png_init_io(png,fp);
+	png_set_compression_level(png,3);
+	png_set_IHDR(png,info,width,height,8,PNG_COLOR_TYPE_RGB,PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(png,info);
+	for (j = 0 ; j < height ; j++)
+		png_write_row(png,rgb + 3 * (size_t)j * width);
+	png_write_end(png,NULL);
+
+	//close
+	png_destroy_write_struct(&png,&info);
+	fclose(fp);
+}
+#endif //HAVE_PNG
+
+/*******************  FUNCTION  *********************/
+
+/**
+ * Render the selected frames, decoded and colormapped in parallel. Each frame goes to a
+ * PNG file named with the printf pattern output, or when output is NULL the raw RGB24
+ * frames are written in order on the standard output to be piped into ffmpeg. The
+ * velocity uses the fixed [0:0.14] range of the gnuplot scripts, the density the range
+ * of the selected frames.
+**/
+void render_frames(lbm_data_file_t * file,int first,int last,bool density,const char * output)
+{
+	//vars
+	int f;
+	size_t image_size = 3 * frame_entries(file);
+	lbm_render_t render = {density, 0.0f, 0.14f};
+
+	//errors
+	#ifndef HAVE_PNG
+		if (output != NULL)
+			fatal("Built without libpng, use --rgb and ffmpeg instead.");
+	#endif //HAVE_PNG
+	if (output != NULL && first != last && strchr(output,'%') == NULL)
+		fatal("Need an output pattern like frame_%05d.png to render several frames.");
+
+	//density range on all the frames to keep the colors stable
+	if (density) {
+		render.min = FLT_MAX;
+		render.max = -FLT_MAX;
+		#pragma omp parallel
+		{
+			lbm_frame_reader_t reader;
+			lbm_frame_stats_t stats;
+			frame_reader_init(&reader,file);
+			#pragma omp for schedule(dynamic)
+			for (f = first ; f <= last ; f++)
+			{
+				compute_frame_stats(file,get_frame(file,f,&reader),&stats);
+				#pragma omp critical
+				{
+					render.min = fminf(render.min,stats.density_min);
+					render.max = fmaxf(render.max,stats.density_max);
+				}
+			}
+			frame_reader_release(&reader);
+		}
+	}
+
+	//render
+	#pragma omp parallel
+	{
+		lbm_frame_reader_t reader;
+		uint8_t * rgb = malloc(image_size);
+		frame_reader_init(&reader,file);
+		#pragma omp for ordered schedule(dynamic)
+		for (f = first ; f <= last ; f++)
+		{
+			render_frame(file,get_frame(file,f,&reader),&render,rgb);
+			if (output == NULL) {
+				#pragma omp ordered
+				fwrite(rgb,1,image_size,stdout);
+			} else {
+				#ifdef HAVE_PNG
+					char fname[1024];
+					snprintf(fname,sizeof(fname),output,f);
+					write_png(fname,rgb,file->header.mesh_width,file->header.mesh_height);
+				#endif //HAVE_PNG
+			}
+		}
+		frame_reader_release(&reader);
+		free(rgb);
+	}
 }
 
 /*******************  FUNCTION  *********************/
 int get_frame_count(lbm_data_file_t * file)
 {
-	struct stat info;
-	if (fstat(fileno(file->fp), &info) == 0)
-		return info.st_size / (file->header.mesh_width * file->header.mesh_height * sizeof(lbm_file_entry_t));
-	else
-		return 0;
+	return file->frames;
 }
 
 /*******************  FUNCTION  *********************/
@@ -203,44 +881,91 @@ void print_info(lbm_data_file_t * file)
 	printf("width=%d\n",file->header.mesh_width);
 	printf("height=%d\n",file->header.mesh_height);
 	printf("frames=%d\n",get_frame_count(file));
+	printf("version=%d\n",file->version);
+	if (file->version == 2) {
+		printf("mesh=%dx%d\n",file->header_v2.mesh_width,file->header_v2.mesh_height);
+		printf("roi=%d %d\n",file->header_v2.roi_x,file->header_v2.roi_y);
+		printf("decimate=%d\n",file->header_v2.decimate);
+		printf("codec=%s\n",(file->header_v2.codec == LBM_CODEC_ZLIB) ? "zlib" : "none");
+		if (file->header_v2.quantized)
+			printf("error_bound=%g\n",file->header_v2.error_bound);
+	}
 }
 
 /*******************  FUNCTION  *********************/
 
-void print_current_frame(lbm_data_file_t * file,lbm_output_format_t format)
+void print_current_frame(lbm_data_file_t * file,const lbm_file_entry_t * entries,lbm_output_format_t format)
 {
 	switch(format)
 	{
 		case OUT_FORMAT_GNUPLOT:
-			print_current_frame_gnuplot(file);
+			print_frame_text(file,entries,false);
+			break;
+		case OUT_FORMAT_CSV:
+			print_frame_text(file,entries,true);
+			break;
+		case OUT_FORMAT_BINARY:
+			fwrite(entries,sizeof(lbm_file_entry_t),frame_entries(file),stdout);
 			break;
 		case OUT_FORMAT_OCTAVE :
 			printf("Not implemented \n");
 			abort();
 			break;
-		case OUT_FORMAT_INFO:
-			print_info(file);
-			break;
 		case OUT_FORMAT_CHECKSUM :
-			do_checksum(file);
+			do_checksum(file,entries);
+			break;
+		default:
+			fatal("Invalid format for a single frame.");
 			break;
 	}
 }
 
 /*******************  FUNCTION  *********************/
 
-void print_data(lbm_data_file_t * file,lbm_output_format_t format,int frame)
-{	
+void print_data(lbm_data_file_t * file,lbm_output_format_t format,const char * frames,bool density,const char * output)
+{
+	//vars
+	int first, last, f;
+	lbm_frame_reader_t reader;
+
 	//errors
 	assert(file != NULL);
-	assert(frame >= 0);
+	assert(frames != NULL);
 
-	//seek to frame
-	if (seek_to_frame(file,frame) == false)
-		fatal("Can't seek to the requested frame.");
-	//read
-	if (read_next_frame(file))
-		print_current_frame(file,format);
+	//info does not need frames
+	if (format == OUT_FORMAT_INFO) {
+		print_info(file);
+		return;
+	}
+
+	//select frames
+	parse_frame_range(file,frames,&first,&last);
+
+	//multi frame processing
+	if (format == OUT_FORMAT_STATS) {
+		print_stats(file,first,last);
+		return;
+	} else if (format == OUT_FORMAT_AVERAGE) {
+		print_average(file,first,last);
+		return;
+	} else if (format == OUT_FORMAT_PNG) {
+		render_frames(file,first,last,density,(output == NULL) ? "frame_%05d.png" : output);
+		return;
+	} else if (format == OUT_FORMAT_RGB) {
+		render_frames(file,first,last,density,NULL);
+		return;
+	} else if (format == OUT_FORMAT_COMPARE) {
+		if (output == NULL)
+			fatal("Missing the file to compare with.");
+		print_compare(file,first,last,output);
+		return;
+	}
+
+	//frame by frame
+	frame_reader_init(&reader,file);
+	for (f = first ; f <= last ; f++)
+		print_current_frame(file,get_frame(file,f,&reader),format);
+	frame_reader_release(&reader);
 }
 
 /*******************  FUNCTION  *********************/
@@ -250,31 +975,51 @@ int main(int argc, char * argv[])
 	//vars
 	lbm_data_file_t file;
 	lbm_output_format_t format;
-	int frame = -1;
-	
+	bool density = false;
+
 	//arg error
-	if (argc != 4)
+	if (argc != 4 && argc != 5)
 	{
-		fprintf(stderr,"Usage : %s {--gnuplot|--octave|--checksum|--info} {file.raw} {frame_id}\n",argv[0]);
+		fprintf(stderr,"Usage : %s {--gnuplot|--csv|--binary|--checksum|--info|--stats|--average} {file.raw} {frame_id|first:last|all}\n",argv[0]);
+		fprintf(stderr,"        %s {--png|--png=density} {file.raw} {frame_id|first:last|all} [{frame_%%05d.png}]\n",argv[0]);
+		fprintf(stderr,"        %s {--rgb|--rgb=density} {file.raw} {frame_id|first:last|all} | ffmpeg -f rawvideo -pix_fmt rgb24 -s {width}x{height} -i - out.mp4\n",argv[0]);
+		fprintf(stderr,"        %s --compare {reference.raw} {frame_id|first:last|all} {file.raw}\n",argv[0]);
 		abort();
 	}
 
 	//open
 	open_data_file(&file,argv[2]);
-	frame = atoi(argv[3]);
 
 	//read args
 	if (strcmp(argv[1],"--gnuplot") == 0)
 		format = OUT_FORMAT_GNUPLOT;
+	else if (strcmp(argv[1],"--csv") == 0)
+		format = OUT_FORMAT_CSV;
+	else if (strcmp(argv[1],"--binary") == 0)
+		format = OUT_FORMAT_BINARY;
 	else if (strcmp(argv[1],"--checksum") == 0)
 		format = OUT_FORMAT_CHECKSUM;
 	else if (strcmp(argv[1],"--info") == 0)
 		format = OUT_FORMAT_INFO;
-	else		
+	else if (strcmp(argv[1],"--stats") == 0)
+		format = OUT_FORMAT_STATS;
+	else if (strcmp(argv[1],"--average") == 0)
+		format = OUT_FORMAT_AVERAGE;
+	else if (strcmp(argv[1],"--png") == 0 || strcmp(argv[1],"--png=velocity") == 0)
+		format = OUT_FORMAT_PNG;
+	else if (strcmp(argv[1],"--rgb") == 0 || strcmp(argv[1],"--rgb=velocity") == 0)
+		format = OUT_FORMAT_RGB;
+	else if ((density = (strcmp(argv[1],"--png=density") == 0)))
+		format = OUT_FORMAT_PNG;
+	else if ((density = (strcmp(argv[1],"--rgb=density") == 0)))
+		format = OUT_FORMAT_RGB;
+	else if (strcmp(argv[1],"--compare") == 0)
+		format = OUT_FORMAT_COMPARE;
+	else
 		fatal("Invalid format option.");
 
 	//print
-	print_data(&file,format,frame);
+	print_data(&file,format,argv[3],density,(argc == 5) ? argv[4] : NULL);
 
 	//close
 	close_data_file(&file);
@@ -8,6 +8,7 @@
 
 /****************************************************/
 #include "lbm_struct.h"
+#include "lbm_sparse.h"
 #include "exercises.h"
 
 /****************************************************/
@@ -17,10 +18,16 @@ static int gblExercice = 0;
 void lbm_ex_select(int id) 
 {
 	int rank;
-	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	MPI_Comm_rank( lbm_comm_world, &rank );
 	gblExercice = id;
-	if (id < 0 || id > 6)
+	if (id < 0 || id > LBM_MAX_EXERCISE)
 		fatal("Invalid exercice ID !");
+	if (GHOST_DEPTH > 1 && id != 10)
+		fatal("A ghost depth larger than 1 is only supported by exercice 10 !");
+	if (DIMENSIONS == 3 && id != 0 && id != 4 && id != 9)
+		fatal("The 3D lattices are only supported by exercices 0, 4 and 9 !");
+	if (DIMENSIONS == 3 && (SPARSE_MODE || BALANCE_INTERVAL > 0 || REFINE_PATCH[2] > REFINE_PATCH[0] || CHECKPOINT_INTERVAL > 0 || ANALYSIS_INTERVAL > 0))
+		fatal("Sparse mode, load balancing, refinement, checkpoints and analysis need a 2D lattice !");
 	if (rank == 0)
 		printf("\033[32mSelect exercice %d\033[39m\n", id);
 }
@@ -28,6 +35,17 @@ void lbm_ex_select(int id)
 /****************************************************/
 void lbm_comm_init_ex_select( lbm_comm_t * comm, int total_width, int total_height )
 {
+	//one layer of ghost cells except for ex10
+	comm->ghost = 1;
+	comm->ghost_step = 0;
+
+	//no split along Z unless the exercise does it, the 3D lattices get the full depth
+	//with its outer ring (2D ones have a single plane)
+	comm->nb_z = 1;
+	comm->rank_z = 0;
+	comm->z = 0;
+	comm->depth = (DIMENSIONS == 3) ? MESH_DEPTH + 2 : 1;
+
 	switch (gblExercice) {
 		case 0:
 			lbm_comm_init_ex0(comm, total_width, total_height);
@@ -50,6 +68,21 @@ void lbm_comm_init_ex_select( lbm_comm_t * comm, int total_width, int total_heig
 		case 6:
 			lbm_comm_init_ex6(comm, total_width, total_height);
 			break;
+		case 7:
+			lbm_comm_init_ex7(comm, total_width, total_height);
+			break;
+		case 8:
+			lbm_comm_init_ex8(comm, total_width, total_height);
+			break;
+		case 9:
+			lbm_comm_init_ex9(comm, total_width, total_height);
+			break;
+		case 10:
+			lbm_comm_init_ex10(comm, total_width, total_height);
+			break;
+		case 11:
+			lbm_comm_init_ex11(comm, total_width, total_height);
+			break;
 		default:
 			fatal("Invalid exercice number !");
 			break;
@@ -62,14 +95,8 @@ void lbm_comm_init_ex_select( lbm_comm_t * comm, int total_width, int total_heig
 		fatal("lbm_comm_init_ex not implemented for this exercise, rank_x or rank_y is -1 !");//, gblExercice);
 	if (comm->width == -1 || comm->height == -1)
 		fatal("lbm_comm_init_ex not implemented for this exercise, width or height is -1 !");//, gblExercice);
-	if (comm->x == -1 || comm->y == -1)
+	if (lbm_comm_inner_x(comm) == -1 || lbm_comm_inner_y(comm) == -1)
 		fatal("lbm_comm_init_ex not implemented for this exercise, x or y is -1 !");//, gblExercice);
-
-	//check
-	if (total_width % comm->nb_x != 0)
-		warning("nb_x not multiple of total_width !");
-	if (total_height % comm->nb_y != 0)
-		warning("nb_x not multiple of total_width !");
 }
 
 /****************************************************/
@@ -97,6 +124,21 @@ void lbm_comm_release_ex_select( lbm_comm_t * comm )
 		case 6:
 			lbm_comm_release_ex6(comm);
 			break;
+		case 7:
+			lbm_comm_release_ex7(comm);
+			break;
+		case 8:
+			lbm_comm_release_ex8(comm);
+			break;
+		case 9:
+			lbm_comm_release_ex9(comm);
+			break;
+		case 10:
+			lbm_comm_release_ex10(comm);
+			break;
+		case 11:
+			lbm_comm_release_ex11(comm);
+			break;
 		default:
 			fatal("Invalid exercice number !");
 			break;
@@ -106,6 +148,9 @@ void lbm_comm_release_ex_select( lbm_comm_t * comm )
 /****************************************************/
 void lbm_comm_ghost_exchange_ex_select(lbm_comm_t * comm, lbm_mesh_t * mesh )
 {
+	//each exchange routine times its own blocking MPI calls as waiting
+	lbm_timer_exchange_begin();
+
 	switch(gblExercice) {
 		case 0:
 			lbm_comm_ghost_exchange_ex0(comm, mesh);
@@ -128,10 +173,28 @@ void lbm_comm_ghost_exchange_ex_select(lbm_comm_t * comm, lbm_mesh_t * mesh )
 		case 6:
 			lbm_comm_ghost_exchange_ex6(comm, mesh);
 			break;
+		case 7:
+			lbm_comm_ghost_exchange_ex7(comm, mesh);
+			break;
+		case 8:
+			lbm_comm_ghost_exchange_ex8(comm, mesh);
+			break;
+		case 9:
+			lbm_comm_ghost_exchange_ex9(comm, mesh);
+			break;
+		case 10:
+			lbm_comm_ghost_exchange_ex10(comm, mesh);
+			break;
+		case 11:
+			lbm_comm_ghost_exchange_ex11(comm, mesh);
+			break;
 		default:
 			fatal("Invalid exercice number !");
 			break;
 	}
+
+	//the rest of the exchange is accounted as packing
+	lbm_timer_exchange_end();
 }
 
 /****************************************************/
@@ -159,6 +222,21 @@ void lbm_save_ex_select(lbm_file_mesh_t * save_buffer, lbm_comm_t * comm, lbm_me
 		case 6:
 			lbm_save_ex0(save_buffer, comm, mesh_to_save, mesh_type, write_step);
 			break;
+		case 7:
+			lbm_save_ex0(save_buffer, comm, mesh_to_save, mesh_type, write_step);
+			break;
+		case 8:
+			lbm_save_ex0(save_buffer, comm, mesh_to_save, mesh_type, write_step);
+			break;
+		case 9:
+			lbm_save_ex0(save_buffer, comm, mesh_to_save, mesh_type, write_step);
+			break;
+		case 10:
+			lbm_save_ex0(save_buffer, comm, mesh_to_save, mesh_type, write_step);
+			break;
+		case 11:
+			lbm_save_ex0(save_buffer, comm, mesh_to_save, mesh_type, write_step);
+			break;
 		default:
 			fatal("Invalid exercice number !");
 			break;
@@ -168,6 +246,12 @@ void lbm_save_ex_select(lbm_file_mesh_t * save_buffer, lbm_comm_t * comm, lbm_me
 /****************************************************/
 void lbm_do_step_ex_select(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh )
 {
+	//sparse mode only keep the communications of the exercise (ex7 handle it in its threads)
+	if (mesh_type->sparse != NULL && gblExercice != 7) {
+		lbm_sparse_do_step(comm, mesh_type, mesh, temp_mesh);
+		return;
+	}
+
 	switch(gblExercice) {
 		case 0:
 			lbm_do_step_ex0(comm, mesh_type, mesh, temp_mesh );
@@ -190,6 +274,21 @@ void lbm_do_step_ex_select(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_m
 		case 6:
 			lbm_do_step_ex0(comm, mesh_type, mesh, temp_mesh );
 			break;
+		case 7:
+			lbm_do_step_ex7(comm, mesh_type, mesh, temp_mesh );
+			break;
+		case 8:
+			lbm_do_step_ex8(comm, mesh_type, mesh, temp_mesh );
+			break;
+		case 9:
+			lbm_do_step_ex0(comm, mesh_type, mesh, temp_mesh );
+			break;
+		case 10:
+			lbm_do_step_ex10(comm, mesh_type, mesh, temp_mesh );
+			break;
+		case 11:
+			lbm_do_step_ex11(comm, mesh_type, mesh, temp_mesh );
+			break;
 		default:
 			fatal("Invalid exercice number !");
 			break;
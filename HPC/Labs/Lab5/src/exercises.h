@@ -15,6 +15,11 @@
 #include "lbm_comm.h"
 #include "lbm_save.h"
 #include "lbm_phys.h"
+#include "lbm_timer.h"
+
+/****************************************************/
+/** Last valid exercise ID, to be updated when adding an exercise. **/
+#define LBM_MAX_EXERCISE 11
 
 /****************************************************/
 //sequential setup
@@ -72,6 +77,40 @@ void lbm_comm_ghost_exchange_ex6(lbm_comm_t * comm, lbm_mesh_t * mesh );
 void lbm_save_ex6(lbm_file_mesh_t * save_buffer, lbm_comm_t * comm, lbm_mesh_t * mesh_to_save, lbm_mesh_type_t * mesh_type, int write_step);
 void lbm_do_step_ex6(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh );
 
+/****************************************************/
+//hybrid MPI + OpenMP
+void lbm_comm_init_ex7( lbm_comm_t * comm, int total_width, int total_height );
+void lbm_comm_release_ex7( lbm_comm_t * comm );
+void lbm_comm_ghost_exchange_ex7(lbm_comm_t * comm, lbm_mesh_t * mesh );
+void lbm_do_step_ex7(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh );
+
+/****************************************************/
+//overlap of communications with computation
+void lbm_comm_init_ex8( lbm_comm_t * comm, int total_width, int total_height );
+void lbm_comm_release_ex8( lbm_comm_t * comm );
+void lbm_comm_ghost_exchange_ex8(lbm_comm_t * comm, lbm_mesh_t * mesh );
+void lbm_do_step_ex8(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh );
+
+/****************************************************/
+//neighborhood collective
+void lbm_comm_init_ex9( lbm_comm_t * comm, int total_width, int total_height );
+void lbm_comm_release_ex9( lbm_comm_t * comm );
+void lbm_comm_ghost_exchange_ex9(lbm_comm_t * comm, lbm_mesh_t * mesh );
+
+/****************************************************/
+//temporal blocking with deep ghost layers
+void lbm_comm_init_ex10( lbm_comm_t * comm, int total_width, int total_height );
+void lbm_comm_release_ex10( lbm_comm_t * comm );
+void lbm_comm_ghost_exchange_ex10(lbm_comm_t * comm, lbm_mesh_t * mesh );
+void lbm_do_step_ex10(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh );
+
+/****************************************************/
+//zero-copy exchange through shared memory on the node
+void lbm_comm_init_ex11( lbm_comm_t * comm, int total_width, int total_height );
+void lbm_comm_release_ex11( lbm_comm_t * comm );
+void lbm_comm_ghost_exchange_ex11(lbm_comm_t * comm, lbm_mesh_t * mesh );
+void lbm_do_step_ex11(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh );
+
 /****************************************************/
 //select
 void lbm_comm_init_ex_select( lbm_comm_t * comm, int total_width, int total_height );
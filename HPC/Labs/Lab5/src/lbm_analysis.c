@@ -0,0 +1,437 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lbm_phys.h"
+#include "lbm_analysis.h"
+
+/****************************************************/
+/** Position des 8 voisins, le tag d'un message est l'indice de sa direction. **/
+static const int lbm_analysis_neighbors[8][2] = {
+	{ 1, 0}, { 0, 1}, {-1, 0}, { 0,-1},
+	{ 1, 1}, {-1, 1}, {-1,-1}, { 1,-1}
+};
+
+/****************************************************/
+/**
+ * Cherche le processus possédant une maille du maillage global (sans la bordure).
+ * @param tiles Position et taille des tuiles de tous les processus (x, y, largeur, hauteur).
+ * @return Le rang du processus ou MPI_PROC_NULL si la maille est hors du maillage.
+**/
+static int lbm_analysis_find_owner(const int * tiles, int size, int x, int y)
+{
+	int r;
+	for (r = 0 ; r < size ; r++)
+	{
+		const int * tile = &tiles[4 * r];
+		if (x >= tile[0] && x < tile[0] + tile[2] && y >= tile[1] && y < tile[1] + tile[3])
+			return r;
+	}
+	return MPI_PROC_NULL;
+}
+
+/****************************************************/
+/**
+ * Construit le type sélectionnant une zone [x_start,x_end[ x [y_start,y_end[ du
+ * champ de vitesse local.
+**/
+static void lbm_analysis_build_type(MPI_Datatype * type, const lbm_comm_t * comm, int x_start, int x_end, int y_start, int y_end)
+{
+	int sizes[3] = {comm->width, comm->height, 2};
+	int subsizes[3] = {x_end - x_start, y_end - y_start, 2};
+	int starts[3] = {x_start, y_start, 0};
+	MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, type);
+	MPI_Type_commit(type);
+}
+
+/****************************************************/
+/**
+ * Recherche les voisins de la tuile locale à partir de la position des tuiles (ce qui
+ * marche quel que soit l'exercice), construit les types du halo et alloue les champs
+ * de vitesse. Fonction collective.
+**/
+static void lbm_analysis_setup_tile(lbm_analysis_t * analysis, const lbm_comm_t * comm)
+{
+	//vars
+	int k, size;
+	int w = comm->width;
+	int h = comm->height;
+	int g = comm->ghost;
+	int tile[4] = {lbm_comm_inner_x(comm), lbm_comm_inner_y(comm), w - 2 * g, h - 2 * g};
+	int * tiles;
+
+	//position of all the tiles
+	MPI_Comm_size( lbm_comm_world, &size );
+	tiles = malloc(sizeof(int) * 4 * size);
+	MPI_Allgather(tile, 4, MPI_INT, tiles, 4, MPI_INT, lbm_comm_world);
+
+	//neighbors and halo types
+	for (k = 0 ; k < 8 ; k++)
+	{
+		int dx = lbm_analysis_neighbors[k][0];
+		int dy = lbm_analysis_neighbors[k][1];
+		int x = (dx < 0) ? tile[0] - 1 : ((dx > 0) ? tile[0] + tile[2] : tile[0]);
+		int y = (dy < 0) ? tile[1] - 1 : ((dy > 0) ? tile[1] + tile[3] : tile[1]);
+		analysis->neighbors[k] = lbm_analysis_find_owner(tiles, size, x, y);
+
+		//last inner cells to send, first ghost layer to receive
+		int send_x = (dx > 0) ? w - g - 1 : g;
+		int send_y = (dy > 0) ? h - g - 1 : g;
+		int recv_x = (dx == 0) ? g : ((dx > 0) ? w - g : g - 1);
+		int recv_y = (dy == 0) ? g : ((dy > 0) ? h - g : g - 1);
+		int count_x = (dx == 0) ? w - 2 * g : 1;
+		int count_y = (dy == 0) ? h - 2 * g : 1;
+		lbm_analysis_build_type(&analysis->send_types[k], comm, send_x, send_x + count_x, send_y, send_y + count_y);
+		lbm_analysis_build_type(&analysis->recv_types[k], comm, recv_x, recv_x + count_x, recv_y, recv_y + count_y);
+	}
+	free(tiles);
+
+	//fields
+	analysis->velocity = calloc((size_t)w * h * 2, sizeof(double));
+	analysis->previous = calloc((size_t)w * h * 2, sizeof(double));
+	if (analysis->velocity == NULL || analysis->previous == NULL)
+		fatal("Fail to allocate the analysis buffers !");
+}
+
+/****************************************************/
+/**
+ * Libère les types du halo et les champs de vitesse de la tuile locale.
+**/
+static void lbm_analysis_release_tile(lbm_analysis_t * analysis)
+{
+	//vars
+	int k;
+
+	//free
+	for (k = 0 ; k < 8 ; k++)
+	{
+		MPI_Type_free(&analysis->send_types[k]);
+		MPI_Type_free(&analysis->recv_types[k]);
+	}
+	free(analysis->velocity);
+	free(analysis->previous);
+}
+
+/****************************************************/
+/**
+ * Calcule la vitesse des mailles internes et récupère celle des mailles voisines
+ * appartenant aux autres processus.
+**/
+static void lbm_analysis_velocity(lbm_analysis_t * analysis, const lbm_comm_t * comm, const lbm_mesh_t * mesh)
+{
+	//vars
+	int i, j, k;
+	int g = comm->ghost;
+	int nb_requests = 0;
+	MPI_Request requests[16];
+	Vector v;
+
+	//inner cells
+	for ( i = g ; i < mesh->width - g ; i++)
+	{
+		for ( j = g ; j < mesh->height - g ; j++)
+		{
+			lbm_mesh_cell_t cell = lbm_mesh_get_cell(mesh, i, j);
+			lbm_phys_cell_velocity(v, cell, lbm_phys_cell_density(cell));
+			analysis->velocity[2 * ((size_t)i * mesh->height + j)] = v[0];
+			analysis->velocity[2 * ((size_t)i * mesh->height + j) + 1] = v[1];
+		}
+	}
+
+	//halo, the neighbor tag its message with the opposite direction
+	for (k = 0 ; k < 8 ; k++)
+	{
+		if (analysis->neighbors[k] == MPI_PROC_NULL)
+			continue;
+		int tag_recv = (k < 4) ? (k + 2) % 4 : 4 + (k - 4 + 2) % 4;
+		MPI_Irecv(analysis->velocity, 1, analysis->recv_types[k], analysis->neighbors[k], tag_recv, lbm_comm_world, &requests[nb_requests++]);
+		MPI_Isend(analysis->velocity, 1, analysis->send_types[k], analysis->neighbors[k], k, lbm_comm_world, &requests[nb_requests++]);
+	}
+	MPI_Waitall(nb_requests, requests, MPI_STATUSES_IGNORE);
+}
+
+/****************************************************/
+/**
+ * Reprend la série temporelle d'un calcul interrompu : garde l'entête et les lignes
+ * jusqu'à l'itération du point de reprise, les suivantes seront recalculées. Une
+ * ligne incomplète (arrêt pendant l'écriture) est aussi retirée.
+ * @param iteration Itération du point de reprise.
+ * @return 1 si l'entête est déjà présent dans le fichier, 0 sinon.
+**/
+static int lbm_analysis_truncate(int iteration)
+{
+	//vars
+	char buffer[4096];
+	long keep = 0;
+	int has_header = 0;
+	FILE * fp;
+
+	//no previous series
+	fp = fopen(ANALYSIS_FILENAME, "r");
+	if (fp == NULL)
+		return 0;
+
+	//header then the rows up to the checkpoint
+	while (fgets(buffer, sizeof(buffer), fp) != NULL)
+	{
+		if (buffer[strlen(buffer) - 1] != '\n')
+			break;
+		if (keep == 0 && strncmp(buffer, "iteration,", 10) == 0)
+			has_header = 1;
+		else if (!has_header || atoi(buffer) > iteration)
+			break;
+		keep = ftell(fp);
+	}
+	fclose(fp);
+
+	//drop the rows computed after the checkpoint
+	if (truncate(ANALYSIS_FILENAME, keep) != 0) {
+		perror(ANALYSIS_FILENAME);
+		abort();
+	}
+	return has_header;
+}
+
+/****************************************************/
+/**
+ * Prépare l'analyse : recherche des voisins à partir de la position des tuiles (ce qui
+ * marche quel que soit l'exercice) et allocation des champs de vitesse.
+ * Sur reprise, la série temporelle est continuée après l'itération du point de reprise
+ * et la vitesse précédente est celle du maillage restauré, le premier résidu est donc
+ * un vrai résidu (identique au calcul non interrompu si le point de reprise tombe sur
+ * un pas d'analyse).
+ * Fonction collective.
+ * @param mesh Maillage restauré, utilisé seulement sur reprise.
+ * @param restart_iteration Itération du point de reprise, 0 pour un nouveau calcul.
+**/
+void lbm_analysis_init(lbm_analysis_t * analysis, const lbm_comm_t * comm, const lbm_mesh_t * mesh, int restart_iteration)
+{
+	//vars
+	int rank;
+
+	//errors
+	assert(analysis != NULL);
+	assert(comm != NULL);
+	assert(mesh != NULL);
+
+	//get infos
+	memset(analysis, 0, sizeof(*analysis));
+	MPI_Comm_rank( lbm_comm_world, &rank );
+
+	//neighbors and fields
+	lbm_analysis_setup_tile(analysis, comm);
+
+	//time series, continue the one of the interrupted run on restart
+	if (rank == RANK_MASTER) {
+		if (restart_iteration > 0)
+			analysis->has_header = lbm_analysis_truncate(restart_iteration);
+		analysis->fp = fopen(ANALYSIS_FILENAME, (restart_iteration > 0) ? "a" : "w");
+		if (analysis->fp == NULL) {
+			perror(ANALYSIS_FILENAME);
+			abort();
+		}
+	}
+
+	//previous velocity from the restored state
+	if (restart_iteration > 0) {
+		lbm_analysis_velocity(analysis, comm, mesh);
+		memcpy(analysis->previous, analysis->velocity, sizeof(double) * 2 * mesh->width * mesh->height);
+		analysis->has_previous = 1;
+	}
+}
+
+/****************************************************/
+/**
+ * Suit un changement des coupes du domaine (équilibrage de charge) : reconstruit le
+ * halo pour la nouvelle tuile et déplace la vitesse précédente pour que le résidu
+ * reste valide. La série temporelle continue dans le même fichier.
+ * Fonction collective.
+ * @param old_comm Découpage d'origine.
+ * @param comm Nouveau découpage.
+**/
+void lbm_analysis_remap(lbm_analysis_t * analysis, const lbm_comm_t * old_comm, const lbm_comm_t * comm)
+{
+	//vars
+	MPI_Datatype cell_type;
+	double * old_previous = analysis->previous;
+
+	//rebuild, keep the previous velocity of the old tile
+	analysis->previous = NULL;
+	lbm_analysis_release_tile(analysis);
+	lbm_analysis_setup_tile(analysis, comm);
+
+	//move the previous velocity, two values per cell
+	MPI_Type_contiguous(2, MPI_DOUBLE, &cell_type);
+	MPI_Type_commit(&cell_type);
+	lbm_comm_migrate(old_comm, old_previous, comm, analysis->previous, cell_type);
+	MPI_Type_free(&cell_type);
+	free(old_previous);
+}
+
+/****************************************************/
+/**
+ * Ajoute une grandeur calculée par l'utilisateur, elle sera réduite avec l'opération
+ * donnée et ajoutée comme une colonne de la série temporelle. Doit être appelé par
+ * tous les processus dans le même ordre, avant le premier appel à lbm_analysis_run.
+**/
+void lbm_analysis_add_hook(lbm_analysis_t * analysis, const char * name, lbm_analysis_hook_t hook, MPI_Op op)
+{
+	//errors
+	assert(analysis != NULL);
+	assert(hook != NULL);
+	if (analysis->nb_hooks >= LBM_ANALYSIS_MAX_HOOKS)
+		fatal("Too many analysis hooks !");
+
+	//register
+	analysis->hook_names[analysis->nb_hooks] = name;
+	analysis->hooks[analysis->nb_hooks] = hook;
+	analysis->hook_ops[analysis->nb_hooks] = op;
+	analysis->nb_hooks++;
+}
+
+/****************************************************/
+void lbm_analysis_release(lbm_analysis_t * analysis)
+{
+	//free
+	lbm_analysis_release_tile(analysis);
+	if (analysis->fp != NULL)
+		fclose(analysis->fp);
+}
+
+/****************************************************/
+/**
+ * Calcule les grandeurs de l'analyse sur l'état courant, les écrit dans la série
+ * temporelle et indique si la simulation a convergé. Fonction collective.
+ * Les forces sur les mailles solides sont obtenues par échange de quantité de mouvement :
+ * chaque densité arrivée d'une maille fluide dans une maille solide repart en sens
+ * inverse, ce qui transfère 2 * c_k * f_k au solide.
+ * @return 1 si le résidu est passé sous le seuil de convergence, 0 sinon.
+**/
+int lbm_analysis_run(lbm_analysis_t * analysis, const lbm_comm_t * comm, const lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type, int iteration)
+{
+	//vars
+	int i, j, k, rank, converged;
+	int h = mesh->height;
+	int g = comm->ghost;
+	double local[6] = {0, 0, 0, 0, 0, 0};
+	double global[6];
+	double local_max_vorticity = 0.0;
+	double local_hooks[LBM_ANALYSIS_MAX_HOOKS];
+	const double * u = analysis->velocity;
+	lbm_analysis_values_t * values = &analysis->values;
+
+	//errors
+	assert(analysis != NULL);
+	assert(mesh != NULL);
+	assert(mesh_type != NULL);
+
+	//velocity field with its halo
+	lbm_analysis_velocity(analysis, comm, mesh);
+
+	//loop on inner cells
+	for ( i = g ; i < mesh->width - g ; i++)
+	{
+		for ( j = g ; j < h - g ; j++)
+		{
+			size_t pos = 2 * ((size_t)i * h + j);
+
+			//momentum given to the solid by the densities coming from the fluid
+			if (lbm_cell_type_t_is_solid(mesh_type, i, j)) {
+				lbm_mesh_cell_t cell = lbm_mesh_get_cell(mesh, i, j);
+				for ( k = 1 ; k < DIRECTIONS ; k++)
+				{
+					int si = i - direction_matrix[k][0];
+					int sj = j - direction_matrix[k][1];
+					if (!lbm_cell_type_t_is_solid(mesh_type, si, sj)) {
+						local[0] += 2.0 * direction_matrix[k][0] * LBM_LOAD(cell,k);
+						local[1] += 2.0 * direction_matrix[k][1] * LBM_LOAD(cell,k);
+					}
+				}
+				continue;
+			}
+
+			//mean velocity and residual
+			double norm2 = u[pos] * u[pos] + u[pos + 1] * u[pos + 1];
+			double dx = u[pos] - analysis->previous[pos];
+			double dy = u[pos + 1] - analysis->previous[pos + 1];
+			local[2] += sqrt(norm2);
+			local[3] += 1.0;
+			local[4] += dx * dx + dy * dy;
+			local[5] += norm2;
+
+			//vorticity with centered differences, only between inner fluid cells
+			int gx = comm->x + i;
+			int gy = comm->y + j;
+			if (gx <= 1 || gx >= MESH_WIDTH || gy <= 1 || gy >= MESH_HEIGHT)
+				continue;
+			if (lbm_cell_type_t_is_solid(mesh_type, i - 1, j)
+				|| lbm_cell_type_t_is_solid(mesh_type, i + 1, j)
+				|| lbm_cell_type_t_is_solid(mesh_type, i, j - 1)
+				|| lbm_cell_type_t_is_solid(mesh_type, i, j + 1))
+				continue;
+			double vorticity = (u[pos + 2 * h + 1] - u[pos - 2 * h + 1]) / 2.0 - (u[pos + 2] - u[pos - 2]) / 2.0;
+			if (fabs(vorticity) > local_max_vorticity)
+				local_max_vorticity = fabs(vorticity);
+		}
+	}
+
+	//user quantities
+	for (k = 0 ; k < analysis->nb_hooks ; k++)
+		local_hooks[k] = analysis->hooks[k](mesh, mesh_type, comm);
+
+	//reduce on master
+	MPI_Reduce(local, global, 6, MPI_DOUBLE, MPI_SUM, RANK_MASTER, lbm_comm_world);
+	MPI_Reduce(&local_max_vorticity, &values->max_vorticity, 1, MPI_DOUBLE, MPI_MAX, RANK_MASTER, lbm_comm_world);
+	for (k = 0 ; k < analysis->nb_hooks ; k++)
+		MPI_Reduce(&local_hooks[k], &values->hooks[k], 1, MPI_DOUBLE, analysis->hook_ops[k], RANK_MASTER, lbm_comm_world);
+
+	//final values and time series on master
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	converged = 0;
+	if (rank == RANK_MASTER) {
+		double reference = INFLOW_MAX_VELOCITY * INFLOW_MAX_VELOCITY * OBSTACLE_R;
+		values->drag = global[0];
+		values->lift = global[1];
+		values->drag_coef = (reference > 0.0) ? global[0] / reference : 0.0;
+		values->lift_coef = (reference > 0.0) ? global[1] / reference : 0.0;
+		values->mean_velocity = (global[3] > 0.0) ? global[2] / global[3] : 0.0;
+		values->residual = (analysis->has_previous && global[5] > 0.0) ? sqrt(global[4] / global[5]) : 1.0;
+		converged = (CONVERGENCE_THRESHOLD > 0.0 && values->residual < CONVERGENCE_THRESHOLD);
+
+		//header on first call, hooks are known
+		if (!analysis->has_header) {
+			fprintf(analysis->fp, "iteration,drag,lift,drag_coef,lift_coef,mean_velocity,max_vorticity,residual");
+			for (k = 0 ; k < analysis->nb_hooks ; k++)
+				fprintf(analysis->fp, ",%s", analysis->hook_names[k]);
+			fprintf(analysis->fp, "\n");
+			analysis->has_header = 1;
+		}
+
+		//values
+		fprintf(analysis->fp, "%d,%.10g,%.10g,%.10g,%.10g,%.10g,%.10g,%.10g", iteration,
+			values->drag, values->lift, values->drag_coef, values->lift_coef,
+			values->mean_velocity, values->max_vorticity, values->residual);
+		for (k = 0 ; k < analysis->nb_hooks ; k++)
+			fprintf(analysis->fp, ",%.10g", values->hooks[k]);
+		fprintf(analysis->fp, "\n");
+		fflush(analysis->fp);
+	}
+
+	//keep for next residual
+	memcpy(analysis->previous, analysis->velocity, sizeof(double) * 2 * mesh->width * h);
+	analysis->has_previous = 1;
+
+	//all the ranks stop together
+	MPI_Bcast(&converged, 1, MPI_INT, RANK_MASTER, lbm_comm_world);
+	return converged;
+}
@@ -0,0 +1,94 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef LBM_ANALYSIS_H
+#define LBM_ANALYSIS_H
+
+/****************************************************/
+#include <stdio.h>
+#include <mpi.h>
+#include "lbm_struct.h"
+#include "lbm_comm.h"
+
+/****************************************************/
+/** Maximum number of user quantities added to the analysis. **/
+#define LBM_ANALYSIS_MAX_HOOKS 8
+
+/****************************************************/
+/**
+ * User quantity computed on the local mesh, the local values of all the ranks are
+ * combined with the MPI operation given at registration.
+**/
+typedef double (*lbm_analysis_hook_t)(const lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
+
+/****************************************************/
+/** Values computed at each analysis step. **/
+typedef struct lbm_analysis_values_s
+{
+	/** Force on the solid cells along X (momentum exchange). **/
+	double drag;
+	/** Force on the solid cells along Y (momentum exchange). **/
+	double lift;
+	/** Drag coefficient using the obstacle diameter and the inflow max velocity. **/
+	double drag_coef;
+	/** Lift coefficient using the obstacle diameter and the inflow max velocity. **/
+	double lift_coef;
+	/** Mean velocity norm on the fluid cells. **/
+	double mean_velocity;
+	/** Maximum absolute vorticity on the fluid cells. **/
+	double max_vorticity;
+	/** Relative L2 change of the velocity since the previous analysis step. **/
+	double residual;
+	/** Values of the user quantities. **/
+	double hooks[LBM_ANALYSIS_MAX_HOOKS];
+} lbm_analysis_values_t;
+
+/****************************************************/
+/**
+ * State of the in-situ analysis : neighbors to exchange the velocity halo, previous
+ * velocity for the residual and the time series file (master only).
+**/
+typedef struct lbm_analysis_s
+{
+	/** Velocity of the local cells with a halo of one cell (width x height x 2). **/
+	double * velocity;
+	/** Velocity at the previous analysis step for the residual (width x height x 2). **/
+	double * previous;
+	/** If the previous velocity is valid. **/
+	int has_previous;
+	/** If the header of the time series is written (master only). **/
+	int has_header;
+	/** Rank of the 8 neighbors (MPI_PROC_NULL on the global borders). **/
+	int neighbors[8];
+	/** Halo types to send to each neighbor. **/
+	MPI_Datatype send_types[8];
+	/** Halo types to receive from each neighbor. **/
+	MPI_Datatype recv_types[8];
+	/** Time series output (master only). **/
+	FILE * fp;
+	/** Number of user quantities. **/
+	int nb_hooks;
+	/** Names of the user quantities. **/
+	const char * hook_names[LBM_ANALYSIS_MAX_HOOKS];
+	/** Functions computing the user quantities. **/
+	lbm_analysis_hook_t hooks[LBM_ANALYSIS_MAX_HOOKS];
+	/** Reduction of the user quantities. **/
+	MPI_Op hook_ops[LBM_ANALYSIS_MAX_HOOKS];
+	/** Last computed values. **/
+	lbm_analysis_values_t values;
+} lbm_analysis_t;
+
+/****************************************************/
+void lbm_analysis_init(lbm_analysis_t * analysis, const lbm_comm_t * comm, const lbm_mesh_t * mesh, int restart_iteration);
+void lbm_analysis_add_hook(lbm_analysis_t * analysis, const char * name, lbm_analysis_hook_t hook, MPI_Op op);
+int lbm_analysis_run(lbm_analysis_t * analysis, const lbm_comm_t * comm, const lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type, int iteration);
+void lbm_analysis_remap(lbm_analysis_t * analysis, const lbm_comm_t * old_comm, const lbm_comm_t * comm);
+void lbm_analysis_release(lbm_analysis_t * analysis);
+
+#endif //LBM_ANALYSIS_H
@@ -0,0 +1,213 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "lbm_balance.h"
+#include "lbm_config.h"
+#include "lbm_timer.h"
+
+/****************************************************/
+/** Valeurs décrivant une tuile pour le profil de coût : x, y, largeur, hauteur, rank_x, rank_y, temps. **/
+#define LBM_BALANCE_TILE 7
+
+/****************************************************/
+/**
+ * Temps de calcul (mailles spéciales, collision et propagation) du processus local
+ * depuis le début de la boucle.
+**/
+static double lbm_balance_compute_time(void)
+{
+	return lbm_timer_get(LBM_TIMER_SPECIAL_CELLS) + lbm_timer_get(LBM_TIMER_COLLISION) + lbm_timer_get(LBM_TIMER_PROPAGATION);
+}
+
+/****************************************************/
+/**
+ * Prépare les mesures, à appeler après lbm_timer_reset().
+**/
+void lbm_balance_init(lbm_balance_t * balance)
+{
+	memset(balance, 0, sizeof(*balance));
+	balance->compute_mark = lbm_balance_compute_time();
+	balance->wait_mark = lbm_timer_get(LBM_TIMER_EXCHANGE_WAIT);
+	balance->imbalance = 1.0;
+}
+
+/****************************************************/
+/**
+ * Mesure la fenêtre écoulée depuis la dernière vérification et l'ajoute au bilan
+ * avant le premier équilibrage ou depuis le dernier. Fonction collective.
+ * @return Le temps de calcul local de la fenêtre.
+**/
+static double lbm_balance_measure(lbm_balance_t * balance, long steps)
+{
+	//vars
+	int size;
+	double local[2];
+	double sum[2];
+	double max;
+	double * totals = (balance->rebalances == 0) ? balance->before : balance->after;
+
+	//local window
+	local[0] = lbm_balance_compute_time() - balance->compute_mark;
+	local[1] = lbm_timer_get(LBM_TIMER_EXCHANGE_WAIT) - balance->wait_mark;
+	balance->compute_mark += local[0];
+	balance->wait_mark += local[1];
+
+	//reduce
+	MPI_Comm_size( lbm_comm_world, &size );
+	MPI_Allreduce(local, sum, 2, MPI_DOUBLE, MPI_SUM, lbm_comm_world);
+	MPI_Allreduce(local, &max, 1, MPI_DOUBLE, MPI_MAX, lbm_comm_world);
+	balance->imbalance = (sum[0] > 0.0) ? max * size / sum[0] : 1.0;
+
+	//accumulate
+	totals[0] += sum[1] / size;
+	totals[1] += max;
+	totals[2] += sum[0] / size;
+	totals[3] += steps - balance->steps_mark;
+	balance->steps_mark = steps;
+
+	return local[0];
+}
+
+/****************************************************/
+/**
+ * Construit le profil de coût des colonnes et des lignes du maillage global : le temps
+ * de calcul de chaque processus est réparti uniformément sur les mailles de sa tuile.
+ * Récupère aussi les coupes actuelles.
+**/
+static void lbm_balance_profiles(const double * tiles, int size, double * columns, double * lines, int * starts_x, int * starts_y)
+{
+	//vars
+	int r, i;
+
+	//clear
+	memset(columns, 0, sizeof(double) * MESH_WIDTH);
+	memset(lines, 0, sizeof(double) * MESH_HEIGHT);
+
+	//spread
+	for (r = 0 ; r < size ; r++)
+	{
+		const double * tile = &tiles[LBM_BALANCE_TILE * r];
+		int x = tile[0], y = tile[1], w = tile[2], h = tile[3];
+		double density = tile[6] / ((double)w * h);
+		for (i = x ; i < x + w ; i++)
+			columns[i] += density * h;
+		for (i = y ; i < y + h ; i++)
+			lines[i] += density * w;
+		starts_x[(int)tile[4]] = x;
+		starts_y[(int)tile[5]] = y;
+	}
+}
+
+/****************************************************/
+/**
+ * Vérifie l'équilibre de charge et choisit de nouvelles coupes si besoin. Les coupes
+ * restent alignées sur toute une colonne (resp. ligne) de processus comme l'attendent
+ * les échanges, elles sont placées par lbm_comm_weighted_split() sur le profil de coût
+ * mesuré. Fonction collective, tous les processus prennent la même décision.
+ * @param steps Nombre de pas calculés depuis le début de la boucle.
+ * @return 1 si les coupes ont changé (imposées via lbm_comm_force_split()) et que les
+ * tuiles doivent être reconstruites.
+**/
+int lbm_balance_check(lbm_balance_t * balance, const lbm_comm_t * comm, long steps)
+{
+	//vars
+	int size, k;
+	int changed = 0;
+	double local[LBM_BALANCE_TILE];
+
+	//measure
+	local[6] = lbm_balance_measure(balance, steps);
+	MPI_Comm_size( lbm_comm_world, &size );
+	if (size == 1 || balance->imbalance <= 1.0 + BALANCE_TOLERANCE)
+		return 0;
+
+	//tiles and times of everybody
+	local[0] = lbm_comm_inner_x(comm);
+	local[1] = lbm_comm_inner_y(comm);
+	local[2] = lbm_comm_inner_width(comm);
+	local[3] = lbm_comm_inner_height(comm);
+	local[4] = comm->rank_x;
+	local[5] = comm->rank_y;
+	double * tiles = malloc(sizeof(double) * LBM_BALANCE_TILE * size);
+	MPI_Allgather(local, LBM_BALANCE_TILE, MPI_DOUBLE, tiles, LBM_BALANCE_TILE, MPI_DOUBLE, lbm_comm_world);
+
+	//cost profiles and current cuts
+	double * columns = malloc(sizeof(double) * MESH_WIDTH);
+	double * lines = malloc(sizeof(double) * MESH_HEIGHT);
+	int * starts_x = malloc(sizeof(int) * (comm->nb_x + 1));
+	int * starts_y = malloc(sizeof(int) * (comm->nb_y + 1));
+	int * cuts_x = malloc(sizeof(int) * (comm->nb_x + 1));
+	int * cuts_y = malloc(sizeof(int) * (comm->nb_y + 1));
+	lbm_balance_profiles(tiles, size, columns, lines, starts_x, starts_y);
+	starts_x[comm->nb_x] = MESH_WIDTH;
+	starts_y[comm->nb_y] = MESH_HEIGHT;
+
+	//new cuts evening the cost
+	lbm_comm_weighted_split(columns, MESH_WIDTH, comm->nb_x, cuts_x);
+	lbm_comm_weighted_split(lines, MESH_HEIGHT, comm->nb_y, cuts_y);
+
+	//keep them if they move and leave room for the ghost layers
+	changed = memcmp(cuts_x, starts_x, sizeof(int) * comm->nb_x) != 0 || memcmp(cuts_y, starts_y, sizeof(int) * comm->nb_y) != 0;
+	for (k = 0 ; k < comm->nb_x ; k++)
+		if (cuts_x[k + 1] - cuts_x[k] < comm->ghost)
+			changed = 0;
+	for (k = 0 ; k < comm->nb_y ; k++)
+		if (cuts_y[k + 1] - cuts_y[k] < comm->ghost)
+			changed = 0;
+	if (changed) {
+		lbm_comm_force_split(cuts_x, comm->nb_x, cuts_y, comm->nb_y);
+		balance->rebalances++;
+		memset(balance->after, 0, sizeof(balance->after));
+	}
+
+	//free
+	free(tiles);
+	free(columns);
+	free(lines);
+	free(starts_x);
+	free(starts_y);
+	free(cuts_x);
+	free(cuts_y);
+
+	return changed;
+}
+
+/****************************************************/
+/**
+ * Mesure la dernière fenêtre et affiche sur le maître le temps perdu en attente dans
+ * l'échange des mailles fantômes avant le premier équilibrage et après le dernier.
+ * Fonction collective.
+ * @param steps Nombre de pas calculés depuis le début de la boucle.
+**/
+void lbm_balance_report(lbm_balance_t * balance, long steps)
+{
+	//vars
+	int rank;
+
+	//last window
+	lbm_balance_measure(balance, steps);
+
+	//print
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	if (rank != RANK_MASTER)
+		return;
+	printf("Load balancing: %d rebalancing\n", balance->rebalances);
+	printf("%-20s %14s %10s\n", "Window", "wait/step (ms)", "imbalance");
+	printf("%-20s %14.6f %10.3f\n", "before",
+		(balance->before[3] > 0.0) ? 1e3 * balance->before[0] / balance->before[3] : 0.0,
+		(balance->before[2] > 0.0) ? balance->before[1] / balance->before[2] : 1.0);
+	if (balance->rebalances > 0)
+		printf("%-20s %14.6f %10.3f\n", "after",
+			(balance->after[3] > 0.0) ? 1e3 * balance->after[0] / balance->after[3] : 0.0,
+			(balance->after[2] > 0.0) ? balance->after[1] / balance->after[2] : 1.0);
+}
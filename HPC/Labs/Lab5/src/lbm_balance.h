@@ -0,0 +1,47 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef LBM_BALANCE_H
+#define LBM_BALANCE_H
+
+/****************************************************/
+#include "lbm_comm.h"
+
+/****************************************************/
+/**
+ * Measured load balancing. Every BALANCE_INTERVAL steps the compute time of each rank
+ * is spread over its tile to build a cost profile of the columns and lines of the
+ * global mesh, and the cuts are moved to even the cost when the slowest rank is above
+ * the mean by more than BALANCE_TOLERANCE. The halo wait is tracked before the first
+ * and after the last rebalancing to measure the gain.
+**/
+typedef struct lbm_balance_s
+{
+	/** Compute time of the local rank at the last check. **/
+	double compute_mark;
+	/** Halo wait of the local rank at the last check. **/
+	double wait_mark;
+	/** Number of steps at the last check. **/
+	long steps_mark;
+	/** Number of rebalancing done. **/
+	int rebalances;
+	/** Imbalance (max / mean compute time) of the last measured window. **/
+	double imbalance;
+	/** Mean halo wait, max and mean compute time and steps before the first rebalancing. **/
+	double before[4];
+	/** Same values since the last rebalancing. **/
+	double after[4];
+} lbm_balance_t;
+
+/****************************************************/
+void lbm_balance_init(lbm_balance_t * balance);
+int lbm_balance_check(lbm_balance_t * balance, const lbm_comm_t * comm, long steps);
+void lbm_balance_report(lbm_balance_t * balance, long steps);
+
+#endif //LBM_BALANCE_H
@@ -0,0 +1,288 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <mpi.h>
+#include "lbm_checkpoint.h"
+
+/****************************************************/
+/**
+ * Zone du maillage local à lire ou écrire le long d'un axe du maillage global avec sa
+ * bordure (size + 2 mailles). La maille locale i correspond à la maille globale
+ * origin + i.
+ * @param owned Si vrai, ne garde que les mailles possédées : les couches fantômes sont
+ * exclues sauf la bordure du maillage global. Sinon toutes les mailles locales qui sont
+ * dans le maillage global (les couches fantômes en plus de l'exercice 10 le dépassent).
+**/
+static void lbm_checkpoint_local_axis(int origin, int local_size, int ghost, int size, int owned, int * start, int * subsize, int * local_start)
+{
+	//vars
+	int lo = origin;
+	int hi = origin + local_size;
+
+	//remove the ghost layers shared with the neighbors
+	if (owned) {
+		lo = origin + ghost;
+		hi = origin + local_size - ghost;
+		if (lo == 1)
+			lo = 0;
+		if (hi == size + 1)
+			hi = size + 2;
+	}
+
+	//clip to the global mesh
+	if (lo < 0)
+		lo = 0;
+	if (hi > size + 2)
+		hi = size + 2;
+
+	//apply
+	*start = lo;
+	*subsize = hi - lo;
+	*local_start = lo - origin;
+}
+
+/****************************************************/
+/**
+ * Zone du maillage local à lire ou écrire dans le maillage global avec sa bordure
+ * ((largeur+2) x (hauteur+2)). La maille locale i correspond à la maille globale
+ * comm->x + i.
+ * @param owned Voir lbm_checkpoint_local_axis().
+**/
+static void lbm_checkpoint_local_region(const lbm_comm_t * comm, int owned, int starts[2], int subsizes[2], int local_starts[2])
+{
+	lbm_checkpoint_local_axis(comm->x, comm->width, comm->ghost, MESH_WIDTH, owned, &starts[0], &subsizes[0], &local_starts[0]);
+	lbm_checkpoint_local_axis(comm->y, comm->height, comm->ghost, MESH_HEIGHT, owned, &starts[1], &subsizes[1], &local_starts[1]);
+}
+
+/****************************************************/
+/**
+ * Construit les types pour placer la zone locale dans le fichier (vue) et pour la
+ * sélectionner dans le maillage local (mémoire).
+ * @param element Type d'une maille (DIRECTIONS lbm_real_t ou un octet).
+**/
+static void lbm_checkpoint_build_types(const lbm_comm_t * comm, int owned, MPI_Datatype element, MPI_Datatype * file_type, MPI_Datatype * memory_type)
+{
+	//vars
+	int starts[2], subsizes[2], local_starts[2];
+	int global_sizes[2] = {MESH_WIDTH + 2, MESH_HEIGHT + 2};
+	int local_sizes[2] = {comm->width, comm->height};
+
+	//region
+	lbm_checkpoint_local_region(comm, owned, starts, subsizes, local_starts);
+
+	//types
+	MPI_Type_create_subarray(2, global_sizes, subsizes, starts, MPI_ORDER_C, element, file_type);
+	MPI_Type_create_subarray(2, local_sizes, subsizes, local_starts, MPI_ORDER_C, element, memory_type);
+	MPI_Type_commit(file_type);
+	MPI_Type_commit(memory_type);
+}
+
+/****************************************************/
+/**
+ * Lit ou écrit les distributions puis les types des mailles. Fonction collective.
+ * @param write Si vrai écrit la zone possédée, sinon lit toute la zone locale.
+**/
+static void lbm_checkpoint_transfer(MPI_File fh, lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm, int write)
+{
+	//vars
+	MPI_Datatype cell_type;
+	MPI_Datatype file_type;
+	MPI_Datatype memory_type;
+	MPI_Offset offset = sizeof(lbm_checkpoint_header_t);
+	int status;
+
+	//distributions
+	MPI_Type_contiguous(DIRECTIONS, LBM_MPI_REAL, &cell_type);
+	MPI_Type_commit(&cell_type);
+	lbm_checkpoint_build_types(comm, write, cell_type, &file_type, &memory_type);
+	MPI_File_set_view(fh, offset, cell_type, file_type, "native", MPI_INFO_NULL);
+	if (write)
+		status = MPI_File_write_all(fh, mesh->cells, 1, memory_type, MPI_STATUS_IGNORE);
+	else
+		status = MPI_File_read_all(fh, mesh->cells, 1, memory_type, MPI_STATUS_IGNORE);
+	if (status != MPI_SUCCESS)
+		fatal("Fail to transfer the checkpoint distributions !");
+	MPI_Type_free(&file_type);
+	MPI_Type_free(&memory_type);
+	MPI_Type_free(&cell_type);
+
+	//types
+	offset += (MPI_Offset)(MESH_WIDTH + 2) * (MESH_HEIGHT + 2) * DIRECTIONS * sizeof(lbm_real_t);
+	lbm_checkpoint_build_types(comm, write, MPI_UINT8_T, &file_type, &memory_type);
+	MPI_File_set_view(fh, offset, MPI_UINT8_T, file_type, "native", MPI_INFO_NULL);
+	if (write)
+		status = MPI_File_write_all(fh, mesh_type->types, 1, memory_type, MPI_STATUS_IGNORE);
+	else
+		status = MPI_File_read_all(fh, mesh_type->types, 1, memory_type, MPI_STATUS_IGNORE);
+	if (status != MPI_SUCCESS)
+		fatal("Fail to transfer the checkpoint cell types !");
+	MPI_Type_free(&file_type);
+	MPI_Type_free(&memory_type);
+}
+
+/****************************************************/
+/**
+ * Ecrit un point de reprise avec l'état complet de la simulation après l'itération
+ * donnée. Le fichier est d'abord écrit sous un nom temporaire puis renommé, un arrêt
+ * pendant l'écriture laisse donc le point de reprise précédent intact.
+ * Fonction collective.
+**/
+void lbm_checkpoint_write(const char * filename, const lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type, lbm_comm_t * comm, int iteration)
+{
+	//vars
+	int rank;
+	MPI_File fh;
+	char tmp_filename[4096];
+	lbm_checkpoint_header_t header;
+
+	//errors
+	assert(filename != NULL);
+	assert(mesh != NULL);
+	assert(mesh_type != NULL);
+
+	//get infos
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+
+	//open
+	if (rank == RANK_MASTER)
+		unlink(tmp_filename);
+	MPI_Barrier(lbm_comm_world);
+	if (MPI_File_open(lbm_comm_world, tmp_filename, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+	{
+		fprintf(stderr, "Fail to open file %s\n", tmp_filename);
+		abort();
+	}
+
+	//header
+	if (rank == RANK_MASTER) {
+		memset(&header, 0, sizeof(header));
+		header.magick              = LBM_CHECKPOINT_MAGICK;
+		header.version             = LBM_CHECKPOINT_VERSION;
+		header.mesh_width          = MESH_WIDTH;
+		header.mesh_height         = MESH_HEIGHT;
+		header.directions          = DIRECTIONS;
+		header.iteration           = iteration;
+		header.obstacle_r          = lbm_gbl_config.obstacle_r;
+		header.obstacle_x          = lbm_gbl_config.obstacle_x;
+		header.obstacle_y          = lbm_gbl_config.obstacle_y;
+		header.inflow_max_velocity = lbm_gbl_config.inflow_max_velocity;
+		header.reynolds            = lbm_gbl_config.reynolds;
+		header.kinetic_viscosity   = lbm_gbl_config.kinetic_viscosity;
+		header.relax_parameter     = lbm_gbl_config.relax_parameter;
+		header.trt_magic           = lbm_gbl_config.trt_magic;
+		header.trt_relax_minus     = lbm_gbl_config.trt_relax_minus;
+		header.mrt_s_e             = lbm_gbl_config.mrt_s_e;
+		header.mrt_s_eps           = lbm_gbl_config.mrt_s_eps;
+		header.mrt_s_q             = lbm_gbl_config.mrt_s_q;
+		header.collision_model     = lbm_gbl_config.collision_model;
+		header.precision           = LBM_PRECISION_ID;
+		if (MPI_File_write_at(fh, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE) != MPI_SUCCESS)
+			fatal("Fail to write the checkpoint header !");
+	}
+
+	//state
+	lbm_checkpoint_transfer(fh, (lbm_mesh_t*)mesh, (lbm_mesh_type_t*)mesh_type, comm, 1);
+
+	//make it durable before replacing the previous one
+	MPI_File_sync(fh);
+	MPI_File_close(&fh);
+	if (rank == RANK_MASTER) {
+		if (rename(tmp_filename, filename) != 0)
+			perror(filename);
+		printf("Checkpoint at iteration %d written to %s\n", iteration, filename);
+	}
+	MPI_Barrier(lbm_comm_world);
+}
+
+/****************************************************/
+/**
+ * Charge l'entête d'un point de reprise et restaure la taille du maillage et les
+ * paramètres physiques de la configuration. Doit être appelé avant la découpe du domaine.
+ * Fonction collective.
+ * @return La dernière itération calculée.
+**/
+int lbm_checkpoint_load_config(const char * filename)
+{
+	//vars
+	int rank;
+	FILE * fp;
+	lbm_checkpoint_header_t header;
+
+	//master read the header
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	if (rank == RANK_MASTER) {
+		fp = fopen(filename, "r");
+		if (fp == NULL) {
+			perror(filename);
+			abort();
+		}
+		if (fread(&header, sizeof(header), 1, fp) != 1)
+			fatal("Fail to read the checkpoint header !");
+		fclose(fp);
+	}
+	MPI_Bcast(&header, sizeof(header), MPI_BYTE, RANK_MASTER, lbm_comm_world);
+
+	//check
+	if (header.magick != LBM_CHECKPOINT_MAGICK)
+		fatal("Invalid checkpoint file format !");
+	if (header.version != LBM_CHECKPOINT_VERSION || header.directions != DIRECTIONS)
+		fatal("Unsupported checkpoint file version !");
+	if (header.precision != LBM_PRECISION_ID)
+		fatal("Checkpoint file written with another precision !");
+
+	//restore
+	lbm_gbl_config.width               = header.mesh_width;
+	lbm_gbl_config.height              = header.mesh_height;
+	lbm_gbl_config.obstacle_r          = header.obstacle_r;
+	lbm_gbl_config.obstacle_x          = header.obstacle_x;
+	lbm_gbl_config.obstacle_y          = header.obstacle_y;
+	lbm_gbl_config.inflow_max_velocity = header.inflow_max_velocity;
+	lbm_gbl_config.reynolds            = header.reynolds;
+	lbm_gbl_config.kinetic_viscosity   = header.kinetic_viscosity;
+	lbm_gbl_config.relax_parameter     = header.relax_parameter;
+	lbm_gbl_config.trt_magic           = header.trt_magic;
+	lbm_gbl_config.trt_relax_minus     = header.trt_relax_minus;
+	lbm_gbl_config.mrt_s_e             = header.mrt_s_e;
+	lbm_gbl_config.mrt_s_eps           = header.mrt_s_eps;
+	lbm_gbl_config.mrt_s_q             = header.mrt_s_q;
+	lbm_gbl_config.collision_model     = header.collision_model;
+
+	return header.iteration;
+}
+
+/****************************************************/
+/**
+ * Charge l'état d'un point de reprise dans le maillage local, mailles fantômes
+ * comprises. Les types des mailles remplacent ceux de l'initialisation.
+ * Fonction collective.
+**/
+void lbm_checkpoint_read(const char * filename, lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, lbm_comm_t * comm)
+{
+	//vars
+	MPI_File fh;
+
+	//open
+	if (MPI_File_open(lbm_comm_world, filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+	{
+		fprintf(stderr, "Fail to open file %s\n", filename);
+		abort();
+	}
+
+	//load
+	lbm_checkpoint_transfer(fh, mesh, mesh_type, comm, 0);
+
+	//close
+	MPI_File_close(&fh);
+}
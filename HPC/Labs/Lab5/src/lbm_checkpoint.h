@@ -0,0 +1,66 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef LBM_CHECKPOINT_H
+#define LBM_CHECKPOINT_H
+
+/****************************************************/
+#include <stdint.h>
+#include "lbm_struct.h"
+#include "lbm_comm.h"
+
+/****************************************************/
+#define LBM_CHECKPOINT_MAGICK 0x4C424D43
+#define LBM_CHECKPOINT_VERSION 2
+
+/****************************************************/
+/**
+ * Header of a checkpoint file. It is followed by the distributions of all the cells
+ * of the global mesh including its outer ring ((width+2) x (height+2) x DIRECTIONS
+ * lbm_real_t as stored in memory, x major) and by their types ((width+2) x (height+2)
+ * uint8_t). As the layout is global, a run can restart with another number of ranks.
+**/
+typedef struct lbm_checkpoint_header_s
+{
+	/** Magick number to check the type of file (LBM_CHECKPOINT_MAGICK). **/
+	uint32_t magick;
+	/** Version of the format. **/
+	uint32_t version;
+	/** Width of the global mesh (no ghost cells). **/
+	uint32_t mesh_width;
+	/** Height of the global mesh (no ghost cells). **/
+	uint32_t mesh_height;
+	/** Number of directions of each cell. **/
+	uint32_t directions;
+	/** Last computed iteration, the run restarts from the next one. **/
+	uint32_t iteration;
+	/** Physical parameters of the run, restored to get the same results. **/
+	double obstacle_r;
+	double obstacle_x;
+	double obstacle_y;
+	double inflow_max_velocity;
+	double reynolds;
+	double kinetic_viscosity;
+	double relax_parameter;
+	double trt_magic;
+	double trt_relax_minus;
+	double mrt_s_e;
+	double mrt_s_eps;
+	double mrt_s_q;
+	uint32_t collision_model;
+	/** Storage of the densities (LBM_PRECISION_ID, 0 for double). **/
+	uint32_t precision;
+} lbm_checkpoint_header_t;
+
+/****************************************************/
+void lbm_checkpoint_write(const char * filename, const lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type, lbm_comm_t * comm, int iteration);
+int lbm_checkpoint_load_config(const char * filename);
+void lbm_checkpoint_read(const char * filename, lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, lbm_comm_t * comm);
+
+#endif //LBM_CHECKPOINT_H
@@ -12,12 +12,24 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "lbm_comm.h"
+#include "lbm_config.h"
+#include "lbm_init.h"
 
 #define XID 1
 #define YID 0
 
+/****************************************************/
+MPI_Comm lbm_comm_world = MPI_COMM_WORLD;
+
+/****************************************************/
+/** Coupes imposées par l'équilibrage de charge le long de X et Y (NULL pour les calculer). **/
+static int * lbm_comm_forced_starts[2] = {NULL, NULL};
+/** Nombre de morceaux le long de X et Y des coupes imposées. **/
+static int lbm_comm_forced_parts[2] = {0, 0};
+
 /****************************************************/
 /**
  * Calcule le PGCD de deux nombre pour trouver un multitple
@@ -43,11 +55,403 @@ int lbm_helper_pgcd(int a, int b)
 void  lbm_comm_print( lbm_comm_t *comm )
 {
 	int rank ;
-	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-	printf( " RANK %d ( POSITION %d %d ) (WH %d %d ) \n", 
-		rank,
-		comm->x,
-		comm->y,
-		comm->width,
-		comm->height);
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	if (DIMENSIONS == 3)
+		printf( " RANK %d ( POSITION %d %d %d ) (WHD %d %d %d ) \n", 
+			rank,
+			comm->x,
+			comm->y,
+			comm->z,
+			comm->width,
+			comm->height,
+			comm->depth);
+	else
+		printf( " RANK %d ( POSITION %d %d ) (WH %d %d ) \n", 
+			rank,
+			comm->x,
+			comm->y,
+			comm->width,
+			comm->height);
+}
+
+/****************************************************/
+/**
+ * Découpe par blocs de total éléments en parts morceaux. Les total % parts premiers
+ * morceaux reçoivent un élément de plus, il n'y a donc plus besoin que la taille du
+ * maillage soit un multiple du nombre de processus.
+ * @param starts Tableau de parts + 1 entrées recevant le début de chaque morceau.
+**/
+void lbm_comm_block_split(int total, int parts, int * starts)
+{
+	//vars
+	int i;
+	int base = total / parts;
+	int rest = total % parts;
+
+	//errors
+	assert(parts > 0 && parts <= total);
+
+	//fill
+	for (i = 0 ; i <= parts ; i++)
+		starts[i] = i * base + (i < rest ? i : rest);
+}
+
+/****************************************************/
+/**
+ * Découpe de total éléments en parts morceaux de poids cumulé le plus proche possible.
+ * Chaque morceau garde au moins un élément.
+ * @param weights Poids de chacun des total éléments.
+ * @param starts Tableau de parts + 1 entrées recevant le début de chaque morceau.
+**/
+void lbm_comm_weighted_split(const double * weights, int total, int parts, int * starts)
+{
+	//vars
+	int i, k;
+	double sum = 0.0;
+	double prefix = 0.0;
+
+	//errors
+	assert(parts > 0 && parts <= total);
+
+	//total weight
+	for (i = 0 ; i < total ; i++)
+		sum += weights[i];
+
+	//no weight, fallback to blocks
+	if (sum <= 0.0) {
+		lbm_comm_block_split(total, parts, starts);
+		return;
+	}
+
+	//place cuts where the prefix sum cross k * sum / parts
+	starts[0] = 0;
+	i = 0;
+	for (k = 1 ; k < parts ; k++)
+	{
+		double target = sum * k / parts;
+		while (i < total && prefix + weights[i] <= target)
+			prefix += weights[i++];
+		//take the closest side of the crossing element
+		int cut = i;
+		if (i < total && target - prefix > prefix + weights[i] - target)
+			cut = i + 1;
+		//keep at least one element on each part
+		if (cut < starts[k - 1] + 1)
+			cut = starts[k - 1] + 1;
+		if (cut > total - (parts - k))
+			cut = total - (parts - k);
+		starts[k] = cut;
+	}
+	starts[parts] = total;
+}
+
+/****************************************************/
+/**
+ * Choisi la découpe 2D de comm_size processus donnant les sous domaines les plus carrés.
+ * Les tailles n'ont pas besoin d'être divisibles, chaque axe est découpé par blocs.
+**/
+void lbm_comm_choose_2d_split(int comm_size, int total_width, int total_height, int dims[2])
+{
+	//vars
+	int best_x = 0;
+	int best_y = 0;
+	int best_score = 0;
+	int nb_x;
+
+	//iterate over all the possibilities
+	for (nb_x = 1 ; nb_x <= comm_size ; nb_x++) {
+		int nb_y;
+
+		//comm size needs to be a multiple of nb_x
+		if (comm_size % nb_x != 0)
+			continue;
+
+		//at least one cell per task
+		nb_y = comm_size / nb_x;
+		if (nb_x > total_width || nb_y > total_height)
+			continue;
+
+		//square proportions are better, compare the largest tiles
+		int local_width = (total_width + nb_x - 1) / nb_x;
+		int local_height = (total_height + nb_y - 1) / nb_y;
+		int score = abs(local_width - local_height);
+
+		if (best_x == 0 || score < best_score) {
+			best_x = nb_x;
+			best_y = nb_y;
+			best_score = score;
+		}
+	}
+
+	//no viable solution found
+	if (best_x == 0)
+		fatal("Too many tasks for the mesh size, cannot split it !");
+
+	dims[0] = best_x;
+	dims[1] = best_y;
+}
+
+/****************************************************/
+/**
+ * Choisi la découpe 3D de comm_size processus donnant les sous domaines les plus cubiques,
+ * ce qui minimise la surface des faces échangées. Chaque axe est découpé par blocs.
+**/
+void lbm_comm_choose_3d_split(int comm_size, int total_width, int total_height, int total_depth, int dims[3])
+{
+	//vars
+	int best_x = 0;
+	int best_y = 0;
+	int best_z = 0;
+	int best_score = 0;
+	int nb_x, nb_y;
+
+	//iterate over all the possibilities
+	for (nb_x = 1 ; nb_x <= comm_size ; nb_x++) {
+		//comm size needs to be a multiple of nb_x
+		if (comm_size % nb_x != 0)
+			continue;
+
+		for (nb_y = 1 ; nb_y <= comm_size / nb_x ; nb_y++) {
+			int nb_z;
+
+			//and of nb_x * nb_y
+			if ((comm_size / nb_x) % nb_y != 0)
+				continue;
+
+			//at least one cell per task
+			nb_z = comm_size / nb_x / nb_y;
+			if (nb_x > total_width || nb_y > total_height || nb_z > total_depth)
+				continue;
+
+			//cubic proportions are better, compare the largest tiles
+			int local_width = (total_width + nb_x - 1) / nb_x;
+			int local_height = (total_height + nb_y - 1) / nb_y;
+			int local_depth = (total_depth + nb_z - 1) / nb_z;
+			int local_max = local_width;
+			int local_min = local_width;
+			if (local_height > local_max) local_max = local_height;
+			if (local_height < local_min) local_min = local_height;
+			if (local_depth > local_max) local_max = local_depth;
+			if (local_depth < local_min) local_min = local_depth;
+			int score = local_max - local_min;
+
+			if (best_x == 0 || score < best_score) {
+				best_x = nb_x;
+				best_y = nb_y;
+				best_z = nb_z;
+				best_score = score;
+			}
+		}
+	}
+
+	//no viable solution found
+	if (best_x == 0)
+		fatal("Too many tasks for the mesh size, cannot split it !");
+
+	dims[0] = best_x;
+	dims[1] = best_y;
+	dims[2] = best_z;
+}
+
+/****************************************************/
+/**
+ * Impose les coupes utilisées par lbm_comm_setup_local_domain() à la place de celles
+ * données par split_mode, elles servent tant que la grille de processus a la même
+ * forme. Appelé avec des tableaux NULL, revient aux coupes calculées.
+ * @param starts_x Début de chacune des nb_x colonnes de processus (nb_x + 1 entrées).
+ * @param starts_y Début de chacune des nb_y lignes de processus (nb_y + 1 entrées).
+**/
+void lbm_comm_force_split(const int * starts_x, int nb_x, const int * starts_y, int nb_y)
+{
+	//free previous ones
+	free(lbm_comm_forced_starts[0]);
+	free(lbm_comm_forced_starts[1]);
+	lbm_comm_forced_starts[0] = NULL;
+	lbm_comm_forced_starts[1] = NULL;
+	lbm_comm_forced_parts[0] = 0;
+	lbm_comm_forced_parts[1] = 0;
+
+	//back to computed cuts
+	if (starts_x == NULL || starts_y == NULL)
+		return;
+
+	//copy
+	lbm_comm_forced_starts[0] = malloc(sizeof(int) * (nb_x + 1));
+	lbm_comm_forced_starts[1] = malloc(sizeof(int) * (nb_y + 1));
+	memcpy(lbm_comm_forced_starts[0], starts_x, sizeof(int) * (nb_x + 1));
+	memcpy(lbm_comm_forced_starts[1], starts_y, sizeof(int) * (nb_y + 1));
+	lbm_comm_forced_parts[0] = nb_x;
+	lbm_comm_forced_parts[1] = nb_y;
+}
+
+/****************************************************/
+/**
+ * Calcule la position et la taille du sous domaine local à partir de nb_x, nb_y, rank_x
+ * et rank_y avec comm->ghost couches de mailles fantômes. Les coupes sont les mêmes pour
+ * toute une colonne (resp. ligne) de processus pour que les voisins échangent des bords de
+ * même taille. Avec les réseaux 3D, l'axe Z (MESH_DEPTH) est découpé par blocs suivant
+ * nb_z et rank_z.
+**/
+void lbm_comm_setup_local_domain(lbm_comm_t * comm, int total_width, int total_height)
+{
+	//vars
+	int * starts_x = malloc(sizeof(int) * (comm->nb_x + 1));
+	int * starts_y = malloc(sizeof(int) * (comm->nb_y + 1));
+
+	//errors
+	if (comm->nb_x > total_width || comm->nb_y > total_height)
+		fatal("Too many tasks for the mesh size, cannot split it !");
+
+	//compute cuts
+	if (lbm_comm_forced_parts[0] == comm->nb_x && lbm_comm_forced_parts[1] == comm->nb_y) {
+		memcpy(starts_x, lbm_comm_forced_starts[0], sizeof(int) * (comm->nb_x + 1));
+		memcpy(starts_y, lbm_comm_forced_starts[1], sizeof(int) * (comm->nb_y + 1));
+	} else if (SPLIT_MODE == LBM_SPLIT_FLUID) {
+		double * columns = malloc(sizeof(double) * total_width);
+		double * lines = malloc(sizeof(double) * total_height);
+		lbm_init_fluid_profiles(columns, lines, total_width, total_height);
+		lbm_comm_weighted_split(columns, total_width, comm->nb_x, starts_x);
+		lbm_comm_weighted_split(lines, total_height, comm->nb_y, starts_y);
+		free(columns);
+		free(lines);
+	} else {
+		lbm_comm_block_split(total_width, comm->nb_x, starts_x);
+		lbm_comm_block_split(total_height, comm->nb_y, starts_y);
+	}
+
+	//the ghost layers are copied from the inner cells of the neighbors
+	if (starts_x[comm->rank_x + 1] - starts_x[comm->rank_x] < comm->ghost || starts_y[comm->rank_y + 1] - starts_y[comm->rank_y] < comm->ghost)
+		fatal("Local sub-domain smaller than the ghost depth !");
+
+	//setup size (+2 * ghost for ghost cells on border)
+	comm->width = starts_x[comm->rank_x + 1] - starts_x[comm->rank_x] + 2 * comm->ghost;
+	comm->height = starts_y[comm->rank_y + 1] - starts_y[comm->rank_y] + 2 * comm->ghost;
+
+	//absolute position in the global mesh without accounting the ghost cells,
+	//shifted so the local cell i stays the global cell x + i with deeper ghost layers
+	comm->x = starts_x[comm->rank_x] + 1 - comm->ghost;
+	comm->y = starts_y[comm->rank_y] + 1 - comm->ghost;
+
+	//same along Z with the 3D lattices, no obstacle weighting as the shape is extruded
+	if (DIMENSIONS == 3) {
+		int * starts_z = malloc(sizeof(int) * (comm->nb_z + 1));
+		if (comm->nb_z > MESH_DEPTH)
+			fatal("Too many tasks for the mesh size, cannot split it !");
+		lbm_comm_block_split(MESH_DEPTH, comm->nb_z, starts_z);
+		if (starts_z[comm->rank_z + 1] - starts_z[comm->rank_z] < comm->ghost)
+			fatal("Local sub-domain smaller than the ghost depth !");
+		comm->depth = starts_z[comm->rank_z + 1] - starts_z[comm->rank_z] + 2 * comm->ghost;
+		comm->z = starts_z[comm->rank_z] + 1 - comm->ghost;
+		free(starts_z);
+	}
+
+	//free
+	free(starts_x);
+	free(starts_y);
+}
+
+/****************************************************/
+/**
+ * Zone du maillage global (avec sa bordure) possédée par un sous domaine : ses mailles
+ * internes plus la bordure du maillage global quand la tuile la touche.
+ * @param area Reçoit x_start, x_end, y_start, y_end (bornes hautes exclues).
+**/
+static void lbm_comm_owned_area(const lbm_comm_t * comm, int area[4])
+{
+	area[0] = comm->x + comm->ghost;
+	area[1] = comm->x + comm->width - comm->ghost;
+	area[2] = comm->y + comm->ghost;
+	area[3] = comm->y + comm->height - comm->ghost;
+	if (area[0] == 1)
+		area[0] = 0;
+	if (area[1] == MESH_WIDTH + 1)
+		area[1] = MESH_WIDTH + 2;
+	if (area[2] == 1)
+		area[2] = 0;
+	if (area[3] == MESH_HEIGHT + 1)
+		area[3] = MESH_HEIGHT + 2;
+}
+
+/****************************************************/
+/**
+ * Construit le type sélectionnant dans un maillage local l'intersection de deux zones
+ * du maillage global, retourne 0 si elle est vide.
+**/
+static int lbm_comm_migrate_type(MPI_Datatype * type, const lbm_comm_t * comm, const int a[4], const int b[4], MPI_Datatype cell_type)
+{
+	//intersection
+	int x_start = (a[0] > b[0]) ? a[0] : b[0];
+	int x_end = (a[1] < b[1]) ? a[1] : b[1];
+	int y_start = (a[2] > b[2]) ? a[2] : b[2];
+	int y_end = (a[3] < b[3]) ? a[3] : b[3];
+	if (x_start >= x_end || y_start >= y_end) {
+		*type = cell_type;
+		return 0;
+	}
+
+	//sub-array of the local mesh, x major
+	int sizes[2] = {comm->width, comm->height};
+	int subsizes[2] = {x_end - x_start, y_end - y_start};
+	int starts[2] = {x_start - comm->x, y_start - comm->y};
+	MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, cell_type, type);
+	MPI_Type_commit(type);
+	return 1;
+}
+
+/****************************************************/
+/**
+ * Déplace un champ des anciennes tuiles vers les nouvelles après un changement des
+ * coupes, en un seul MPI_Alltoallw : chaque processus envoie à chacun l'intersection
+ * de sa zone possédée avec la nouvelle zone de l'autre. Les mailles fantômes ne sont
+ * pas remplies, le prochain échange s'en charge. Fonction collective.
+ * @param old_comm Découpage d'origine (seules la position et la taille servent).
+ * @param src Champ sur l'ancienne tuile.
+ * @param dst Champ sur la nouvelle tuile.
+ * @param cell_type Type d'une maille du champ.
+**/
+void lbm_comm_migrate(const lbm_comm_t * old_comm, const void * src, const lbm_comm_t * comm, void * dst, MPI_Datatype cell_type)
+{
+	//vars
+	int r, size;
+	int old_area[4], new_area[4];
+
+	//areas of everybody
+	MPI_Comm_size( lbm_comm_world, &size );
+	int * old_areas = malloc(sizeof(int) * 4 * size);
+	int * new_areas = malloc(sizeof(int) * 4 * size);
+	int * send_counts = malloc(sizeof(int) * size);
+	int * recv_counts = malloc(sizeof(int) * size);
+	int * displs = calloc(size, sizeof(int));
+	MPI_Datatype * send_types = malloc(sizeof(MPI_Datatype) * size);
+	MPI_Datatype * recv_types = malloc(sizeof(MPI_Datatype) * size);
+	lbm_comm_owned_area(old_comm, old_area);
+	lbm_comm_owned_area(comm, new_area);
+	MPI_Allgather(old_area, 4, MPI_INT, old_areas, 4, MPI_INT, lbm_comm_world);
+	MPI_Allgather(new_area, 4, MPI_INT, new_areas, 4, MPI_INT, lbm_comm_world);
+
+	//what we send to and receive from each rank (including ourself)
+	for (r = 0 ; r < size ; r++)
+	{
+		send_counts[r] = lbm_comm_migrate_type(&send_types[r], old_comm, old_area, &new_areas[4 * r], cell_type);
+		recv_counts[r] = lbm_comm_migrate_type(&recv_types[r], comm, &old_areas[4 * r], new_area, cell_type);
+	}
+
+	//move
+	MPI_Alltoallw(src, send_counts, displs, send_types, dst, recv_counts, displs, recv_types, lbm_comm_world);
+
+	//free
+	for (r = 0 ; r < size ; r++)
+	{
+		if (send_counts[r] > 0)
+			MPI_Type_free(&send_types[r]);
+		if (recv_counts[r] > 0)
+			MPI_Type_free(&recv_types[r]);
+	}
+	free(old_areas);
+	free(new_areas);
+	free(send_counts);
+	free(recv_counts);
+	free(displs);
+	free(send_types);
+	free(recv_types);
 }
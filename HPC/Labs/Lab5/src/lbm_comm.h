@@ -19,6 +19,37 @@
 #define RANK_MASTER 0
 /** Maximum number of parallel async operations to track. **/
 #define MAX_ASYNC 16
+/** Number of neighbors of a task in a 2D splitting (sides and corners). **/
+#define LBM_NEIGHBORS_2D 8
+/** Maximum number of neighbors of a task (faces, edges and corners with the 3D splitting). **/
+#if DIMENSIONS == 3
+	#define MAX_NEIGHBORS 26
+#else
+	#define MAX_NEIGHBORS LBM_NEIGHBORS_2D
+#endif
+
+/****************************************************/
+/**
+ * Side of a neighbor on the same node read directly from its temporary mesh in the
+ * shared window (ex11). Only the directions moving toward us are copied.
+**/
+typedef struct lbm_comm_shared_copy_s
+{
+	/** First cell to read in the mesh of the neighbor, NULL if it is on another node. **/
+	const lbm_real_t * src;
+	/** Distance in cells between two cells to read. **/
+	int src_stride;
+	/** Index of the first ghost cell to fill in the local mesh. **/
+	int dst;
+	/** Distance in cells between two ghost cells to fill. **/
+	int dst_stride;
+	/** Number of cells of the side. **/
+	int count;
+	/** Number of directions to copy. **/
+	int nb_dirs;
+	/** Directions to copy. **/
+	int dirs[DIRECTIONS];
+} lbm_comm_shared_copy_t;
 
 /****************************************************/
 /**
@@ -31,13 +62,19 @@ typedef struct lbm_comm_t_s
 	int nb_x;
 	/** Number of processes along Y. **/
 	int nb_y;
+	/** Number of processes along Z (1 for the 2D lattices). **/
+	int nb_z;
 	/** Process rank position along the X axis. **/
 	int rank_x;
 	/** Process rank position along the Y axis. **/
 	int rank_y;
+	/** Process rank position along the Z axis. **/
+	int rank_z;
 	/** 
 	 * Absolute position along X of the local mesh in the global one 
 	 * without accounting the ghost cells. 
+	 * With deeper ghost layers, the local cell i is the global cell x + i
+	 * of the global mesh including its outer ring.
 	**/
 	int x;
 	/** 
@@ -45,10 +82,23 @@ typedef struct lbm_comm_t_s
 	 * without accounting the ghost cells. 
 	**/
 	int y;
+	/** 
+	 * Absolute position along Z of the local mesh in the global one 
+	 * without accounting the ghost cells (0 for the 2D lattices). 
+	**/
+	int z;
 	/** Width of the local mesh, accounting the ghost cells. **/
 	int width;
 	/** Height of the local mesh, accounting the ghost cells. **/
 	int height;
+	/** Depth of the local mesh, accounting the ghost cells (1 for the 2D lattices). **/
+	int depth;
+	/** Number of layers of ghost cells on each side (1 except for ex10). **/
+	int ghost;
+	/** Steps done since the last exchange of the ghost layers (ex10). **/
+	int ghost_step;
+	/** If there is a neighbor on the left, right, top and bottom side (ex10). **/
+	int has_neighbor[4];
 	/** Can be used to store the cartesian communication if using MPI_Cart. **/
 	MPI_Comm communicator;
 	/** Can be used to store requests. **/
@@ -56,13 +106,45 @@ typedef struct lbm_comm_t_s
 	/** Can be used to store data type. **/
 	MPI_Datatype type;
 	/** Can be used to keep track of buffer for non contiguous communications. **/
-	double * buffer_send_up;
+	lbm_real_t * buffer_send_up;
 	/** Can be used to keep track of buffer for non contiguous communications. **/
-	double * buffer_send_down;
+	lbm_real_t * buffer_send_down;
 	/** Can be used to keep track of buffer for non contiguous communications. **/
-	double * buffer_recv_up;
+	lbm_real_t * buffer_recv_up;
 	/** Can be used to keep track of buffer for non contiguous communications. **/
-	double * buffer_recv_down;
+	lbm_real_t * buffer_recv_down;
+	/** Number of persistent requests stored in requests (0 if not built yet). **/
+	int nb_persistent;
+	/** Cells of the mesh the persistent requests are bound to. **/
+	const lbm_real_t * persistent_cells;
+	/** Can be used to store a graph communicator for neighborhood collectives. **/
+	MPI_Comm neighbor_communicator;
+	/** Number of neighbors in neighbor_communicator. **/
+	int nb_neighbors;
+	/** Datatypes to send to each neighbor (relative to the mesh cells). **/
+	MPI_Datatype send_types[MAX_NEIGHBORS];
+	/** Datatypes to receive from each neighbor (relative to the mesh cells). **/
+	MPI_Datatype recv_types[MAX_NEIGHBORS];
+	/** Byte displacements of the send types from the first cell of the mesh. **/
+	MPI_Aint send_displs[MAX_NEIGHBORS];
+	/** Byte displacements of the receive types from the first cell of the mesh. **/
+	MPI_Aint recv_displs[MAX_NEIGHBORS];
+	/** Rank of each neighbor in communicator (ex11). **/
+	int neighbor_ranks[MAX_NEIGHBORS];
+	/** Direction of each neighbor in the 8 neighbors table, used as tag (ex11). **/
+	int neighbor_dirs[MAX_NEIGHBORS];
+	/** Communicator of the tasks sharing the memory of the node (ex11). **/
+	MPI_Comm node_communicator;
+	/** Shared window holding the temporary mesh of each task of the node (ex11). **/
+	MPI_Win shared_window;
+	/** Local part of the shared window (ex11). **/
+	lbm_real_t * shared_cells;
+	/** Temporary mesh whose state was copied in the shared window (ex11). **/
+	const lbm_real_t * shared_source;
+	/** How to read the sides of the neighbors on the same node (ex11). **/
+	lbm_comm_shared_copy_t shared_copies[MAX_NEIGHBORS];
+	/** Number of pending notifications in requests (ex11). **/
+	int nb_pending;
 	//////////////////// EXTRA PARAMETERS ALREADY HANDLED /////////////////////////
 	/** Keep track of the file handler to save data (DO NOT MODIFY FOR THE LAB) **/
 	MPI_File file_handler;
@@ -80,7 +162,73 @@ static inline int lbm_comm_height( lbm_comm_t *comm )
 	return comm->height;
 }
 
+/****************************************************/
+static inline int lbm_comm_depth( lbm_comm_t *comm )
+{
+	return comm->depth;
+}
+
+/****************************************************/
+/** Width of the local mesh without the ghost cells. **/
+static inline int lbm_comm_inner_width( const lbm_comm_t *comm )
+{
+	return comm->width - 2 * comm->ghost;
+}
+
+/****************************************************/
+/** Height of the local mesh without the ghost cells. **/
+static inline int lbm_comm_inner_height( const lbm_comm_t *comm )
+{
+	return comm->height - 2 * comm->ghost;
+}
+
+/****************************************************/
+/** Depth of the local mesh without the ghost cells (1 for the 2D lattices). **/
+static inline int lbm_comm_inner_depth( const lbm_comm_t *comm )
+{
+	return (DIMENSIONS == 3) ? comm->depth - 2 * comm->ghost : 1;
+}
+
+/****************************************************/
+/** Position along X of the first inner cell in the global mesh without its outer ring. **/
+static inline int lbm_comm_inner_x( const lbm_comm_t *comm )
+{
+	return comm->x + comm->ghost - 1;
+}
+
+/****************************************************/
+/** Position along Y of the first inner cell in the global mesh without its outer ring. **/
+static inline int lbm_comm_inner_y( const lbm_comm_t *comm )
+{
+	return comm->y + comm->ghost - 1;
+}
+
+/****************************************************/
+/** Position along Z of the first inner cell in the global mesh without its outer ring (0 in 2D). **/
+static inline int lbm_comm_inner_z( const lbm_comm_t *comm )
+{
+	return (DIMENSIONS == 3) ? comm->z + comm->ghost - 1 : 0;
+}
+
+/****************************************************/
+/**
+ * Communicator of the ranks running the current case, used instead of MPI_COMM_WORLD
+ * by all the modules. It is MPI_COMM_WORLD except in ensemble mode where each group
+ * of ranks runs its own cases.
+**/
+extern MPI_Comm lbm_comm_world;
+
 /****************************************************/
 void  lbm_comm_print( lbm_comm_t * comm );
 
+/****************************************************/
+//domain decomposition
+void lbm_comm_block_split(int total, int parts, int * starts);
+void lbm_comm_weighted_split(const double * weights, int total, int parts, int * starts);
+void lbm_comm_choose_2d_split(int comm_size, int total_width, int total_height, int dims[2]);
+void lbm_comm_choose_3d_split(int comm_size, int total_width, int total_height, int total_depth, int dims[3]);
+void lbm_comm_setup_local_domain(lbm_comm_t * comm, int total_width, int total_height);
+void lbm_comm_force_split(const int * starts_x, int nb_x, const int * starts_y, int nb_y);
+void lbm_comm_migrate(const lbm_comm_t * old_comm, const void * src, const lbm_comm_t * comm, void * dst, MPI_Datatype cell_type);
+
 #endif
@@ -21,51 +21,348 @@ lbm_config_t lbm_gbl_config;
  * Application des valeurs par defaut au cas ou l'utilisateur en définirait pas tout dans
  * le fichie de configuration.
 **/
-void lbm_config_set_default(void)
+void lbm_config_set_default(lbm_config_t * config)
 {
 	//directisation.
-	lbm_gbl_config.iterations = 10000;
-	lbm_gbl_config.width = 800;
-	lbm_gbl_config.height = 100;
+	config->iterations = 10000;
+	config->width = 800;
+	config->height = 100;
+	config->depth = (DIMENSIONS == 3) ? 20 : 1;
 	//obstacle
-	lbm_gbl_config.obstacle_r = 0.0;
-	lbm_gbl_config.obstacle_x = 0.0;
-	lbm_gbl_config.obstacle_y = 0.0;
+	config->obstacle_r = 0.0;
+	config->obstacle_x = 0.0;
+	config->obstacle_y = 0.0;
 	//flow
-	lbm_gbl_config.inflow_max_velocity = 0.1;
-	lbm_gbl_config.reynolds = 100;
+	config->inflow_max_velocity = 0.1;
+	config->reynolds = 100;
+	//collision
+	config->collision_model = LBM_COLLISION_BGK;
+	config->trt_magic = 1.0 / 4.0;
+	config->mrt_s_e = 1.64;
+	config->mrt_s_eps = 1.54;
+	config->mrt_s_q = 1.9;
+	//decomposition
+	config->split_mode = LBM_SPLIT_UNIFORM;
+	config->ghost_depth = 1;
+	config->balance_interval = 0;
+	config->balance_tolerance = 0.05;
+	config->refine_patch[0] = 0;
+	config->refine_patch[1] = 0;
+	config->refine_patch[2] = 0;
+	config->refine_patch[3] = 0;
+	//storage
+	config->sparse = LBM_SPARSE_NONE;
 	//result output file
-	lbm_gbl_config.output_filename = NULL;
-	lbm_gbl_config.write_interval = 50;
+	config->output_filename = NULL;
+	config->write_interval = 50;
+	config->output_version = 1;
+	config->output_codec = LBM_CODEC_NONE;
+	config->output_error_bound = 0.0;
+	config->output_roi[0] = 0;
+	config->output_roi[1] = 0;
+	config->output_roi[2] = 0;
+	config->output_roi[3] = 0;
+	config->output_decimate = 1;
+	//checkpoint
+	config->checkpoint_interval = 0;
+	config->checkpoint_filename = NULL;
+	//analysis
+	config->analysis_interval = 0;
+	config->analysis_filename = NULL;
+	config->convergence_threshold = 0.0;
 	//obstacle
-	lbm_gbl_config.obstacle_filename = NULL;
-	lbm_gbl_config.obstable_scale = 1.0;
-	lbm_gbl_config.obstable_rotate = 0.0;
+	config->obstacle_filename = NULL;
+	config->obstable_scale = 1.0;
+	config->obstable_rotate = 0.0;
+	config->obstacle_mask = NULL;
+	config->obstacle_mask_save = NULL;
+	config->nb_obstacle_circles = 0;
+	config->nb_obstacle_polygons = 0;
 }
 
 /****************************************************/
 /**
  * Calcule des paramètres dérivés.
 **/
-void lbm_config_drived_parameters(void)
+void lbm_config_drived_parameters(lbm_config_t * config)
 {
 	//derived parameter
-	lbm_gbl_config.kinetic_viscosity = (lbm_gbl_config.inflow_max_velocity * 2.0 * lbm_gbl_config.obstacle_r / lbm_gbl_config.reynolds);
-	lbm_gbl_config.relax_parameter = 1.0 / (3.0 * lbm_gbl_config.kinetic_viscosity + 1.0/2.0);
+	config->kinetic_viscosity = (config->inflow_max_velocity * 2.0 * config->obstacle_r / config->reynolds);
+	config->relax_parameter = 1.0 / (3.0 * config->kinetic_viscosity + 1.0/2.0);
+	//TRT : magic = (1/w+ - 1/2) * (1/w- - 1/2) with w+ fixed by the viscosity
+	config->trt_relax_minus = 1.0 / (config->trt_magic / (1.0 / config->relax_parameter - 1.0/2.0) + 1.0/2.0);
+	//the compression, quantization and sub-sampling only exist in the version 2 format
+	if (config->output_codec != LBM_CODEC_NONE || config->output_error_bound > 0.0
+		|| config->output_decimate > 1 || config->output_roi[2] > 0 || config->output_roi[3] > 0)
+		config->output_version = 2;
+	//default checkpoint file
+	if (config->checkpoint_interval > 0 && config->checkpoint_filename == NULL)
+		config->checkpoint_filename = strdup("checkpoint.lbm");
+	//default analysis file
+	if (config->analysis_interval > 0 && config->analysis_filename == NULL)
+		config->analysis_filename = strdup("analysis.csv");
 }
 
 /****************************************************/
 /**
- * Chargement de la config depuis le fichier.
+ * Convertion du nom du modèle de collision.
+**/
+const char * lbm_config_collision_name(lbm_collision_model_t model)
+{
+	switch (model)
+	{
+		case LBM_COLLISION_BGK:
+			return "bgk";
+		case LBM_COLLISION_TRT:
+			return "trt";
+		case LBM_COLLISION_MRT:
+			return "mrt";
+		default:
+			return "unknown";
+	}
+}
+
+/****************************************************/
+/**
+ * Convertion du nom du mode de découpage du domaine.
+**/
+const char * lbm_config_split_name(lbm_split_mode_t mode)
+{
+	switch (mode)
+	{
+		case LBM_SPLIT_UNIFORM:
+			return "uniform";
+		case LBM_SPLIT_FLUID:
+			return "fluid";
+		default:
+			return "unknown";
+	}
+}
+
+/****************************************************/
+/**
+ * Convertion du nom de la compression du fichier de sortie.
+**/
+const char * lbm_config_codec_name(lbm_output_codec_t codec)
+{
+	switch (codec)
+	{
+		case LBM_CODEC_NONE:
+			return "none";
+		case LBM_CODEC_ZLIB:
+			return "zlib";
+		default:
+			return "unknown";
+	}
+}
+
+/****************************************************/
+/**
+ * Ajoute un polygone donné par la liste de ses sommets "x1 y1 x2 y2 ...".
 **/
-void lbm_config_init(const char * filename)
+static void lbm_config_add_polygon(lbm_config_t * config, const char * values, int line)
+{
+	//vars
+	char * end;
+	int p = config->nb_obstacle_polygons;
+	int cnt = 0;
+
+	//check
+	if (p >= LBM_MAX_OBSTACLE_SHAPES)
+	{
+		fprintf(stderr,"Too many obstacle polygons line %d (max %d)\n",line,LBM_MAX_OBSTACLE_SHAPES);
+		abort();
+	}
+
+	//parse the coordinates
+	while (cnt < 2 * LBM_MAX_POLYGON_POINTS)
+	{
+		double value = strtod(values,&end);
+		if (end == values)
+			break;
+		config->obstacle_polygons[p][cnt++] = value;
+		values = end;
+	}
+
+	//need a full list of at least 3 points
+	if (cnt < 6 || cnt % 2 != 0 || strtod(values,&end) != 0.0 || end != values)
+	{
+		fprintf(stderr,"Invalid obstacle polygon line %d (3 to %d points x y)\n",line,LBM_MAX_POLYGON_POINTS);
+		abort();
+	}
+	config->obstacle_polygon_points[p] = cnt / 2;
+	config->nb_obstacle_polygons++;
+}
+
+/****************************************************/
+/**
+ * Applique une ligne "clef = valeur" du fichier de configuration (ou d'un cas d'un
+ * ensemble) sur la configuration donnée. Les paramètres dérivés ne sont pas recalculés.
+ * @param line Numéro de la ligne pour les messages d'erreur.
+**/
+void lbm_config_parse_line(lbm_config_t * config, const char * buffer, int line)
 {
 	//vars
-	FILE * fp;
-	char buffer[1024];
 	char buffer2[1024];
 	int intValue;
 	double doubleValue;
+	double circle[3];
+
+	//parse
+	if (buffer[0] == '#')
+	{
+		//comment, nothing to do
+	} else if (sscanf(buffer,"iterations = %d\n",&intValue) == 1) {
+		 config->iterations = intValue;
+	} else if (sscanf(buffer,"width = %d\n",&intValue) == 1) {
+		 config->width = intValue;
+		 if (config->obstacle_x == 0.0)
+			config->obstacle_x = (config->width / 5.0 + 1.0);
+	} else if (sscanf(buffer,"height = %d\n",&intValue) == 1) {
+		config->height = intValue;
+		if (config->obstacle_r == 0.0)
+			config->obstacle_r = (config->height / 10.0 + 1.0);
+		if (config->obstacle_y == 0.0)
+			config->obstacle_y = (config->height / 2.0 + 3.0);
+	} else if (sscanf(buffer,"depth = %d\n",&intValue) == 1) {
+		if ((DIMENSIONS == 3 && intValue < 3) || (DIMENSIONS == 2 && intValue != 1)) {
+			fprintf(stderr,"Invalid depth line %d for the %s lattice : %s\n",line,LBM_LATTICE_NAME,buffer);
+			abort();
+		}
+		config->depth = intValue;
+	} else if (sscanf(buffer,"obstacle_r = %lf\n",&doubleValue) == 1) {
+		 config->obstacle_r = doubleValue;
+	} else if (sscanf(buffer,"obstacle_x = %lf\n",&doubleValue) == 1) {
+		 config->obstacle_x = doubleValue;
+	} else if (sscanf(buffer,"obstacle_y = %lf\n",&doubleValue) == 1) {
+		 config->obstacle_y = doubleValue;
+	} else if (sscanf(buffer,"inflow_max_velocity = %lf\n",&doubleValue) == 1) {
+		 config->inflow_max_velocity = doubleValue;
+	} else if (sscanf(buffer,"reynolds = %lf\n",&doubleValue) == 1) {
+		 config->reynolds = doubleValue;
+	} else if (sscanf(buffer,"kinetic_viscosity = %lf\n",&doubleValue) == 1) {
+		 config->kinetic_viscosity = doubleValue;
+	} else if (sscanf(buffer,"relax_parameter = %lf\n",&doubleValue) == 1) {
+		 config->relax_parameter = doubleValue;
+	} else if (sscanf(buffer,"collision_model = %s\n",buffer2) == 1) {
+		if (strcmp(buffer2,"bgk") == 0)
+			config->collision_model = LBM_COLLISION_BGK;
+		else if (strcmp(buffer2,"trt") == 0)
+			config->collision_model = LBM_COLLISION_TRT;
+		else if (strcmp(buffer2,"mrt") == 0)
+			config->collision_model = LBM_COLLISION_MRT;
+		else {
+			fprintf(stderr,"Invalid collision model line %d : %s\n",line,buffer);
+			abort();
+		}
+	} else if (sscanf(buffer,"trt_magic = %lf\n",&doubleValue) == 1) {
+		 config->trt_magic = doubleValue;
+	} else if (sscanf(buffer,"mrt_s_e = %lf\n",&doubleValue) == 1) {
+		 config->mrt_s_e = doubleValue;
+	} else if (sscanf(buffer,"mrt_s_eps = %lf\n",&doubleValue) == 1) {
+		 config->mrt_s_eps = doubleValue;
+	} else if (sscanf(buffer,"mrt_s_q = %lf\n",&doubleValue) == 1) {
+		 config->mrt_s_q = doubleValue;
+	} else if (sscanf(buffer,"split_mode = %s\n",buffer2) == 1) {
+		if (strcmp(buffer2,"uniform") == 0)
+			config->split_mode = LBM_SPLIT_UNIFORM;
+		else if (strcmp(buffer2,"fluid") == 0)
+			config->split_mode = LBM_SPLIT_FLUID;
+		else {
+			fprintf(stderr,"Invalid split mode line %d : %s\n",line,buffer);
+			abort();
+		}
+	} else if (sscanf(buffer,"ghost_depth = %d\n",&intValue) == 1) {
+		if (intValue < 1) {
+			fprintf(stderr,"Invalid ghost depth line %d : %s\n",line,buffer);
+			abort();
+		}
+		config->ghost_depth = intValue;
+	} else if (sscanf(buffer,"balance_interval = %d\n",&intValue) == 1) {
+		 config->balance_interval = intValue;
+	} else if (sscanf(buffer,"balance_tolerance = %lf\n",&doubleValue) == 1) {
+		 config->balance_tolerance = doubleValue;
+	} else if (sscanf(buffer,"refine_patch = %d %d %d %d\n",&config->refine_patch[0],&config->refine_patch[1],&config->refine_patch[2],&config->refine_patch[3]) == 4) {
+		if (config->refine_patch[2] <= config->refine_patch[0] || config->refine_patch[3] <= config->refine_patch[1]) {
+			fprintf(stderr,"Invalid refine patch line %d : %s\n",line,buffer);
+			abort();
+		}
+	} else if (sscanf(buffer,"sparse = %d\n",&intValue) == 1) {
+		if (intValue < LBM_SPARSE_NONE || intValue > LBM_SPARSE_SURFACE) {
+			fprintf(stderr,"Invalid sparse mode line %d : %s\n",line,buffer);
+			abort();
+		}
+		config->sparse = intValue;
+	} else if (sscanf(buffer,"write_interval = %d\n",&intValue) == 1) {
+		 config->write_interval = intValue;
+	} else if (sscanf(buffer,"output_version = %d\n",&intValue) == 1) {
+		 config->output_version = intValue;
+	} else if (sscanf(buffer,"output_codec = %s\n",buffer2) == 1) {
+		if (strcmp(buffer2,"none") == 0)
+			config->output_codec = LBM_CODEC_NONE;
+		else if (strcmp(buffer2,"zlib") == 0)
+			config->output_codec = LBM_CODEC_ZLIB;
+		else {
+			fprintf(stderr,"Invalid output codec line %d : %s\n",line,buffer);
+			abort();
+		}
+	} else if (sscanf(buffer,"output_error_bound = %lf\n",&doubleValue) == 1) {
+		 config->output_error_bound = doubleValue;
+	} else if (sscanf(buffer,"output_roi = %d %d %d %d\n",&config->output_roi[0],&config->output_roi[1],&config->output_roi[2],&config->output_roi[3]) == 4) {
+		 //already stored
+	} else if (sscanf(buffer,"output_decimate = %d\n",&intValue) == 1) {
+		 config->output_decimate = intValue;
+	} else if (sscanf(buffer,"checkpoint_interval = %d\n",&intValue) == 1) {
+		 config->checkpoint_interval = intValue;
+	} else if (sscanf(buffer,"checkpoint_filename = %s\n",buffer2) == 1) {
+		 free((void*)config->checkpoint_filename);
+		 config->checkpoint_filename = strdup(buffer2);
+	} else if (sscanf(buffer,"analysis_interval = %d\n",&intValue) == 1) {
+		 config->analysis_interval = intValue;
+	} else if (sscanf(buffer,"analysis_filename = %s\n",buffer2) == 1) {
+		 free((void*)config->analysis_filename);
+		 config->analysis_filename = strdup(buffer2);
+	} else if (sscanf(buffer,"convergence_threshold = %lf\n",&doubleValue) == 1) {
+		 config->convergence_threshold = doubleValue;
+	} else if (sscanf(buffer,"output_filename = %s\n",buffer2) == 1) {
+		 free((void*)config->output_filename);
+		 config->output_filename = strdup(buffer2);
+	} else if (sscanf(buffer,"obstacle_filename = %s\n",buffer2) == 1) {
+		 free((void*)config->obstacle_filename);
+		 config->obstacle_filename = strdup(buffer2);
+	} else if (sscanf(buffer,"obstacle_scale = %lf\n",&doubleValue) == 1) {
+		 config->obstable_scale = doubleValue;
+	} else if (sscanf(buffer,"obstacle_rotate = %lf\n",&doubleValue) == 1) {
+		 config->obstable_rotate = doubleValue;
+	} else if (sscanf(buffer,"obstacle_mask = %s\n",buffer2) == 1) {
+		 free((void*)config->obstacle_mask);
+		 config->obstacle_mask = strdup(buffer2);
+	} else if (sscanf(buffer,"obstacle_mask_save = %s\n",buffer2) == 1) {
+		 free((void*)config->obstacle_mask_save);
+		 config->obstacle_mask_save = strdup(buffer2);
+	} else if (sscanf(buffer,"obstacle_circle = %lf %lf %lf\n",&circle[0],&circle[1],&circle[2]) == 3) {
+		 if (config->nb_obstacle_circles >= LBM_MAX_OBSTACLE_SHAPES) {
+			fprintf(stderr,"Too many obstacle circles line %d (max %d)\n",line,LBM_MAX_OBSTACLE_SHAPES);
+			abort();
+		 }
+		 memcpy(config->obstacle_circles[config->nb_obstacle_circles++],circle,sizeof(circle));
+	} else if (sscanf(buffer,"obstacle_polygon = %[^\n]\n",buffer2) == 1) {
+		 lbm_config_add_polygon(config,buffer2,line);
+	} else {
+		fprintf(stderr,"Invalid config option line %d : %s\n",line,buffer);
+		abort();
+	}
+}
+
+/****************************************************/
+/**
+ * Chargement de la config depuis le fichier.
+**/
+void lbm_config_load(lbm_config_t * config, const char * filename)
+{
+	//vars
+	FILE * fp;
+	char buffer[1024];
 	int line = 0;
 
 	//open the config file
@@ -77,56 +374,11 @@ void lbm_config_init(const char * filename)
 	}
 
 	//load default values
-	lbm_config_set_default();
+	lbm_config_set_default(config);
 
 	//loop on lines
 	while (fgets(buffer,1024,fp) != NULL)
-	{
-		line++;
-		if (buffer[0] == '#')
-		{
-			//comment, nothing to do
-		} else if (sscanf(buffer,"iterations = %d\n",&intValue) == 1) {
-			 lbm_gbl_config.iterations = intValue;
-		} else if (sscanf(buffer,"width = %d\n",&intValue) == 1) {
-			 lbm_gbl_config.width = intValue;
-			 if (lbm_gbl_config.obstacle_x == 0.0)
-				lbm_gbl_config.obstacle_x = (lbm_gbl_config.width / 5.0 + 1.0);
-		} else if (sscanf(buffer,"height = %d\n",&intValue) == 1) {
-			lbm_gbl_config.height = intValue;
-			if (lbm_gbl_config.obstacle_r == 0.0)
-				lbm_gbl_config.obstacle_r = (lbm_gbl_config.height / 10.0 + 1.0);
-			if (lbm_gbl_config.obstacle_y == 0.0)
-				lbm_gbl_config.obstacle_y = (lbm_gbl_config.height / 2.0 + 3.0);
-		} else if (sscanf(buffer,"obstacle_r = %lf\n",&doubleValue) == 1) {
-			 lbm_gbl_config.obstacle_r = doubleValue;
-		} else if (sscanf(buffer,"obstacle_x = %lf\n",&doubleValue) == 1) {
-			 lbm_gbl_config.obstacle_x = doubleValue;
-		} else if (sscanf(buffer,"obstacle_y = %lf\n",&doubleValue) == 1) {
-			 lbm_gbl_config.obstacle_y = doubleValue;
-		} else if (sscanf(buffer,"inflow_max_velocity = %lf\n",&doubleValue) == 1) {
-			 lbm_gbl_config.inflow_max_velocity = doubleValue;
-		} else if (sscanf(buffer,"reynolds = %lf\n",&doubleValue) == 1) {
-			 lbm_gbl_config.reynolds = doubleValue;
-		} else if (sscanf(buffer,"kinetic_viscosity = %lf\n",&doubleValue) == 1) {
-			 lbm_gbl_config.kinetic_viscosity = doubleValue;
-		} else if (sscanf(buffer,"relax_parameter = %lf\n",&doubleValue) == 1) {
-			 lbm_gbl_config.relax_parameter = doubleValue;
-		} else if (sscanf(buffer,"write_interval = %d\n",&intValue) == 1) {
-			 lbm_gbl_config.write_interval = intValue;
-		} else if (sscanf(buffer,"output_filename = %s\n",buffer2) == 1) {
-			 lbm_gbl_config.output_filename = strdup(buffer2);
-		} else if (sscanf(buffer,"obstacle_filename = %s\n",buffer2) == 1) {
-			 lbm_gbl_config.obstacle_filename = strdup(buffer2);
-		} else if (sscanf(buffer,"obstacle_scale = %lf\n",&doubleValue) == 1) {
-			 lbm_gbl_config.obstable_scale = doubleValue;
-		} else if (sscanf(buffer,"obstacle_rotate = %lf\n",&doubleValue) == 1) {
-			 lbm_gbl_config.obstable_rotate = doubleValue;
-		} else {
-			fprintf(stderr,"Invalid config option line %d : %s\n",line,buffer);
-			abort();
-		}
-	}
+		lbm_config_parse_line(config,buffer,++line);
 
 	//check error
 	if (!feof(fp))
@@ -134,47 +386,131 @@ void lbm_config_init(const char * filename)
 		perror(filename);
 		abort();
 	}
+	fclose(fp);
 
-	lbm_config_drived_parameters();
+	lbm_config_drived_parameters(config);
+}
+
+/****************************************************/
+/**
+ * Copie une configuration, les chaînes sont dupliquées pour que chaque copie puisse être
+ * modifiée et libérée indépendamment.
+**/
+void lbm_config_copy(lbm_config_t * dest, const lbm_config_t * src)
+{
+	*dest = *src;
+	dest->output_filename = (src->output_filename == NULL) ? NULL : strdup(src->output_filename);
+	dest->checkpoint_filename = (src->checkpoint_filename == NULL) ? NULL : strdup(src->checkpoint_filename);
+	dest->analysis_filename = (src->analysis_filename == NULL) ? NULL : strdup(src->analysis_filename);
+	dest->obstacle_filename = (src->obstacle_filename == NULL) ? NULL : strdup(src->obstacle_filename);
+	dest->obstacle_mask = (src->obstacle_mask == NULL) ? NULL : strdup(src->obstacle_mask);
+	dest->obstacle_mask_save = (src->obstacle_mask_save == NULL) ? NULL : strdup(src->obstacle_mask_save);
+}
+
+/****************************************************/
+/**
+ * Rend la configuration donnée active : c'est celle que lisent les macros (MESH_WIDTH,
+ * RELAX_PARAMETER...). Les chaînes restent la propriété de la configuration source.
+**/
+void lbm_config_select(const lbm_config_t * config)
+{
+	lbm_gbl_config = *config;
 }
 
 /****************************************************/
 /**
  * Nettotage de la mémoire dynamique de la config.
 **/
-void lbm_config_cleanup(void)
+void lbm_config_cleanup(lbm_config_t * config)
 {
-	free((void*)lbm_gbl_config.output_filename);
+	free((void*)config->output_filename);
+	free((void*)config->checkpoint_filename);
+	free((void*)config->analysis_filename);
+	free((void*)config->obstacle_filename);
+	free((void*)config->obstacle_mask);
+	free((void*)config->obstacle_mask_save);
 }
 
 /****************************************************/
 /**
  * Affichage de la config.
 **/
-void lbm_config_print(void)
+void lbm_config_print(const lbm_config_t * config)
 {
+	//vars
+	int s;
+
 	printf("=================== CONFIG ===================\n");
 	//discretisation
-	printf("%-20s = %d\n","iterations",lbm_gbl_config.iterations);
-	printf("%-20s = %d\n","width",lbm_gbl_config.width);
-	printf("%-20s = %d\n","height",lbm_gbl_config.height);
+	printf("%-20s = %d\n","iterations",config->iterations);
+	printf("%-20s = %d\n","width",config->width);
+	printf("%-20s = %d\n","height",config->height);
+	if (DIMENSIONS == 3)
+		printf("%-20s = %d\n","depth",config->depth);
 	//obstacle
-	printf("%-20s = %lf\n","obstacle_r",lbm_gbl_config.obstacle_r);
-	printf("%-20s = %lf\n","obstacle_x",lbm_gbl_config.obstacle_x);
-	printf("%-20s = %lf\n","obstacle_y",lbm_gbl_config.obstacle_y);
+	printf("%-20s = %lf\n","obstacle_r",config->obstacle_r);
+	printf("%-20s = %lf\n","obstacle_x",config->obstacle_x);
+	printf("%-20s = %lf\n","obstacle_y",config->obstacle_y);
 	//flow parameters
-	printf("%-20s = %lf\n","reynolds",lbm_gbl_config.reynolds);
-	printf("%-20s = %lf\n","inflow_max_velocity",lbm_gbl_config.inflow_max_velocity);
-	printf("%-20s = %lf\n","inflow_max_velocity",lbm_gbl_config.inflow_max_velocity);
+	printf("%-20s = %lf\n","reynolds",config->reynolds);
+	printf("%-20s = %lf\n","inflow_max_velocity",config->inflow_max_velocity);
+	printf("%-20s = %lf\n","inflow_max_velocity",config->inflow_max_velocity);
+	//collision
+	printf("%-20s = %s\n","lattice",LBM_LATTICE_NAME);
+	printf("%-20s = %s\n","precision",LBM_PRECISION_NAME);
+	printf("%-20s = %s\n","collision_model",lbm_config_collision_name(config->collision_model));
+	if (config->collision_model == LBM_COLLISION_TRT)
+		printf("%-20s = %lf\n","trt_magic",config->trt_magic);
+	if (config->collision_model == LBM_COLLISION_MRT) {
+		printf("%-20s = %lf\n","mrt_s_e",config->mrt_s_e);
+		printf("%-20s = %lf\n","mrt_s_eps",config->mrt_s_eps);
+		printf("%-20s = %lf\n","mrt_s_q",config->mrt_s_q);
+	}
+	//decomposition
+	printf("%-20s = %s\n","split_mode",lbm_config_split_name(config->split_mode));
+	printf("%-20s = %d\n","ghost_depth",config->ghost_depth);
+	printf("%-20s = %d\n","balance_interval",config->balance_interval);
+	if (config->balance_interval > 0)
+		printf("%-20s = %lf\n","balance_tolerance",config->balance_tolerance);
+	if (config->refine_patch[2] > config->refine_patch[0])
+		printf("%-20s = %d %d %d %d\n","refine_patch",config->refine_patch[0],config->refine_patch[1],config->refine_patch[2],config->refine_patch[3]);
+	//storage
+	printf("%-20s = %d\n","sparse",config->sparse);
 	//results
-	printf("%-20s = %s\n","output_filename",lbm_gbl_config.output_filename);
-	printf("%-20s = %d\n","write_interval",lbm_gbl_config.write_interval);
+	printf("%-20s = %s\n","output_filename",config->output_filename);
+	printf("%-20s = %d\n","write_interval",config->write_interval);
+	printf("%-20s = %d\n","output_version",config->output_version);
+	if (config->output_version >= 2) {
+		printf("%-20s = %s\n","output_codec",lbm_config_codec_name(config->output_codec));
+		printf("%-20s = %lf\n","output_error_bound",config->output_error_bound);
+		printf("%-20s = %d %d %d %d\n","output_roi",config->output_roi[0],config->output_roi[1],config->output_roi[2],config->output_roi[3]);
+		printf("%-20s = %d\n","output_decimate",config->output_decimate);
+	}
+	//checkpoint
+	printf("%-20s = %d\n","checkpoint_interval",config->checkpoint_interval);
+	printf("%-20s = %s\n","checkpoint_filename",config->checkpoint_filename);
+	//analysis
+	printf("%-20s = %d\n","analysis_interval",config->analysis_interval);
+	if (config->analysis_interval > 0) {
+		printf("%-20s = %s\n","analysis_filename",config->analysis_filename);
+		printf("%-20s = %lf\n","convergence_threshold",config->convergence_threshold);
+	}
 	//obstacle
-	printf("%-20s = %s\n","obstacle_filename",lbm_gbl_config.obstacle_filename);
-	printf("%-20s = %lf\n","obstable_scale",lbm_gbl_config.obstable_scale);
-	printf("%-20s = %lf\n","obstable_rotate",lbm_gbl_config.obstable_rotate);
+	printf("%-20s = %s\n","obstacle_filename",config->obstacle_filename);
+	printf("%-20s = %lf\n","obstable_scale",config->obstable_scale);
+	printf("%-20s = %lf\n","obstable_rotate",config->obstable_rotate);
+	if (config->obstacle_mask != NULL)
+		printf("%-20s = %s\n","obstacle_mask",config->obstacle_mask);
+	if (config->obstacle_mask_save != NULL)
+		printf("%-20s = %s\n","obstacle_mask_save",config->obstacle_mask_save);
+	for ( s = 0 ; s < config->nb_obstacle_circles ; s++)
+		printf("%-20s = %lf %lf %lf\n","obstacle_circle",config->obstacle_circles[s][0],config->obstacle_circles[s][1],config->obstacle_circles[s][2]);
+	for ( s = 0 ; s < config->nb_obstacle_polygons ; s++)
+		printf("%-20s = %d points\n","obstacle_polygon",config->obstacle_polygon_points[s]);
 	printf("------------ Derived parameters --------------\n");
-	printf("%-20s = %lf\n","kinetic_viscosity",lbm_gbl_config.kinetic_viscosity);
-	printf("%-20s = %lf\n","relax_parameter",lbm_gbl_config.relax_parameter);
+	printf("%-20s = %lf\n","kinetic_viscosity",config->kinetic_viscosity);
+	printf("%-20s = %lf\n","relax_parameter",config->relax_parameter);
+	if (config->collision_model == LBM_COLLISION_TRT)
+		printf("%-20s = %lf\n","trt_relax_minus",config->trt_relax_minus);
 	printf("==============================================\n");
 }
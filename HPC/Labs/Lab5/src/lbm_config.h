@@ -12,12 +12,42 @@
 
 /****************************************************/
 
-//number of space dimentions to consider
-#define DIMENSIONS 2
-#define DIRECTIONS 9
+//lattice (number of space dimentions and of discrete velocities), selected at
+//build time with -DLBM_LATTICE_D3Q19 or -DLBM_LATTICE_D3Q27, D2Q9 by default.
+//The 3D lattices add a Z extent (depth) to the mesh and to the domain decomposition.
+#if defined(LBM_LATTICE_D3Q27)
+	#define DIMENSIONS 3
+	#define DIRECTIONS 27
+	#define LBM_LATTICE_NAME "D3Q27"
+#elif defined(LBM_LATTICE_D3Q19)
+	#define DIMENSIONS 3
+	#define DIRECTIONS 19
+	#define LBM_LATTICE_NAME "D3Q19"
+#else
+	#ifndef LBM_LATTICE_D2Q9
+		#define LBM_LATTICE_D2Q9
+	#endif
+	#define DIMENSIONS 2
+	#define DIRECTIONS 9
+	#define LBM_LATTICE_NAME "D2Q9"
+#endif
+//storage of the microscopic densities, selected at build time with
+//-DLBM_PRECISION_SINGLE (float) or -DLBM_PRECISION_MIXED (float deviation from the
+//direction weight), double by default. The computations are always done in double.
+#if defined(LBM_PRECISION_SINGLE)
+	#define LBM_PRECISION_ID 1
+	#define LBM_PRECISION_NAME "single"
+#elif defined(LBM_PRECISION_MIXED)
+	#define LBM_PRECISION_ID 2
+	#define LBM_PRECISION_NAME "mixed"
+#else
+	#define LBM_PRECISION_ID 0
+	#define LBM_PRECISION_NAME "double"
+#endif
 //mesh discretisation
 #define MESH_WIDTH (lbm_gbl_config.width)
 #define MESH_HEIGHT (lbm_gbl_config.height)
+#define MESH_DEPTH (lbm_gbl_config.depth)
 //obstable parameter
 #define OBSTACLE_R (lbm_gbl_config.obstacle_r)
 #define OBSTACLE_X (lbm_gbl_config.obstacle_x)
@@ -31,11 +61,90 @@
 #define REYNOLDS (lbm_gbl_config.reynolds)
 #define KINETIC_VISCOSITY (lbm_gbl_config.kinetic_viscosity)
 #define RELAX_PARAMETER (lbm_gbl_config.relax_parameter)
+#define COLLISION_MODEL (lbm_gbl_config.collision_model)
+//domain decomposition
+#define SPLIT_MODE (lbm_gbl_config.split_mode)
+//layers of ghost cells exchanged once every GHOST_DEPTH steps (ex10)
+#define GHOST_DEPTH (lbm_gbl_config.ghost_depth)
+//measured load balancing, check every BALANCE_INTERVAL steps
+#define BALANCE_INTERVAL (lbm_gbl_config.balance_interval)
+#define BALANCE_TOLERANCE (lbm_gbl_config.balance_tolerance)
+//local refinement : first and last coarse nodes of the fine patch (x0 y0 x1 y1)
+#define REFINE_PATCH (lbm_gbl_config.refine_patch)
+//compute the cells through lists (lbm_sparse_mode_t), 0 for the dense loops
+#define SPARSE_MODE (lbm_gbl_config.sparse)
 //result filename
 #define RESULT_FILENAME (lbm_gbl_config.output_filename)
 #define RESULT_MAGICK 0x12345
+#define RESULT_MAGICK_V2 0x12346
+#define RESULT_VERSION (lbm_gbl_config.output_version)
+#define RESULT_CODEC (lbm_gbl_config.output_codec)
+#define RESULT_ERROR_BOUND (lbm_gbl_config.output_error_bound)
+#define RESULT_DECIMATE (lbm_gbl_config.output_decimate)
 #define WRITE_BUFFER_ENTRIES 4096
 #define WRITE_STEP_INTERVAL (lbm_gbl_config.write_interval)
+//checkpoint/restart
+#define CHECKPOINT_INTERVAL (lbm_gbl_config.checkpoint_interval)
+#define CHECKPOINT_FILENAME (lbm_gbl_config.checkpoint_filename)
+//in-situ analysis
+#define ANALYSIS_INTERVAL (lbm_gbl_config.analysis_interval)
+#define ANALYSIS_FILENAME (lbm_gbl_config.analysis_filename)
+#define CONVERGENCE_THRESHOLD (lbm_gbl_config.convergence_threshold)
+//analytic obstacles given in the config
+#define LBM_MAX_OBSTACLE_SHAPES 16
+#define LBM_MAX_POLYGON_POINTS 64
+
+/****************************************************/
+/**
+ * Collision operator applied on each cell.
+**/
+typedef enum lbm_collision_model_e
+{
+	/** Single relaxation time (Bhatnagar-Gross-Krook), the historical one. **/
+	LBM_COLLISION_BGK,
+	/** Two relaxation times on the symmetric/anti-symmetric parts. **/
+	LBM_COLLISION_TRT,
+	/** Multiple relaxation times in the moment space (Lallemand & Luo). **/
+	LBM_COLLISION_MRT
+} lbm_collision_model_t;
+
+/****************************************************/
+/**
+ * Way to place the cuts of the domain decomposition.
+**/
+typedef enum lbm_split_mode_e
+{
+	/** Same number of cells in each tile (up to one row/column). **/
+	LBM_SPLIT_UNIFORM,
+	/** Same number of fluid cells in each tile column/row, tiles with obstacles get more area. **/
+	LBM_SPLIT_FLUID
+} lbm_split_mode_t;
+
+/****************************************************/
+/**
+ * Cells visited by the sparse mode, the values are the ones of the sparse config key.
+**/
+typedef enum lbm_sparse_mode_e
+{
+	/** Dense loops over the whole mesh. **/
+	LBM_SPARSE_NONE = 0,
+	/** Lists of the fluid and obstacle cells, gives the same results as the dense loops. **/
+	LBM_SPARSE_EXACT = 1,
+	/** Also skip the obstacle cells not touching the fluid, results differ from the dense loops. **/
+	LBM_SPARSE_SURFACE = 2
+} lbm_sparse_mode_t;
+
+/****************************************************/
+/**
+ * Compression applied on each frame of the version 2 output file.
+**/
+typedef enum lbm_output_codec_e
+{
+	/** Frames are stored as is. **/
+	LBM_CODEC_NONE,
+	/** Frames are byte-shuffled and compressed with zlib. **/
+	LBM_CODEC_ZLIB
+} lbm_output_codec_t;
 
 /****************************************************/
 /**
@@ -47,6 +156,7 @@ typedef struct lbm_config_s
 	int iterations;
 	int width;
 	int height;
+	int depth;
 	//obstacle
 	double obstacle_r;
 	double obstacle_x;
@@ -57,26 +167,69 @@ typedef struct lbm_config_s
 	//derived flow parameters
 	double kinetic_viscosity;
 	double relax_parameter;
+	//collision operator
+	lbm_collision_model_t collision_model;
+	double trt_magic;
+	double mrt_s_e;
+	double mrt_s_eps;
+	double mrt_s_q;
+	//derived collision parameters
+	double trt_relax_minus;
+	//domain decomposition
+	lbm_split_mode_t split_mode;
+	int ghost_depth;
+	int balance_interval;
+	double balance_tolerance;
+	//local refinement
+	int refine_patch[4];
+	//storage
+	lbm_sparse_mode_t sparse;
 	//results
 	const char * output_filename;
 	int write_interval;
+	int output_version;
+	lbm_output_codec_t output_codec;
+	double output_error_bound;
+	int output_roi[4];
+	int output_decimate;
+	//checkpoint
+	int checkpoint_interval;
+	const char * checkpoint_filename;
+	//in-situ analysis
+	int analysis_interval;
+	const char * analysis_filename;
+	double convergence_threshold;
 	//obstable
 	const char * obstacle_filename;
 	double obstable_scale;
 	double obstable_rotate;
+	const char * obstacle_mask;
+	const char * obstacle_mask_save;
+	int nb_obstacle_circles;
+	double obstacle_circles[LBM_MAX_OBSTACLE_SHAPES][3];
+	int nb_obstacle_polygons;
+	int obstacle_polygon_points[LBM_MAX_OBSTACLE_SHAPES];
+	double obstacle_polygons[LBM_MAX_OBSTACLE_SHAPES][2 * LBM_MAX_POLYGON_POINTS];
 } lbm_config_t;
 
 /****************************************************/
-void lbm_config_init(const char * filename);
-void lbm_config_drived_parameters(void);
-void lbm_config_cleanup(void);
-void lbm_config_print(void);
-void lbm_config_set_default(void);
+void lbm_config_load(lbm_config_t * config, const char * filename);
+void lbm_config_parse_line(lbm_config_t * config, const char * buffer, int line);
+void lbm_config_drived_parameters(lbm_config_t * config);
+void lbm_config_copy(lbm_config_t * dest, const lbm_config_t * src);
+void lbm_config_select(const lbm_config_t * config);
+void lbm_config_cleanup(lbm_config_t * config);
+void lbm_config_print(const lbm_config_t * config);
+void lbm_config_set_default(lbm_config_t * config);
+const char * lbm_config_collision_name(lbm_collision_model_t model);
+const char * lbm_config_split_name(lbm_split_mode_t mode);
+const char * lbm_config_codec_name(lbm_output_codec_t codec);
 
 /****************************************************/
 /**
- * Configuration accessible sous le forme d'une variable globale.
- * A utiliser comme une constante à part pour le chargement initiale.
+ * Configuration du cas en cours accessible sous le forme d'une variable globale (lue par
+ * les macros ci-dessus). A utiliser comme une constante, elle est remplie par
+ * lbm_config_select() à partir d'une configuration chargée avec lbm_config_load().
 **/
 extern lbm_config_t lbm_gbl_config;
 
@@ -14,10 +14,7 @@
 //internal
 #include "lbm_phys.h"
 #include "lbm_init.h"
-//magick want for image processing
-#ifdef HAVE_MAGICK_WAND
-	#include <wand/MagickWand.h>
-#endif
+#include "lbm_obstacle.h"
 
 /****************************************************/
 /**
@@ -33,7 +30,7 @@
 void lbm_init_velocity_0_density_1(lbm_mesh_t * mesh)
 {
 	//vars
-	int i,j,k;
+	int i,j,z,k;
 
 	//errors
 	assert(mesh != NULL);
@@ -41,31 +38,39 @@ void lbm_init_velocity_0_density_1(lbm_mesh_t * mesh)
 	//loop on all cells
 	for ( i = 0 ; i <  mesh->width ; i++)
 		for ( j = 0 ; j <  mesh->height ; j++)
-			for ( k = 0 ; k < DIRECTIONS ; k++)
-				lbm_mesh_get_cell(mesh, i, j)[k] = equil_weight[k];
+			for ( z = 0 ; z <  LBM_MESH_DEPTH(mesh) ; z++)
+				for ( k = 0 ; k < DIRECTIONS ; k++)
+					LBM_STORE(lbm_mesh_get_cell_3d(mesh, i, j, z),k,equil_weight[k]);
 }
 
 /****************************************************/
 /**
- * Initialisation de l'obstacle, on bascule les types des mailles associé à CELL_BOUNCE_BACK.
- * Ici l'obstacle est un cercle de centre (OBSTACLE_X,OBSTACLE_Y) et de rayon OBSTACLE_R.
+ * Compte les mailles fluides de chaque colonne et de chaque ligne du maillage global
+ * (sans les mailles fantômes) pour pondérer le découpage du domaine. L'obstacle doit
+ * avoir été chargé par lbm_obstacle_load().
+ * @param columns Tableau de total_width entrées.
+ * @param lines Tableau de total_height entrées.
 **/
-void lbm_init_circle_obstacle(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
+void lbm_init_fluid_profiles(double * columns, double * lines, int total_width, int total_height)
 {
 	//vars
 	int i,j;
 
-	//loop on nodes
-	for ( i =  comm->x; i < mesh->width + comm->x ; i++)
+	//reset
+	for ( i = 0 ; i < total_width ; i++)
+		columns[i] = total_height;
+	for ( j = 0 ; j < total_height ; j++)
+		lines[j] = total_width;
+
+	//remove obstacle cells, same test than lbm_obstacle_rasterize() in global coordinates
+	for ( i = 0 ; i < total_width ; i++)
 	{
-		for ( j =  comm->y ; j <  mesh->height + comm->y ; j++)
+		for ( j = 0 ; j < total_height ; j++)
 		{
-			if ( ( (i-OBSTACLE_X) * (i-OBSTACLE_X) ) + ( (j-OBSTACLE_Y) * (j-OBSTACLE_Y) ) <= OBSTACLE_R * OBSTACLE_R )
+			if (lbm_obstacle_test(i + 1, j + 1) != LBM_OBSTACLE_NONE)
 			{
-
-				*( lbm_cell_type_t_get_cell( mesh_type , i - comm->x, j - comm->y) ) = CELL_BOUNCE_BACK;
-				//for ( k = 0 ; k < DIMENSIONS ; k++)
-				//	mesh[i][j][k] = 0.0;
+				columns[i] -= 1.0;
+				lines[j] -= 1.0;
 			}
 		}
 	}
@@ -81,28 +86,34 @@ void lbm_init_circle_obstacle(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, co
 void lbm_init_global_poiseuille_profile(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type,const lbm_comm_t * comm)
 {
 	//vars
-	int i,j,k;
+	int i,j,z,k;
 	Vector v = {0.0,0.0};
 	const double density = 1.0;
 
 	int rank;
-	MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+	MPI_Comm_rank(lbm_comm_world,&rank);
 
-	//apply poiseuil for all nodes except on top/bottom border
+	//apply poiseuil for all nodes except on top/bottom border (and front/back in 3D)
 	for ( i = 0 ; i < mesh->width ; i++)
 	{
 		for ( j = 0 ; j < mesh->height ; j++)
 		{
-			for ( k = 0 ; k < DIRECTIONS ; k++)
+			for ( z = 0 ; z < LBM_MESH_DEPTH(mesh) ; z++)
 			{
-				//compute equilibr.
-				v[0] = lbm_phys_poiseuille(j + comm->y,MESH_HEIGHT);
-				lbm_mesh_get_cell(mesh, i, j)[k] = lbm_phys_equilibrium_profile(v,density,k);
-				//mark as standard fluid
-				*( lbm_cell_type_t_get_cell( mesh_type , i, j) ) = CELL_FUILD;
-				//this is a try to init the fluide with null speed except on left interface.
-				//if (i > 1)
-				//	lbm_mesh_get_cell(mesh, i, j)[k] = equil_weight[k];
+				for ( k = 0 ; k < DIRECTIONS ; k++)
+				{
+					//compute equilibr.
+					if (DIMENSIONS == 3)
+						v[0] = lbm_phys_poiseuille_3d(j + comm->y,MESH_HEIGHT,z + comm->z,MESH_DEPTH);
+					else
+						v[0] = lbm_phys_poiseuille(j + comm->y,MESH_HEIGHT);
+					LBM_STORE(lbm_mesh_get_cell_3d(mesh, i, j, z),k,lbm_phys_equilibrium_profile(v,density,k));
+					//mark as standard fluid
+					*( lbm_cell_type_t_get_cell_3d( mesh_type , i, j, z) ) = CELL_FUILD;
+					//this is a try to init the fluide with null speed except on left interface.
+					//if (i > 1)
+					//	lbm_mesh_get_cell(mesh, i, j)[k] = equil_weight[k];
+				}
 			}
 		}
 	}
@@ -120,19 +131,24 @@ void lbm_init_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_c
 	int i,j,k;
 	Vector v = {0.0,0.0};
 	const double density = 1.0;
+	//the outer ring is after the extra ghost layers (exercise 10)
+	int left = comm->ghost - 1;
+	int right = mesh->width - comm->ghost;
+	int top = comm->ghost - 1;
+	int bottom = mesh->height - comm->ghost;
 
 	//setup left border type
 	if( comm->rank_x == 0 )
 	{
-		for ( j = 1 ; j < mesh->height - 1 ; j++)
-			*( lbm_cell_type_t_get_cell( mesh_type , 0, j) ) = CELL_LEFT_IN;
+		for ( j = top + 1 ; j < bottom ; j++)
+			*( lbm_cell_type_t_get_cell( mesh_type , left, j) ) = CELL_LEFT_IN;
 	}
 
 	if( comm->rank_x == comm->nb_x - 1 )
 	{
 		//setup right border type
-		for ( j = 1 ; j < mesh->height - 1 ; j++)
-			*( lbm_cell_type_t_get_cell( mesh_type , mesh->width - 1, j) ) = CELL_RIGHT_OUT;
+		for ( j = top + 1 ; j < bottom ; j++)
+			*( lbm_cell_type_t_get_cell( mesh_type , right, j) ) = CELL_RIGHT_OUT;
 	}
 
 	//top
@@ -141,9 +157,9 @@ void lbm_init_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_c
 			for ( k = 0 ; k < DIRECTIONS ; k++)
 			{
 				//compute equilibr.
-				lbm_mesh_get_cell(mesh, i, 0)[k] = lbm_phys_equilibrium_profile(v,density,k);
+				LBM_STORE(lbm_mesh_get_cell(mesh, i, top),k,lbm_phys_equilibrium_profile(v,density,k));
 				//mark as bounce back
-				*( lbm_cell_type_t_get_cell( mesh_type , i, 0) ) = CELL_BOUNCE_BACK;
+				*( lbm_cell_type_t_get_cell( mesh_type , i, top) ) = CELL_BOUNCE_BACK;
 			}
 
 	//bottom
@@ -152,81 +168,11 @@ void lbm_init_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_c
 			for ( k = 0 ; k < DIRECTIONS ; k++)
 			{
 				//compute equilibr.
-				lbm_mesh_get_cell(mesh, i, mesh->height - 1)[k] = lbm_phys_equilibrium_profile(v,density,k);
+				LBM_STORE(lbm_mesh_get_cell(mesh, i, bottom),k,lbm_phys_equilibrium_profile(v,density,k));
 				//mark as bounce back
-				*( lbm_cell_type_t_get_cell( mesh_type , i, mesh->height - 1) ) = CELL_BOUNCE_BACK;
-			}
-}
-
-/****************************************************/
-/**
- * Initialisation de l'obstacle, on bascule les types des mailles associé à CELL_BOUNCE_BACK.
- * Ici l'obstacle est un cercle de centre (OBSTACLE_X,OBSTACLE_Y) et de rayon OBSTACLE_R.
-**/
-#ifdef HAVE_MAGICK_WAND
-void lbm_init_image_obstacle(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm,const char * fname)
-{
-	//vars
-	int i,j;
-	int k;
-	int obsty;
-	size_t w,h;
-	PixelWand * p;
-
-	//open wand image
-	MagickBooleanType status;
-	MagickWand * image = NULL;
-	MagickWandGenesis();
-	image = NewMagickWand();
-	status = MagickReadImage(image,fname);
-	if (status == MagickFalse) abort();
-	p =  NewPixelWand();
-	h = MagickGetImageHeight(image);
-	w = MagickGetImageWidth(image);
-	//printf("Obstacle size : %lu x %lu\n",w,h);
-
-	//scale if need
-	if (lbm_gbl_config.obstable_scale != 1.0)
-	{
-		MagickScaleImage(image,w * lbm_gbl_config.obstable_scale, h * lbm_gbl_config.obstable_scale);
-		h = MagickGetImageHeight(image);
-		w = MagickGetImageWidth(image);
-		//printf("Obstacle size : %lu x %lu\n",w,h);
-	}
-
-	//roate
-	if (lbm_gbl_config.obstable_rotate != 0.0)
-	{
-		PixelSetColor(p,"white");
-		MagickRotateImage(image,p,lbm_gbl_config.obstable_rotate);
-		h = MagickGetImageHeight(image);
-		w = MagickGetImageWidth(image);
-		//printf("Obstacle size after rotate : %lu x %lu\n",w,h);
-	}
-
-	obsty = (MESH_HEIGHT - h) / 2;
-	//printf("Obstacle y pos : %d\n",obsty);
-
-	//loop on nodes
-	// 	#pragma omp for private (i,j)
-	for ( i =  comm->x; i < mesh->width + comm->x ; i++)
-	{
-		for ( j =  comm->y ; j <  mesh->height + comm->y ; j++)
-		{
-			if ( i > OBSTACLE_X && (i-OBSTACLE_X) < w && (j-obsty) < h && j > obsty)
-			{
-				MagickGetImagePixelColor(image,(i-OBSTACLE_X),h - (j-obsty),p);
-				if (PixelGetRed(p) < 0.8)
-				{
-					*( lbm_cell_type_t_get_cell( mesh_type , i - comm->x, j - comm->y) ) = CELL_BOUNCE_BACK;
-					for ( k = 0 ; k < DIMENSIONS ; k++)
-						lbm_mesh_get_cell(mesh,  i - comm->x, j - comm->y)[k] = equil_weight[k];
-				}
+				*( lbm_cell_type_t_get_cell( mesh_type , i, bottom) ) = CELL_BOUNCE_BACK;
 			}
-		}
-	}
 }
-#endif
 
 /****************************************************/
 /**
@@ -241,12 +187,6 @@ void lbm_init_mesh_state(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const l
 	//Skip due to a bug
 	//lbm_init_border(mesh,mesh_type,comm);
 
-	#ifdef HAVE_MAGICK_WAND
-		if (lbm_gbl_config.obstacle_filename == NULL)
-			lbm_init_circle_obstacle(mesh,mesh_type, comm);
-		else
-			lbm_init_image_obstacle(mesh,mesh_type, comm,lbm_gbl_config.obstacle_filename);
-	#else
-		lbm_init_circle_obstacle(mesh,mesh_type, comm);
-	#endif
+	//obstacle loaded by lbm_obstacle_load()
+	lbm_obstacle_rasterize(mesh,mesh_type,comm);
 }
@@ -16,10 +16,9 @@
 
 /****************************************************/
 void lbm_init_velocity_0_density_1(lbm_mesh_t * mesh);
-void lbm_init_circle_obstacle(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
 void lbm_init_global_poiseuille_profile(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type,const lbm_comm_t * comm);
 void lbm_init_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
 void lbm_init_mesh_state(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
-void lbm_init_image_obstacle(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * mesh_comm,const char * fname);
+void lbm_init_fluid_profiles(double * columns, double * lines, int total_width, int total_height);
 
 #endif //LBM_INIT_H
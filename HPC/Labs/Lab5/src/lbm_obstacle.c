@@ -0,0 +1,410 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <mpi.h>
+#include "lbm_phys.h"
+#include "lbm_obstacle.h"
+//magick want for image processing
+#ifdef HAVE_MAGICK_WAND
+	#include <wand/MagickWand.h>
+#endif
+
+/****************************************************/
+/** Masque de l'obstacle partagé par tous les processus. **/
+static lbm_obstacle_mask_t lbm_obstacle_mask = {0, 0, 0.0, 0, NULL};
+/** Boîte englobante de chaque polygone (x_min, y_min, x_max, y_max). **/
+static double lbm_obstacle_polygon_bbox[LBM_MAX_OBSTACLE_SHAPES][4];
+
+/****************************************************/
+/**
+ * Nombre d'octets d'une ligne du masque.
+**/
+static inline size_t lbm_obstacle_mask_stride(const lbm_obstacle_mask_t * mask)
+{
+	return ((size_t)mask->width + 7) / 8;
+}
+
+/****************************************************/
+/**
+ * Alloue un masque vide (tout fluide) de la taille donnée.
+**/
+static void lbm_obstacle_mask_alloc(lbm_obstacle_mask_t * mask, int width, int height)
+{
+	mask->width = width;
+	mask->height = height;
+	mask->bits = calloc(lbm_obstacle_mask_stride(mask) * height + 1, 1);
+	if (mask->bits == NULL)
+		fatal("Fail to allocate the obstacle mask !");
+}
+
+/****************************************************/
+/**
+ * Lit un entier de l'entête d'un fichier PBM en sautant les blancs et les commentaires.
+**/
+static int lbm_obstacle_pbm_int(FILE * fp, const char * filename)
+{
+	//vars
+	int c;
+	int value;
+
+	//skip blanks and comments
+	while ((c = fgetc(fp)) != EOF) {
+		if (c == '#') {
+			while ((c = fgetc(fp)) != EOF && c != '\n') {}
+		} else if (!isspace(c)) {
+			break;
+		}
+	}
+
+	//read
+	ungetc(c, fp);
+	if (fscanf(fp, "%d", &value) != 1 || value <= 0) {
+		fprintf(stderr, "Invalid PBM header in %s\n", filename);
+		abort();
+	}
+	return value;
+}
+
+/****************************************************/
+/**
+ * Charge un masque depuis un fichier PBM binaire (P4) ou texte (P1), les pixels noirs
+ * étant solides.
+**/
+void lbm_obstacle_mask_read_pbm(lbm_obstacle_mask_t * mask, const char * filename)
+{
+	//vars
+	char magick[3] = {0, 0, 0};
+	int r,c,value;
+
+	//open
+	FILE * fp = fopen(filename, "rb");
+	if (fp == NULL) {
+		perror(filename);
+		abort();
+	}
+
+	//header
+	if (fread(magick, 1, 2, fp) != 2 || magick[0] != 'P' || (magick[1] != '1' && magick[1] != '4')) {
+		fprintf(stderr, "%s is not a PBM file (P1 or P4)\n", filename);
+		abort();
+	}
+	int width = lbm_obstacle_pbm_int(fp, filename);
+	int height = lbm_obstacle_pbm_int(fp, filename);
+	lbm_obstacle_mask_alloc(mask, width, height);
+
+	//raw data after a single blank is the layout of the mask
+	if (magick[1] == '4') {
+		fgetc(fp);
+		if (fread(mask->bits, lbm_obstacle_mask_stride(mask), height, fp) != (size_t)height) {
+			fprintf(stderr, "Truncated PBM file %s\n", filename);
+			abort();
+		}
+	} else {
+		for ( r = 0 ; r < height ; r++)
+		{
+			for ( c = 0 ; c < width ; c++)
+			{
+				if (fscanf(fp, " %1d", &value) != 1) {
+					fprintf(stderr, "Truncated PBM file %s\n", filename);
+					abort();
+				}
+				if (value)
+					mask->bits[r * lbm_obstacle_mask_stride(mask) + c / 8] |= 0x80 >> (c % 8);
+			}
+		}
+	}
+
+	//close
+	fclose(fp);
+}
+
+/****************************************************/
+/**
+ * Ecrit le masque dans un fichier PBM binaire (P4) pour les exécutions suivantes.
+**/
+void lbm_obstacle_mask_write_pbm(const lbm_obstacle_mask_t * mask, const char * filename)
+{
+	//open
+	FILE * fp = fopen(filename, "wb");
+	if (fp == NULL) {
+		perror(filename);
+		abort();
+	}
+
+	//write
+	fprintf(fp, "P4\n%d %d\n", mask->width, mask->height);
+	if (fwrite(mask->bits, lbm_obstacle_mask_stride(mask), mask->height, fp) != (size_t)mask->height) {
+		perror(filename);
+		abort();
+	}
+
+	//close
+	fclose(fp);
+}
+
+/****************************************************/
+#ifdef HAVE_MAGICK_WAND
+/**
+ * Décode l'image de l'obstacle (mise à l'échelle et rotation comprises) et la convertit
+ * en masque en exportant la composante rouge en une seule fois au lieu d'un appel par
+ * pixel. Les pixels de rouge inférieur à 0.8 sont solides.
+**/
+static void lbm_obstacle_mask_decode_image(lbm_obstacle_mask_t * mask, const char * fname)
+{
+	//vars
+	size_t w,h;
+	size_t r,c;
+
+	//open wand image
+	MagickWandGenesis();
+	MagickWand * image = NewMagickWand();
+	PixelWand * p = NewPixelWand();
+	if (MagickReadImage(image,fname) == MagickFalse)
+		fatal("Fail to read the obstacle image !");
+
+	//scale if need
+	h = MagickGetImageHeight(image);
+	w = MagickGetImageWidth(image);
+	if (lbm_gbl_config.obstable_scale != 1.0)
+		MagickScaleImage(image,w * lbm_gbl_config.obstable_scale, h * lbm_gbl_config.obstable_scale);
+
+	//rotate
+	if (lbm_gbl_config.obstable_rotate != 0.0)
+	{
+		PixelSetColor(p,"white");
+		MagickRotateImage(image,p,lbm_gbl_config.obstable_rotate);
+	}
+
+	//export the red channel
+	h = MagickGetImageHeight(image);
+	w = MagickGetImageWidth(image);
+	double * red = malloc(sizeof(double) * w * h);
+	if (red == NULL)
+		fatal("Fail to allocate the obstacle image buffer !");
+	if (MagickExportImagePixels(image, 0, 0, w, h, "R", DoublePixel, red) == MagickFalse)
+		fatal("Fail to export the obstacle image pixels !");
+
+	//threshold
+	lbm_obstacle_mask_alloc(mask, w, h);
+	for ( r = 0 ; r < h ; r++)
+		for ( c = 0 ; c < w ; c++)
+			if (red[r * w + c] < 0.8)
+				mask->bits[r * lbm_obstacle_mask_stride(mask) + c / 8] |= 0x80 >> (c % 8);
+
+	//free
+	free(red);
+	DestroyPixelWand(p);
+	DestroyMagickWand(image);
+	MagickWandTerminus();
+}
+#endif //HAVE_MAGICK_WAND
+
+/****************************************************/
+/**
+ * Charge la géométrie de l'obstacle. Le masque (fichier PBM ou image) est décodé par le
+ * maître puis diffusé, les formes analytiques sont lues par chacun dans la config.
+ * Fonction collective, à appeler après le chargement de la config et avant le découpage
+ * du domaine qui peut en dépendre.
+**/
+void lbm_obstacle_load(void)
+{
+	//vars
+	int rank;
+	int p,k;
+	int dims[2] = {0, 0};
+
+	//reset
+	lbm_obstacle_release();
+	MPI_Comm_rank(lbm_comm_world, &rank);
+
+	//bounding boxes of the polygons
+	for ( p = 0 ; p < lbm_gbl_config.nb_obstacle_polygons ; p++)
+	{
+		const double * points = lbm_gbl_config.obstacle_polygons[p];
+		double * bbox = lbm_obstacle_polygon_bbox[p];
+		bbox[0] = bbox[2] = points[0];
+		bbox[1] = bbox[3] = points[1];
+		for ( k = 1 ; k < lbm_gbl_config.obstacle_polygon_points[p] ; k++)
+		{
+			if (points[2 * k] < bbox[0]) bbox[0] = points[2 * k];
+			if (points[2 * k] > bbox[2]) bbox[2] = points[2 * k];
+			if (points[2 * k + 1] < bbox[1]) bbox[1] = points[2 * k + 1];
+			if (points[2 * k + 1] > bbox[3]) bbox[3] = points[2 * k + 1];
+		}
+	}
+
+	//nothing to decode
+	if (lbm_gbl_config.obstacle_mask == NULL && lbm_gbl_config.obstacle_filename == NULL)
+		return;
+
+	//decode on master only
+	if (rank == RANK_MASTER) {
+		if (lbm_gbl_config.obstacle_mask != NULL) {
+			lbm_obstacle_mask_read_pbm(&lbm_obstacle_mask, lbm_gbl_config.obstacle_mask);
+		} else {
+			#ifdef HAVE_MAGICK_WAND
+				lbm_obstacle_mask_decode_image(&lbm_obstacle_mask, lbm_gbl_config.obstacle_filename);
+			#else
+				fprintf(stderr, "Built without MagickWand, ignore %s (use obstacle_mask with a PBM file)\n", lbm_gbl_config.obstacle_filename);
+			#endif
+		}
+		if (lbm_obstacle_mask.bits != NULL && lbm_gbl_config.obstacle_mask_save != NULL)
+			lbm_obstacle_mask_write_pbm(&lbm_obstacle_mask, lbm_gbl_config.obstacle_mask_save);
+		dims[0] = lbm_obstacle_mask.width;
+		dims[1] = lbm_obstacle_mask.height;
+	}
+
+	//share
+	MPI_Bcast(dims, 2, MPI_INT, RANK_MASTER, lbm_comm_world);
+	if (dims[0] == 0)
+		return;
+	if (rank != RANK_MASTER)
+		lbm_obstacle_mask_alloc(&lbm_obstacle_mask, dims[0], dims[1]);
+	MPI_Bcast(lbm_obstacle_mask.bits, lbm_obstacle_mask_stride(&lbm_obstacle_mask) * dims[1], MPI_BYTE, RANK_MASTER, lbm_comm_world);
+
+	//placement of the obstacle images
+	lbm_obstacle_mask.x = OBSTACLE_X;
+	lbm_obstacle_mask.y = (MESH_HEIGHT - dims[1]) / 2;
+}
+
+/****************************************************/
+/**
+ * Libère le masque de l'obstacle.
+**/
+void lbm_obstacle_release(void)
+{
+	free(lbm_obstacle_mask.bits);
+	memset(&lbm_obstacle_mask, 0, sizeof(lbm_obstacle_mask));
+}
+
+/****************************************************/
+/**
+ * Test pair/impair du point (x,y) dans un polygone.
+**/
+static int lbm_obstacle_in_polygon(const double * points, int nb_points, double x, double y)
+{
+	//vars
+	int k,l;
+	int inside = 0;
+
+	//count crossings of the horizontal half line
+	for ( k = 0, l = nb_points - 1 ; k < nb_points ; l = k++)
+	{
+		double xk = points[2 * k], yk = points[2 * k + 1];
+		double xl = points[2 * l], yl = points[2 * l + 1];
+		if ((yk > y) != (yl > y) && x < (xl - xk) * (y - yk) / (yl - yk) + xk)
+			inside = !inside;
+	}
+
+	return inside;
+}
+
+/****************************************************/
+/**
+ * Indique si le point (x,y) du maillage global (anneau extérieur compris) est dans
+ * l'obstacle, les positions non entières servant aux noeuds du niveau fin (voir
+ * lbm_refine.c). Les formes analytiques sont évaluées au point exact, le masque garde
+ * la résolution de ses mailles. Sans masque ni forme dans la config on garde le cercle
+ * historique (OBSTACLE_X, OBSTACLE_Y, OBSTACLE_R).
+**/
+lbm_obstacle_kind_t lbm_obstacle_test_point(double x, double y)
+{
+	//vars
+	int s;
+	const lbm_obstacle_mask_t * mask = &lbm_obstacle_mask;
+
+	//mask
+	if (mask->bits != NULL) {
+		double mx = x - mask->x;
+		double my = y - mask->y;
+		if (mx > 0 && mx < mask->width && my > 0 && my < mask->height) {
+			int c = (int)mx;
+			int r = mask->height - (int)my;
+			if (mask->bits[r * lbm_obstacle_mask_stride(mask) + c / 8] & (0x80 >> (c % 8)))
+				return LBM_OBSTACLE_MASK;
+		}
+	}
+
+	//circles
+	for ( s = 0 ; s < lbm_gbl_config.nb_obstacle_circles ; s++)
+	{
+		const double * circle = lbm_gbl_config.obstacle_circles[s];
+		if ( ( (x-circle[0]) * (x-circle[0]) ) + ( (y-circle[1]) * (y-circle[1]) ) <= circle[2] * circle[2] )
+			return LBM_OBSTACLE_SHAPE;
+	}
+
+	//polygons
+	for ( s = 0 ; s < lbm_gbl_config.nb_obstacle_polygons ; s++)
+	{
+		const double * bbox = lbm_obstacle_polygon_bbox[s];
+		if (x >= bbox[0] && x <= bbox[2] && y >= bbox[1] && y <= bbox[3]
+		    && lbm_obstacle_in_polygon(lbm_gbl_config.obstacle_polygons[s], lbm_gbl_config.obstacle_polygon_points[s], x, y))
+			return LBM_OBSTACLE_SHAPE;
+	}
+
+	//default circle
+	if (mask->bits == NULL && lbm_gbl_config.nb_obstacle_circles == 0 && lbm_gbl_config.nb_obstacle_polygons == 0)
+		if ( ( (x-OBSTACLE_X) * (x-OBSTACLE_X) ) + ( (y-OBSTACLE_Y) * (y-OBSTACLE_Y) ) <= OBSTACLE_R * OBSTACLE_R )
+			return LBM_OBSTACLE_SHAPE;
+
+	return LBM_OBSTACLE_NONE;
+}
+
+/****************************************************/
+/**
+ * Indique si la maille (x,y) du maillage global (anneau extérieur compris) est dans
+ * l'obstacle.
+**/
+lbm_obstacle_kind_t lbm_obstacle_test(int x, int y)
+{
+	return lbm_obstacle_test_point(x, y);
+}
+
+/****************************************************/
+/**
+ * Marque les mailles solides du sous domaine local (mailles fantômes comprises) en
+ * CELL_BOUNCE_BACK, les colonnes étant réparties entre les threads. Les mailles venant
+ * du masque sont remises au fluide au repos comme le faisait le chargement d'image.
+**/
+void lbm_obstacle_rasterize(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
+{
+	//vars
+	int i,j,z,k;
+
+	//loop on nodes, the 2D shape is extruded along Z with the 3D lattices
+	#pragma omp parallel for schedule(static) private(j,z,k)
+	for ( i = 0 ; i < mesh->width ; i++)
+	{
+		for ( j = 0 ; j < mesh->height ; j++)
+		{
+			switch (lbm_obstacle_test(i + comm->x, j + comm->y))
+			{
+				case LBM_OBSTACLE_NONE:
+					break;
+				case LBM_OBSTACLE_MASK:
+					for ( z = 0 ; z < LBM_MESH_DEPTH(mesh) ; z++)
+					{
+						for ( k = 0 ; k < DIRECTIONS ; k++)
+							LBM_STORE(lbm_mesh_get_cell_3d(mesh, i, j, z),k,equil_weight[k]);
+						*( lbm_cell_type_t_get_cell_3d( mesh_type , i, j, z) ) = CELL_BOUNCE_BACK;
+					}
+					break;
+				case LBM_OBSTACLE_SHAPE:
+					for ( z = 0 ; z < LBM_MESH_DEPTH(mesh) ; z++)
+						*( lbm_cell_type_t_get_cell_3d( mesh_type , i, j, z) ) = CELL_BOUNCE_BACK;
+					break;
+			}
+		}
+	}
+}
@@ -0,0 +1,62 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef LBM_OBSTACLE_H
+#define LBM_OBSTACLE_H
+
+/****************************************************/
+#include <stdint.h>
+#include "lbm_struct.h"
+#include "lbm_comm.h"
+
+/****************************************************/
+/**
+ * Obstacle described by a bitmask, decoded once (image or PBM file) and shared by
+ * all the tasks. Rows are stored from top to bottom as in the source image, with
+ * (width + 7) / 8 bytes per row, most significant bit first and 1 for solid, which
+ * is the layout of a binary PBM (P4) file.
+ * The mask is placed like the obstacle images : column c and row r cover the
+ * global cell (x + c, y + height - r), the first column and row being skipped.
+**/
+typedef struct lbm_obstacle_mask_s
+{
+	/** Number of columns of the mask. **/
+	int width;
+	/** Number of rows of the mask. **/
+	int height;
+	/** Position of the left side in the global mesh (OBSTACLE_X). **/
+	double x;
+	/** Position of the bottom side in the global mesh (centered vertically). **/
+	int y;
+	/** Packed bits, NULL if there is no mask. **/
+	uint8_t * bits;
+} lbm_obstacle_mask_t;
+
+/****************************************************/
+/** Result of the obstacle test on one cell. **/
+typedef enum lbm_obstacle_kind_e
+{
+	/** Fluid cell. **/
+	LBM_OBSTACLE_NONE,
+	/** Inside an analytic shape (circle, polygon). **/
+	LBM_OBSTACLE_SHAPE,
+	/** Inside the mask, the cell state is reset to the fluid at rest. **/
+	LBM_OBSTACLE_MASK
+} lbm_obstacle_kind_t;
+
+/****************************************************/
+void lbm_obstacle_load(void);
+void lbm_obstacle_release(void);
+lbm_obstacle_kind_t lbm_obstacle_test(int x, int y);
+lbm_obstacle_kind_t lbm_obstacle_test_point(double x, double y);
+void lbm_obstacle_rasterize(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
+void lbm_obstacle_mask_read_pbm(lbm_obstacle_mask_t * mask, const char * filename);
+void lbm_obstacle_mask_write_pbm(const lbm_obstacle_mask_t * mask, const char * filename);
+
+#endif //LBM_OBSTACLE_H
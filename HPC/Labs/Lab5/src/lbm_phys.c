@@ -9,6 +9,7 @@
 /****************************************************/
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include "lbm_config.h"
 #include "lbm_struct.h"
 #include "lbm_phys.h"
@@ -16,32 +17,63 @@
 
 /****************************************************/
 /**
- * Definitions des 9 vecteurs de base utilisé pour discrétiser les directions sur chaque mailles.
+ * Definitions des vecteurs de base utilisé pour discrétiser les directions sur chaque mailles,
+ * de leurs poids et de leurs opposés (pour le bounce back). Le réseau est choisi à la
+ * compilation (voir lbm_config.h). Pour les réseaux 3D on garde en tête le repos, les 2D
+ * dans l'ordre D2Q9 puis les directions ayant une composante en Z.
 **/
-#if DIRECTIONS == 9 && DIMENSIONS == 2
+#if defined(LBM_LATTICE_D2Q9) && DIRECTIONS == 9 && DIMENSIONS == 2
 const Vector direction_matrix[DIRECTIONS] = {
 	{+0.0,+0.0},
 	{+1.0,+0.0}, {+0.0,+1.0}, {-1.0,+0.0}, {+0.0,-1.0},
 	{+1.0,+1.0}, {-1.0,+1.0}, {-1.0,-1.0}, {+1.0,-1.0}
 };
-#else
-#error Need to defined adapted direction matrix.
-#endif
-
-/****************************************************/
-/**
- * Poids utilisé pour compenser les différentes de longueur des 9 vecteurs directions.
-**/
-#if DIRECTIONS == 9
 const double equil_weight[DIRECTIONS] = {
 	4.0/9.0 ,
 	1.0/9.0 , 1.0/9.0 , 1.0/9.0 , 1.0/9.0,
 	1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0
 };
-//opposite directions, for bounce back implementation
 const int opposite_of[DIRECTIONS] = { 0, 3, 4, 1, 2, 7, 8, 5, 6 };
+#elif (defined(LBM_LATTICE_D3Q19) && DIRECTIONS == 19 || defined(LBM_LATTICE_D3Q27) && DIRECTIONS == 27) && DIMENSIONS == 3
+const Vector direction_matrix[DIRECTIONS] = {
+	{+0.0,+0.0,+0.0},
+	//faces
+	{+1.0,+0.0,+0.0}, {+0.0,+1.0,+0.0}, {-1.0,+0.0,+0.0}, {+0.0,-1.0,+0.0},
+	{+0.0,+0.0,+1.0}, {+0.0,+0.0,-1.0},
+	//edges
+	{+1.0,+1.0,+0.0}, {-1.0,+1.0,+0.0}, {-1.0,-1.0,+0.0}, {+1.0,-1.0,+0.0},
+	{+1.0,+0.0,+1.0}, {-1.0,+0.0,+1.0}, {-1.0,+0.0,-1.0}, {+1.0,+0.0,-1.0},
+	{+0.0,+1.0,+1.0}, {+0.0,-1.0,+1.0}, {+0.0,-1.0,-1.0}, {+0.0,+1.0,-1.0},
+	#if DIRECTIONS == 27
+	//corners
+	{+1.0,+1.0,+1.0}, {-1.0,+1.0,+1.0}, {-1.0,-1.0,+1.0}, {+1.0,-1.0,+1.0},
+	{+1.0,+1.0,-1.0}, {-1.0,+1.0,-1.0}, {-1.0,-1.0,-1.0}, {+1.0,-1.0,-1.0}
+	#endif
+};
+#if DIRECTIONS == 19
+const double equil_weight[DIRECTIONS] = {
+	1.0/3.0,
+	1.0/18.0, 1.0/18.0, 1.0/18.0, 1.0/18.0, 1.0/18.0, 1.0/18.0,
+	1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0,
+	1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0
+};
+const int opposite_of[DIRECTIONS] = { 0, 3, 4, 1, 2, 6, 5, 9, 10, 7, 8, 13, 14, 11, 12, 17, 18, 15, 16 };
+#else
+const double equil_weight[DIRECTIONS] = {
+	8.0/27.0,
+	2.0/27.0, 2.0/27.0, 2.0/27.0, 2.0/27.0, 2.0/27.0, 2.0/27.0,
+	1.0/54.0, 1.0/54.0, 1.0/54.0, 1.0/54.0, 1.0/54.0, 1.0/54.0,
+	1.0/54.0, 1.0/54.0, 1.0/54.0, 1.0/54.0, 1.0/54.0, 1.0/54.0,
+	1.0/216.0, 1.0/216.0, 1.0/216.0, 1.0/216.0,
+	1.0/216.0, 1.0/216.0, 1.0/216.0, 1.0/216.0
+};
+const int opposite_of[DIRECTIONS] = {
+	0, 3, 4, 1, 2, 6, 5, 9, 10, 7, 8, 13, 14, 11, 12, 17, 18, 15, 16,
+	25, 26, 23, 24, 21, 22, 19, 20
+};
+#endif
 #else
-#error Need to defined adapted equibirium distribution function
+#error Need to defined adapted direction matrix.
 #endif
 
 /****************************************************/
@@ -77,7 +109,7 @@ double lbm_phys_cell_density(const lbm_mesh_cell_t cell)
 
 	//loop on directions
 	for( k = 0 ; k < DIRECTIONS ; k++)
-		res += cell[k];
+		res += LBM_LOAD(cell,k);
 
 	//return res
 	return res;
@@ -106,7 +138,7 @@ void lbm_phys_cell_velocity(Vector v,const lbm_mesh_cell_t cell,double cell_dens
 
 		//sum all directions
 		for ( k = 0 ; k < DIRECTIONS ; k++)
-			v[d] += cell[k] * direction_matrix[k][d];
+			v[d] += LBM_LOAD(cell,k) * direction_matrix[k][d];
 
 		//normalize
 		v[d] = v[d] / cell_density;
@@ -170,10 +202,356 @@ void lbm_phys_cell_collision(lbm_mesh_cell_t cell_out,const lbm_mesh_cell_t cell
 		//compute f at equilibr.
 		feq = lbm_phys_equilibrium_profile(v,density,k);
 		//compute fout
-		cell_out[k] = cell_in[k] - RELAX_PARAMETER * (cell_in[k] - feq);
+		LBM_STORE(cell_out,k,LBM_LOAD(cell_in,k) - RELAX_PARAMETER * (LBM_LOAD(cell_in,k) - feq));
+	}
+}
+
+/****************************************************/
+/**
+ * Densité et vitesse macroscopiques en un seul parcours des directions, pour les noyaux
+ * génériques.
+ * @return La densité de la maille.
+**/
+static inline double lbm_phys_cell_moments_lattice(Vector v, const lbm_real_t * restrict cell)
+{
+	//vars
+	int k,d;
+	double density = 0.0;
+
+	//sum all directions
+	for ( d = 0 ; d < DIMENSIONS ; d++)
+		v[d] = 0.0;
+	for ( k = 0 ; k < DIRECTIONS ; k++)
+	{
+		density += LBM_LOAD(cell,k);
+		for ( d = 0 ; d < DIMENSIONS ; d++)
+			v[d] += LBM_LOAD(cell,k) * direction_matrix[k][d];
+	}
+
+	//normalize
+	for ( d = 0 ; d < DIMENSIONS ; d++)
+		v[d] = v[d] / density;
+
+	return density;
+}
+
+/****************************************************/
+/**
+ * Collision BGK pour les réseaux sans version spécialisée. Le nombre de directions étant
+ * connu à la compilation, les boucles sont déroulées par le compilateur et v*v n'est
+ * calculé qu'une fois par maille.
+ * @param omega Paramètre de relaxation (RELAX_PARAMETER) lu une seule fois par l'appelant.
+**/
+static inline void lbm_phys_cell_collision_bgk_lattice(lbm_real_t * restrict cell_out, const lbm_real_t * restrict cell_in, double omega)
+{
+	//vars
+	int k;
+	double p;
+	Vector v;
+
+	//macroscopic values
+	const double density = lbm_phys_cell_moments_lattice(v, cell_in);
+	const double v2 = (3.0 / 2.0) * lbm_phys_vect_norme_2(v, v);
+
+	//relax to equilibrium
+	for ( k = 0 ; k < DIRECTIONS ; k++)
+	{
+		p = lbm_phys_vect_norme_2(direction_matrix[k], v);
+		LBM_STORE(cell_out,k,LBM_LOAD(cell_in,k) - omega * (LBM_LOAD(cell_in,k) - (1.0 + (3.0 * p) + ((9.0 / 2.0) * p * p) - v2) * equil_weight[k] * density));
+	}
+}
+
+/****************************************************/
+/**
+ * Collision TRT pour une paire de directions opposées (a, b = opposite_of[a]).
+ * @param p Projection e_a * v (b utilise -p).
+ * @param w Poids de la direction multiplié par la densité.
+ * @param base Terme 1 - 3/2 v*v commun à toutes les directions.
+**/
+static inline void lbm_phys_cell_collision_trt_pair(lbm_real_t * restrict cell_out, const lbm_real_t * restrict cell_in, int a, int b, double p, double w, double base, double omega_plus, double omega_minus)
+{
+	const double feq_plus = w * (base + (9.0 / 2.0) * p * p);
+	const double feq_minus = w * 3.0 * p;
+	const double fa = LBM_LOAD(cell_in,a);
+	const double fb = LBM_LOAD(cell_in,b);
+	const double delta_plus = omega_plus * (0.5 * (fa + fb) - feq_plus);
+	const double delta_minus = omega_minus * (0.5 * (fa - fb) - feq_minus);
+	LBM_STORE(cell_out,a,fa - delta_plus - delta_minus);
+	LBM_STORE(cell_out,b,fb - delta_plus + delta_minus);
+}
+
+/****************************************************/
+/**
+ * Collision TRT pour les réseaux sans version spécialisée, par paires de directions
+ * opposées. La direction 0 est le repos dans tous les réseaux.
+**/
+static inline void lbm_phys_cell_collision_trt_lattice(lbm_real_t * restrict cell_out, const lbm_real_t * restrict cell_in, double omega_plus, double omega_minus)
+{
+	//vars
+	int k;
+	Vector v;
+
+	//macroscopic values
+	const double density = lbm_phys_cell_moments_lattice(v, cell_in);
+	const double base = 1.0 - (3.0 / 2.0) * lbm_phys_vect_norme_2(v, v);
+
+	//rest population is purely symmetric
+	LBM_STORE(cell_out,0,LBM_LOAD(cell_in,0) - omega_plus * (LBM_LOAD(cell_in,0) - equil_weight[0] * density * base));
+
+	//pairs of opposite directions, each one done from its first member
+	for ( k = 1 ; k < DIRECTIONS ; k++)
+		if (opposite_of[k] > k)
+			lbm_phys_cell_collision_trt_pair(cell_out, cell_in, k, opposite_of[k], lbm_phys_vect_norme_2(direction_matrix[k], v), equil_weight[k] * density, base, omega_plus, omega_minus);
+}
+
+/****************************************************/
+#if DIRECTIONS == 9 && DIMENSIONS == 2
+/**
+ * Matrice de passage vers l'espace des moments pour le MRT D2Q9 (Lallemand & Luo),
+ * dans l'ordre (rho, e, epsilon, j_x, q_x, j_y, q_y, p_xx, p_xy) et pour l'ordre des
+ * directions de direction_matrix.
+**/
+static const double lbm_phys_mrt_matrix[DIRECTIONS][DIRECTIONS] = {
+	{ +1.0, +1.0, +1.0, +1.0, +1.0, +1.0, +1.0, +1.0, +1.0},
+	{ -4.0, -1.0, -1.0, -1.0, -1.0, +2.0, +2.0, +2.0, +2.0},
+	{ +4.0, -2.0, -2.0, -2.0, -2.0, +1.0, +1.0, +1.0, +1.0},
+	{ +0.0, +1.0, +0.0, -1.0, +0.0, +1.0, -1.0, -1.0, +1.0},
+	{ +0.0, -2.0, +0.0, +2.0, +0.0, +1.0, -1.0, -1.0, +1.0},
+	{ +0.0, +0.0, +1.0, +0.0, -1.0, +1.0, +1.0, -1.0, -1.0},
+	{ +0.0, +0.0, -2.0, +0.0, +2.0, +1.0, +1.0, -1.0, -1.0},
+	{ +0.0, +1.0, -1.0, +1.0, -1.0, +0.0, +0.0, +0.0, +0.0},
+	{ +0.0, +0.0, +0.0, +0.0, +0.0, +1.0, -1.0, +1.0, -1.0}
+};
+
+/****************************************************/
+/**
+ * Inverse de lbm_phys_mrt_matrix. La matrice étant orthogonale il s'agit de sa transposée
+ * divisée par la norme de chacune des lignes.
+**/
+static const double lbm_phys_mrt_matrix_inv[DIRECTIONS][DIRECTIONS] = {
+	{+1.0/9.0, -1.0/9.0,  +1.0/9.0,  +0.0,     +0.0,      +0.0,     +0.0,      +0.0,     +0.0},
+	{+1.0/9.0, -1.0/36.0, -1.0/18.0, +1.0/6.0, -1.0/6.0,  +0.0,     +0.0,      +1.0/4.0, +0.0},
+	{+1.0/9.0, -1.0/36.0, -1.0/18.0, +0.0,     +0.0,      +1.0/6.0, -1.0/6.0,  -1.0/4.0, +0.0},
+	{+1.0/9.0, -1.0/36.0, -1.0/18.0, -1.0/6.0, +1.0/6.0,  +0.0,     +0.0,      +1.0/4.0, +0.0},
+	{+1.0/9.0, -1.0/36.0, -1.0/18.0, +0.0,     +0.0,      -1.0/6.0, +1.0/6.0,  -1.0/4.0, +0.0},
+	{+1.0/9.0, +1.0/18.0, +1.0/36.0, +1.0/6.0, +1.0/12.0, +1.0/6.0, +1.0/12.0, +0.0,     +1.0/4.0},
+	{+1.0/9.0, +1.0/18.0, +1.0/36.0, -1.0/6.0, -1.0/12.0, +1.0/6.0, +1.0/12.0, +0.0,     -1.0/4.0},
+	{+1.0/9.0, +1.0/18.0, +1.0/36.0, -1.0/6.0, -1.0/12.0, -1.0/6.0, -1.0/12.0, +0.0,     +1.0/4.0},
+	{+1.0/9.0, +1.0/18.0, +1.0/36.0, +1.0/6.0, +1.0/12.0, -1.0/6.0, -1.0/12.0, +0.0,     -1.0/4.0}
+};
+
+/****************************************************/
+/**
+ * Version spécialisée D2Q9 de lbm_phys_cell_collision (BGK) : directions déroulées, poids
+ * constants et un seul calcul de v*v. L'ordre des opérations est celui de la version
+ * générique pour fournir des résultats identiques au bit près.
+ * @param stride Distance entre deux directions d'une même cellule (1 pour le stockage du
+ *               maillage, LBM_COLLISION_BLOCK pour un bloc transposé).
+ * @param omega Paramètre de relaxation (RELAX_PARAMETER) lu une seule fois par l'appelant.
+**/
+static inline void lbm_phys_cell_collision_bgk_d2q9(double * restrict cell_out, const double * restrict cell_in, int stride, double omega)
+{
+	//load
+	const double f0 = cell_in[0 * stride];
+	const double f1 = cell_in[1 * stride];
+	const double f2 = cell_in[2 * stride];
+	const double f3 = cell_in[3 * stride];
+	const double f4 = cell_in[4 * stride];
+	const double f5 = cell_in[5 * stride];
+	const double f6 = cell_in[6 * stride];
+	const double f7 = cell_in[7 * stride];
+	const double f8 = cell_in[8 * stride];
+
+	//macroscopic values
+	const double density = 0.0 + f0 + f1 + f2 + f3 + f4 + f5 + f6 + f7 + f8;
+	const double vx = (f1 - f3 + f5 - f6 - f7 + f8) / density;
+	const double vy = (f2 - f4 + f5 + f6 - f7 - f8) / density;
+
+	//terms shared by all directions
+	const double v2 = (3.0 / 2.0) * (vx * vx + vy * vy);
+	const double w0 = (4.0 / 9.0) * density;
+	const double w1 = (1.0 / 9.0) * density;
+	const double w2 = (1.0 / 36.0) * density;
+
+	//projections e_i * v
+	const double p5 = vx + vy;
+	const double p6 = -vx + vy;
+
+	//relax to equilibrium
+	#define LBM_BGK_DIR(k, f, p, w) \
+		cell_out[k * stride] = f - omega * (f - (1.0 + (3.0 * (p)) + ((9.0 / 2.0) * (p) * (p)) - v2) * (w))
+	LBM_BGK_DIR(0, f0, 0.0, w0);
+	LBM_BGK_DIR(1, f1, vx, w1);
+	LBM_BGK_DIR(2, f2, vy, w1);
+	LBM_BGK_DIR(3, f3, -vx, w1);
+	LBM_BGK_DIR(4, f4, -vy, w1);
+	LBM_BGK_DIR(5, f5, p5, w2);
+	LBM_BGK_DIR(6, f6, p6, w2);
+	LBM_BGK_DIR(7, f7, -p5, w2);
+	LBM_BGK_DIR(8, f8, -p6, w2);
+	#undef LBM_BGK_DIR
+}
+
+/****************************************************/
+/**
+ * Applique lbm_phys_cell_collision_bgk_d2q9 sur une maille du maillage. En double le
+ * calcul se fait directement sur le stockage, sinon via une copie locale en double.
+**/
+static inline void lbm_phys_cell_collision_bgk_d2q9_stored(lbm_real_t * restrict cell_out, const lbm_real_t * restrict cell_in, double omega)
+{
+	#if LBM_PRECISION_ID == 0
+		lbm_phys_cell_collision_bgk_d2q9(cell_out, cell_in, 1, omega);
+	#else
+		//vars
+		int k;
+		double f[DIRECTIONS];
+		double out[DIRECTIONS];
+
+		//load, compute, store
+		for ( k = 0 ; k < DIRECTIONS ; k++)
+			f[k] = LBM_LOAD(cell_in, k);
+		lbm_phys_cell_collision_bgk_d2q9(out, f, 1, omega);
+		for ( k = 0 ; k < DIRECTIONS ; k++)
+			LBM_STORE(cell_out, k, out[k]);
+	#endif
+}
+
+/****************************************************/
+/** Nombre de cellules traitées ensemble par la version par blocs des collisions. **/
+#define LBM_COLLISION_BLOCK 8
+
+/****************************************************/
+/**
+ * Applique lbm_phys_cell_collision_bgk_d2q9 sur une colonne de cellules contiguës en
+ * passant par une copie transposée (une ligne par direction) afin que le compilateur
+ * puisse vectoriser le calcul sur les cellules malgré le stockage entrelacé des directions.
+ * @param count Nombre de cellules contiguës à traiter.
+**/
+static void lbm_phys_column_collision_bgk_d2q9(lbm_real_t * restrict cells_out, const lbm_real_t * restrict cells_in, int count, double omega)
+{
+	//vars
+	int c,k,start;
+	double f[DIRECTIONS * LBM_COLLISION_BLOCK];
+	double out[DIRECTIONS * LBM_COLLISION_BLOCK];
+
+	//full blocks
+	for ( start = 0 ; start + LBM_COLLISION_BLOCK <= count ; start += LBM_COLLISION_BLOCK)
+	{
+		//transpose in
+		for ( c = 0 ; c < LBM_COLLISION_BLOCK ; c++)
+			for ( k = 0 ; k < DIRECTIONS ; k++)
+				f[k * LBM_COLLISION_BLOCK + c] = LBM_LOAD(cells_in + (start + c) * DIRECTIONS, k);
+
+		//compute on all cells of the block
+		for ( c = 0 ; c < LBM_COLLISION_BLOCK ; c++)
+			lbm_phys_cell_collision_bgk_d2q9(out + c, f + c, LBM_COLLISION_BLOCK, omega);
+
+		//transpose out
+		for ( c = 0 ; c < LBM_COLLISION_BLOCK ; c++)
+			for ( k = 0 ; k < DIRECTIONS ; k++)
+				LBM_STORE(cells_out + (start + c) * DIRECTIONS, k, out[k * LBM_COLLISION_BLOCK + c]);
 	}
+
+	//remaining cells
+	for ( ; start < count ; start++)
+		lbm_phys_cell_collision_bgk_d2q9_stored(cells_out + start * DIRECTIONS, cells_in + start * DIRECTIONS, omega);
 }
 
+/****************************************************/
+/**
+ * Collision à deux temps de relaxation (TRT) : omega_plus (fixé par la viscosité) sur la
+ * partie symétrique et omega_minus (fixé par le paramètre magique) sur l'anti-symétrique.
+**/
+static inline void lbm_phys_cell_collision_trt_d2q9(lbm_real_t * restrict cell_out, const lbm_real_t * restrict cell_in, double omega_plus, double omega_minus)
+{
+	//load
+	const double f0 = LBM_LOAD(cell_in,0);
+	const double f1 = LBM_LOAD(cell_in,1);
+	const double f2 = LBM_LOAD(cell_in,2);
+	const double f3 = LBM_LOAD(cell_in,3);
+	const double f4 = LBM_LOAD(cell_in,4);
+	const double f5 = LBM_LOAD(cell_in,5);
+	const double f6 = LBM_LOAD(cell_in,6);
+	const double f7 = LBM_LOAD(cell_in,7);
+	const double f8 = LBM_LOAD(cell_in,8);
+
+	//macroscopic values
+	const double density = f0 + f1 + f2 + f3 + f4
+	                     + f5 + f6 + f7 + f8;
+	const double vx = (f1 - f3 + f5 - f6 - f7 + f8) / density;
+	const double vy = (f2 - f4 + f5 + f6 - f7 - f8) / density;
+	const double base = 1.0 - (3.0 / 2.0) * (vx * vx + vy * vy);
+	const double w1 = (1.0 / 9.0) * density;
+	const double w2 = (1.0 / 36.0) * density;
+
+	//rest population is purely symmetric
+	LBM_STORE(cell_out,0,f0 - omega_plus * (f0 - (4.0 / 9.0) * density * base));
+
+	//pairs of opposite directions
+	lbm_phys_cell_collision_trt_pair(cell_out, cell_in, 1, 3, vx, w1, base, omega_plus, omega_minus);
+	lbm_phys_cell_collision_trt_pair(cell_out, cell_in, 2, 4, vy, w1, base, omega_plus, omega_minus);
+	lbm_phys_cell_collision_trt_pair(cell_out, cell_in, 5, 7, vx + vy, w2, base, omega_plus, omega_minus);
+	lbm_phys_cell_collision_trt_pair(cell_out, cell_in, 6, 8, -vx + vy, w2, base, omega_plus, omega_minus);
+}
+
+/****************************************************/
+/**
+ * Collision à temps de relaxation multiples (MRT) : les moments non conservés sont
+ * relaxés vers leur équilibre avec les taux de relax_rates puis ramenés dans l'espace
+ * des vitesses avec la matrice inverse précalculée.
+ * @param relax_rates Taux de relaxation de chaque moment (0 pour les moments conservés).
+**/
+static inline void lbm_phys_cell_collision_mrt_d2q9(lbm_real_t * restrict cell_out, const lbm_real_t * restrict cell_in, const double * restrict relax_rates)
+{
+	//vars
+	int i,k;
+	double f[DIRECTIONS];
+	double moments[DIRECTIONS];
+	double delta[DIRECTIONS];
+	double equilibrium[DIRECTIONS];
+
+	//load
+	for ( k = 0 ; k < DIRECTIONS ; k++)
+		f[k] = LBM_LOAD(cell_in,k);
+
+	//project on moment space
+	for ( i = 0 ; i < DIRECTIONS ; i++)
+	{
+		moments[i] = 0.0;
+		for ( k = 0 ; k < DIRECTIONS ; k++)
+			moments[i] += lbm_phys_mrt_matrix[i][k] * f[k];
+	}
+
+	//equilibrium moments
+	const double density = moments[0];
+	const double jx = moments[3];
+	const double jy = moments[5];
+	const double j2 = (jx * jx + jy * jy) / density;
+	equilibrium[0] = density;
+	equilibrium[1] = -2.0 * density + 3.0 * j2;
+	equilibrium[2] = density - 3.0 * j2;
+	equilibrium[3] = jx;
+	equilibrium[4] = -jx;
+	equilibrium[5] = jy;
+	equilibrium[6] = -jy;
+	equilibrium[7] = (jx * jx - jy * jy) / density;
+	equilibrium[8] = jx * jy / density;
+
+	//relax
+	for ( i = 0 ; i < DIRECTIONS ; i++)
+		delta[i] = relax_rates[i] * (moments[i] - equilibrium[i]);
+
+	//back to velocity space
+	for ( k = 0 ; k < DIRECTIONS ; k++)
+	{
+		double res = f[k];
+		for ( i = 0 ; i < DIRECTIONS ; i++)
+			res -= lbm_phys_mrt_matrix_inv[k][i] * delta[i];
+		LBM_STORE(cell_out,k,res);
+	}
+}
+#endif //DIRECTIONS == 9 && DIMENSIONS == 2
+
 /****************************************************/
 /**
  * Applique une reflexion sur les différentes directions pour simuler la présence d'un solide.
@@ -182,7 +560,7 @@ void lbm_phys_bounce_back(lbm_mesh_cell_t cell)
 {
 	//vars
 	int k;
-	double tmp[DIRECTIONS];
+	lbm_real_t tmp[DIRECTIONS];
 
 	//compute bounce back
 	for ( k = 0 ; k < DIRECTIONS ; k++)
@@ -206,34 +584,54 @@ double lbm_phys_poiseuille(int i,int size)
 	return 4.0 * INFLOW_MAX_VELOCITY / ( L * L ) * ( L * y - y * y );
 }
 
+/****************************************************/
+/**
+ * Fournit la vitesse de poiseuille dans un canal rectangulaire de section height x depth,
+ * produit des deux profils paraboliques, maximale au centre de la section.
+ * @param j Position le long de Y.
+ * @param z Position le long de Z.
+**/
+double lbm_phys_poiseuille_3d(int j,int height,int z,int depth)
+{
+	double zz = (double)(z - 1);
+	double L = (double)(depth - 1);
+	return lbm_phys_poiseuille(j,height) * 4.0 / ( L * L ) * ( L * zz - zz * zz );
+}
+
 /****************************************************/
 /**
  * Applique la méthode de Zou/He pour simler un fluidre entrant dans le domain de gauche vers la droite sur une
- * interface verticale. Le profile de vitesse du fluide entrant suit une distribution de poiseuille.
- * @param mesh Maillage considéré (surtout pour avoir la hauteur.)
+ * interface verticale avec une vitesse donnée.
  * @param cell Maille à mettre à jour.
- * @param id_y Position en y de la cellule pour savoir comment calculer la vitesse de poiseuille.
+ * @param v Vitesse du fluide entrant (sur X, nulle sur Y).
 **/
-void lbm_phys_inflow_zou_he_poiseuille_distr( const lbm_mesh_t * mesh, lbm_mesh_cell_t cell,int id_y)
+void lbm_phys_inflow_zou_he(lbm_mesh_cell_t cell,double v)
 {
 	//vars
-	double v;
 	double density;
 
-	//errors
-	#if DIRECTIONS != 9
-	#error Implemented only for 9 directions
+	#ifndef LBM_LATTICE_D2Q9
+		//generic form : rho from the directions staying on the wall or leaving the
+		//domain, then non-equilibrium bounce back for the directions entering it
+		int k;
+		density = 0.0;
+		for ( k = 0 ; k < DIRECTIONS ; k++)
+			if (direction_matrix[k][0] == 0.0)
+				density += LBM_LOAD(cell,k);
+			else if (direction_matrix[k][0] < 0.0)
+				density += 2 * LBM_LOAD(cell,k);
+		density /= (1.0 - v);
+		for ( k = 0 ; k < DIRECTIONS ; k++)
+			if (direction_matrix[k][0] > 0.0)
+				cell[k] = cell[opposite_of[k]] + 6.0 * equil_weight[k] * density * direction_matrix[k][0] * v;
+		return;
 	#endif
 
-	//set macroscopic fluide info
-	//poiseuille distr on X and null on Y
-	//we just want the norm, so v = v_x
-	v = lbm_phys_poiseuille(id_y,mesh->height);
-
 	//compute rho from u and inner flow on surface
-	density = (cell[0] + cell[2] + cell[4] + 2 * ( cell[3] + cell[6] + cell[7] )) / (1.0 - v) ;
+	density = (LBM_LOAD(cell,0) + LBM_LOAD(cell,2) + LBM_LOAD(cell,4) + 2 * ( LBM_LOAD(cell,3) + LBM_LOAD(cell,6) + LBM_LOAD(cell,7) )) / (1.0 - v) ;
 
-	//now compute unknown microscopic values
+	//now compute unknown microscopic values, from opposite directions only so they
+	//are valid on the stored values (see LBM_LOAD)
 	cell[1] = cell[3];// + (2.0/3.0) * density * v_y <--- no velocity on Y so v_y = 0
 	cell[5] = cell[7] - (1.0/2.0) * (cell[2] - cell[4])
 	                         + (1.0/6.0) * (density * v);
@@ -245,6 +643,21 @@ void lbm_phys_inflow_zou_he_poiseuille_distr( const lbm_mesh_t * mesh, lbm_mesh_
 	//no need to copy already known one as the value will be "loss" in the wall at propagatation time
 }
 
+/****************************************************/
+/**
+ * Applique la méthode de Zou/He pour simler un fluidre entrant dans le domain de gauche vers la droite sur une
+ * interface verticale. Le profile de vitesse du fluide entrant suit une distribution de poiseuille.
+ * @param mesh Maillage considéré (surtout pour avoir la hauteur.)
+ * @param cell Maille à mettre à jour.
+ * @param id_y Position en y de la cellule pour savoir comment calculer la vitesse de poiseuille.
+**/
+void lbm_phys_inflow_zou_he_poiseuille_distr( const lbm_mesh_t * mesh, lbm_mesh_cell_t cell,int id_y)
+{
+	//poiseuille distr on X and null on Y
+	//we just want the norm, so v = v_x
+	lbm_phys_inflow_zou_he(cell, lbm_phys_poiseuille(id_y,mesh->height));
+}
+
 /****************************************************/
 /**
  * Applique la méthode de Zou/He pour simler un fluidre sortant du domain de gauche vers la droite sur une
@@ -260,15 +673,27 @@ void lbm_phys_outflow_zou_he_const_density(lbm_mesh_cell_t cell)
 	const double density = 1.0;
 	double v;
 
-	//errors
-	#if DIRECTIONS != 9
-	#error Implemented only for 9 directions
+	#ifndef LBM_LATTICE_D2Q9
+		//generic form : v from the directions staying on the wall or leaving the
+		//domain, then non-equilibrium bounce back for the directions entering it
+		int k;
+		v = -1.0;
+		for ( k = 0 ; k < DIRECTIONS ; k++)
+			if (direction_matrix[k][0] == 0.0)
+				v += LBM_LOAD(cell,k) / density;
+			else if (direction_matrix[k][0] > 0.0)
+				v += 2 * LBM_LOAD(cell,k) / density;
+		for ( k = 0 ; k < DIRECTIONS ; k++)
+			if (direction_matrix[k][0] < 0.0)
+				cell[k] = cell[opposite_of[k]] + 6.0 * equil_weight[k] * density * direction_matrix[k][0] * v;
+		return;
 	#endif
 
 	//compute macroscopic v depeding on inner flow going onto the wall
-	v = -1.0 + (1.0 / density) * (cell[0] + cell[2] + cell[4] + 2 * (cell[1] + cell[5] + cell[8]));
+	v = -1.0 + (1.0 / density) * (LBM_LOAD(cell,0) + LBM_LOAD(cell,2) + LBM_LOAD(cell,4) + 2 * (LBM_LOAD(cell,1) + LBM_LOAD(cell,5) + LBM_LOAD(cell,8)));
 
-	//now can compute unknown microscopic values
+	//now can compute unknown microscopic values, from opposite directions only so they
+	//are valid on the stored values (see LBM_LOAD)
 	cell[3] = cell[1] - (2.0/3.0) * density * v;
 	cell[7] = cell[5] + (1.0/2.0) * (cell[2] - cell[4])
 	                       //- (1.0/2.0) * (density * v_y)    <--- no velocity on Y so v_y = 0
@@ -279,78 +704,295 @@ void lbm_phys_outflow_zou_he_const_density(lbm_mesh_cell_t cell)
 }
 
 /****************************************************/
-void lbm_phys_special_cells_one_cell(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm,int i,int j)
+/**
+ * Construit les listes de mailles de bord par type, le masque des mailles solides et
+ * précalcule le profil de vitesse entrant pour chaque ligne du maillage local. Doit être
+ * appelé une fois les types des mailles connus (initialisation ou reprise) et à chaque
+ * changement de géométrie, les pas de temps ne lisent plus la carte des types.
+ * @param mesh_type Types des mailles, reçoit les listes.
+ * @param comm Position du sous domaine local pour le profil de Poiseuille.
+**/
+void lbm_phys_boundary_build(lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
 {
-	switch (*( lbm_cell_type_t_get_cell( mesh_type , i, j) ))
+	//vars
+	int i,j,z,pass;
+	int width = mesh_type->width;
+	int height = mesh_type->height;
+	int depth = LBM_MESH_DEPTH(mesh_type);
+
+	//rebuild
+	if (mesh_type->boundary != NULL)
+		lbm_phys_boundary_release(mesh_type);
+
+	//allocate
+	lbm_boundary_t * boundary = calloc(1, sizeof(lbm_boundary_t));
+	if (boundary == NULL)
+		fatal("Fail to allocate the boundary lists !");
+
+	//inflow profile, one value per line, on the height of the global mesh with its
+	//outer ring so a split along Y gives the same profile as a single task
+	boundary->inflow_profile = malloc(sizeof(double) * height);
+	for ( j = 0 ; j < height ; j++)
+		boundary->inflow_profile[j] = lbm_phys_poiseuille(j + comm->y, MESH_HEIGHT + 2);
+
+	//first pass count, second pass fill, both in memory order
+	for ( pass = 0 ; pass < 2 ; pass++)
 	{
-		case CELL_FUILD:
-			break;
-		case CELL_BOUNCE_BACK:
-			lbm_phys_bounce_back(lbm_mesh_get_cell(mesh, i, j));
-			break;
-		case CELL_LEFT_IN:
-			lbm_phys_inflow_zou_he_poiseuille_distr(mesh, lbm_mesh_get_cell(mesh, i, j) ,j + comm->y);
-			break;
-		case CELL_RIGHT_OUT:
-			lbm_phys_outflow_zou_he_const_density(lbm_mesh_get_cell(mesh, i, j));
-			break;
+		if (pass == 1) {
+			boundary->bounce_back = malloc(sizeof(int) * boundary->nb_bounce_back);
+			boundary->inflow = malloc(sizeof(int) * boundary->nb_inflow);
+			boundary->inflow_velocity = malloc(sizeof(double) * boundary->nb_inflow);
+			boundary->outflow = malloc(sizeof(int) * boundary->nb_outflow);
+			if (boundary->inflow_profile == NULL || boundary->bounce_back == NULL || boundary->inflow == NULL
+			    || boundary->inflow_velocity == NULL || boundary->outflow == NULL)
+				fatal("Fail to allocate the boundary lists !");
+			boundary->nb_bounce_back = 0;
+			boundary->nb_inflow = 0;
+			boundary->nb_outflow = 0;
+			memset(mesh_type->solid, 0, sizeof(uint64_t) * (((size_t)width * height * depth + 63) / 64));
+		}
+
+		for ( i = 0 ; i < width ; i++)
+		{
+			for ( j = 0 ; j < height ; j++)
+			{
+				for ( z = 0 ; z < depth ; z++)
+				{
+					int pos = (i * height + j) * depth + z;
+					switch (*lbm_cell_type_t_get_cell_3d(mesh_type, i, j, z))
+					{
+						case CELL_BOUNCE_BACK:
+							if (pass == 1) {
+								boundary->bounce_back[boundary->nb_bounce_back] = pos;
+								mesh_type->solid[pos / 64] |= (uint64_t)1 << (pos % 64);
+							}
+							boundary->nb_bounce_back++;
+							break;
+						case CELL_LEFT_IN:
+							if (pass == 1) {
+								boundary->inflow[boundary->nb_inflow] = pos;
+								boundary->inflow_velocity[boundary->nb_inflow] = boundary->inflow_profile[j];
+							}
+							boundary->nb_inflow++;
+							break;
+						case CELL_RIGHT_OUT:
+							if (pass == 1)
+								boundary->outflow[boundary->nb_outflow] = pos;
+							boundary->nb_outflow++;
+							break;
+						default:
+							break;
+					}
+				}
+			}
+		}
 	}
+
+	//attach
+	mesh_type->boundary = boundary;
+}
+
+/****************************************************/
+/**
+ * Libère les listes de mailles de bord.
+**/
+void lbm_phys_boundary_release(lbm_mesh_type_t * mesh_type)
+{
+	//nothing to do
+	if (mesh_type->boundary == NULL)
+		return;
+
+	//free
+	free(mesh_type->boundary->inflow_profile);
+	free(mesh_type->boundary->bounce_back);
+	free(mesh_type->boundary->inflow);
+	free(mesh_type->boundary->inflow_velocity);
+	free(mesh_type->boundary->outflow);
+	free(mesh_type->boundary);
+	mesh_type->boundary = NULL;
 }
 
 /****************************************************/
 /**
  * Applique les actions spéciale liée aux conditions de bords ou au réflexions sur l'obstacle.
+ * Chaque condition est une boucle sans branchement sur sa liste de mailles (voir
+ * lbm_phys_boundary_build()), les mailles d'une liste étant indépendantes entre elles.
 **/
 void lbm_phys_special_cells(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
 {
 	//vars
-	int i,j;
+	int c;
+	const lbm_boundary_t * boundary = mesh_type->boundary;
 
-	//loop on all inner cells
-	for( i = 0 ; i < mesh->width ; i++ )
-		for( j = 0 ; j < mesh->height  ; j++)
-			lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,i,j);
+	//errors
+	assert(boundary != NULL);
+
+	//obstacle and walls
+	#pragma omp for schedule(static)
+	for ( c = 0 ; c < boundary->nb_bounce_back ; c++)
+		lbm_phys_bounce_back(mesh->cells + (size_t)boundary->bounce_back[c] * DIRECTIONS);
+
+	//input wall
+	#pragma omp for schedule(static)
+	for ( c = 0 ; c < boundary->nb_inflow ; c++)
+		lbm_phys_inflow_zou_he(mesh->cells + (size_t)boundary->inflow[c] * DIRECTIONS, boundary->inflow_velocity[c]);
+
+	//output wall
+	#pragma omp for schedule(static)
+	for ( c = 0 ; c < boundary->nb_outflow ; c++)
+		lbm_phys_outflow_zou_he_const_density(mesh->cells + (size_t)boundary->outflow[c] * DIRECTIONS);
 }
 
 /****************************************************/
 /**
- * Applique les actions spéciale liée aux conditions de bords ou au réflexions sur l'obstacle.
+ * Calcule les collision sur une zone rectangulaire du maillage. Le choix du modèle de
+ * collision et la lecture des paramètres globaux sont faits une seule fois, hors des boucles.
+ * @param x_start Première colonne (incluse).
+ * @param x_end Dernière colonne (exclue).
+ * @param y_start Première ligne (incluse).
+ * @param y_end Dernière ligne (exclue).
 **/
-void lbm_phys_special_cells_inner(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
+void lbm_phys_collision_region(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in,int x_start,int x_end,int y_start,int y_end)
 {
 	//vars
 	int i,j;
 
-	//loop on all inner cells
-	for( i = 1 ; i < mesh->width - 1 ; i++ )
-		for( j = 1 ; j < mesh->height - 1 ; j++)
-			lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,i,j);
+	//errors
+	assert(mesh_in->width == mesh_out->width);
+	assert(mesh_in->height == mesh_out->height);
+	assert(x_start >= 0 && x_end <= mesh_in->width);
+	assert(y_start >= 0 && y_end <= mesh_in->height);
+
+	#if DIRECTIONS == 9 && DIMENSIONS == 2
+		//load params once
+		const double omega = RELAX_PARAMETER;
+		const double omega_minus = lbm_gbl_config.trt_relax_minus;
+		const double relax_rates[DIRECTIONS] = {
+			0.0, lbm_gbl_config.mrt_s_e, lbm_gbl_config.mrt_s_eps,
+			0.0, lbm_gbl_config.mrt_s_q, 0.0, lbm_gbl_config.mrt_s_q,
+			omega, omega
+		};
+
+		//loop on cells with the selected operator
+		switch (COLLISION_MODEL)
+		{
+			case LBM_COLLISION_BGK:
+				//columns are contiguous in memory, work on them by blocks
+				#pragma omp for schedule(static)
+				for( i = x_start ; i < x_end ; i++ )
+					lbm_phys_column_collision_bgk_d2q9(lbm_mesh_get_cell(mesh_out, i, y_start),lbm_mesh_get_cell(mesh_in, i, y_start),y_end - y_start,omega);
+				break;
+			case LBM_COLLISION_TRT:
+				#pragma omp for schedule(static) private(j)
+				for( i = x_start ; i < x_end ; i++ )
+					for( j = y_start ; j < y_end ; j++)
+						lbm_phys_cell_collision_trt_d2q9(lbm_mesh_get_cell(mesh_out, i, j),lbm_mesh_get_cell(mesh_in, i, j),omega,omega_minus);
+				break;
+			case LBM_COLLISION_MRT:
+				#pragma omp for schedule(static) private(j)
+				for( i = x_start ; i < x_end ; i++ )
+					for( j = y_start ; j < y_end ; j++)
+						lbm_phys_cell_collision_mrt_d2q9(lbm_mesh_get_cell(mesh_out, i, j),lbm_mesh_get_cell(mesh_in, i, j),relax_rates);
+				break;
+		}
+	#else
+		//load params once
+		const double omega = RELAX_PARAMETER;
+		const double omega_minus = lbm_gbl_config.trt_relax_minus;
+		const int depth = LBM_MESH_DEPTH(mesh_in);
+		int z;
+
+		//loop on cells with the selected operator, the whole depth of each column
+		switch (COLLISION_MODEL)
+		{
+			case LBM_COLLISION_BGK:
+				#pragma omp for schedule(static) private(j,z)
+				for( i = x_start ; i < x_end ; i++ )
+					for( j = y_start ; j < y_end ; j++)
+						for( z = 0 ; z < depth ; z++)
+							lbm_phys_cell_collision_bgk_lattice(lbm_mesh_get_cell_3d(mesh_out, i, j, z),lbm_mesh_get_cell_3d(mesh_in, i, j, z),omega);
+				break;
+			case LBM_COLLISION_TRT:
+				#pragma omp for schedule(static) private(j,z)
+				for( i = x_start ; i < x_end ; i++ )
+					for( j = y_start ; j < y_end ; j++)
+						for( z = 0 ; z < depth ; z++)
+							lbm_phys_cell_collision_trt_lattice(lbm_mesh_get_cell_3d(mesh_out, i, j, z),lbm_mesh_get_cell_3d(mesh_in, i, j, z),omega,omega_minus);
+				break;
+			case LBM_COLLISION_MRT:
+				fatal("MRT collision is implemented only for D2Q9 !");
+				break;
+		}
+	#endif
 }
 
 /****************************************************/
 /**
- * Applique les actions spéciale liée aux conditions de bords ou au réflexions sur l'obstacle.
+ * Calcule les collision sur une liste de mailles (adressage indirect du mode creux).
+ * @param cells Position des mailles dans le maillage (x * height + y).
+ * @param count Nombre de mailles de la liste.
 **/
-void lbm_phys_special_cells_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
+void lbm_phys_collision_list(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in,const int * cells,int count)
 {
 	//vars
-	int i,j;
-
-	//top
-	for ( i = 0 ; i < mesh->width; i++)
-		lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,i,0);
+	int c;
 
-	//bottom
-	for ( i = 0 ; i < mesh->width; i++)
-		lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,i,mesh->height - 1);
-
-	//left
-	for ( j = 0 ; j < mesh->height ; j++)
-		lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,0,j);
+	//errors
+	assert(mesh_in->width == mesh_out->width);
+	assert(mesh_in->height == mesh_out->height);
 
-	//right
-	for ( j = 0 ; j < mesh->height ; j++)
-		lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,mesh->width - 1,j);
+	#if DIRECTIONS == 9 && DIMENSIONS == 2
+		//load params once
+		const double omega = RELAX_PARAMETER;
+		const double omega_minus = lbm_gbl_config.trt_relax_minus;
+		const double relax_rates[DIRECTIONS] = {
+			0.0, lbm_gbl_config.mrt_s_e, lbm_gbl_config.mrt_s_eps,
+			0.0, lbm_gbl_config.mrt_s_q, 0.0, lbm_gbl_config.mrt_s_q,
+			omega, omega
+		};
+
+		//loop on cells with the selected operator
+		switch (COLLISION_MODEL)
+		{
+			case LBM_COLLISION_BGK:
+				#pragma omp for schedule(static)
+				for( c = 0 ; c < count ; c++ )
+					lbm_phys_cell_collision_bgk_d2q9_stored(mesh_out->cells + (size_t)cells[c] * DIRECTIONS,mesh_in->cells + (size_t)cells[c] * DIRECTIONS,omega);
+				break;
+			case LBM_COLLISION_TRT:
+				#pragma omp for schedule(static)
+				for( c = 0 ; c < count ; c++ )
+					lbm_phys_cell_collision_trt_d2q9(mesh_out->cells + (size_t)cells[c] * DIRECTIONS,mesh_in->cells + (size_t)cells[c] * DIRECTIONS,omega,omega_minus);
+				break;
+			case LBM_COLLISION_MRT:
+				#pragma omp for schedule(static)
+				for( c = 0 ; c < count ; c++ )
+					lbm_phys_cell_collision_mrt_d2q9(mesh_out->cells + (size_t)cells[c] * DIRECTIONS,mesh_in->cells + (size_t)cells[c] * DIRECTIONS,relax_rates);
+				break;
+		}
+	#else
+		//load params once
+		const double omega = RELAX_PARAMETER;
+		const double omega_minus = lbm_gbl_config.trt_relax_minus;
+
+		//loop on cells with the selected operator
+		switch (COLLISION_MODEL)
+		{
+			case LBM_COLLISION_BGK:
+				#pragma omp for schedule(static)
+				for( c = 0 ; c < count ; c++ )
+					lbm_phys_cell_collision_bgk_lattice(mesh_out->cells + (size_t)cells[c] * DIRECTIONS,mesh_in->cells + (size_t)cells[c] * DIRECTIONS,omega);
+				break;
+			case LBM_COLLISION_TRT:
+				#pragma omp for schedule(static)
+				for( c = 0 ; c < count ; c++ )
+					lbm_phys_cell_collision_trt_lattice(mesh_out->cells + (size_t)cells[c] * DIRECTIONS,mesh_in->cells + (size_t)cells[c] * DIRECTIONS,omega,omega_minus);
+				break;
+			case LBM_COLLISION_MRT:
+				fatal("MRT collision is implemented only for D2Q9 !");
+				break;
+		}
+	#endif
 }
 
 /****************************************************/
@@ -360,18 +1002,9 @@ void lbm_phys_special_cells_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_typ
 **/
 void lbm_phys_collision(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
 {
-	//vars
-	int i,j;
-
-	//errors
-	assert(mesh_in->width == mesh_out->width);
-	assert(mesh_in->height == mesh_out->height);
-
 	//loop on all inner cells
 	//to avoid reflexion of first shock wave : i = 1
-	for( i = 0 ; i < mesh_in->width ; i++ )
-		for( j = 0 ; j < mesh_in->height ; j++)
-			lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, i, j),lbm_mesh_get_cell(mesh_in, i, j));
+	lbm_phys_collision_region(mesh_out, mesh_in, 0, mesh_in->width, 0, mesh_in->height);
 }
 
 /****************************************************/
@@ -381,18 +1014,8 @@ void lbm_phys_collision(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
 **/
 void lbm_phys_collision_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
 {
-	//vars
-	int i,j;
-
-	//errors
-	assert(mesh_in->width == mesh_out->width);
-	assert(mesh_in->height == mesh_out->height);
-
 	//loop on all inner cells
-	//to avoid reflexion of first shock wave : i = 1
-	for( i = 1 ; i < mesh_in->width - 1 ; i++ )
-		for( j = 1 ; j < mesh_in->height - 1 ; j++)
-			lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, i, j),lbm_mesh_get_cell(mesh_in, i, j));
+	lbm_phys_collision_region(mesh_out, mesh_in, 1, mesh_in->width - 1, 1, mesh_in->height - 1);
 }
 
 /****************************************************/
@@ -402,45 +1025,47 @@ void lbm_phys_collision_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
 **/
 void lbm_phys_collision_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
 {
-	//vars
-	int i,j;
-
-	//errors
-	assert(mesh_in->width == mesh_out->width);
-	assert(mesh_in->height == mesh_out->height);
-
 	//top
-	for ( i = 0 ; i < mesh_out->width; i++)
-		lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, i, 0),lbm_mesh_get_cell(mesh_in, i, 0));
+	lbm_phys_collision_region(mesh_out, mesh_in, 0, mesh_out->width, 0, 1);
 
 	//bottom
-	for ( i = 0 ; i < mesh_out->width; i++)
-		lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, i, mesh_out->height - 1),lbm_mesh_get_cell(mesh_in, i, mesh_out->height - 1));
+	lbm_phys_collision_region(mesh_out, mesh_in, 0, mesh_out->width, mesh_out->height - 1, mesh_out->height);
 
 	//left
-	for ( j = 0 ; j < mesh_out->height ; j++)
-		lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, 0, j),lbm_mesh_get_cell(mesh_in, 0, j));
+	lbm_phys_collision_region(mesh_out, mesh_in, 0, 1, 0, mesh_out->height);
 
 	//right
-	for ( j = 0 ; j < mesh_out->height ; j++)
-		lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, mesh_out->width - 1, j),lbm_mesh_get_cell(mesh_in, mesh_out->width - 1, j));
+	lbm_phys_collision_region(mesh_out, mesh_in, mesh_out->width - 1, mesh_out->width, 0, mesh_out->height);
 }
 
 /****************************************************/
+/**
+ * Propagation depuis la maille (i,j), soit toute la colonne le long de Z avec les réseaux 3D.
+**/
 void lbm_phys_propagation_one_cell(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in,int i, int j)
 {
-	int k;
-	int ii,jj;
+	int k,z;
+	int ii,jj,zz;
+	const int depth = LBM_MESH_DEPTH(mesh_out);
 
-	//for all direction
-	for ( k  = 0 ; k < DIRECTIONS ; k++)
+	//for all cells of the column
+	for ( z = 0 ; z < depth ; z++)
 	{
-		//compute destination point
-		ii = (i + direction_matrix[k][0]);
-		jj = (j + direction_matrix[k][1]);
-		//propagate to neighboor nodes
-		if ((ii >= 0 && ii < mesh_out->width) && (jj >= 0 && jj < mesh_out->height))
-			lbm_mesh_get_cell(mesh_out, ii, jj)[k] = lbm_mesh_get_cell(mesh_in, i, j)[k];
+		//for all direction
+		for ( k  = 0 ; k < DIRECTIONS ; k++)
+		{
+			//compute destination point
+			ii = (i + direction_matrix[k][0]);
+			jj = (j + direction_matrix[k][1]);
+			#if DIMENSIONS == 3
+				zz = (z + direction_matrix[k][2]);
+			#else
+				zz = z;
+			#endif
+			//propagate to neighboor nodes
+			if ((ii >= 0 && ii < mesh_out->width) && (jj >= 0 && jj < mesh_out->height) && (zz >= 0 && zz < depth))
+				lbm_mesh_get_cell_3d(mesh_out, ii, jj, zz)[k] = lbm_mesh_get_cell_3d(mesh_in, i, j, z)[k];
+		}
 	}
 }
 
@@ -456,11 +1081,36 @@ void lbm_phys_propagation(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
 	int i,j;
 
 	//loop on all cells
+	#pragma omp for schedule(static) private(j)
 	for ( i = 0 ; i < mesh_out->width; i++)
 		for ( j = 0 ; j < mesh_out->height ; j++)
 			lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,j);
 }
 
+/****************************************************/
+/**
+ * lbm_phys_propagation des densité depuis les mailles de la zone [x_start,x_end[ x [y_start,y_end[
+ * vers leurs voisines. Chaque densité destination n'ayant qu'une seule source, plusieurs zones
+ * disjointes peuvent être traitées dans n'importe quel ordre.
+ * @param mesh_out Maillage de sortie.
+ * @param mesh_in Maillage d'entrée (ne doivent pas être les mêmes).
+**/
+void lbm_phys_propagation_region(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in,int x_start,int x_end,int y_start,int y_end)
+{
+	//vars
+	int i,j;
+
+	//errors
+	assert(x_start >= 0 && x_end <= mesh_in->width);
+	assert(y_start >= 0 && y_end <= mesh_in->height);
+
+	//loop on all cells of the region
+	#pragma omp for schedule(static) private(j)
+	for ( i = x_start ; i < x_end; i++)
+		for ( j = y_start ; j < y_end ; j++)
+			lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,j);
+}
+
 /****************************************************/
 /**
  * lbm_phys_propagation des densité vers les maillse voisines.
@@ -473,6 +1123,7 @@ void lbm_phys_propagation_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in
 	int i,j;
 
 	//loop on all cells
+	#pragma omp for schedule(static) private(j)
 	for ( i = 1 ; i < mesh_out->width - 1; i++)
 		for ( j = 1 ; j < mesh_out->height - 1; j++)
 			lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,j);
@@ -490,15 +1141,19 @@ void lbm_phys_propagation_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_i
 	int i,j;
 
 	//loop on all cells
+	#pragma omp for schedule(static)
 	for ( i = 0 ; i < mesh_out->width; i++)
 		lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,0);
 
+	#pragma omp for schedule(static)
 	for ( i = 0 ; i < mesh_out->width; i++)
 		lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,mesh_out->height - 1);
 
+	#pragma omp for schedule(static)
 	for ( j = 0 ; j < mesh_out->height ; j++)
 		lbm_phys_propagation_one_cell(mesh_out,mesh_in,0,j);
 
+	#pragma omp for schedule(static)
 	for ( j = 0 ; j < mesh_out->height ; j++)
 		lbm_phys_propagation_one_cell(mesh_out,mesh_in,mesh_out->width - 1,j);
 }
@@ -14,38 +14,88 @@
 #include "lbm_struct.h"
 #include "lbm_comm.h"
 
+/****************************************************/
+/**
+ * Boundary cells of the local mesh grouped by kind, so each condition is applied by
+ * a plain loop over a contiguous list of positions ((x * height + y) * depth + z) instead of
+ * dispatching on the type of every cell.
+**/
+typedef struct lbm_boundary_s
+{
+	/** Velocity of the Poiseuille inflow for each line of the local mesh (height entries). **/
+	double * inflow_profile;
+	/** Number of bounce back cells (obstacle and walls). **/
+	int nb_bounce_back;
+	/** Bounce back cells. **/
+	int * bounce_back;
+	/** Number of Zou/He inflow cells. **/
+	int nb_inflow;
+	/** Zou/He inflow cells. **/
+	int * inflow;
+	/** Inflow velocity of each inflow cell, taken from inflow_profile. **/
+	double * inflow_velocity;
+	/** Number of Zou/He outflow cells. **/
+	int nb_outflow;
+	/** Zou/He outflow cells. **/
+	int * outflow;
+} lbm_boundary_t;
+
 /****************************************************/
 extern const int opposite_of[DIRECTIONS];
 extern const double equil_weight[DIRECTIONS];
 extern const Vector direction_matrix[DIRECTIONS];
 
+/****************************************************/
+/**
+ * Access to the stored microscopic densities, the computations always use doubles.
+ * In mixed precision a cell stores f_k - equil_weight[k] so the float keeps its
+ * digits for the small deviation from the rest state. As opposite directions share
+ * the same weight, raw copies (propagation, bounce back, exchanges) and differences
+ * of opposite directions stay valid on the stored values.
+**/
+#if LBM_PRECISION_ID == 2
+	#define LBM_LOAD(cell,k) ((double)(cell)[k] + equil_weight[k])
+	#define LBM_STORE(cell,k,value) ((cell)[k] = (lbm_real_t)((value) - equil_weight[k]))
+#else
+	#define LBM_LOAD(cell,k) ((double)(cell)[k])
+	#define LBM_STORE(cell,k,value) ((cell)[k] = (lbm_real_t)(value))
+#endif
+
 /****************************************************/
 //helper
 double lbm_phys_vect_norme_2(const Vector vect1,const Vector vect2);
 double lbm_phys_cell_density(const lbm_mesh_cell_t cell);
 void lbm_phys_cell_velocity(Vector v,const lbm_mesh_cell_t cell,double cell_density);
 double lbm_phys_poiseuille(int i,int size);
+double lbm_phys_poiseuille_3d(int j,int height,int z,int depth);
 
 /****************************************************/
 //collistion
 double lbm_phys_equilibrium_profile(Vector velocity,double density,int direction);
-void lbm_phys_cell_lbm_phys_collision(lbm_mesh_cell_t cell_out,const lbm_mesh_cell_t cell_in);
+void lbm_phys_cell_collision(lbm_mesh_cell_t cell_out,const lbm_mesh_cell_t cell_in);
 
 /****************************************************/
 //limit conditions
 void lbm_phys_bounce_back(lbm_mesh_cell_t cell);
+void lbm_phys_inflow_zou_he(lbm_mesh_cell_t cell,double v);
 void lbm_phys_inflow_zou_he_poiseuille_distr( const lbm_mesh_t * mesh, lbm_mesh_cell_t cell,int id_y);
 void lbm_phys_outflow_zou_he_const_density(lbm_mesh_cell_t mesh);
 
+/****************************************************/
+//boundary lists
+void lbm_phys_boundary_build(lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
+void lbm_phys_boundary_release(lbm_mesh_type_t * mesh_type);
+
 /****************************************************/
 //main functions
 void lbm_phys_special_cells(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
-void lbm_phys_special_cells_inner(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * mesh_comm);
-void lbm_phys_special_cells_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * mesh_comm);
 void lbm_phys_collision(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
+void lbm_phys_collision_region(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in,int x_start,int x_end,int y_start,int y_end);
+void lbm_phys_collision_list(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in,const int * cells,int count);
 void lbm_phys_collision_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
 void lbm_phys_collision_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
 void lbm_phys_propagation(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
+void lbm_phys_propagation_region(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in,int x_start,int x_end,int y_start,int y_end);
 void lbm_phys_propagation_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
 void lbm_phys_propagation_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
 
@@ -0,0 +1,626 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "lbm_refine.h"
+#include "lbm_config.h"
+#include "lbm_phys.h"
+#include "lbm_obstacle.h"
+#include "lbm_timer.h"
+
+/****************************************************/
+/** Zones décrivant la part du patch d'une tâche : noeuds possédés puis avec la couche fantôme. **/
+#define LBM_REFINE_AREAS 8
+
+/****************************************************/
+static inline int lbm_refine_min(int a, int b)
+{
+	return (a < b) ? a : b;
+}
+
+/****************************************************/
+static inline int lbm_refine_max(int a, int b)
+{
+	return (a > b) ? a : b;
+}
+
+/****************************************************/
+/**
+ * Position du noeud fin (i,j) du patch dans les maillages fins locaux.
+**/
+static inline int lbm_refine_pos(const lbm_refine_t * refine, int i, int j)
+{
+	return (i - refine->x) * refine->mesh.height + (j - refine->y);
+}
+
+/****************************************************/
+/**
+ * Écrit dans une maille la distribution f en multipliant sa partie hors équilibre par
+ * factor, la densité et la vitesse étant conservées. C'est le changement de niveau :
+ * à viscosité égale la partie hors équilibre est proportionnelle à tau * dt.
+**/
+static void lbm_refine_rescale(lbm_real_t * cell, const double * f, double factor)
+{
+	//vars
+	int k, d;
+	double density = 0.0;
+	Vector v;
+
+	//macroscopic values
+	for ( k = 0 ; k < DIRECTIONS ; k++)
+		density += f[k];
+	for ( d = 0 ; d < DIMENSIONS ; d++)
+	{
+		v[d] = 0.0;
+		for ( k = 0 ; k < DIRECTIONS ; k++)
+			v[d] += f[k] * direction_matrix[k][d];
+		v[d] /= density;
+	}
+
+	//keep the equilibrium, scale the rest
+	for ( k = 0 ; k < DIRECTIONS ; k++)
+	{
+		double feq = lbm_phys_equilibrium_profile(v, density, k);
+		LBM_STORE(cell, k, feq + factor * (f[k] - feq));
+	}
+}
+
+/****************************************************/
+/**
+ * Moyenne de deux mailles, faite sur les valeurs stockées (linéaire, y compris en
+ * précision mixte car les deux mailles portent le même décalage).
+**/
+static inline void lbm_refine_average(lbm_real_t * cell, const lbm_real_t * a, const lbm_real_t * b)
+{
+	int k;
+	for ( k = 0 ; k < DIRECTIONS ; k++)
+		cell[k] = (lbm_real_t)(0.5 * ((double)a[k] + (double)b[k]));
+}
+
+/****************************************************/
+/**
+ * Construit le type sélectionnant dans le maillage fin local l'intersection de deux
+ * zones du patch, retourne 0 si elle est vide.
+**/
+static int lbm_refine_area_type(MPI_Datatype * type, const lbm_refine_t * refine, const int a[4], const int b[4])
+{
+	//intersection
+	int x_start = lbm_refine_max(a[0], b[0]);
+	int x_end = lbm_refine_min(a[1], b[1]);
+	int y_start = lbm_refine_max(a[2], b[2]);
+	int y_end = lbm_refine_min(a[3], b[3]);
+	if (x_start >= x_end || y_start >= y_end)
+		return 0;
+
+	//sub-array of the local fine mesh, x major
+	MPI_Datatype cell_type;
+	int sizes[2] = {refine->mesh.width, refine->mesh.height};
+	int subsizes[2] = {x_end - x_start, y_end - y_start};
+	int starts[2] = {x_start - refine->x, y_start - refine->y};
+	MPI_Type_contiguous(DIRECTIONS, LBM_MPI_REAL, &cell_type);
+	MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, cell_type, type);
+	MPI_Type_commit(type);
+	MPI_Type_free(&cell_type);
+	return 1;
+}
+
+/****************************************************/
+/**
+ * Échange la couche de noeuds fantômes fins avec les tâches voisines dans le patch,
+ * en une seule opération comme l'exercice 9. Fonction collective.
+**/
+static void lbm_refine_exchange(lbm_refine_t * refine, lbm_mesh_t * mesh)
+{
+	//vars
+	int k;
+	int counts[MAX_NEIGHBORS];
+	MPI_Aint base;
+	MPI_Aint displs[MAX_NEIGHBORS];
+
+	//send and receive areas are in the same buffer, address them from MPI_BOTTOM
+	lbm_timer_exchange_begin();
+	MPI_Get_address(mesh->cells, &base);
+	for (k = 0 ; k < refine->nb_neighbors ; k++)
+	{
+		counts[k] = 1;
+		displs[k] = base;
+	}
+
+	//exchange
+	double start = lbm_timer_now();
+	MPI_Neighbor_alltoallw(
+		MPI_BOTTOM, counts, displs, refine->send_types,
+		MPI_BOTTOM, counts, displs, refine->recv_types,
+		refine->neighbor_communicator);
+	lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT, start);
+	lbm_timer_exchange_end();
+}
+
+/****************************************************/
+/**
+ * Construit le communicateur de graphe reliant les tâches dont les parts du patch se
+ * touchent, avec pour chacune l'intersection de notre part et de sa couche fantôme
+ * (envoi) et l'inverse (réception). Fonction collective.
+**/
+static void lbm_refine_build_neighbors(lbm_refine_t * refine)
+{
+	//vars
+	int r, rank, size;
+	int area[LBM_REFINE_AREAS] = {0};
+	int neighbors[MAX_NEIGHBORS];
+	int weights[MAX_NEIGHBORS];
+	const int * owned = refine->owned;
+	int active = owned[0] < owned[1] && owned[2] < owned[3];
+
+	//owned nodes and with their ghost layer
+	if (active) {
+		memcpy(area, owned, sizeof(int) * 4);
+		area[4] = owned[0] - 1;
+		area[5] = owned[1] + 1;
+		area[6] = owned[2] - 1;
+		area[7] = owned[3] + 1;
+	}
+
+	//parts of everybody
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	MPI_Comm_size( lbm_comm_world, &size );
+	int * areas = malloc(sizeof(int) * LBM_REFINE_AREAS * size);
+	MPI_Allgather(area, LBM_REFINE_AREAS, MPI_INT, areas, LBM_REFINE_AREAS, MPI_INT, lbm_comm_world);
+
+	//neighbors, the relation is symmetric as the ghost layers have the same depth
+	refine->nb_neighbors = 0;
+	for (r = 0 ; r < size && active ; r++)
+	{
+		const int * other = &areas[LBM_REFINE_AREAS * r];
+		if (r == rank || other[0] >= other[1] || other[2] >= other[3])
+			continue;
+		MPI_Datatype send_type, recv_type;
+		if (!lbm_refine_area_type(&send_type, refine, area, other + 4))
+			continue;
+		if (!lbm_refine_area_type(&recv_type, refine, other, area + 4))
+			fatal("Asymmetric neighbors in the refine patch !");
+		if (refine->nb_neighbors == MAX_NEIGHBORS)
+			fatal("Too many neighbors in the refine patch !");
+		int id = refine->nb_neighbors++;
+		neighbors[id] = r;
+		weights[id] = 1;
+		refine->send_types[id] = send_type;
+		refine->recv_types[id] = recv_type;
+	}
+	free(areas);
+
+	//graph communicator
+	MPI_Dist_graph_create_adjacent(lbm_comm_world,
+		refine->nb_neighbors, neighbors, weights,
+		refine->nb_neighbors, neighbors, weights,
+		MPI_INFO_NULL, 0, &refine->neighbor_communicator);
+}
+
+/****************************************************/
+/**
+ * Classe les noeuds fins possédés : solides, anneau sur un noeud grossier, anneau entre
+ * deux noeuds grossiers et noeuds fins sous un noeud grossier intérieur, ce dernier
+ * n'étant restreint que s'il est fluide sur les deux niveaux.
+**/
+static void lbm_refine_build_lists(lbm_refine_t * refine, const lbm_comm_t * comm, const lbm_mesh_type_t * mesh_type)
+{
+	//vars
+	int i, j;
+	const int * owned = refine->owned;
+	const int * patch = refine->patch;
+	int count = (owned[1] - owned[0]) * (owned[3] - owned[2]);
+
+	//allocate for the worst case
+	refine->solid = malloc(sizeof(int) * count);
+	refine->ring_fine = malloc(sizeof(int) * count);
+	refine->ring_coarse = malloc(sizeof(int) * count);
+	refine->ring_odd = malloc(sizeof(int) * 3 * count);
+	refine->restrict_fine = malloc(sizeof(int) * count);
+	refine->restrict_coarse = malloc(sizeof(int) * count);
+
+	//classify
+	for ( i = owned[0] ; i < owned[1] ; i++)
+	{
+		for ( j = owned[2] ; j < owned[3] ; j++)
+		{
+			int pos = lbm_refine_pos(refine, i, j);
+			int solid = lbm_obstacle_test_point(patch[0] + 0.5 * i, patch[1] + 0.5 * j) != LBM_OBSTACLE_NONE;
+			int ring = (i == 0 || j == 0 || i == refine->size[0] - 1 || j == refine->size[1] - 1);
+			int coarse_x = patch[0] + i / 2 - comm->x;
+			int coarse_y = patch[1] + j / 2 - comm->y;
+
+			//obstacle
+			if (solid && ring)
+				fatal("The refine patch must not cross the obstacle !");
+			if (solid)
+				refine->solid[refine->nb_solid++] = pos;
+
+			//ring, its nodes between two coarse nodes are on the sides so only one position is odd
+			if (ring && i % 2 == 0 && j % 2 == 0) {
+				refine->ring_fine[refine->nb_ring] = pos;
+				refine->ring_coarse[refine->nb_ring] = coarse_x * comm->height + coarse_y;
+				refine->nb_ring++;
+			} else if (ring) {
+				int * odd = &refine->ring_odd[3 * refine->nb_ring_odd++];
+				odd[0] = pos;
+				odd[1] = (i % 2) ? lbm_refine_pos(refine, i - 1, j) : lbm_refine_pos(refine, i, j - 1);
+				odd[2] = (i % 2) ? lbm_refine_pos(refine, i + 1, j) : lbm_refine_pos(refine, i, j + 1);
+			} else if (i % 2 == 0 && j % 2 == 0 && !solid
+			           && *lbm_cell_type_t_get_cell(mesh_type, coarse_x, coarse_y) == CELL_FUILD) {
+				refine->restrict_fine[refine->nb_restrict] = pos;
+				refine->restrict_coarse[refine->nb_restrict] = coarse_x * comm->height + coarse_y;
+				refine->nb_restrict++;
+			}
+		}
+	}
+
+	//previous state of the coarse ring
+	refine->ring_prev = malloc(sizeof(lbm_real_t) * DIRECTIONS * (refine->nb_ring + 1));
+}
+
+/****************************************************/
+/**
+ * État initial du niveau fin, interpolé (bilinéaire) depuis les noeuds grossiers
+ * possédés : copie des noeuds confondus, puis milieux des côtés des mailles grossières
+ * et enfin leurs centres, chaque passe étant précédée d'un échange des noeuds fantômes
+ * fins. Utilisé au démarrage, à la reprise et après un équilibrage. Fonction collective.
+**/
+static void lbm_refine_fill(lbm_refine_t * refine, const lbm_comm_t * comm, const lbm_mesh_t * mesh)
+{
+	//vars
+	int i, j, k, pass;
+	double f[DIRECTIONS];
+	const int * owned = refine->owned;
+	const int * patch = refine->patch;
+	lbm_real_t * cells = refine->mesh.cells;
+
+	//nodes on a coarse node
+	for ( i = owned[0] ; i < owned[1] ; i++)
+	{
+		for ( j = owned[2] ; j < owned[3] ; j++)
+		{
+			if (i % 2 != 0 || j % 2 != 0)
+				continue;
+			const lbm_real_t * coarse = lbm_mesh_get_cell(mesh, patch[0] + i / 2 - comm->x, patch[1] + j / 2 - comm->y);
+			for ( k = 0 ; k < DIRECTIONS ; k++)
+				f[k] = LBM_LOAD(coarse, k);
+			lbm_refine_rescale(cells + (size_t)lbm_refine_pos(refine, i, j) * DIRECTIONS, f, refine->scale);
+		}
+	}
+
+	//nodes with one odd position, then the ones with two using the previous pass along Y
+	for ( pass = 1 ; pass <= 2 ; pass++)
+	{
+		lbm_refine_exchange(refine, &refine->mesh);
+		for ( i = owned[0] ; i < owned[1] ; i++)
+		{
+			for ( j = owned[2] ; j < owned[3] ; j++)
+			{
+				if ((i % 2) + (j % 2) != pass)
+					continue;
+				int a = (j % 2) ? lbm_refine_pos(refine, i, j - 1) : lbm_refine_pos(refine, i - 1, j);
+				int b = (j % 2) ? lbm_refine_pos(refine, i, j + 1) : lbm_refine_pos(refine, i + 1, j);
+				lbm_refine_average(cells + (size_t)lbm_refine_pos(refine, i, j) * DIRECTIONS,
+					cells + (size_t)a * DIRECTIONS, cells + (size_t)b * DIRECTIONS);
+			}
+		}
+	}
+}
+
+/****************************************************/
+/**
+ * Prépare le niveau fin sur le patch REFINE_PATCH (rien si la config n'en donne pas) :
+ * répartition des noeuds fins, relaxation du niveau fin, listes de noeuds et état
+ * initial interpolé depuis le maillage grossier. Fonction collective.
+ * @param mesh Maillage grossier local dont on part.
+ * @param mesh_type Types des mailles grossières (pour ne restreindre que le fluide).
+**/
+void lbm_refine_init(lbm_refine_t * refine, const lbm_comm_t * comm, const lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type)
+{
+	//vars
+	const int * patch = REFINE_PATCH;
+
+	//disabled
+	memset(refine, 0, sizeof(*refine));
+	refine->neighbor_communicator = MPI_COMM_NULL;
+	if (patch[2] <= patch[0])
+		return;
+
+	//errors
+	if (comm->ghost != 1)
+		fatal("The local refinement needs a ghost depth of 1 !");
+	if (patch[0] < 3 || patch[1] < 3 || patch[2] > MESH_WIDTH - 2 || patch[3] > MESH_HEIGHT - 2)
+		fatal("The refine patch must stay two cells away from the borders of the mesh !");
+
+	//geometry
+	refine->enabled = 1;
+	memcpy(refine->patch, patch, sizeof(refine->patch));
+	refine->size[0] = 2 * (patch[2] - patch[0]) + 1;
+	refine->size[1] = 2 * (patch[3] - patch[1]) + 1;
+
+	//same viscosity with half the spacing and time step : tau - 1/2 doubles in lattice units
+	double tau = 1.0 / RELAX_PARAMETER;
+	double tau_fine = 2.0 * tau - 0.5;
+	refine->relax_parameter = 1.0 / tau_fine;
+	refine->trt_relax_minus = 1.0 / (lbm_gbl_config.trt_magic / (tau_fine - 0.5) + 0.5);
+	refine->scale = tau_fine / (2.0 * tau);
+
+	//fine nodes lying on the owned coarse cells (the inner cells start at comm->x + 1)
+	refine->owned[0] = lbm_refine_max(0, 2 * (comm->x + 1 - patch[0]));
+	refine->owned[1] = lbm_refine_min(refine->size[0], 2 * (comm->x + comm->width - 1 - patch[0]));
+	refine->owned[2] = lbm_refine_max(0, 2 * (comm->y + 1 - patch[1]));
+	refine->owned[3] = lbm_refine_min(refine->size[1], 2 * (comm->y + comm->height - 1 - patch[1]));
+	if (refine->owned[0] >= refine->owned[1] || refine->owned[2] >= refine->owned[3])
+		memset(refine->owned, 0, sizeof(refine->owned));
+
+	//local fine meshes with one ghost layer
+	refine->x = refine->owned[0] - 1;
+	refine->y = refine->owned[2] - 1;
+	if (refine->owned[1] > refine->owned[0]) {
+		lbm_mesh_init(&refine->mesh, refine->owned[1] - refine->owned[0] + 2, refine->owned[3] - refine->owned[2] + 2, 1);
+		lbm_mesh_init(&refine->temp, refine->owned[1] - refine->owned[0] + 2, refine->owned[3] - refine->owned[2] + 2, 1);
+	}
+
+	//communications, lists and initial state
+	lbm_refine_build_neighbors(refine);
+	lbm_refine_build_lists(refine, comm, mesh_type);
+	lbm_refine_fill(refine, comm, mesh);
+}
+
+/****************************************************/
+/**
+ * Déplace les noeuds fins possédés de l'ancienne répartition vers la nouvelle après un
+ * équilibrage, en un seul MPI_Alltoallw comme lbm_comm_migrate(). Les noeuds fantômes
+ * sont remplis par les échanges du sous-pas suivant. Fonction collective.
+ * @param old_refine Niveau fin sur les anciennes tuiles.
+ * @param refine Niveau fin préparé par lbm_refine_init() sur les nouvelles tuiles.
+**/
+void lbm_refine_migrate(const lbm_refine_t * old_refine, lbm_refine_t * refine)
+{
+	//vars
+	int r, size;
+
+	//parts of everybody
+	MPI_Comm_size( lbm_comm_world, &size );
+	int * old_areas = malloc(sizeof(int) * 4 * size);
+	int * new_areas = malloc(sizeof(int) * 4 * size);
+	int * send_counts = malloc(sizeof(int) * size);
+	int * recv_counts = malloc(sizeof(int) * size);
+	int * displs = calloc(size, sizeof(int));
+	MPI_Datatype * send_types = malloc(sizeof(MPI_Datatype) * size);
+	MPI_Datatype * recv_types = malloc(sizeof(MPI_Datatype) * size);
+	MPI_Allgather(old_refine->owned, 4, MPI_INT, old_areas, 4, MPI_INT, lbm_comm_world);
+	MPI_Allgather(refine->owned, 4, MPI_INT, new_areas, 4, MPI_INT, lbm_comm_world);
+
+	//what we send to and receive from each rank (including ourself)
+	for (r = 0 ; r < size ; r++)
+	{
+		send_counts[r] = lbm_refine_area_type(&send_types[r], old_refine, old_refine->owned, &new_areas[4 * r]);
+		recv_counts[r] = lbm_refine_area_type(&recv_types[r], refine, &old_areas[4 * r], refine->owned);
+		if (send_counts[r] == 0)
+			send_types[r] = MPI_BYTE;
+		if (recv_counts[r] == 0)
+			recv_types[r] = MPI_BYTE;
+	}
+
+	//move
+	MPI_Alltoallw(old_refine->mesh.cells, send_counts, displs, send_types, refine->mesh.cells, recv_counts, displs, recv_types, lbm_comm_world);
+
+	//free
+	for (r = 0 ; r < size ; r++)
+	{
+		if (send_counts[r] > 0)
+			MPI_Type_free(&send_types[r]);
+		if (recv_counts[r] > 0)
+			MPI_Type_free(&recv_types[r]);
+	}
+	free(old_areas);
+	free(new_areas);
+	free(send_counts);
+	free(recv_counts);
+	free(displs);
+	free(send_types);
+	free(recv_types);
+}
+
+/****************************************************/
+/**
+ * Libère le niveau fin.
+**/
+void lbm_refine_release(lbm_refine_t * refine)
+{
+	//vars
+	int k;
+
+	//nothing to do
+	if (!refine->enabled)
+		return;
+
+	//free
+	for ( k = 0 ; k < refine->nb_neighbors ; k++)
+	{
+		MPI_Type_free(&refine->send_types[k]);
+		MPI_Type_free(&refine->recv_types[k]);
+	}
+	MPI_Comm_free(&refine->neighbor_communicator);
+	if (refine->mesh.cells != NULL) {
+		lbm_mesh_release(&refine->mesh);
+		lbm_mesh_release(&refine->temp);
+	}
+	free(refine->solid);
+	free(refine->ring_fine);
+	free(refine->ring_coarse);
+	free(refine->ring_prev);
+	free(refine->ring_odd);
+	free(refine->restrict_fine);
+	free(refine->restrict_coarse);
+	memset(refine, 0, sizeof(*refine));
+}
+
+/****************************************************/
+/**
+ * Garde l'état des noeuds grossiers de l'anneau avant le pas grossier, pour
+ * l'interpolation en temps du premier sous-pas.
+ * @param mesh Maillage grossier local.
+**/
+void lbm_refine_save(lbm_refine_t * refine, const lbm_mesh_t * mesh)
+{
+	int c;
+	for ( c = 0 ; c < refine->nb_ring ; c++)
+		memcpy(refine->ring_prev + (size_t)c * DIRECTIONS, mesh->cells + (size_t)refine->ring_coarse[c] * DIRECTIONS, sizeof(lbm_real_t) * DIRECTIONS);
+}
+
+/****************************************************/
+/**
+ * Remplit l'anneau du patch depuis le niveau grossier à la fraction weight du pas
+ * grossier (interpolation linéaire entre son début et sa fin). Les noeuds entre deux
+ * noeuds grossiers prennent la moyenne de leurs voisins le long de l'anneau, après un
+ * échange pour ceux dont un voisin est sur une autre tâche. Fonction collective.
+**/
+static void lbm_refine_ring(lbm_refine_t * refine, const lbm_mesh_t * mesh, double weight)
+{
+	//vars
+	int c, k;
+	double f[DIRECTIONS];
+	lbm_real_t * cells = refine->mesh.cells;
+
+	//nodes on a coarse node
+	for ( c = 0 ; c < refine->nb_ring ; c++)
+	{
+		const lbm_real_t * prev = refine->ring_prev + (size_t)c * DIRECTIONS;
+		const lbm_real_t * next = mesh->cells + (size_t)refine->ring_coarse[c] * DIRECTIONS;
+		for ( k = 0 ; k < DIRECTIONS ; k++)
+			f[k] = (1.0 - weight) * LBM_LOAD(prev, k) + weight * LBM_LOAD(next, k);
+		lbm_refine_rescale(cells + (size_t)refine->ring_fine[c] * DIRECTIONS, f, refine->scale);
+	}
+
+	//nodes in between
+	lbm_refine_exchange(refine, &refine->mesh);
+	for ( c = 0 ; c < refine->nb_ring_odd ; c++)
+	{
+		const int * odd = &refine->ring_odd[3 * c];
+		lbm_refine_average(cells + (size_t)odd[0] * DIRECTIONS, cells + (size_t)odd[1] * DIRECTIONS, cells + (size_t)odd[2] * DIRECTIONS);
+	}
+}
+
+/****************************************************/
+/**
+ * Échange les paramètres de relaxation de la config courante avec ceux du niveau fin,
+ * les opérateurs de collision les lisant dans la config. Appelé autour de la collision fine.
+**/
+static void lbm_refine_swap_relax(lbm_refine_t * refine)
+{
+	double relax = lbm_gbl_config.relax_parameter;
+	double relax_minus = lbm_gbl_config.trt_relax_minus;
+	lbm_gbl_config.relax_parameter = refine->relax_parameter;
+	lbm_gbl_config.trt_relax_minus = refine->trt_relax_minus;
+	refine->relax_parameter = relax;
+	refine->trt_relax_minus = relax_minus;
+}
+
+/****************************************************/
+/**
+ * Avance le niveau fin de deux sous-pas jusqu'à la fin du pas grossier qui vient d'être
+ * calculé, l'anneau étant pris au milieu puis à la fin du pas grossier, et remplace les
+ * noeuds grossiers intérieurs au patch par les noeuds fins à leur position. Les phases
+ * sont comptées avec celles du pas grossier. Fonction collective.
+ * @param mesh Maillage grossier local à la fin du pas.
+**/
+void lbm_refine_step(lbm_refine_t * refine, lbm_mesh_t * mesh)
+{
+	//vars
+	int c, k, sub;
+	double f[DIRECTIONS];
+	lbm_mesh_t * fine = &refine->mesh;
+	lbm_mesh_t * temp = &refine->temp;
+
+	//two fine steps per coarse step
+	for ( sub = 1 ; sub <= 2 ; sub++)
+	{
+		//reflexion on the obstacle
+		double start = lbm_timer_now();
+		for ( c = 0 ; c < refine->nb_solid ; c++)
+			lbm_phys_bounce_back(fine->cells + (size_t)refine->solid[c] * DIRECTIONS);
+		lbm_timer_add(LBM_TIMER_SPECIAL_CELLS, start);
+
+		//collision of the owned nodes with the relaxation of the fine level
+		start = lbm_timer_now();
+		if (fine->cells != NULL) {
+			lbm_refine_swap_relax(refine);
+			#pragma omp parallel
+			lbm_phys_collision_region(temp, fine, 1, fine->width - 1, 1, fine->height - 1);
+			lbm_refine_swap_relax(refine);
+		}
+		lbm_timer_add(LBM_TIMER_COLLISION, start);
+
+		//ghost layer
+		lbm_refine_exchange(refine, temp);
+
+		//propagation from the owned and ghost nodes, the ring is overwritten just after
+		start = lbm_timer_now();
+		if (fine->cells != NULL) {
+			#pragma omp parallel
+			lbm_phys_propagation_region(fine, temp, 0, fine->width, 0, fine->height);
+		}
+		lbm_timer_add(LBM_TIMER_PROPAGATION, start);
+
+		//interface with the coarse level
+		start = lbm_timer_now();
+		lbm_refine_ring(refine, mesh, 0.5 * sub);
+		lbm_timer_add(LBM_TIMER_REFINE, start);
+	}
+
+	//restriction on the inner coarse nodes
+	double start = lbm_timer_now();
+	for ( c = 0 ; c < refine->nb_restrict ; c++)
+	{
+		const lbm_real_t * cell = fine->cells + (size_t)refine->restrict_fine[c] * DIRECTIONS;
+		for ( k = 0 ; k < DIRECTIONS ; k++)
+			f[k] = LBM_LOAD(cell, k);
+		lbm_refine_rescale(mesh->cells + (size_t)refine->restrict_coarse[c] * DIRECTIONS, f, 1.0 / refine->scale);
+	}
+	lbm_timer_add(LBM_TIMER_REFINE, start);
+}
+
+/****************************************************/
+/**
+ * Nombre de mises à jour de noeuds fins par pas grossier sur l'ensemble du patch.
+**/
+long lbm_refine_updates(const lbm_refine_t * refine)
+{
+	if (!refine->enabled)
+		return 0;
+	return 2L * refine->size[0] * refine->size[1];
+}
+
+/****************************************************/
+/**
+ * Affiche la taille du niveau fin et le coût d'un pas grossier, comparé à celui d'un
+ * maillage fin uniforme (quatre fois plus de mailles et deux fois plus de pas).
+**/
+void lbm_refine_print_stats(const lbm_refine_t * refine)
+{
+	//vars
+	int rank;
+	long coarse = (long)MESH_WIDTH * MESH_HEIGHT;
+	long uniform = 8 * coarse;
+
+	//only master
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	if (!refine->enabled || rank != RANK_MASTER)
+		return;
+
+	//print
+	printf("Refinement: %d x %d fine nodes (relaxation %g on the fine level)\n", refine->size[0], refine->size[1], refine->relax_parameter);
+	printf("Refinement: %ld cell updates per coarse step, uniform fine mesh %ld (%.1fx more)\n",
+		coarse + lbm_refine_updates(refine), uniform, (double)uniform / (coarse + lbm_refine_updates(refine)));
+}
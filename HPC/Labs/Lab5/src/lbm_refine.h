@@ -0,0 +1,93 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef LBM_REFINE_H
+#define LBM_REFINE_H
+
+/****************************************************/
+#include <mpi.h>
+#include "lbm_struct.h"
+#include "lbm_comm.h"
+
+/****************************************************/
+/**
+ * Local grid refinement : a patch of the coarse mesh around the obstacle (REFINE_PATCH)
+ * is covered by a fine mesh with half the spacing, advanced with two sub-steps for each
+ * coarse step. Fine node (i,j) sits on the coarse position (x0 + i/2, y0 + j/2), so the
+ * ring of the patch is filled from the coarse nodes (interpolated in time and space) and
+ * the coarse nodes inside the patch are overwritten by the fine nodes at their position.
+ * The fine nodes are split between the tasks as the coarse cells they lie on, each task
+ * keeping one layer of fine ghost nodes around its part.
+**/
+typedef struct lbm_refine_s
+{
+	/** If the refinement is enabled, the other fields are unused otherwise. **/
+	int enabled;
+	/** First and last coarse nodes of the patch in the global mesh (x0, y0, x1, y1). **/
+	int patch[4];
+	/** Number of fine nodes of the patch along X and Y. **/
+	int size[2];
+	/** Fine nodes owned by the local task [x_start,x_end[ x [y_start,y_end[ (empty if none). **/
+	int owned[4];
+	/** Fine position of the first node of the local meshes (owned nodes and their ghost layer). **/
+	int x;
+	/** Fine position of the first node of the local meshes along Y. **/
+	int y;
+	/** Relaxation parameters of the fine level (swapped with the coarse ones around the fine collision). **/
+	double relax_parameter;
+	/** TRT relaxation parameter of the odd moments on the fine level. **/
+	double trt_relax_minus;
+	/** Scaling of the non equilibrium part from the coarse level to the fine one (tau_f / (2 tau_c)). **/
+	double scale;
+	/** Fine distributions. **/
+	lbm_mesh_t mesh;
+	/** Fine distributions after the collision. **/
+	lbm_mesh_t temp;
+	/** Number of solid fine nodes. **/
+	int nb_solid;
+	/** Solid fine nodes (x * height + y in the local fine mesh). **/
+	int * solid;
+	/** Number of ring nodes on a coarse node. **/
+	int nb_ring;
+	/** Ring nodes on a coarse node in the local fine mesh. **/
+	int * ring_fine;
+	/** Coarse node under each ring node in the local coarse mesh. **/
+	int * ring_coarse;
+	/** Distributions of the coarse ring nodes at the start of the coarse step. **/
+	lbm_real_t * ring_prev;
+	/** Number of ring nodes between two coarse nodes. **/
+	int nb_ring_odd;
+	/** Ring nodes between two coarse nodes, followed by their two neighbors along the ring. **/
+	int * ring_odd;
+	/** Number of coarse nodes restricted from the fine level. **/
+	int nb_restrict;
+	/** Restricted nodes in the local fine mesh. **/
+	int * restrict_fine;
+	/** Restricted nodes in the local coarse mesh. **/
+	int * restrict_coarse;
+	/** Graph communicator with the tasks sharing a side of their part of the patch. **/
+	MPI_Comm neighbor_communicator;
+	/** Number of neighbors in neighbor_communicator. **/
+	int nb_neighbors;
+	/** Datatypes to send to each neighbor (relative to the fine cells). **/
+	MPI_Datatype send_types[MAX_NEIGHBORS];
+	/** Datatypes to receive from each neighbor (relative to the fine cells). **/
+	MPI_Datatype recv_types[MAX_NEIGHBORS];
+} lbm_refine_t;
+
+/****************************************************/
+void lbm_refine_init(lbm_refine_t * refine, const lbm_comm_t * comm, const lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type);
+void lbm_refine_release(lbm_refine_t * refine);
+void lbm_refine_migrate(const lbm_refine_t * old_refine, lbm_refine_t * refine);
+void lbm_refine_save(lbm_refine_t * refine, const lbm_mesh_t * mesh);
+void lbm_refine_step(lbm_refine_t * refine, lbm_mesh_t * mesh);
+long lbm_refine_updates(const lbm_refine_t * refine);
+void lbm_refine_print_stats(const lbm_refine_t * refine);
+
+#endif //LBM_REFINE_H
@@ -9,8 +9,12 @@
 /****************************************************/
 #include <mpi.h>
 #include <math.h>
+#include <string.h>
 #include <unistd.h>
 #include <assert.h>
+#ifdef HAVE_ZLIB
+	#include <zlib.h>
+#endif //HAVE_ZLIB
 #include "lbm_phys.h"
 #include "lbm_save.h"
 
@@ -27,7 +31,8 @@ void lbm_save_file_header(lbm_comm_t * comm)
 	header.magick      = RESULT_MAGICK;
 	header.mesh_height = MESH_HEIGHT;
 	header.mesh_width  = MESH_WIDTH;
-	header.lines       = comm->nb_y;
+	//tiles are placed in the global layout by the file view, so a single line
+	header.lines       = 1;
 
 	//write file
 	//fwrite(&header,sizeof(header),1,fp);
@@ -37,6 +42,70 @@ void lbm_save_file_header(lbm_comm_t * comm)
 		fatal("Failed to write header in output file !");
 }
 
+/****************************************************/
+/**
+ * Build the header of the version 2 file from the config, clamping the region of
+ * interest inside the mesh.
+**/
+static void lbm_save_build_header_v2(lbm_file_header_v2_t * header)
+{
+	//region, a null size means up to the end of the mesh
+	int decimate = (RESULT_DECIMATE > 1) ? RESULT_DECIMATE : 1;
+	int x = lbm_gbl_config.output_roi[0];
+	int y = lbm_gbl_config.output_roi[1];
+	int width = lbm_gbl_config.output_roi[2];
+	int height = lbm_gbl_config.output_roi[3];
+	if (x < 0 || x >= MESH_WIDTH || y < 0 || y >= MESH_HEIGHT)
+		fatal("Output region of interest out of the mesh !");
+	if (width <= 0 || x + width > MESH_WIDTH)
+		width = MESH_WIDTH - x;
+	if (height <= 0 || y + height > MESH_HEIGHT)
+		height = MESH_HEIGHT - y;
+
+	//fill
+	memset(header, 0, sizeof(*header));
+	header->magick      = RESULT_MAGICK_V2;
+	header->version     = 2;
+	header->mesh_width  = MESH_WIDTH;
+	header->mesh_height = MESH_HEIGHT;
+	header->roi_x       = x;
+	header->roi_y       = y;
+	header->width       = (width + decimate - 1) / decimate;
+	header->height      = (height + decimate - 1) / decimate;
+	header->decimate    = decimate;
+	header->codec       = RESULT_CODEC;
+	header->quantized   = (RESULT_ERROR_BOUND > 0.0);
+	header->error_bound = RESULT_ERROR_BOUND;
+
+	//check we can encode
+	#ifndef HAVE_ZLIB
+		if (header->codec == LBM_CODEC_ZLIB)
+			fatal("Output compression with zlib requested but not compiled in (ENABLE_ZLIB=false) !");
+	#endif //HAVE_ZLIB
+}
+
+/****************************************************/
+/**
+ * Local Z position of the saved plane. The 3D lattices only save the plane at mid
+ * depth of the global mesh, in the same format as the 2D meshes.
+ * @return The plane in the local mesh (0 in 2D), -1 if the tile does not own it.
+**/
+static int lbm_save_local_plane(const lbm_comm_t * comm)
+{
+	//vars
+	int plane;
+
+	//2D, one plane
+	if (DIMENSIONS == 2)
+		return 0;
+
+	//global position accounting the outer ring
+	plane = MESH_DEPTH / 2 + 1 - comm->z;
+	if (plane < comm->ghost || plane >= comm->depth - comm->ghost)
+		return -1;
+	return plane;
+}
+
 /****************************************************/
 /**
  * Function to be used to get a cell from its coordinate.
@@ -49,6 +118,55 @@ static inline lbm_file_entry_t * lbm_file_mesh_get_cell( const lbm_file_mesh_t *
 	return &mesh->cells[ (x * mesh->height + y) ];
 }
 
+/****************************************************/
+/**
+ * Allocate the buffers of the master to rebuild and encode the full frames and
+ * collect the position of all the tiles. Collective function.
+**/
+static void lbm_save_mesh_init_v2(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm)
+{
+	//vars
+	int rank, size, i;
+	int tile[4] = {lbm_comm_inner_x(comm), lbm_comm_inner_y(comm), file_mesh->width, file_mesh->height};
+
+	//get infos
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	MPI_Comm_size( lbm_comm_world, &size );
+	lbm_save_build_header_v2(&file_mesh->header_v2);
+
+	//collect tiles
+	if (rank == RANK_MASTER)
+		file_mesh->tiles = malloc(sizeof(int) * 4 * size);
+	MPI_Gather(tile, 4, MPI_INT, file_mesh->tiles, 4, MPI_INT, RANK_MASTER, lbm_comm_world);
+
+	//only the master encodes
+	if (rank != RANK_MASTER)
+		return;
+
+	//gather layout, in floats
+	file_mesh->counts = malloc(sizeof(int) * size);
+	file_mesh->displs = malloc(sizeof(int) * size);
+	for (i = 0 ; i < size ; i++) {
+		file_mesh->counts[i] = 2 * file_mesh->tiles[4 * i + 2] * file_mesh->tiles[4 * i + 3];
+		file_mesh->displs[i] = (i == 0) ? 0 : file_mesh->displs[i - 1] + file_mesh->counts[i - 1];
+	}
+
+	//buffers
+	size_t frame_entries = (size_t)MESH_WIDTH * MESH_HEIGHT;
+	size_t packed_size = (size_t)file_mesh->header_v2.width * file_mesh->header_v2.height * sizeof(lbm_file_entry_t);
+	file_mesh->encoded_size = packed_size;
+	#ifdef HAVE_ZLIB
+		if (file_mesh->header_v2.codec == LBM_CODEC_ZLIB)
+			file_mesh->encoded_size = compressBound(packed_size);
+	#endif //HAVE_ZLIB
+	file_mesh->gather = malloc(sizeof(lbm_file_entry_t) * frame_entries);
+	file_mesh->frame = malloc(sizeof(lbm_file_entry_t) * frame_entries);
+	file_mesh->packed = malloc(packed_size);
+	file_mesh->encoded = malloc(file_mesh->encoded_size);
+	if (file_mesh->tiles == NULL || file_mesh->counts == NULL || file_mesh->displs == NULL || file_mesh->gather == NULL || file_mesh->frame == NULL || file_mesh->packed == NULL || file_mesh->encoded == NULL)
+		fatal("Fail to allocate the output buffers !");
+}
+
 /****************************************************/
 void lbm_save_mesh_init(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm)
 {
@@ -56,22 +174,119 @@ void lbm_save_mesh_init(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm)
 	assert(file_mesh != NULL);
 	assert(comm != NULL);
 
+	//vars
+	int i;
+
+	//the 3D lattices save the plane at mid depth, tiles not crossing it write nothing
+	file_mesh->plane = lbm_save_local_plane(comm);
+
 	//size
-	file_mesh->width = comm->width - 2;
-	file_mesh->height = comm->height - 2;
+	file_mesh->width = (file_mesh->plane < 0) ? 0 : lbm_comm_inner_width(comm);
+	file_mesh->height = (file_mesh->plane < 0) ? 0 : lbm_comm_inner_height(comm);
 
 	//allocate
-	file_mesh->cells = malloc( sizeof(lbm_file_entry_t) * file_mesh->width * file_mesh->height );
+	for (i = 0 ; i < LBM_SAVE_BUFFERS ; i++) {
+		file_mesh->buffers[i] = malloc( sizeof(lbm_file_entry_t) * file_mesh->width * file_mesh->height );
+		file_mesh->requests[i] = MPI_REQUEST_NULL;
+		if (file_mesh->buffers[i] == NULL)
+			fatal("Fail to allocate the output buffers !");
+	}
+	file_mesh->current = 0;
+	file_mesh->cells = file_mesh->buffers[0];
+
+	//version 2 : the master gathers the tiles to encode full frames
+	file_mesh->counts = NULL;
+	file_mesh->displs = NULL;
+	file_mesh->tiles = NULL;
+	file_mesh->gather = NULL;
+	file_mesh->frame = NULL;
+	file_mesh->packed = NULL;
+	file_mesh->encoded = NULL;
+	file_mesh->index = NULL;
+	file_mesh->frames = 0;
+	file_mesh->max_frames = 0;
+	file_mesh->offset = sizeof(lbm_file_header_v2_t);
+	if (RESULT_FILENAME != NULL && RESULT_VERSION >= 2)
+		lbm_save_mesh_init_v2(file_mesh, comm);
 }
 
 /****************************************************/
 void lbm_save_mesh_release(lbm_file_mesh_t * file_mesh)
 {
+	//vars
+	int i;
+
 	//check
 	assert(file_mesh != NULL);
 
+	//write must be done before freeing the buffers
+	lbm_save_flush(file_mesh);
+
 	//free
-	free(file_mesh->cells);
+	for (i = 0 ; i < LBM_SAVE_BUFFERS ; i++)
+		free(file_mesh->buffers[i]);
+	file_mesh->cells = NULL;
+
+	//free version 2
+	free(file_mesh->counts);
+	free(file_mesh->displs);
+	free(file_mesh->tiles);
+	free(file_mesh->gather);
+	free(file_mesh->frame);
+	free(file_mesh->packed);
+	free(file_mesh->encoded);
+	free(file_mesh->index);
+}
+
+/****************************************************/
+/**
+ * Wait for all the pending writes. Must be called by all the ranks before closing the file.
+**/
+void lbm_save_flush(lbm_file_mesh_t * file_mesh)
+{
+	MPI_Waitall(LBM_SAVE_BUFFERS, file_mesh->requests, MPI_STATUSES_IGNORE);
+}
+
+/****************************************************/
+/**
+ * Wait the pending writes, append the frame index for the version 2 format and close
+ * the output file. Collective function.
+**/
+void lbm_save_close(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm)
+{
+	//vars
+	int rank;
+
+	//nothing to close
+	if (RESULT_FILENAME == NULL)
+		return;
+
+	//wait
+	lbm_save_flush(file_mesh);
+
+	//index and trailer
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	if (RESULT_VERSION >= 2 && rank == RANK_MASTER) {
+		lbm_file_trailer_v2_t trailer;
+		trailer.index_offset = file_mesh->offset;
+		trailer.frames = file_mesh->frames;
+		trailer.magick = RESULT_MAGICK_V2;
+		int status = MPI_File_write_at(comm->file_handler, file_mesh->offset, file_mesh->index, sizeof(uint64_t) * file_mesh->frames, MPI_BYTE, MPI_STATUS_IGNORE);
+		if (status == MPI_SUCCESS)
+			status = MPI_File_write_at(comm->file_handler, file_mesh->offset + sizeof(uint64_t) * file_mesh->frames, &trailer, sizeof(trailer), MPI_BYTE, MPI_STATUS_IGNORE);
+		if (status != MPI_SUCCESS)
+			fatal("Fail to write the frame index into file !");
+	}
+
+	//drop what a previous run wrote after our end (restart)
+	if (RESULT_VERSION >= 2) {
+		MPI_Offset size = file_mesh->offset + sizeof(uint64_t) * file_mesh->frames + sizeof(lbm_file_trailer_v2_t);
+		MPI_Bcast(&size, 1, MPI_OFFSET, RANK_MASTER, lbm_comm_world);
+		MPI_File_set_size(comm->file_handler, size);
+	}
+
+	//close
+	MPI_File_close(&comm->file_handler);
 }
 
 /****************************************************/
@@ -79,38 +294,236 @@ void lbm_save_fill_mesh(lbm_file_mesh_t * file_mesh, const lbm_mesh_t * mesh, lb
 {
 	//write buffer to write float instead of double
 	int i,j;
+	int g = (mesh->width - file_mesh->width) / 2;
 	double density;
 	Vector v;
 	double norm;
 
-	//nothing to do
-	if (RESULT_FILENAME == NULL)
+	//nothing to do (or no cell of the saved plane)
+	if (RESULT_FILENAME == NULL || file_mesh->plane < 0)
 		return;
 
-	//loop on all values
-	for ( i = 1 ; i < mesh->width - 1 ; i++)
+	//the buffer can still be in use by the write of two frames ago
+	MPI_Wait(&file_mesh->requests[file_mesh->current], MPI_STATUS_IGNORE);
+
+	//loop on all values, skipping the ghost layers
+	for ( i = g ; i < mesh->width - g ; i++)
 	{
-		for ( j = 1 ; j < mesh->height - 1 ; j++)
+		for ( j = g ; j < mesh->height - g ; j++)
 		{
 			//compute macrospic values
-			density = lbm_phys_cell_density(lbm_mesh_get_cell(mesh, i, j));
-			lbm_phys_cell_velocity(v,lbm_mesh_get_cell(mesh, i, j),density);
+			lbm_real_t * cell_in = lbm_mesh_get_cell_3d(mesh, i, j, file_mesh->plane);
+			density = lbm_phys_cell_density(cell_in);
+			lbm_phys_cell_velocity(v,cell_in,density);
 			norm = sqrt(lbm_phys_vect_norme_2(v,v));
 
 			//fill obstable
-			if (*lbm_cell_type_t_get_cell(mesh_type, i, j) == CELL_BOUNCE_BACK) {
+			if (lbm_cell_type_t_is_solid_3d(mesh_type, i, j, file_mesh->plane)) {
 				norm = NAN;
 				density = NAN;
 			}
 
 			//fill
-			lbm_file_entry_t * cell = lbm_file_mesh_get_cell(file_mesh, i - 1, j - 1);
+			lbm_file_entry_t * cell = lbm_file_mesh_get_cell(file_mesh, i - g, j - g);
 			cell->density = density;
 			cell->v = norm;
 		}
 	}
 }
 
+/****************************************************/
+/**
+ * Quantize a value on a grid of step 2 * error_bound, the error is then bounded by
+ * error_bound (up to the float rounding of the reader).
+**/
+static inline int32_t lbm_save_quantize(float value, float error_bound)
+{
+	double q = rint(value / (2.0 * error_bound));
+	if (fabs(q) >= (double)(1 << 30))
+		fatal("Value out of the range of the quantization, increase output_error_bound !");
+	return (int32_t)q;
+}
+
+/****************************************************/
+/**
+ * Extract the saved region of the full frame in the packed buffer, either as floats or
+ * as quantized values. The quantized values of each field are stored as the difference
+ * with the previous one, which is small for smooth fields and compress well.
+ * @return The size of the packed data in bytes.
+**/
+static size_t lbm_save_pack_frame_v2(lbm_file_mesh_t * file_mesh)
+{
+	//vars
+	const lbm_file_header_v2_t * header = &file_mesh->header_v2;
+	uint32_t i,j;
+	size_t pos = 0;
+	int32_t prev_v = 0;
+	int32_t prev_density = 0;
+	lbm_file_entry_t * entries = file_mesh->packed;
+	int32_t * quantized = file_mesh->packed;
+
+	//loop on saved cells
+	for ( i = 0 ; i < header->width ; i++)
+	{
+		const lbm_file_entry_t * column = file_mesh->frame + (size_t)(header->roi_x + i * header->decimate) * MESH_HEIGHT + header->roi_y;
+		for ( j = 0 ; j < header->height ; j++)
+		{
+			const lbm_file_entry_t * entry = &column[j * header->decimate];
+			if (!header->quantized) {
+				entries[pos] = *entry;
+			} else if (isnan(entry->v) || isnan(entry->density)) {
+				quantized[2 * pos] = LBM_FILE_QUANTIZED_NAN;
+				quantized[2 * pos + 1] = LBM_FILE_QUANTIZED_NAN;
+			} else {
+				int32_t v = lbm_save_quantize(entry->v, header->error_bound);
+				int32_t density = lbm_save_quantize(entry->density, header->error_bound);
+				quantized[2 * pos] = v - prev_v;
+				quantized[2 * pos + 1] = density - prev_density;
+				prev_v = v;
+				prev_density = density;
+			}
+			pos++;
+		}
+	}
+
+	return pos * sizeof(lbm_file_entry_t);
+}
+
+/****************************************************/
+/**
+ * Encode the packed frame in the encoded buffer.
+ * @return The size of the encoded data in bytes.
+**/
+static size_t lbm_save_encode_frame_v2(lbm_file_mesh_t * file_mesh, size_t size)
+{
+	//no compression
+	if (file_mesh->header_v2.codec == LBM_CODEC_NONE) {
+		memcpy(file_mesh->encoded, file_mesh->packed, size);
+		return size;
+	}
+
+	#ifdef HAVE_ZLIB
+		//group the bytes of same weight of the 32 bits words (the exponents and the high
+		//bytes of the quantized values are very redundant) in the gather buffer
+		size_t i, b;
+		size_t words = size / 4;
+		const uint8_t * in = file_mesh->packed;
+		uint8_t * shuffled = (uint8_t*)file_mesh->gather;
+		for (b = 0 ; b < 4 ; b++)
+			for (i = 0 ; i < words ; i++)
+				shuffled[b * words + i] = in[i * 4 + b];
+
+		//compress
+		uLongf encoded_size = file_mesh->encoded_size;
+		if (compress2(file_mesh->encoded, &encoded_size, shuffled, size, LBM_SAVE_ZLIB_LEVEL) != Z_OK)
+			fatal("Fail to compress the output frame !");
+		return encoded_size;
+	#else //HAVE_ZLIB
+		fatal("Output compression with zlib requested but not compiled in (ENABLE_ZLIB=false) !");
+		return 0;
+	#endif //HAVE_ZLIB
+}
+
+/****************************************************/
+/**
+ * Add the frame at the current offset in the frame index.
+**/
+static void lbm_save_register_frame(lbm_file_mesh_t * file_mesh)
+{
+	if (file_mesh->frames == file_mesh->max_frames) {
+		file_mesh->max_frames = (file_mesh->max_frames == 0) ? 64 : 2 * file_mesh->max_frames;
+		file_mesh->index = realloc(file_mesh->index, sizeof(uint64_t) * file_mesh->max_frames);
+		if (file_mesh->index == NULL)
+			fatal("Fail to allocate the frame index !");
+	}
+	file_mesh->index[file_mesh->frames++] = file_mesh->offset;
+}
+
+/****************************************************/
+/**
+ * Continue an output file after a restart. Version 1 frames have a fixed position so
+ * they are simply overwritten. For version 2 the master keeps the frames written before
+ * the given step and appends the next ones after them.
+ * @param first_write_step First write step produced by the restarted run.
+**/
+void lbm_save_resume(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm, int first_write_step)
+{
+	//vars
+	int rank;
+	lbm_file_frame_v2_t prefix;
+	lbm_file_trailer_v2_t trailer;
+	MPI_Offset end;
+
+	//nothing to do
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	if (RESULT_FILENAME == NULL || RESULT_VERSION < 2 || rank != RANK_MASTER)
+		return;
+
+	//frames stop at the index if the previous run closed the file
+	MPI_File_get_size(comm->file_handler, &end);
+	if (end >= (MPI_Offset)(sizeof(lbm_file_header_v2_t) + sizeof(trailer))) {
+		MPI_File_read_at(comm->file_handler, end - sizeof(trailer), &trailer, sizeof(trailer), MPI_BYTE, MPI_STATUS_IGNORE);
+		if (trailer.magick == RESULT_MAGICK_V2 && (MPI_Offset)trailer.index_offset < end)
+			end = trailer.index_offset;
+	}
+
+	//keep the complete frames before the restart
+	while (file_mesh->offset + (MPI_Offset)sizeof(prefix) <= end)
+	{
+		MPI_File_read_at(comm->file_handler, file_mesh->offset, &prefix, sizeof(prefix), MPI_BYTE, MPI_STATUS_IGNORE);
+		if (prefix.step >= (uint32_t)first_write_step || file_mesh->offset + (MPI_Offset)(sizeof(prefix) + prefix.size) > end)
+			break;
+		lbm_save_register_frame(file_mesh);
+		file_mesh->offset += sizeof(prefix) + prefix.size;
+	}
+}
+
+/****************************************************/
+/**
+ * Write a frame in the version 2 format : the master gathers the tiles, rebuild the
+ * frame, keep the region of interest and encode it before appending it to the file.
+ * Collective function.
+**/
+static void lbm_save_write_mesh_v2(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm, int write_step)
+{
+	//vars
+	int rank, size, r, i;
+
+	//gather the tiles on master
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	MPI_Comm_size( lbm_comm_world, &size );
+	MPI_Gatherv(file_mesh->cells, 2 * file_mesh->width * file_mesh->height, MPI_FLOAT,
+		file_mesh->gather, file_mesh->counts, file_mesh->displs, MPI_FLOAT, RANK_MASTER, lbm_comm_world);
+	if (rank != RANK_MASTER)
+		return;
+
+	//rebuild the frame, columns of the tiles are contiguous in the frame
+	for (r = 0 ; r < size ; r++)
+	{
+		const int * tile = &file_mesh->tiles[4 * r];
+		const lbm_file_entry_t * src = file_mesh->gather + file_mesh->displs[r] / 2;
+		for (i = 0 ; i < tile[2] ; i++)
+			memcpy(file_mesh->frame + (size_t)(tile[0] + i) * MESH_HEIGHT + tile[1], src + (size_t)i * tile[3], sizeof(lbm_file_entry_t) * tile[3]);
+	}
+
+	//encode
+	size_t packed_size = lbm_save_pack_frame_v2(file_mesh);
+	lbm_file_frame_v2_t prefix;
+	prefix.step = write_step;
+	prefix.size = lbm_save_encode_frame_v2(file_mesh, packed_size);
+
+	//register in index
+	lbm_save_register_frame(file_mesh);
+
+	//write
+	int status = MPI_File_write_at(comm->file_handler, file_mesh->offset, &prefix, sizeof(prefix), MPI_BYTE, MPI_STATUS_IGNORE);
+	if (status == MPI_SUCCESS)
+		status = MPI_File_write_at(comm->file_handler, file_mesh->offset + sizeof(prefix), file_mesh->encoded, prefix.size, MPI_BYTE, MPI_STATUS_IGNORE);
+	if (status != MPI_SUCCESS)
+		fatal("Fail to fully write data into file !");
+	file_mesh->offset += sizeof(prefix) + prefix.size;
+}
+
 /****************************************************/
 void lbm_save_write_mesh(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm, int rank_x, int rank_y, int write_step)
 {
@@ -124,16 +537,64 @@ void lbm_save_write_mesh(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm, int ran
 	if (RESULT_FILENAME == NULL)
 		return;
 
-	//calc size
-	size_t size = sizeof(lbm_file_entry_t) * file_mesh->width * file_mesh->height;
+	//version 2 is encoded by the master
+	if (RESULT_VERSION >= 2) {
+		lbm_save_write_mesh_v2(file_mesh, comm, write_step);
+		return;
+	}
 
-	//calc offset
-	size_t offset = sizeof(lbm_file_header_t) + (comm->nb_x * comm->nb_y * size * write_step) + (rank_y * comm->nb_x + rank_x) * size;
+	//calc size (in number of entries)
+	int size = file_mesh->width * file_mesh->height;
 
-	//pwrite
-	int status = MPI_File_write_at(comm->file_handler, offset, file_mesh->cells, size, MPI_CHAR, MPI_STATUS_IGNORE);
+	//calc offset, in entries of the file view, each frame expose exactly our tile
+	MPI_Offset offset = (MPI_Offset)size * write_step;
+
+	//collective non-blocking write, it completes while we compute the next steps
+	int status = MPI_File_iwrite_at_all(comm->file_handler, offset, file_mesh->cells, 2 * size, MPI_FLOAT, &file_mesh->requests[file_mesh->current]);
 	if (status != MPI_SUCCESS)
 		fatal("Fail to fully write data into file !");
+
+	//fill the other buffer next time
+	file_mesh->current = (file_mesh->current + 1) % LBM_SAVE_BUFFERS;
+	file_mesh->cells = file_mesh->buffers[file_mesh->current];
+}
+
+/****************************************************/
+/**
+ * Setup the file view so each rank only sees its own tile inside each frame. Frames are
+ * stored in the global column-major layout (x major, y contiguous), so tiles of any size
+ * can be written and the reader does not need to know the splitting.
+ * @param comm Communication structure to keep track of the MPI_File handler.
+**/
+void lbm_save_set_file_view(lbm_comm_t * comm)
+{
+	//vars
+	MPI_Datatype entry_type;
+	MPI_Datatype tile_type;
+	int sizes[2] = {MESH_WIDTH, MESH_HEIGHT};
+	int subsizes[2] = {lbm_comm_inner_width(comm), lbm_comm_inner_height(comm)};
+	int starts[2] = {lbm_comm_inner_x(comm), lbm_comm_inner_y(comm)};
+
+	//one entry is two floats
+	MPI_Type_contiguous(2, MPI_FLOAT, &entry_type);
+	MPI_Type_commit(&entry_type);
+
+	//our tile in a frame, the extent is the full frame so frames follow each other,
+	//tiles of a 3D mesh not crossing the saved plane write nothing through any view
+	if (lbm_save_local_plane(comm) < 0)
+		MPI_Type_dup(entry_type, &tile_type);
+	else
+		MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, entry_type, &tile_type);
+	MPI_Type_commit(&tile_type);
+
+	//apply
+	int status = MPI_File_set_view(comm->file_handler, sizeof(lbm_file_header_t), entry_type, tile_type, "native", MPI_INFO_NULL);
+	if (status != MPI_SUCCESS)
+		fatal("Fail to setup the view of the output file !");
+
+	//the view keep its own reference
+	MPI_Type_free(&entry_type);
+	MPI_Type_free(&tile_type);
 }
 
 /****************************************************/
@@ -145,10 +606,17 @@ void lbm_open_output_file(lbm_comm_t * comm)
 
 	//get infos
 	int rank;
-	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	MPI_Comm_rank( lbm_comm_world, &rank );
+
+	//hints to aggregate the small tiles in large writes (two-phase I/O)
+	MPI_Info info;
+	MPI_Info_create(&info);
+	MPI_Info_set(info, "collective_buffering", "true");
+	MPI_Info_set(info, "romio_cb_write", "enable");
 
 	//open result file
-	int status = MPI_File_open(MPI_COMM_WORLD, RESULT_FILENAME, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &comm->file_handler);
+	int status = MPI_File_open(lbm_comm_world, RESULT_FILENAME, MPI_MODE_RDWR | MPI_MODE_CREATE, info, &comm->file_handler);
+	MPI_Info_free(&info);
 
 	//errors
 	if (status != MPI_SUCCESS)
@@ -157,9 +625,24 @@ void lbm_open_output_file(lbm_comm_t * comm)
 		abort();
 	}
 
+	//version 2 is written by the master only, at the byte level
+	if (RESULT_VERSION >= 2) {
+		if (rank == 0) {
+			lbm_file_header_v2_t header;
+			lbm_save_build_header_v2(&header);
+			status = MPI_File_write_at(comm->file_handler, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+			if (status != MPI_SUCCESS)
+				fatal("Failed to write header in output file !");
+		}
+		return;
+	}
+
 	//write header
 	if (rank == 0) {
 		printf("write header \n");
 		lbm_save_file_header(comm);
 	}
+
+	//set the file view
+	lbm_save_set_file_view(comm);
 }
@@ -17,11 +17,53 @@
 #include "lbm_struct.h"
 #include "lbm_save.h"
 
+/****************************************************/
+/** Number of output buffers, one is filled while the other one is written. **/
+#define LBM_SAVE_BUFFERS 2
+/** Compression level of zlib, favor the speed as the master compress while the others wait. **/
+#define LBM_SAVE_ZLIB_LEVEL 1
+
 /****************************************************/
 typedef struct lbm_file_mesh_s {
+	/** Buffer to fill for the next write (one of buffers). **/
 	lbm_file_entry_t * cells;
 	int width;
 	int height;
+	/** Local Z position of the saved plane (mid depth of the 3D mesh, 0 in 2D), -1 if not owned. **/
+	int plane;
+	/** Output buffers used in turn. **/
+	lbm_file_entry_t * buffers[LBM_SAVE_BUFFERS];
+	/** Pending non-blocking write of each buffer (MPI_REQUEST_NULL if none). **/
+	MPI_Request requests[LBM_SAVE_BUFFERS];
+	/** Index of the buffer pointed by cells. **/
+	int current;
+	//////////////////// VERSION 2 FORMAT (MASTER ONLY) /////////////////////////
+	/** Header of the version 2 file, describe the saved region and the encoding. **/
+	lbm_file_header_v2_t header_v2;
+	/** Number of floats sent by each rank to the master. **/
+	int * counts;
+	/** Position of the tile of each rank in the gather buffer (in floats). **/
+	int * displs;
+	/** Position and size of the tile of each rank (x, y, width, height). **/
+	int * tiles;
+	/** Tiles received from all the ranks. **/
+	lbm_file_entry_t * gather;
+	/** Full frame rebuilt from the tiles. **/
+	lbm_file_entry_t * frame;
+	/** Saved region of the frame after quantization. **/
+	void * packed;
+	/** Encoded frame to write. **/
+	void * encoded;
+	/** Size of the encoded buffer. **/
+	size_t encoded_size;
+	/** Offset of each written frame. **/
+	uint64_t * index;
+	/** Number of written frames. **/
+	int frames;
+	/** Number of entries allocated in index. **/
+	int max_frames;
+	/** Where to write the next frame. **/
+	MPI_Offset offset;
 } lbm_file_mesh_t;
 
 /****************************************************/
@@ -29,9 +71,13 @@ void lbm_save_mesh_init(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm);
 void lbm_save_mesh_release(lbm_file_mesh_t * file_mesh);
 void lbm_save_fill_mesh(lbm_file_mesh_t * file_mesh, const lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type);
 void lbm_save_write_mesh(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm, int rank_x, int rank_y, int write_step);
+void lbm_save_flush(lbm_file_mesh_t * file_mesh);
+void lbm_save_close(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm);
+void lbm_save_resume(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm, int first_write_step);
 
 /****************************************************/
 void lbm_save_file_header(lbm_comm_t * comm);
+void lbm_save_set_file_view(lbm_comm_t * comm);
 void lbm_open_output_file(lbm_comm_t * comm);
 
 #endif //LBM_SAVE_H
@@ -0,0 +1,313 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#include <assert.h>
+#include <stdlib.h>
+#include <mpi.h>
+#include "lbm_phys.h"
+#include "lbm_sparse.h"
+#include "exercises.h"
+#include "lbm_timer.h"
+
+/****************************************************/
+/**
+ * Indique si une maille doit être calculée : toutes en mode exact, sinon
+ * (LBM_SPARSE_SURFACE) les mailles non solides et les mailles solides ayant au moins une
+ * voisine non solide dans le maillage local.
+**/
+static int lbm_sparse_is_active(const lbm_mesh_type_t * mesh_type, int i, int j)
+{
+	//vars
+	int k;
+	int ii,jj;
+
+	//fluid, open boundary, or any solid cell in exact mode
+	if (SPARSE_MODE != LBM_SPARSE_SURFACE || !lbm_cell_type_t_is_solid(mesh_type, i, j))
+		return 1;
+
+	//solid cell touching the fluid
+	for ( k = 1 ; k < DIRECTIONS ; k++)
+	{
+		ii = i + direction_matrix[k][0];
+		jj = j + direction_matrix[k][1];
+		if (ii >= 0 && ii < mesh_type->width && jj >= 0 && jj < mesh_type->height)
+			if (!lbm_cell_type_t_is_solid(mesh_type, ii, jj))
+				return 1;
+	}
+
+	return 0;
+}
+
+/****************************************************/
+/**
+ * Construit les listes de mailles et la table des voisins du mode creux à partir des
+ * types de mailles. Doit être appelé après l'initialisation des obstacles et des bords
+ * et après lbm_phys_boundary_build() dont il reprend le profil entrant.
+ * @param mesh_type Types des mailles, reçoit la description creuse.
+**/
+void lbm_sparse_build(lbm_mesh_type_t * mesh_type)
+{
+	//vars
+	int i,j,k,c;
+	int ii,jj;
+	int width = mesh_type->width;
+	int height = mesh_type->height;
+	char * active;
+
+	//errors
+	assert(mesh_type != NULL);
+	assert(mesh_type->boundary != NULL);
+
+	//rebuild
+	if (mesh_type->sparse != NULL)
+		lbm_sparse_release(mesh_type);
+
+	//allocate
+	lbm_sparse_t * sparse = calloc(1, sizeof(lbm_sparse_t));
+	active = malloc(width * height);
+	if (sparse == NULL || active == NULL)
+		fatal("Fail to allocate the sparse mesh description !");
+
+	//mark active cells and count each kind
+	for ( i = 0 ; i < width ; i++)
+	{
+		for ( j = 0 ; j < height ; j++)
+		{
+			active[i * height + j] = lbm_sparse_is_active(mesh_type, i, j);
+			if (!active[i * height + j])
+				continue;
+			sparse->nb_cells++;
+			switch (*lbm_cell_type_t_get_cell(mesh_type, i, j))
+			{
+				case CELL_BOUNCE_BACK:
+					sparse->nb_bounce_back++;
+					break;
+				case CELL_LEFT_IN:
+					sparse->nb_inflow++;
+					sparse->nb_collide++;
+					break;
+				case CELL_RIGHT_OUT:
+					sparse->nb_outflow++;
+					sparse->nb_collide++;
+					break;
+				default:
+					sparse->nb_collide++;
+					break;
+			}
+		}
+	}
+
+	//allocate lists
+	sparse->cells = malloc(sizeof(int) * sparse->nb_cells);
+	sparse->neighbors = malloc(sizeof(int) * sparse->nb_cells * DIRECTIONS);
+	sparse->collide = malloc(sizeof(int) * sparse->nb_collide);
+	sparse->bounce_back = malloc(sizeof(int) * sparse->nb_bounce_back);
+	sparse->inflow = malloc(sizeof(int) * sparse->nb_inflow);
+	sparse->inflow_velocity = malloc(sizeof(double) * sparse->nb_inflow);
+	sparse->outflow = malloc(sizeof(int) * sparse->nb_outflow);
+
+	//fill lists in memory order
+	sparse->nb_cells = 0;
+	sparse->nb_collide = 0;
+	sparse->nb_bounce_back = 0;
+	sparse->nb_inflow = 0;
+	sparse->nb_outflow = 0;
+	for ( i = 0 ; i < width ; i++)
+	{
+		for ( j = 0 ; j < height ; j++)
+		{
+			//skip deep solid (surface mode)
+			int pos = i * height + j;
+			if (!active[pos])
+				continue;
+
+			//neighbor table, drop what goes out of the local mesh or inside the solid
+			c = sparse->nb_cells++;
+			sparse->cells[c] = pos;
+			for ( k = 0 ; k < DIRECTIONS ; k++)
+			{
+				ii = i + direction_matrix[k][0];
+				jj = j + direction_matrix[k][1];
+				if (ii >= 0 && ii < width && jj >= 0 && jj < height && active[ii * height + jj])
+					sparse->neighbors[c * DIRECTIONS + k] = ii * height + jj;
+				else
+					sparse->neighbors[c * DIRECTIONS + k] = -1;
+			}
+
+			//lists per type
+			switch (*lbm_cell_type_t_get_cell(mesh_type, i, j))
+			{
+				case CELL_BOUNCE_BACK:
+					sparse->bounce_back[sparse->nb_bounce_back++] = pos;
+					break;
+				case CELL_LEFT_IN:
+					sparse->inflow_velocity[sparse->nb_inflow] = mesh_type->boundary->inflow_profile[j];
+					sparse->inflow[sparse->nb_inflow++] = pos;
+					sparse->collide[sparse->nb_collide++] = pos;
+					break;
+				case CELL_RIGHT_OUT:
+					sparse->outflow[sparse->nb_outflow++] = pos;
+					sparse->collide[sparse->nb_collide++] = pos;
+					break;
+				default:
+					sparse->collide[sparse->nb_collide++] = pos;
+					break;
+			}
+		}
+	}
+
+	//attach
+	free(active);
+	mesh_type->sparse = sparse;
+}
+
+/****************************************************/
+/**
+ * Libère la description creuse du maillage.
+**/
+void lbm_sparse_release(lbm_mesh_type_t * mesh_type)
+{
+	//nothing to do
+	if (mesh_type->sparse == NULL)
+		return;
+
+	//free
+	free(mesh_type->sparse->cells);
+	free(mesh_type->sparse->neighbors);
+	free(mesh_type->sparse->collide);
+	free(mesh_type->sparse->bounce_back);
+	free(mesh_type->sparse->inflow);
+	free(mesh_type->sparse->inflow_velocity);
+	free(mesh_type->sparse->outflow);
+	free(mesh_type->sparse);
+	mesh_type->sparse = NULL;
+}
+
+/****************************************************/
+/**
+ * Affiche sur le maître la part de mailles calculées sur l'ensemble des processus.
+ * Fonction collective.
+**/
+void lbm_sparse_print_stats(const lbm_mesh_type_t * mesh_type)
+{
+	//vars
+	int rank;
+	long local[3] = {0, 0, 0};
+	long global[3];
+
+	//count
+	local[0] = (long)mesh_type->width * mesh_type->height;
+	if (mesh_type->sparse != NULL) {
+		local[1] = mesh_type->sparse->nb_cells;
+		local[2] = mesh_type->sparse->nb_bounce_back;
+	}
+
+	//reduce and print
+	MPI_Comm_rank(lbm_comm_world, &rank);
+	MPI_Reduce(local, global, 3, MPI_LONG, MPI_SUM, RANK_MASTER, lbm_comm_world);
+	if (rank == RANK_MASTER)
+		printf("Sparse mode: %ld / %ld cells computed (%.1f%%), %ld in the obstacle\n",
+			global[1], global[0], 100.0 * global[1] / global[0], global[2]);
+}
+
+/****************************************************/
+/**
+ * Applique les conditions de bords et les réflexions sur l'obstacle à partir des
+ * listes, sans tester le type de chaque maille.
+**/
+void lbm_sparse_special_cells(lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
+{
+	//vars
+	int c;
+	const lbm_sparse_t * sparse = mesh_type->sparse;
+
+	//obstacle surface
+	#pragma omp for schedule(static)
+	for ( c = 0 ; c < sparse->nb_bounce_back ; c++)
+		lbm_phys_bounce_back(mesh->cells + (size_t)sparse->bounce_back[c] * DIRECTIONS);
+
+	//input wall
+	#pragma omp for schedule(static)
+	for ( c = 0 ; c < sparse->nb_inflow ; c++)
+		lbm_phys_inflow_zou_he(mesh->cells + (size_t)sparse->inflow[c] * DIRECTIONS, sparse->inflow_velocity[c]);
+
+	//output wall
+	#pragma omp for schedule(static)
+	for ( c = 0 ; c < sparse->nb_outflow ; c++)
+		lbm_phys_outflow_zou_he_const_density(mesh->cells + (size_t)sparse->outflow[c] * DIRECTIONS);
+}
+
+/****************************************************/
+/**
+ * Collision sur les mailles fluides puis sur celles de l'obstacle après leur réflexion,
+ * comme le fait la boucle dense sur tout le maillage.
+**/
+void lbm_sparse_collision(lbm_mesh_t * mesh_out, const lbm_mesh_t * mesh_in, const lbm_mesh_type_t * mesh_type)
+{
+	//vars
+	const lbm_sparse_t * sparse = mesh_type->sparse;
+
+	//fluid
+	lbm_phys_collision_list(mesh_out, mesh_in, sparse->collide, sparse->nb_collide);
+
+	//obstacle
+	lbm_phys_collision_list(mesh_out, mesh_in, sparse->bounce_back, sparse->nb_bounce_back);
+}
+
+/****************************************************/
+/**
+ * Propagation des densités vers les mailles voisines avec la table des voisins.
+ * @param mesh_out Maillage de sortie.
+ * @param mesh_in Maillage d'entrée (ne doivent pas être les mêmes).
+**/
+void lbm_sparse_propagation(lbm_mesh_t * mesh_out, const lbm_mesh_t * mesh_in, const lbm_mesh_type_t * mesh_type)
+{
+	//vars
+	int c,k;
+	const lbm_sparse_t * sparse = mesh_type->sparse;
+
+	//loop on computed cells
+	#pragma omp for schedule(static) private(k)
+	for ( c = 0 ; c < sparse->nb_cells ; c++)
+	{
+		const lbm_real_t * cell_in = mesh_in->cells + (size_t)sparse->cells[c] * DIRECTIONS;
+		const int * neighbors = sparse->neighbors + (size_t)c * DIRECTIONS;
+		for ( k = 0 ; k < DIRECTIONS ; k++)
+			if (neighbors[k] >= 0)
+				mesh_out->cells[(size_t)neighbors[k] * DIRECTIONS + k] = cell_in[k];
+	}
+}
+
+/****************************************************/
+/**
+ * Pas de temps en mode creux, les communications sont celles de l'exercice choisi.
+ * Peut être appelé dans une région parallèle OpenMP (seul le maître communique).
+**/
+void lbm_sparse_do_step(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh)
+{
+	//compute special actions (border, obstacle...)
+	double start = lbm_timer_now();
+	lbm_sparse_special_cells( mesh, mesh_type, comm);
+	lbm_timer_add(LBM_TIMER_SPECIAL_CELLS, start);
+
+	//compute lbm_phys_collision term
+	start = lbm_timer_now();
+	lbm_sparse_collision( temp_mesh, mesh, mesh_type);
+	lbm_timer_add(LBM_TIMER_COLLISION, start);
+
+	//propagate values from node to neighboors
+	#pragma omp master
+	lbm_comm_ghost_exchange_ex_select( comm, temp_mesh );
+	#pragma omp barrier
+
+	//compute fuild displacement from cells to cells
+	start = lbm_timer_now();
+	lbm_sparse_propagation( mesh, temp_mesh, mesh_type);
+	lbm_timer_add(LBM_TIMER_PROPAGATION, start);
+}
@@ -0,0 +1,63 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef LBM_SPARSE_H
+#define LBM_SPARSE_H
+
+/****************************************************/
+#include "lbm_struct.h"
+#include "lbm_comm.h"
+
+/****************************************************/
+/**
+ * Sparse description of the local mesh. The cells stay in the dense mesh storage
+ * and are visited through lists of positions (x * height + y) and a precomputed
+ * neighbor table. LBM_SPARSE_EXACT keeps every cell so the results match the dense
+ * loops, LBM_SPARSE_SURFACE never computes the obstacle cells deep inside a solid.
+**/
+typedef struct lbm_sparse_s
+{
+	/** Number of computed cells (fluid, boundaries and obstacle surface). **/
+	int nb_cells;
+	/** Position of the computed cells in the dense mesh, in memory order. **/
+	int * cells;
+	/** Destination of each direction of each computed cell (nb_cells * DIRECTIONS), -1 to drop. **/
+	int * neighbors;
+	/** Number of cells on which to apply the collision. **/
+	int nb_collide;
+	/** Cells on which to apply the collision (fluid, inflow and outflow cells). **/
+	int * collide;
+	/** Number of computed obstacle cells. **/
+	int nb_bounce_back;
+	/** Computed obstacle cells (reflexion then collision), only the ones touching the fluid in surface mode. **/
+	int * bounce_back;
+	/** Number of Zou/He inflow cells. **/
+	int nb_inflow;
+	/** Zou/He inflow cells. **/
+	int * inflow;
+	/** Inflow velocity of each inflow cell, from the precomputed profile. **/
+	double * inflow_velocity;
+	/** Number of Zou/He outflow cells. **/
+	int nb_outflow;
+	/** Zou/He outflow cells. **/
+	int * outflow;
+} lbm_sparse_t;
+
+/****************************************************/
+void lbm_sparse_build(lbm_mesh_type_t * mesh_type);
+void lbm_sparse_release(lbm_mesh_type_t * mesh_type);
+void lbm_sparse_print_stats(const lbm_mesh_type_t * mesh_type);
+
+/****************************************************/
+void lbm_sparse_special_cells(lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
+void lbm_sparse_collision(lbm_mesh_t * mesh_out, const lbm_mesh_t * mesh_in, const lbm_mesh_type_t * mesh_type);
+void lbm_sparse_propagation(lbm_mesh_t * mesh_out, const lbm_mesh_t * mesh_in, const lbm_mesh_type_t * mesh_type);
+void lbm_sparse_do_step(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh);
+
+#endif //LBM_SPARSE_H
@@ -17,15 +17,20 @@
  * @param mesh Mesh to init.
  * @param width With of the local mesh accounting the ghost cells.
  * @param height Height of the local mesh accounting the ghost cells.
+ * @param depth Depth of the local mesh accounting the ghost cells (1 for the 2D lattices).
 **/
-void lbm_mesh_init( lbm_mesh_t * mesh, int width,  int height )
+void lbm_mesh_init( lbm_mesh_t * mesh, int width,  int height, int depth )
 {
+	//vars
+	int i,k;
+
 	//setup params
 	mesh->width = width;
 	mesh->height = height;
+	mesh->depth = depth;
 
 	//alloc cells memory
-	mesh->cells = malloc( width * height  * DIRECTIONS * sizeof( double ) );
+	mesh->cells = malloc( (size_t)width * height * depth * DIRECTIONS * sizeof( lbm_real_t ) );
 
 	//errors
 	if( mesh->cells == NULL )
@@ -33,6 +38,13 @@ void lbm_mesh_init( lbm_mesh_t * mesh, int width,  int height )
 		perror( "malloc" );
 		abort();
 	}
+
+	//first touch with the same static column split than the compute loops so the pages
+	//land on the NUMA node of the thread which will use them
+	#pragma omp parallel for schedule(static) private(k)
+	for ( i = 0 ; i < width ; i++ )
+		for ( k = 0 ; k < height * depth * DIRECTIONS ; k++ )
+			mesh->cells[ (size_t)i * height * depth * DIRECTIONS + k ] = 0.0;
 }
 
 /****************************************************/
@@ -42,6 +54,7 @@ void lbm_mesh_release( lbm_mesh_t * mesh )
 	//reset values
 	mesh->width = 0;
 	mesh->height = 0;
+	mesh->depth = 0;
 
 	//free memory
 	free( mesh->cells );
@@ -54,18 +67,23 @@ void lbm_mesh_release( lbm_mesh_t * mesh )
  * @param mesh Cell type mesh to initilize.
  * @param width Width of the local mesh, accounting the ghost cells.
  * @param height Height of the local mesh, accounting the ghost cells.
+ * @param depth Depth of the local mesh, accounting the ghost cells (1 for the 2D lattices).
 **/
-void lbm_mesh_type_t_init( lbm_mesh_type_t * meshtype, int width,  int height )
+void lbm_mesh_type_t_init( lbm_mesh_type_t * meshtype, int width,  int height, int depth )
 {
 	//setup params
 	meshtype->width = width;
 	meshtype->height = height;
+	meshtype->depth = depth;
+	meshtype->sparse = NULL;
+	meshtype->boundary = NULL;
 
 	//alloc cells memory
-	meshtype->types = malloc( (width + 2) * height * sizeof( lbm_cell_type_t ) );
+	meshtype->types = malloc( (size_t)(width + 2) * height * depth * sizeof( lbm_cell_type_store_t ) );
+	meshtype->solid = calloc( ((size_t)width * height * depth + 63) / 64, sizeof( uint64_t ) );
 
 	//errors
-	if( meshtype->types == NULL )
+	if( meshtype->types == NULL || meshtype->solid == NULL )
 	{
 		perror( "malloc" );
 		abort();
@@ -79,10 +97,13 @@ void lbm_mesh_type_t_release( lbm_mesh_type_t * mesh )
 	//reset values
 	mesh->width = 0;
 	mesh->height = 0;
+	mesh->depth = 0;
 
 	//free memory
 	free( mesh->types );
+	free( mesh->solid );
 	mesh->types = NULL;
+	mesh->solid = NULL;
 }
 
 /****************************************************/
@@ -16,10 +16,23 @@
 
 /****************************************************/
 /**
- * A cell is an array of DIRECTIONS doubles to store the microscopic
+ * Type used to store the microscopic probabilities (see LBM_PRECISION_NAME) and
+ * the matching MPI type to exchange them.
+**/
+#if LBM_PRECISION_ID == 0
+	typedef double lbm_real_t;
+	#define LBM_MPI_REAL MPI_DOUBLE
+#else
+	typedef float lbm_real_t;
+	#define LBM_MPI_REAL MPI_FLOAT
+#endif
+
+/****************************************************/
+/**
+ * A cell is an array of DIRECTIONS lbm_real_t to store the microscopic
  * probabilities (f_i)
 **/
-typedef double * lbm_mesh_cell_t;
+typedef lbm_real_t * lbm_mesh_cell_t;
 /** Represent a vector to handle the macroscopic verlocity. **/
 typedef double Vector[DIMENSIONS];
 
@@ -31,13 +44,26 @@ typedef double Vector[DIMENSIONS];
 typedef struct lbm_mesh_s
 {
 	/** Cells of the mesh (MESH_WIDTH * MESG_HEIGHT). **/
-	double * cells;
+	lbm_real_t * cells;
 	/** Width of the local mesh (accounting the ghost cells). **/
 	int width;
 	/** Height of the local mesh (accounting the ghost cells). **/
 	int height;
+	/** Depth of the local mesh (accounting the ghost cells), 1 for the 2D lattices. **/
+	int depth;
 } lbm_mesh_t;
 
+/****************************************************/
+/**
+ * Depth of a mesh or type mesh, a constant with the 2D lattices so the compiler keeps
+ * the historical (x * height + y) addressing.
+**/
+#if DIMENSIONS == 3
+	#define LBM_MESH_DEPTH(mesh) ((mesh)->depth)
+#else
+	#define LBM_MESH_DEPTH(mesh) 1
+#endif
+
 /****************************************************/
 /**
  * Define the type of the cell to know what compute function to apply.
@@ -54,6 +80,14 @@ typedef enum lbm_cell_type_e
 	CELL_RIGHT_OUT
 } lbm_cell_type_t;
 
+/****************************************************/
+/** Storage of a cell type in the type map, one byte holding a lbm_cell_type_t value. **/
+typedef uint8_t lbm_cell_type_store_t;
+
+/****************************************************/
+/** Sparse description of the mesh, defined in lbm_sparse.h. **/
+struct lbm_sparse_s;
+
 /****************************************************/
 /**
  * Matrix storing the type of each cell of the mesh (accounting ghost cells).
@@ -61,11 +95,19 @@ typedef enum lbm_cell_type_e
 typedef struct lbm_mesh_type_s
 {
 	/** Store the type of the local cells (MESH_WIDTH * MESH_HEIGHT). **/
-	lbm_cell_type_t * types;
+	lbm_cell_type_store_t * types;
+	/** Bitmask of the bounce back cells (bit (x * height + y) * depth + z), built with the boundary lists. **/
+	uint64_t * solid;
 	/** width of the local type mesh (mailles fantome comprises). **/
 	int width;
 	/** Height of the local type mesh (mailles fantome comprises). **/
 	int height;
+	/** Depth of the local type mesh (mailles fantome comprises), 1 for the 2D lattices. **/
+	int depth;
+	/** Lists of cells to compute in sparse mode, NULL to compute the full mesh. **/
+	struct lbm_sparse_s * sparse;
+	/** Lists of boundary cells, built by lbm_phys_boundary_build() once the types are set. **/
+	struct lbm_boundary_s * boundary;
 } lbm_mesh_type_t;
 
 /****************************************************/
@@ -93,24 +135,94 @@ typedef struct lbm_file_entry_s
 } lbm_file_entry_t;
 
 /****************************************************/
-/** Use to read the output file. **/
+/**
+ * Header of the version 2 output file. It is followed by the frames, each one
+ * prefixed by a lbm_file_frame_v2_t, then by the frame index (one uint64_t
+ * offset per frame) and a lbm_file_trailer_v2_t closing the file.
+**/
+typedef struct lbm_file_header_v2_s
+{
+	/** Magick number to check the type of file (RESULT_MAGICK_V2). **/
+	uint32_t magick;
+	/** Version of the format. **/
+	uint32_t version;
+	/** Width of the global mesh (no ghost cells). **/
+	uint32_t mesh_width;
+	/** Height of the global mesh (no ghost cells). **/
+	uint32_t mesh_height;
+	/** Global position along X of the first saved cell. **/
+	uint32_t roi_x;
+	/** Global position along Y of the first saved cell. **/
+	uint32_t roi_y;
+	/** Number of saved cells along X in each frame. **/
+	uint32_t width;
+	/** Number of saved cells along Y in each frame. **/
+	uint32_t height;
+	/** Distance between two saved cells in both directions. **/
+	uint32_t decimate;
+	/** Compression of the frames (lbm_output_codec_t). **/
+	uint32_t codec;
+	/** If not 0, values are stored as int32_t quantized with 2 * error_bound steps. **/
+	uint32_t quantized;
+	/** Maximal absolute error of the quantization. **/
+	float error_bound;
+} lbm_file_header_v2_t;
+
+/****************************************************/
+/** Prefix of each frame in the version 2 output file. **/
+typedef struct lbm_file_frame_v2_s
+{
+	/** Write step of the frame. **/
+	uint32_t step;
+	/** Size in bytes of the (compressed) frame data following this prefix. **/
+	uint32_t size;
+} lbm_file_frame_v2_t;
+
+/****************************************************/
+/** End of the version 2 output file, to find the frame index. **/
+typedef struct lbm_file_trailer_v2_s
+{
+	/** Position of the frame index in the file. **/
+	uint64_t index_offset;
+	/** Number of frames in the index. **/
+	uint32_t frames;
+	/** Magick number (RESULT_MAGICK_V2) to check the file was closed properly. **/
+	uint32_t magick;
+} lbm_file_trailer_v2_t;
+
+/****************************************************/
+/** Quantized value used to store the obstacle cells (NaN). **/
+#define LBM_FILE_QUANTIZED_NAN INT32_MIN
+
+/****************************************************/
+/** Use to read the output file, mapped in memory. **/
 typedef struct lbm_data_file_s
 {
-	/** Keep track of the file pointer **/
-	FILE * fp;
+	/** File descriptor of the mapped file. **/
+	int fd;
+	/** Content of the file. **/
+	const uint8_t * data;
+	/** Size of the file in bytes. **/
+	size_t size;
 	/** Content of the headers. **/
 	lbm_file_header_t header;
-	/** Loaded data for the current frame. **/
-	lbm_file_entry_t * entries;
+	/** Version of the file format (1 or 2). **/
+	int version;
+	/** Content of the version 2 header. **/
+	lbm_file_header_v2_t header_v2;
+	/** Offset of each frame in the file. **/
+	uint64_t * index;
+	/** Number of complete frames. **/
+	int frames;
 } lbm_data_file_t;
 
 
 /****************************************************/
-void lbm_mesh_init( lbm_mesh_t * mesh, int width,  int height );
+void lbm_mesh_init( lbm_mesh_t * mesh, int width,  int height, int depth );
 void lbm_mesh_release( lbm_mesh_t * mesh );
 
 /****************************************************/
-void lbm_mesh_type_t_init( lbm_mesh_type_t * mesh, int width,  int height );
+void lbm_mesh_type_t_init( lbm_mesh_type_t * mesh, int width,  int height, int depth );
 void lbm_mesh_type_t_release( lbm_mesh_type_t * mesh );
 
 /****************************************************/
@@ -119,14 +231,28 @@ void warning(const char * message);
 
 /****************************************************/
 /**
- * Function used to get the address of a given cell in the local mesh.
+ * Function used to get the address of a given cell in the local mesh. With the 3D
+ * lattices it is the first cell (z = 0) of the contiguous column along Z.
+ * @param mesh Pointer to the mesh struct.
+ * @param x Position of the cell in the local mesh (accounting ghost cells)
+ * @param y Position of the cell in the local mesh (accounting ghost cells)
+**/
+static inline lbm_real_t * lbm_mesh_get_cell( const lbm_mesh_t * mesh, int x, int y)
+{
+	return &mesh->cells[ (size_t)(x * mesh->height + y) * LBM_MESH_DEPTH(mesh) * DIRECTIONS ];
+}
+
+/****************************************************/
+/**
+ * Function used to get the address of a given cell in the local 3D mesh.
  * @param mesh Pointer to the mesh struct.
  * @param x Position of the cell in the local mesh (accounting ghost cells)
  * @param y Position of the cell in the local mesh (accounting ghost cells)
+ * @param z Position of the cell in the local mesh (accounting ghost cells)
 **/
-static inline double * lbm_mesh_get_cell( const lbm_mesh_t * mesh, int x, int y)
+static inline lbm_real_t * lbm_mesh_get_cell_3d( const lbm_mesh_t * mesh, int x, int y, int z)
 {
-	return &mesh->cells[ (x * mesh->height + y) * DIRECTIONS ];
+	return &mesh->cells[ ((size_t)(x * mesh->height + y) * LBM_MESH_DEPTH(mesh) + z) * DIRECTIONS ];
 }
 
 /****************************************************/
@@ -136,9 +262,37 @@ static inline double * lbm_mesh_get_cell( const lbm_mesh_t * mesh, int x, int y)
  * @param x Position of the cell in the local mesh (accounting ghost cells)
  * @param y Position of the cell in the local mesh (accounting ghost cells)
 **/
-static inline lbm_cell_type_t * lbm_cell_type_t_get_cell( const lbm_mesh_type_t * meshtype, int x, int y)
+static inline lbm_cell_type_store_t * lbm_cell_type_t_get_cell( const lbm_mesh_type_t * meshtype, int x, int y)
+{
+	return &meshtype->types[ (size_t)(x * meshtype->height + y) * LBM_MESH_DEPTH(meshtype) ];
+}
+
+/****************************************************/
+/**
+ * Function used to get the address of a given cell type in the local 3D mesh.
+ * @param z Position of the cell in the local mesh (accounting ghost cells)
+**/
+static inline lbm_cell_type_store_t * lbm_cell_type_t_get_cell_3d( const lbm_mesh_type_t * meshtype, int x, int y, int z)
+{
+	return &meshtype->types[ (size_t)(x * meshtype->height + y) * LBM_MESH_DEPTH(meshtype) + z ];
+}
+
+/****************************************************/
+/**
+ * Tell if a cell is a bounce back cell from the solid bitmask, so the loops which only
+ * need this information read one bit per cell instead of the type map.
+**/
+static inline int lbm_cell_type_t_is_solid_3d( const lbm_mesh_type_t * meshtype, int x, int y, int z)
+{
+	size_t pos = ((size_t)x * meshtype->height + y) * LBM_MESH_DEPTH(meshtype) + z;
+	return (meshtype->solid[pos / 64] >> (pos % 64)) & 1;
+}
+
+/****************************************************/
+/** Same as lbm_cell_type_t_is_solid_3d() on the first cell of the column (z = 0). **/
+static inline int lbm_cell_type_t_is_solid( const lbm_mesh_type_t * meshtype, int x, int y)
 {
-	return &meshtype->types[ x * meshtype->height + y];
+	return lbm_cell_type_t_is_solid_3d(meshtype, x, y, 0);
 }
 
 #endif //LBM_STRUCT_H
@@ -0,0 +1,159 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#include <stdio.h>
+#include <mpi.h>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+#include "lbm_comm.h"
+#include "lbm_timer.h"
+
+/****************************************************/
+/** Noms des phases pour l'affichage. **/
+static const char * lbm_timer_names[LBM_TIMER_PHASES] = {
+	"special_cells",
+	"collision",
+	"propagation",
+	"exchange_pack",
+	"exchange_wait",
+	"save",
+	"checkpoint",
+	"analysis",
+	"balance",
+	"refine"
+};
+
+/****************************************************/
+/** Temps cumulé de chaque phase sur ce processus. **/
+static double lbm_timer_totals[LBM_TIMER_PHASES];
+/** Date de début de l'échange en cours. **/
+static double lbm_timer_exchange_start = 0.0;
+/** Temps d'attente cumulé au début de l'échange en cours. **/
+static double lbm_timer_exchange_waited = 0.0;
+
+/****************************************************/
+/**
+ * Date courante en secondes.
+**/
+double lbm_timer_now(void)
+{
+	return MPI_Wtime();
+}
+
+/****************************************************/
+/**
+ * Ajoute le temps écoulé depuis start à une phase. Dans une région parallèle
+ * seul le thread maître compte : les phases finissant par une barrière, son temps
+ * est celui de l'équipe.
+**/
+void lbm_timer_add(lbm_timer_phase_t phase, double start)
+{
+	#ifdef _OPENMP
+	if (omp_get_thread_num() != 0)
+		return;
+	#endif
+	lbm_timer_totals[phase] += MPI_Wtime() - start;
+}
+
+/****************************************************/
+/**
+ * Début d'un échange des mailles fantômes. Les routines d'échange mesurent
+ * elles-mêmes leurs appels MPI bloquants avec lbm_timer_add(LBM_TIMER_EXCHANGE_WAIT).
+**/
+void lbm_timer_exchange_begin(void)
+{
+	lbm_timer_exchange_waited = lbm_timer_totals[LBM_TIMER_EXCHANGE_WAIT];
+	lbm_timer_exchange_start = MPI_Wtime();
+}
+
+/****************************************************/
+/**
+ * Fin d'un échange, le temps hors attente est compté comme de la préparation.
+**/
+void lbm_timer_exchange_end(void)
+{
+	double elapsed = MPI_Wtime() - lbm_timer_exchange_start;
+	double waited = lbm_timer_totals[LBM_TIMER_EXCHANGE_WAIT] - lbm_timer_exchange_waited;
+	lbm_timer_totals[LBM_TIMER_EXCHANGE_PACK] += elapsed - waited;
+}
+
+/****************************************************/
+/**
+ * Remet à zéro tous les compteurs.
+**/
+void lbm_timer_reset(void)
+{
+	int p;
+	for ( p = 0 ; p < LBM_TIMER_PHASES ; p++)
+		lbm_timer_totals[p] = 0.0;
+}
+
+/****************************************************/
+/**
+ * Temps cumulé d'une phase sur ce processus depuis le dernier lbm_timer_reset().
+**/
+double lbm_timer_get(lbm_timer_phase_t phase)
+{
+	return lbm_timer_totals[phase];
+}
+
+/****************************************************/
+/**
+ * Affiche sur le maître le min, la moyenne et le max de chaque phase sur les
+ * processus ainsi que le débit en millions de mailles mises à jour par seconde.
+ * Fonction collective.
+ * @param total_time Durée totale de la boucle en secondes.
+ * @param iterations Nombre de pas de temps calculés.
+ * @param cells Nombre de mailles du maillage global.
+**/
+void lbm_timer_report(double total_time, long iterations, long cells)
+{
+	//vars
+	int p;
+	int rank;
+	int comm_size;
+	double local[LBM_TIMER_PHASES + 1];
+	double min[LBM_TIMER_PHASES + 1];
+	double max[LBM_TIMER_PHASES + 1];
+	double sum[LBM_TIMER_PHASES + 1];
+
+	//local values, the last one is the time in the step itself
+	local[LBM_TIMER_PHASES] = 0.0;
+	for ( p = 0 ; p < LBM_TIMER_PHASES ; p++)
+	{
+		local[p] = lbm_timer_totals[p];
+		if (p <= LBM_TIMER_EXCHANGE_WAIT)
+			local[LBM_TIMER_PHASES] += lbm_timer_totals[p];
+	}
+
+	//reduce
+	MPI_Comm_rank(lbm_comm_world, &rank);
+	MPI_Comm_size(lbm_comm_world, &comm_size);
+	MPI_Reduce(local, min, LBM_TIMER_PHASES + 1, MPI_DOUBLE, MPI_MIN, RANK_MASTER, lbm_comm_world);
+	MPI_Reduce(local, max, LBM_TIMER_PHASES + 1, MPI_DOUBLE, MPI_MAX, RANK_MASTER, lbm_comm_world);
+	MPI_Reduce(local, sum, LBM_TIMER_PHASES + 1, MPI_DOUBLE, MPI_SUM, RANK_MASTER, lbm_comm_world);
+	if (rank != RANK_MASTER)
+		return;
+
+	//table, the imbalance is max / mean (1 when balanced)
+	printf("%-20s %12s %12s %12s %10s\n", "Phase (s)", "min", "mean", "max", "imbalance");
+	for ( p = 0 ; p <= LBM_TIMER_PHASES ; p++)
+	{
+		double mean = sum[p] / comm_size;
+		printf("%-20s %12.6f %12.6f %12.6f %10.3f\n",
+			(p < LBM_TIMER_PHASES) ? lbm_timer_names[p] : "step",
+			min[p], mean, max[p], (mean > 0.0) ? max[p] / mean : 1.0);
+	}
+
+	//rate on the full loop and on the step only (slowest rank)
+	double updates = (double)cells * iterations / 1e6;
+	printf("MLUPS: %g\n", (total_time > 0.0) ? updates / total_time : 0.0);
+	printf("MLUPS (step only): %g\n", (max[LBM_TIMER_PHASES] > 0.0) ? updates / max[LBM_TIMER_PHASES] : 0.0);
+}
@@ -0,0 +1,43 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef LBM_TIMER_H
+#define LBM_TIMER_H
+
+/****************************************************/
+/**
+ * Phases of the time loop measured separately. The halo exchange is split in the
+ * time spent blocked in MPI (waiting for the neighbors) and the remaining time
+ * (posting the requests, packing and unpacking the buffers).
+**/
+typedef enum lbm_timer_phase_e
+{
+	LBM_TIMER_SPECIAL_CELLS,
+	LBM_TIMER_COLLISION,
+	LBM_TIMER_PROPAGATION,
+	LBM_TIMER_EXCHANGE_PACK,
+	LBM_TIMER_EXCHANGE_WAIT,
+	LBM_TIMER_SAVE,
+	LBM_TIMER_CHECKPOINT,
+	LBM_TIMER_ANALYSIS,
+	LBM_TIMER_BALANCE,
+	LBM_TIMER_REFINE,
+	LBM_TIMER_PHASES
+} lbm_timer_phase_t;
+
+/****************************************************/
+double lbm_timer_now(void);
+void lbm_timer_add(lbm_timer_phase_t phase, double start);
+void lbm_timer_exchange_begin(void);
+void lbm_timer_exchange_end(void);
+void lbm_timer_reset(void);
+double lbm_timer_get(lbm_timer_phase_t phase);
+void lbm_timer_report(double total_time, long iterations, long cells);
+
+#endif //LBM_TIMER_H
@@ -30,12 +30,22 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <time.h>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
 #include "lbm_config.h"
 #include "lbm_struct.h"
 #include "lbm_phys.h"
 #include "lbm_init.h"
 #include "lbm_comm.h"
 #include "lbm_save.h"
+#include "lbm_sparse.h"
+#include "lbm_checkpoint.h"
+#include "lbm_analysis.h"
+#include "lbm_timer.h"
+#include "lbm_obstacle.h"
+#include "lbm_balance.h"
+#include "lbm_refine.h"
 #include "exercises.h"
 
 /****************************************************/
@@ -49,6 +59,12 @@ static char doc[] = "A simple simulation applying the Lattice Boltzmann Method (
 		{"exercise", 'e', "EXID",  0, "ID of the exercice to execute." },
 		{"no-out",   'n', 0,       0, "Skip output for benchmarking only compute and communications."},
 		{"scaling",  's', "FACTOR",0, "Apply weak scaling factor to increase the mesh size."},
+		{"sparse",   'S', 0,       0, "Compute the fluid and obstacle cells through lists (indirect addressing), same results as the dense mode."},
+		{"sparse-surface", 'O', 0, 0, "Sparse mode also skipping the obstacle cells not touching the fluid, results differ from the dense mode."},
+		{"restart",  'r', "FILE",  0, "Restart from the given checkpoint file."},
+		{"ghost-depth", 'g', "DEPTH", 0, "Exchange DEPTH layers of ghost cells every DEPTH steps (exercise 10)."},
+		{"ensemble", 'E', "FILE",  0, "Run the cases of FILE (one line of config overrides per case) in one job."},
+		{"group-size", 'G', "RANKS", 0, "Number of ranks running each case of the ensemble (default 1)."},
 		{ 0 }
 	};
 #else
@@ -57,15 +73,27 @@ static char doc[] = "A simple simulation applying the Lattice Boltzmann Method (
 			{ "exercise",   required_argument,      NULL,           'e' },
 			{ "scaling",    required_argument,      NULL,           's' },
 			{ "no-out",     no_argument,            NULL,           'n' },
+			{ "sparse",     no_argument,            NULL,           'S' },
+			{ "sparse-surface", no_argument,        NULL,           'O' },
+			{ "restart",    required_argument,      NULL,           'r' },
+			{ "ghost-depth",required_argument,      NULL,           'g' },
+			{ "ensemble",   required_argument,      NULL,           'E' },
+			{ "group-size", required_argument,      NULL,           'G' },
 			{ "help",       no_argument,            NULL,           '?' },
 			{ NULL,         0,                      NULL,           0 }
 	};
-	static const char * short_options = "[-c CONFIG] [-e EXID] [-s SCALE] [-n]";
+	static const char * short_options = "[-c CONFIG] [-e EXID] [-s SCALE] [-n] [-S] [-O] [-r CHECKPOINT] [-g DEPTH] [-E CASES] [-G RANKS]";
 	static const char * help_message = 
 		"-c/--config   {FILE}    Input config file to use.\n"
 		"-e/--exercise {EXID}    ID of the exercise to execute\n"
 		"-n/--no-out             Skip output for benchmarking only compute and communications.\n"
-		"-s/--scaling  {FACTOR}  Apply weak scaling factor to increase the mesh size.\n";
+		"-s/--scaling  {FACTOR}  Apply weak scaling factor to increase the mesh size.\n"
+		"-S/--sparse             Compute the fluid and obstacle cells through lists (indirect addressing), same results as the dense mode.\n"
+		"-O/--sparse-surface     Sparse mode also skipping the obstacle cells not touching the fluid, results differ from the dense mode.\n"
+		"-r/--restart  {FILE}    Restart from the given checkpoint file.\n"
+		"-g/--ghost-depth {DEPTH} Exchange DEPTH layers of ghost cells every DEPTH steps (exercise 10).\n"
+		"-E/--ensemble {FILE}    Run the cases of FILE (one line of config overrides per case) in one job.\n"
+		"-G/--group-size {RANKS} Number of ranks running each case of the ensemble (default 1).\n";
 #endif
 
 /****************************************************/
@@ -76,8 +104,25 @@ struct arguments
 	int exercice;
 	char * config_file;
 	int scaling;
+	lbm_sparse_mode_t sparse;
+	char * restart_file;
+	int ghost_depth;
+	char * ensemble_file;
+	int group_size;
 };
 
+/****************************************************/
+/** Summary of a finished case, gathered in the ensemble index. **/
+typedef struct lbm_case_result_s
+{
+	/** Time spent in the time steps (s). **/
+	double time;
+	/** Number of computed steps. **/
+	long steps;
+	/** Stopped by the convergence criterion. **/
+	int converged;
+} lbm_case_result_t;
+
 /****************************************************/
 /* Parse a single option. */
 #ifdef HAVE_ARGP
@@ -100,6 +145,24 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 		case 'n':
 			arguments->do_output = false;
 			break;
+		case 'S':
+			arguments->sparse = LBM_SPARSE_EXACT;
+			break;
+		case 'O':
+			arguments->sparse = LBM_SPARSE_SURFACE;
+			break;
+		case 'r':
+			arguments->restart_file = arg;
+			break;
+		case 'g':
+			arguments->ghost_depth = atoi(arg);
+			break;
+		case 'E':
+			arguments->ensemble_file = arg;
+			break;
+		case 'G':
+			arguments->group_size = atoi(arg);
+			break;
 		case ARGP_KEY_ARG:
 			argp_usage (state);
 			break;
@@ -151,7 +214,7 @@ void print_help_message(char ** argv)
 void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
 {
 	int c;
-	while ( (c = getopt_long(argc, argv, "c:e:s:nh", long_options, NULL)) != -1) {
+	while ( (c = getopt_long(argc, argv, "c:e:s:nSOr:g:E:G:h", long_options, NULL)) != -1) {
 		switch(c) {
 			case 'c':
 				arguments->config_file = strdup(optarg);
@@ -165,6 +228,24 @@ void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
 			case 'n':
 				arguments->do_output = false;
 				break;
+			case 'S':
+				arguments->sparse = LBM_SPARSE_EXACT;
+				break;
+			case 'O':
+				arguments->sparse = LBM_SPARSE_SURFACE;
+				break;
+			case 'r':
+				arguments->restart_file = strdup(optarg);
+				break;
+			case 'g':
+				arguments->ghost_depth = atoi(optarg);
+				break;
+			case 'E':
+				arguments->ensemble_file = strdup(optarg);
+				break;
+			case 'G':
+				arguments->group_size = atoi(optarg);
+				break;
 			case 'h':
 			case '?':
 				print_help_message(argv);
@@ -188,7 +269,80 @@ void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
 #endif //HAVE_ARGP
 
 /****************************************************/
-int main(int argc, char * argv[])
+/**
+ * Move the case on the new cuts chosen by the load balancing : rebuild the communication
+ * structure and all the local structures on the new tile, then migrate the distributions
+ * (and the previous velocity of the analysis) from the old tiles. The output file is
+ * closed and reopened to follow the new tiles, as on restart. The fine nodes of the
+ * local refinement follow the coarse cells they lie on.
+ * @param iteration Last computed step.
+**/
+static void lbm_run_rebalance(lbm_comm_t * comm, lbm_mesh_t * mesh, lbm_mesh_t * temp, lbm_mesh_type_t * mesh_type, lbm_file_mesh_t * save_mesh, lbm_analysis_t * analysis, lbm_refine_t * refine, int iteration)
+{
+	//vars
+	lbm_comm_t old_comm;
+	lbm_mesh_t old_mesh;
+	MPI_Datatype cell_type;
+
+	//finish the writes on the old tiles
+	lbm_save_close(save_mesh, comm);
+	lbm_save_mesh_release(save_mesh);
+
+	//release, keep the old mesh and the old tile geometry
+	lbm_comm_release_ex_select( comm );
+	lbm_mesh_release( temp );
+	lbm_sparse_release( mesh_type );
+	lbm_phys_boundary_release( mesh_type );
+	lbm_mesh_type_t_release( mesh_type );
+	old_comm = *comm;
+	old_mesh = *mesh;
+
+	//new tiles with the forced cuts
+	lbm_comm_init_ex_select( comm, MESH_WIDTH, MESH_HEIGHT);
+	lbm_mesh_init( mesh, lbm_comm_width( comm ), lbm_comm_height( comm ), lbm_comm_depth( comm ) );
+	lbm_mesh_init( temp, lbm_comm_width( comm ), lbm_comm_height( comm ), lbm_comm_depth( comm ) );
+	lbm_mesh_type_t_init( mesh_type, lbm_comm_width( comm ), lbm_comm_height( comm ), lbm_comm_depth( comm ));
+	lbm_init_mesh_state( mesh, mesh_type, comm);
+	lbm_init_mesh_state( temp, mesh_type, comm);
+
+	//move the distributions
+	MPI_Type_contiguous(DIRECTIONS, LBM_MPI_REAL, &cell_type);
+	MPI_Type_commit(&cell_type);
+	lbm_comm_migrate(&old_comm, old_mesh.cells, comm, mesh->cells, cell_type);
+	MPI_Type_free(&cell_type);
+	lbm_mesh_release( &old_mesh );
+
+	//cell lists
+	lbm_phys_boundary_build(mesh_type, comm);
+	if (SPARSE_MODE)
+		lbm_sparse_build(mesh_type);
+
+	//fine level, moved as the coarse distributions
+	if (refine->enabled) {
+		lbm_refine_t old_refine = *refine;
+		lbm_refine_init(refine, comm, mesh, mesh_type);
+		lbm_refine_migrate(&old_refine, refine);
+		lbm_refine_release(&old_refine);
+	}
+
+	//analysis
+	if (ANALYSIS_INTERVAL > 0)
+		lbm_analysis_remap(analysis, &old_comm, comm);
+
+	//continue the output file
+	lbm_save_mesh_init(save_mesh, comm);
+	lbm_open_output_file(comm);
+	lbm_save_resume(save_mesh, comm, iteration / WRITE_STEP_INTERVAL + 1);
+}
+
+/****************************************************/
+/**
+ * Run one case with the selected config (lbm_gbl_config) on the ranks of lbm_comm_world.
+ * @param first_iteration First step to compute (after the one of the checkpoint on restart).
+ * @param verbose Print the progress and the timers, disabled for the ensemble cases.
+ * @param result Receive the time, number of steps and convergence of the run.
+**/
+static void lbm_run_case(const struct arguments * arguments, int first_iteration, bool verbose, lbm_case_result_t * result)
 {
 	//vars
 	lbm_mesh_t mesh;
@@ -196,84 +350,77 @@ int main(int argc, char * argv[])
 	lbm_mesh_type_t mesh_type;
 	lbm_comm_t comm;
 	lbm_file_mesh_t save_mesh;
-	int i, rank, comm_size;
-	const char * config_filename = NULL;
+	lbm_analysis_t analysis;
+	lbm_balance_t balance;
+	lbm_refine_t refine;
+	int i, rank;
 
-	//init MPI and get current rank and commuincator size.
-	MPI_Init( &argc, &argv );
-	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
-
-	//parse args
-	struct arguments arguments = {
-		.do_output = true,
-		.exercice = 0,
-		.config_file = "config.txt",
-		.scaling = 1,
-	};
-	parse_prgm_arguments(&arguments, argc, argv);
+	//rank in the case
+	MPI_Comm_rank( lbm_comm_world, &rank );
+	result->converged = 0;
 
 	//dispatch
-	config_filename = arguments.config_file;
+	lbm_ex_select(arguments->exercice);
 
-	//load config file and display it on master node
-	lbm_config_init(config_filename);
+	//threads
+	#ifdef _OPENMP
+		if (rank == RANK_MASTER && verbose)
+			printf("OpenMP threads per rank: %d\n", omp_get_max_threads());
+	#endif
 
-	//apply option
-	if (arguments.do_output == false)
-		RESULT_FILENAME = NULL;
-
-	//apply scaling
-	if (arguments.scaling > 1) {
-		//apply
-		double factor = sqrt((double)arguments.scaling);
-		MESH_WIDTH = (double)MESH_WIDTH * factor;
-		MESH_HEIGHT = (double)MESH_HEIGHT * factor;
-
-		//make multiple of
-		if (MESH_WIDTH % comm_size != 0)
-			MESH_WIDTH += comm_size - MESH_WIDTH % comm_size;
-		if (MESH_HEIGHT % comm_size != 0)
-			MESH_HEIGHT -= MESH_HEIGHT % comm_size;
-
-		//recompute obstable
-		lbm_gbl_config.obstacle_r = (lbm_gbl_config.height / 10.0 + 1.0);
-		lbm_gbl_config.obstacle_y = (lbm_gbl_config.height / 2.0 + 3.0);
-	}
-
-	//print config
-	if (rank == RANK_MASTER)
-		lbm_config_print();
-
-	//dispatch
-	lbm_ex_select(arguments.exercice);
+	//obstacle geometry, needed by the fluid split
+	lbm_obstacle_load();
 
 	//init structures, allocate memory...
 	lbm_comm_init_ex_select( &comm, MESH_WIDTH, MESH_HEIGHT);
-	lbm_mesh_init( &mesh, lbm_comm_width( &comm ), lbm_comm_height( &comm ) );
-	lbm_mesh_init( &temp, lbm_comm_width( &comm ), lbm_comm_height( &comm ) );
-	lbm_mesh_type_t_init( &mesh_type, lbm_comm_width( &comm ), lbm_comm_height( &comm ));
+	lbm_mesh_init( &mesh, lbm_comm_width( &comm ), lbm_comm_height( &comm ), lbm_comm_depth( &comm ) );
+	lbm_mesh_init( &temp, lbm_comm_width( &comm ), lbm_comm_height( &comm ), lbm_comm_depth( &comm ) );
+	lbm_mesh_type_t_init( &mesh_type, lbm_comm_width( &comm ), lbm_comm_height( &comm ), lbm_comm_depth( &comm ));
 	lbm_save_mesh_init(&save_mesh, &comm);
 
-	//truncate file
-	if (RESULT_FILENAME != NULL) {
+	//truncate file (keep the frames of the interrupted run on restart)
+	if (RESULT_FILENAME != NULL && arguments->restart_file == NULL) {
 		if (rank == RANK_MASTER)
 			unlink(RESULT_FILENAME);
 		usleep(1000);
-		MPI_Barrier(MPI_COMM_WORLD);
+		MPI_Barrier(lbm_comm_world);
 	}
 
 	//master open the output file
 	//if( rank == RANK_MASTER )
 	lbm_open_output_file(&comm);
-	MPI_Barrier(MPI_COMM_WORLD);
+	MPI_Barrier(lbm_comm_world);
 
 	//setup initial conditions on mesh
 	lbm_init_mesh_state( &mesh, &mesh_type, &comm);
 	lbm_init_mesh_state( &temp, &mesh_type, &comm);
 
+	//restore the state of the interrupted run
+	if (arguments->restart_file != NULL) {
+		lbm_checkpoint_read(arguments->restart_file, &mesh, &mesh_type, &comm);
+		lbm_save_resume(&save_mesh, &comm, (first_iteration - 1) / WRITE_STEP_INTERVAL + 1);
+		if (rank == RANK_MASTER)
+			printf("Restart from %s at iteration %d\n", arguments->restart_file, first_iteration);
+	}
+
+	//build the cell lists once the geometry is known
+	lbm_phys_boundary_build(&mesh_type, &comm);
+	if (SPARSE_MODE) {
+		lbm_sparse_build(&mesh_type);
+		lbm_sparse_print_stats(&mesh_type);
+	}
+
+	//fine level around the obstacle, started from the coarse state
+	lbm_refine_init(&refine, &comm, &mesh, &mesh_type);
+	if (verbose)
+		lbm_refine_print_stats(&refine);
+
+	//in-situ analysis
+	if (ANALYSIS_INTERVAL > 0)
+		lbm_analysis_init(&analysis, &comm, &mesh, (arguments->restart_file != NULL) ? first_iteration - 1 : 0);
+
 	//write initial condition in output file
-	if (lbm_gbl_config.output_filename != NULL)
+	if (lbm_gbl_config.output_filename != NULL && arguments->restart_file == NULL)
 		lbm_save_ex_select(&save_mesh, &comm, &mesh, &mesh_type, 0 / WRITE_STEP_INTERVAL);
 
 	//start time
@@ -285,24 +432,66 @@ int main(int argc, char * argv[])
 	clock_gettime(CLOCK_MONOTONIC, &full_start);
 
 	//time steps
-	for ( i = 1 ; i < ITERATIONS ; i++ )
+	long steps = 0;
+	lbm_timer_reset();
+	lbm_balance_init(&balance);
+	for ( i = first_iteration ; i < ITERATIONS ; i++ )
 	{
 		//compute
+		if (refine.enabled)
+			lbm_refine_save(&refine, &mesh);
 		lbm_do_step_ex_select(&comm, &mesh_type, &mesh, &temp );
+		if (refine.enabled)
+			lbm_refine_step(&refine, &mesh);
+		steps++;
 
 		//save step
-		if ( i % WRITE_STEP_INTERVAL == 0 && lbm_gbl_config.output_filename != NULL )
+		if ( i % WRITE_STEP_INTERVAL == 0 && lbm_gbl_config.output_filename != NULL ) {
+			double phase_start = lbm_timer_now();
 			lbm_save_ex_select(&save_mesh, &comm, &mesh, &mesh_type, i / WRITE_STEP_INTERVAL);
+			lbm_timer_add(LBM_TIMER_SAVE, phase_start);
+		}
+
+		//checkpoint step
+		if ( CHECKPOINT_INTERVAL > 0 && i % CHECKPOINT_INTERVAL == 0 ) {
+			double phase_start = lbm_timer_now();
+			lbm_checkpoint_write(CHECKPOINT_FILENAME, &mesh, &mesh_type, &comm, i);
+			lbm_timer_add(LBM_TIMER_CHECKPOINT, phase_start);
+		}
+
+		//analysis step, stop on convergence
+		if ( ANALYSIS_INTERVAL > 0 && i % ANALYSIS_INTERVAL == 0 ) {
+			double phase_start = lbm_timer_now();
+			int converged = lbm_analysis_run(&analysis, &comm, &mesh, &mesh_type, i);
+			lbm_timer_add(LBM_TIMER_ANALYSIS, phase_start);
+			if (converged) {
+				if (rank == RANK_MASTER && verbose)
+					printf("Converged at iteration %d (residual %g)\n", i, analysis.values.residual);
+				result->converged = 1;
+				break;
+			}
+		}
+
+		//load balancing step (between two exchanges with deep ghost layers)
+		if ( BALANCE_INTERVAL > 0 && i % BALANCE_INTERVAL == 0 && comm.ghost_step == 0 ) {
+			double phase_start = lbm_timer_now();
+			if (lbm_balance_check(&balance, &comm, steps)) {
+				lbm_run_rebalance(&comm, &mesh, &temp, &mesh_type, &save_mesh, &analysis, &refine, i);
+				if (rank == RANK_MASTER && verbose)
+					printf("Rebalance at iteration %d (imbalance %.3f)\n", i, balance.imbalance);
+			}
+			lbm_timer_add(LBM_TIMER_BALANCE, phase_start);
+		}
 		
 		//print progress
-		if( rank == RANK_MASTER && i % WRITE_STEP_INTERVAL == 0 ) {
+		if( rank == RANK_MASTER && verbose && i % WRITE_STEP_INTERVAL == 0 ) {
 			//compute delta
 			struct timespec stop;
 			clock_gettime(CLOCK_MONOTONIC, &stop);
-			double result = timespec_diff(&stop, &start);
+			double elapsed = timespec_diff(&stop, &start);
 
 			//printf
-			printf("Progress [%5d / %5d] (%g s)\n",i,ITERATIONS, result);
+			printf("Progress [%5d / %5d] (%g s)\n",i,ITERATIONS, elapsed);
 
 			//copy back
 			start = stop;
@@ -313,19 +502,311 @@ int main(int argc, char * argv[])
 	struct timespec full_stop;
 	clock_gettime(CLOCK_MONOTONIC, &full_stop);
 	double full_time = timespec_diff(&full_stop, &full_start);
-	if (rank == 0)
-		printf("Total time: %g seconds\n", full_time);
+	result->time = full_time;
+	result->steps = steps;
+
+	//per phase timers and update rate
+	if (verbose) {
+		if (rank == 0)
+			printf("Total time: %g seconds\n", full_time);
+		lbm_timer_report(full_time, steps, (long)MESH_WIDTH * MESH_HEIGHT * MESH_DEPTH + lbm_refine_updates(&refine));
+		if (BALANCE_INTERVAL > 0)
+			lbm_balance_report(&balance, steps);
+	}
 
-	//close file
-	if (RESULT_FILENAME != NULL)
-		MPI_File_close(&comm.file_handler);
+	//close file (wait the last writes first)
+	lbm_save_close(&save_mesh, &comm);
 
 	//free memory
 	lbm_comm_release_ex_select( &comm );
 	lbm_mesh_release( &mesh );
 	lbm_mesh_release( &temp );
+	lbm_sparse_release( &mesh_type );
+	lbm_phys_boundary_release( &mesh_type );
 	lbm_mesh_type_t_release( &mesh_type );
 	lbm_save_mesh_release(&save_mesh);
+	lbm_refine_release(&refine);
+	lbm_obstacle_release();
+	if (ANALYSIS_INTERVAL > 0)
+		lbm_analysis_release(&analysis);
+
+	//next case starts from the configured cuts
+	lbm_comm_force_split(NULL, 0, NULL, 0);
+}
+
+/****************************************************/
+/**
+ * Name of a per case output file : "out.raw" becomes "out.case0003.raw".
+**/
+static char * lbm_ensemble_case_filename(const char * filename, int id)
+{
+	//vars
+	const char * slash = strrchr(filename, '/');
+	const char * dot = strrchr(filename, '.');
+	size_t size = strlen(filename) + 32;
+	char * res = malloc(size);
+
+	//no extension, append
+	if (dot == NULL || (slash != NULL && dot < slash))
+		dot = filename + strlen(filename);
+	snprintf(res, size, "%.*s.case%04d%s", (int)(dot - filename), filename, id, dot);
+	return res;
+}
+
+/****************************************************/
+/**
+ * Load the cases of an ensemble, one non empty line per case, '#' for comments.
+ * @return Number of cases, the lines are stored in *cases.
+**/
+static int lbm_ensemble_load(const char * filename, char *** cases)
+{
+	//vars
+	FILE * fp;
+	char buffer[4096];
+	int count = 0;
+
+	//open
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+	{
+		perror(filename);
+		abort();
+	}
+
+	//load lines
+	*cases = NULL;
+	while (fgets(buffer, sizeof(buffer), fp) != NULL)
+	{
+		buffer[strcspn(buffer, "\r\n")] = '\0';
+		if (buffer[strspn(buffer, " \t")] == '\0' || buffer[0] == '#')
+			continue;
+		*cases = realloc(*cases, sizeof(char*) * (count + 1));
+		(*cases)[count++] = strdup(buffer);
+	}
+	fclose(fp);
+
+	//check
+	if (count == 0)
+		fatal("No case in the ensemble file !");
+
+	return count;
+}
+
+/****************************************************/
+/**
+ * Build the config of a case : the base config with one output file per case, then
+ * the overrides of the case line ("key = value; key = value" with the keys of the
+ * config file).
+**/
+static void lbm_ensemble_case_config(lbm_config_t * config, const lbm_config_t * base, const char * overrides, int id)
+{
+	//vars
+	char * line = strdup(overrides);
+	char * item;
+	char * save;
+	char * name;
+
+	//base config
+	lbm_config_copy(config, base);
+
+	//one set of files per case
+	if (config->output_filename != NULL) {
+		name = lbm_ensemble_case_filename(config->output_filename, id);
+		free((void*)config->output_filename);
+		config->output_filename = name;
+	}
+	if (config->checkpoint_filename != NULL) {
+		name = lbm_ensemble_case_filename(config->checkpoint_filename, id);
+		free((void*)config->checkpoint_filename);
+		config->checkpoint_filename = name;
+	}
+	if (config->analysis_filename != NULL) {
+		name = lbm_ensemble_case_filename(config->analysis_filename, id);
+		free((void*)config->analysis_filename);
+		config->analysis_filename = name;
+	}
+
+	//overrides
+	for (item = strtok_r(line, ";", &save) ; item != NULL ; item = strtok_r(NULL, ";", &save))
+	{
+		item += strspn(item, " \t");
+		if (*item != '\0')
+			lbm_config_parse_line(config, item, id + 1);
+	}
+	lbm_config_drived_parameters(config);
+
+	//free
+	free(line);
+}
+
+/****************************************************/
+/**
+ * Run all the cases of an ensemble in one job. The ranks are split in groups of
+ * group_size ranks, each group runs the cases id % nb_groups == group one after the
+ * other on its own communicator (lbm_comm_world). The MPI startup and the base config
+ * are shared, and the master writes one index of all the cases at the end.
+**/
+static void lbm_ensemble_run(const struct arguments * arguments, const lbm_config_t * base)
+{
+	//vars
+	int rank, comm_size, group_rank, c;
+	int nb_groups, group;
+	int nb_cases;
+	char ** cases;
+	char index_filename[1024];
+	lbm_config_t config;
+	lbm_case_result_t result;
+
+	//check
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+	if (arguments->group_size < 1 || comm_size % arguments->group_size != 0)
+		fatal("The number of ranks must be a multiple of the group size !");
+	if (arguments->restart_file != NULL)
+		fatal("Restart is not supported in ensemble mode !");
+
+	//groups
+	nb_groups = comm_size / arguments->group_size;
+	group = rank / arguments->group_size;
+	MPI_Comm_split(MPI_COMM_WORLD, group, rank, &lbm_comm_world);
+	MPI_Comm_rank( lbm_comm_world, &group_rank );
+
+	//cases
+	nb_cases = lbm_ensemble_load(arguments->ensemble_file, &cases);
+	double * values = calloc(3 * nb_cases, sizeof(double));
+	double * gathered = calloc(3 * nb_cases, sizeof(double));
+	if (rank == RANK_MASTER)
+		printf("Ensemble of %d cases on %d groups of %d ranks\n", nb_cases, nb_groups, arguments->group_size);
+
+	//run the cases of the group
+	for (c = group ; c < nb_cases ; c += nb_groups)
+	{
+		lbm_ensemble_case_config(&config, base, cases[c], c);
+		lbm_config_select(&config);
+		lbm_run_case(arguments, 1, false, &result);
+		if (group_rank == RANK_MASTER) {
+			values[3 * c] = result.time;
+			values[3 * c + 1] = result.steps;
+			values[3 * c + 2] = result.converged;
+			printf("Case %d / %d (group %d) : %ld steps in %g s%s\n", c + 1, nb_cases, group, result.steps, result.time, result.converged ? ", converged" : "");
+		}
+		lbm_config_cleanup(&config);
+	}
+
+	//one index for all the cases
+	MPI_Reduce(values, gathered, 3 * nb_cases, MPI_DOUBLE, MPI_SUM, RANK_MASTER, MPI_COMM_WORLD);
+	if (rank == RANK_MASTER) {
+		snprintf(index_filename, sizeof(index_filename), "%s.index.csv", arguments->ensemble_file);
+		FILE * fp = fopen(index_filename, "w");
+		if (fp == NULL) {
+			perror(index_filename);
+			abort();
+		}
+		fprintf(fp, "case,group,reynolds,inflow_max_velocity,width,height,steps,time,converged,output_filename,overrides\n");
+		for (c = 0 ; c < nb_cases ; c++)
+		{
+			lbm_ensemble_case_config(&config, base, cases[c], c);
+			fprintf(fp, "%d,%d,%g,%g,%d,%d,%ld,%g,%d,%s,\"%s\"\n", c, c % nb_groups, config.reynolds, config.inflow_max_velocity,
+				config.width, config.height, (long)gathered[3 * c + 1], gathered[3 * c], (int)gathered[3 * c + 2],
+				(config.output_filename == NULL) ? "" : config.output_filename, cases[c]);
+			lbm_config_cleanup(&config);
+		}
+		fclose(fp);
+		printf("Ensemble index written in %s\n", index_filename);
+	}
+
+	//free
+	for (c = 0 ; c < nb_cases ; c++)
+		free(cases[c]);
+	free(cases);
+	free(values);
+	free(gathered);
+	MPI_Comm_free(&lbm_comm_world);
+	lbm_comm_world = MPI_COMM_WORLD;
+}
+
+/****************************************************/
+int main(int argc, char * argv[])
+{
+	//vars
+	lbm_config_t config;
+	lbm_case_result_t result;
+	int rank, comm_size, thread_support;
+	int first_iteration = 1;
+
+	//init MPI and get current rank and commuincator size.
+	//only the master thread of the hybrid exercise calls MPI
+	MPI_Init_thread( &argc, &argv, MPI_THREAD_FUNNELED, &thread_support );
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+
+	//parse args
+	struct arguments arguments = {
+		.do_output = true,
+		.exercice = 0,
+		.config_file = "config.txt",
+		.scaling = 1,
+		.sparse = LBM_SPARSE_NONE,
+		.restart_file = NULL,
+		.ghost_depth = 0,
+		.ensemble_file = NULL,
+		.group_size = 1,
+	};
+	parse_prgm_arguments(&arguments, argc, argv);
+
+	//the other exercises run without threads in MPI, ex7 checks the level itself in lbm_comm_init_ex7()
+	if (thread_support < MPI_THREAD_FUNNELED && arguments.exercice != 7 && rank == RANK_MASTER)
+		warning("The MPI library does not provide MPI_THREAD_FUNNELED, only single threaded MPI is used.");
+
+	//load config file
+	lbm_config_load(&config, arguments.config_file);
+
+	//apply option
+	if (arguments.do_output == false) {
+		free((void*)config.output_filename);
+		config.output_filename = NULL;
+	}
+	if (arguments.sparse != LBM_SPARSE_NONE)
+		config.sparse = arguments.sparse;
+	if (arguments.ghost_depth > 0)
+		config.ghost_depth = arguments.ghost_depth;
+
+	//apply scaling
+	if (arguments.scaling > 1) {
+		//apply
+		double factor = sqrt((double)arguments.scaling);
+		config.width = (double)config.width * factor;
+		config.height = (double)config.height * factor;
+
+		//recompute obstable
+		config.obstacle_r = (config.height / 10.0 + 1.0);
+		config.obstacle_y = (config.height / 2.0 + 3.0);
+	}
+
+	//many cases in one job
+	if (arguments.ensemble_file != NULL) {
+		lbm_ensemble_run(&arguments, &config);
+		lbm_config_cleanup(&config);
+		MPI_Finalize();
+		return EXIT_SUCCESS;
+	}
+
+	//single case
+	lbm_config_select(&config);
+
+	//the mesh size and physical parameters come from the checkpoint
+	if (arguments.restart_file != NULL)
+		first_iteration = lbm_checkpoint_load_config(arguments.restart_file) + 1;
+
+	//print config
+	if (rank == RANK_MASTER)
+		lbm_config_print(&lbm_gbl_config);
+
+	//run
+	lbm_run_case(&arguments, first_iteration, true, &result);
+
+	//free config
+	lbm_config_cleanup(&config);
 
 	//close MPI
 	MPI_Finalize();